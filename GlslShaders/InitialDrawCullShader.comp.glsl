@@ -48,6 +48,14 @@ struct Surface
     vec3 center;
     float radius;
 
+    // Axis aligned bounding box in model space
+    vec3 aabbMin;
+
+    // Normal cone of every triangle of the surface (4 signed bytes). Not used by this shader
+    uint cone;
+
+    vec3 aabbMax;
+
     // Holds up to 8 level of detail data structs
     MeshLod lod[8];
     
@@ -58,6 +66,13 @@ struct Surface
     uint vertexOffset;
 
     uint materialTag;
+
+    uint8_t postPass;
+    uint8_t indices16;
+
+    // Cluster lod hierarchy, not used by this renderer
+    uint firstLodCluster;
+    uint lodClusterCount;
 };
 
 layout(std430, binding = 2) readonly buffer SurfaceBuffer
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdio.h>
+#include <cstdint>
+
+namespace BlitzenTest
+{
+    // Returned from main by tests that cannot run on this machine, ctest reports them as skipped (SKIP_RETURN_CODE)
+    constexpr int ce_testSkipped = 77;
+
+    // Failed checks of the test that is running
+    inline uint32_t s_failedChecks = 0;
+
+    // Return value of main, 1 if any check failed
+    inline int TestResult(const char* testName)
+    {
+        if(s_failedChecks)
+        {
+            printf("%s: %u checks failed\n", testName, s_failedChecks);
+            return 1;
+        }
+
+        printf("%s: passed\n", testName);
+        return 0;
+    }
+}
+
+// Prints the expression and counts the failure, the test keeps going so that every failed check is reported
+#define BLIT_TEST_CHECK(expr)                                                                   \
+                        if(expr){}                                                              \
+                        else                                                                    \
+                        {                                                                       \
+                            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);    \
+                            ++BlitzenTest::s_failedChecks;                                      \
+                        }
@@ -0,0 +1,106 @@
+// Checks that AsyncReadRange puts every byte of the range where it belongs, for ranges that take many chunks,
+// a queue that is too small to hold all of them and ranges that do not start or end on a chunk.
+// Uses io_uring where the kernel allows it and the worker threads otherwise, the test passes with either
+#include "Platform/asyncIO.h"
+#include "blitTest.h"
+
+#include <string.h>
+#include <vector>
+
+namespace BlitzenTest
+{
+    // Several chunks of the default size and a partial one
+    constexpr size_t ce_asyncTestFileSize = 3 * BlitzenPlatform::ce_asyncIORangeChunkSize + 12'345;
+
+    // Depth of the queue that is too small for the reads of a whole file
+    constexpr uint32_t ce_asyncTestSmallQueueDepth = 3;
+
+    static uint8_t FileByte(size_t i)
+    {
+        return static_cast<uint8_t>(i * 31 + 7 + (i >> 13));
+    }
+
+    static uint8_t WriteTestFile(const char* path)
+    {
+        std::vector<uint8_t> bytes(ce_asyncTestFileSize);
+        for(size_t i = 0; i < bytes.size(); ++i)
+            bytes[i] = FileByte(i);
+
+        FILE* pFile = fopen(path, "wb");
+        if(!pFile)
+            return 0;
+        size_t written = fwrite(bytes.data(), 1, bytes.size(), pFile);
+        fclose(pFile);
+        return written == bytes.size();
+    }
+
+    static uint8_t SameBytes(const std::vector<uint8_t>& bytes, uint64_t offset)
+    {
+        for(size_t i = 0; i < bytes.size(); ++i)
+        {
+            if(bytes[i] != FileByte(offset + i))
+                return 0;
+        }
+        return 1;
+    }
+
+    static void TestReadRanges(BlitzenPlatform::AsyncIOQueue& queue, BlitzenPlatform::AsyncFile& file)
+    {
+        struct Range
+        {
+            uint64_t offset;
+            size_t size;
+            size_t chunkSize;
+        };
+        const Range ranges[] = {
+            {0, ce_asyncTestFileSize, BlitzenPlatform::ce_asyncIORangeChunkSize},
+            {0, ce_asyncTestFileSize, 64 * 1024},
+            {4'097, ce_asyncTestFileSize - 4'097 - 3, 100'000},
+            {ce_asyncTestFileSize - 1, 1, 64 * 1024},
+            {123, 0, 64 * 1024}};
+
+        for(const Range& range : ranges)
+        {
+            // The byte after the range should be left alone
+            std::vector<uint8_t> bytes(range.size + 1, 0xcd);
+            BLIT_TEST_CHECK(BlitzenPlatform::AsyncReadRange(queue, file, range.offset, range.size, bytes.data(), range.chunkSize))
+            BLIT_TEST_CHECK(bytes.back() == 0xcd)
+            bytes.pop_back();
+            BLIT_TEST_CHECK(SameBytes(bytes, range.offset))
+            BLIT_TEST_CHECK(queue.GetPendingCount() == 0)
+        }
+
+        // Past the end of the file
+        std::vector<uint8_t> bytes(1024);
+        BLIT_TEST_CHECK(!BlitzenPlatform::AsyncReadRange(queue, file, ce_asyncTestFileSize - 10, 11, bytes.data()))
+        BLIT_TEST_CHECK(queue.GetPendingCount() == 0)
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace BlitzenTest;
+
+    if(argc < 2 || !WriteTestFile(argv[1]))
+    {
+        printf("The test file could not be written\n");
+        return 1;
+    }
+
+    BlitzenPlatform::AsyncFile file;
+    BLIT_TEST_CHECK(file.Open(argv[1]))
+    BLIT_TEST_CHECK(file.GetSize() == ce_asyncTestFileSize)
+
+    const uint32_t queueDepths[] = {BlitzenPlatform::ce_asyncIODefaultQueueDepth, ce_asyncTestSmallQueueDepth};
+    for(uint32_t queueDepth : queueDepths)
+    {
+        BlitzenPlatform::AsyncIOQueue queue;
+        BLIT_TEST_CHECK(queue.Init(queueDepth))
+        TestReadRanges(queue, file);
+        queue.Shutdown();
+    }
+
+    file.Close();
+    remove(argv[1]);
+    return TestResult("AsyncReadRange");
+}
@@ -0,0 +1,698 @@
+// Checks the CPU culling path against the culling shaders on a random reference scene.
+// ShaderDrawCull is InitialDrawCull.comp.glsl and LateDrawCull.comp.glsl written out one object at a time, in object order,
+// so the commands, counts and visibilities of CpuDrawCull should be the same to the bit for every setting and thread count
+#include "Renderer/blitCpuFrame.h"
+#include "BlitzenMathLibrary/blitMLRandom.h"
+#include "blitTest.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+namespace BlitzenTest
+{
+    using namespace BlitzenEngine;
+
+    constexpr uint64_t ce_cullTestSeed = 45;
+    constexpr uint32_t ce_cullTestSurfaceCount = 64;
+    constexpr uint32_t ce_cullTestTransformCount = 10'007;
+
+    // Not a multiple of the block size, so that the last block of every thread is a partial one
+    constexpr uint32_t ce_cullTestObjectCount = 20'011;
+
+    // Every transform whose id is a multiple of this is dynamic
+    constexpr uint32_t ce_cullTestDynamicInterval = 5;
+
+    // Each bit of a configuration is one of the settings that the shaders get from their macros and push constants
+    constexpr uint32_t ce_cullTestConfigCount = 32;
+
+    struct ReferenceScene
+    {
+        std::vector<SurfaceCullData> surfaces;
+        std::vector<SurfaceLodDraw> lodDraws;
+        std::vector<MeshTransform> transforms;
+        std::vector<RenderObject> renders;
+
+        BlitCL::DynamicArray<uint32_t> dynamicTransforms;
+        BlitCL::DynamicArray<RenderWorldBounds> worldBounds;
+
+        // Visibilities of a last frame, about half of the objects
+        std::vector<uint32_t> visibilities;
+
+        CameraViewData view;
+    };
+
+    // A camera at position turned by yaw radians around the y axis, with the frustum planes of a 16:9 perspective projection
+    static CameraViewData ReferenceView(const BlitML::vec3& position, float yaw, float zFar)
+    {
+        CameraViewData view = {};
+        view.viewMatrix = BlitML::mat4();
+        float* m = view.viewMatrix.data;
+        m[0] = cosf(yaw);
+        m[8] = sinf(yaw);
+        m[2] = -sinf(yaw);
+        m[10] = cosf(yaw);
+        m[12] = -(m[0] * position.x + m[8] * position.z);
+        m[13] = -position.y;
+        m[14] = -(m[2] * position.x + m[10] * position.z);
+
+        float proj5 = 1.f / tanf(0.6f);
+        float proj0 = proj5 / (16.f / 9.f);
+        view.frustumRight = proj0 / sqrtf(proj0 * proj0 + 1.f);
+        view.frustumLeft = 1.f / sqrtf(proj0 * proj0 + 1.f);
+        view.frustumTop = proj5 / sqrtf(proj5 * proj5 + 1.f);
+        view.frustumBottom = 1.f / sqrtf(proj5 * proj5 + 1.f);
+        view.proj0 = proj0;
+        view.proj5 = proj5;
+        view.zNear = 1.f;
+        view.zFar = zFar;
+        view.lodTarget = 0.002f;
+        return view;
+    }
+
+    static void BuildReferenceScene(ReferenceScene& scene)
+    {
+        BlitML::RandomState random = BlitML::RandomStream(ce_cullTestSeed, 0);
+
+        // Surfaces with every flag combination, lod chain length and normal cone
+        scene.surfaces.resize(ce_cullTestSurfaceCount);
+        scene.lodDraws.resize(size_t(ce_cullTestSurfaceCount) * ce_primitiveSurfaceMaxLODCount);
+        for(uint32_t i = 0; i < ce_cullTestSurfaceCount; ++i)
+        {
+            SurfaceCullData& surface = scene.surfaces[i];
+            surface.center = BlitML::vec3(BlitML::RandomFloatInRange(random, -1.f, 1.f), BlitML::RandomFloatInRange(random, -1.f, 1.f),
+            BlitML::RandomFloatInRange(random, -1.f, 1.f));
+            surface.radius = BlitML::RandomFloatInRange(random, 0.5f, 3.f);
+            surface.lodCount = static_cast<uint8_t>(1 + BlitML::RandomUint32Below(random, ce_primitiveSurfaceMaxLODCount));
+            surface.flags = static_cast<uint8_t>(BlitML::RandomUint32Below(random, 4));
+
+            float error = 0.f;
+            for(uint32_t lod = 0; lod < ce_primitiveSurfaceMaxLODCount - 1; ++lod)
+            {
+                error += BlitML::RandomFloat(random) * 0.05f;
+                surface.lodErrors[lod] = meshopt_quantizeHalf(error);
+            }
+
+            // The box is inside the sphere, like the ones of imported surfaces
+            float center[3] = {surface.center.x, surface.center.y, surface.center.z};
+            for(uint32_t axis = 0; axis < 3; ++axis)
+            {
+                surface.aabbMin[axis] = QuantizeHalfConservative(center[axis] - surface.radius * BlitML::RandomFloatInRange(random, 0.1f, 0.57f), 0);
+                surface.aabbMax[axis] = QuantizeHalfConservative(center[axis] + surface.radius * BlitML::RandomFloatInRange(random, 0.1f, 0.57f), 1);
+                surface.coneAxis[axis] = static_cast<int8_t>(int32_t(BlitML::RandomUint32Below(random, 255)) - 127);
+            }
+            surface.coneCutoff = static_cast<int8_t>(int32_t(BlitML::RandomUint32Below(random, 255)) - 127);
+
+            for(uint32_t lod = 0; lod < ce_primitiveSurfaceMaxLODCount; ++lod)
+            {
+                scene.lodDraws[i * ce_primitiveSurfaceMaxLODCount + lod] = {BlitML::RandomUint32(random), BlitML::RandomUint32(random),
+                BlitML::RandomUint32(random)};
+            }
+        }
+
+        // Objects all around the camera, many of them behind it, past the far plane or crossing a plane
+        scene.transforms.resize(ce_cullTestTransformCount);
+        for(MeshTransform& transform : scene.transforms)
+        {
+            transform.pos = BlitML::vec3(BlitML::RandomFloatInRange(random, -600.f, 600.f), BlitML::RandomFloatInRange(random, -600.f, 600.f),
+            BlitML::RandomFloatInRange(random, -200.f, 1200.f));
+            transform.scale = BlitML::RandomFloatInRange(random, 0.3f, 5.f);
+            transform.orientation = BlitML::RandomQuat(random);
+        }
+
+        scene.renders.resize(ce_cullTestObjectCount);
+        for(RenderObject& render : scene.renders)
+        {
+            render.transformId = BlitML::RandomUint32Below(random, ce_cullTestTransformCount);
+            render.surfaceId = BlitML::RandomUint32Below(random, ce_cullTestSurfaceCount);
+        }
+
+        for(uint32_t i = 0; i < ce_cullTestTransformCount; i += ce_cullTestDynamicInterval)
+            scene.dynamicTransforms.PushBack(i);
+        BuildRenderWorldBounds(scene.renders.data(), ce_cullTestObjectCount, scene.transforms.data(), scene.transforms.size(),
+        scene.surfaces.data(), scene.dynamicTransforms, scene.worldBounds);
+
+        scene.visibilities.resize(ce_cullTestObjectCount);
+        for(uint32_t& visibility : scene.visibilities)
+            visibility = BlitML::RandomUint32Below(random, 2);
+
+        scene.view = ReferenceView(BlitML::vec3(-5.f, 3.f, -20.f), 0.3f, 800.f);
+    }
+
+    static CpuCullScene ReferenceCullScene(ReferenceScene& scene, uint8_t bWorldBounds)
+    {
+        CpuCullScene cull;
+        cull.pRenders = scene.renders.data();
+        cull.renderCount = ce_cullTestObjectCount;
+        cull.pTransforms = scene.transforms.data();
+        cull.pSurfaces = scene.surfaces.data();
+        cull.pLodDraws = scene.lodDraws.data();
+        cull.pWorldBounds = bWorldBounds ? scene.worldBounds.Data() : nullptr;
+        return cull;
+    }
+
+    static CpuCullSettings ConfigSettings(uint32_t config)
+    {
+        CpuCullSettings settings;
+        settings.bLatePass = config & 1;
+        settings.bPostPass = (config >> 1) & 1;
+        settings.bOcclusion = (config >> 2) & 1;
+        settings.bLod = (config >> 3) & 1;
+        settings.bConeCulling = (config >> 4) & 1;
+        return settings;
+    }
+
+    /*----------------------------------------
+        The shaders, one object at a time
+    ----------------------------------------*/
+
+    // (viewData.view * vec4(v, w)).xyz
+    static BlitML::vec3 ViewMul(const CameraViewData& view, const BlitML::vec3& v, float w)
+    {
+        const float* m = view.viewMatrix.data;
+        return BlitML::vec3(m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12] * w, m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13] * w,
+        m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14] * w);
+    }
+
+    static uint8_t ShaderSphereInFrustum(const CameraViewData& view, const BlitML::vec3& center, float radius)
+    {
+        uint8_t visible = center.z * view.frustumLeft - fabsf(center.x) * view.frustumRight > -radius;
+        visible = visible && center.z * view.frustumBottom - fabsf(center.y) * view.frustumTop > -radius;
+        visible = visible && center.z + radius > view.zNear && center.z - radius < view.zFar;
+        return visible;
+    }
+
+    static float ShaderBoxProjectedRadius(const BlitML::vec3& direction, const BlitML::vec3 axes[3])
+    {
+        return fabsf(BlitML::Dot(direction, axes[0])) + fabsf(BlitML::Dot(direction, axes[1])) + fabsf(BlitML::Dot(direction, axes[2]));
+    }
+
+    static uint8_t ShaderViewBoxInFrustum(const CameraViewData& view, const BlitML::vec3& center, const BlitML::vec3 axes[3])
+    {
+        BlitML::vec3 sidePlane(center.x >= 0.f ? -view.frustumRight : view.frustumRight, 0.f, view.frustumLeft);
+        BlitML::vec3 verticalPlane(0.f, center.y >= 0.f ? -view.frustumTop : view.frustumTop, view.frustumBottom);
+        float depthRadius = ShaderBoxProjectedRadius(BlitML::vec3(0.f, 0.f, 1.f), axes);
+
+        uint8_t visible = BlitML::Dot(sidePlane, center) > -ShaderBoxProjectedRadius(sidePlane, axes);
+        visible = visible && BlitML::Dot(verticalPlane, center) > -ShaderBoxProjectedRadius(verticalPlane, axes);
+        visible = visible && center.z + depthRadius > view.zNear && center.z - depthRadius < view.zFar;
+        return visible;
+    }
+
+    static uint8_t ShaderBoxInFrustum(const CameraViewData& view, const SurfaceCullData& surface, const MeshTransform& transform)
+    {
+        BlitML::vec3 boxMin(meshopt_dequantizeHalf(surface.aabbMin[0]), meshopt_dequantizeHalf(surface.aabbMin[1]),
+        meshopt_dequantizeHalf(surface.aabbMin[2]));
+        BlitML::vec3 boxMax(meshopt_dequantizeHalf(surface.aabbMax[0]), meshopt_dequantizeHalf(surface.aabbMax[1]),
+        meshopt_dequantizeHalf(surface.aabbMax[2]));
+        BlitML::vec3 extents = (boxMax - boxMin) * 0.5f * transform.scale;
+
+        BlitML::vec3 axes[3] = {
+            ViewMul(view, BlitML::RotateQuat(BlitML::vec3(1.f, 0.f, 0.f), transform.orientation), 0.f) * extents.x,
+            ViewMul(view, BlitML::RotateQuat(BlitML::vec3(0.f, 1.f, 0.f), transform.orientation), 0.f) * extents.y,
+            ViewMul(view, BlitML::RotateQuat(BlitML::vec3(0.f, 0.f, 1.f), transform.orientation), 0.f) * extents.z};
+
+        BlitML::vec3 center = BlitML::RotateQuat((boxMin + boxMax) * 0.5f, transform.orientation) * transform.scale + transform.pos;
+        return ShaderViewBoxInFrustum(view, ViewMul(view, center, 1.f), axes);
+    }
+
+    static uint8_t ShaderWorldBoxInFrustum(const CameraViewData& view, const RenderWorldBounds& bounds)
+    {
+        BlitML::vec3 extents = (bounds.boundsMax - bounds.boundsMin) * 0.5f;
+        const float* m = view.viewMatrix.data;
+        BlitML::vec3 axes[3] = {BlitML::vec3(m[0], m[1], m[2]) * extents.x, BlitML::vec3(m[4], m[5], m[6]) * extents.y,
+        BlitML::vec3(m[8], m[9], m[10]) * extents.z};
+        return ShaderViewBoxInFrustum(view, ViewMul(view, (bounds.boundsMin + bounds.boundsMax) * 0.5f, 1.f), axes);
+    }
+
+    static uint8_t ShaderConeCulled(const CameraViewData& view, const SurfaceCullData& surface, const MeshTransform& transform,
+    const BlitML::vec3& center, float radius)
+    {
+        BlitML::vec3 axis = BlitML::vec3(float(surface.coneAxis[0]), float(surface.coneAxis[1]), float(surface.coneAxis[2])) / 127.f;
+        float cutoff = float(surface.coneCutoff) / 127.f;
+        axis = ViewMul(view, BlitML::RotateQuat(axis, transform.orientation), 0.f);
+        return BlitML::Dot(center, axis) >= cutoff * BlitML::Length(center) + radius;
+    }
+
+    // Both culling shaders for one pass. Without world bounds every object is treated as dynamic
+    static void ShaderDrawCull(const CpuCullScene& scene, const CameraViewData& view, const CpuCullSettings& settings,
+    uint32_t* pVisibilities, CpuDrawCommand* pCommands, CpuDrawCounts& counts)
+    {
+        counts = {0, 0};
+        for(uint32_t objectIndex = 0; objectIndex < scene.renderCount; ++objectIndex)
+        {
+            const RenderObject& object = scene.pRenders[objectIndex];
+            const SurfaceCullData& surface = scene.pSurfaces[object.surfaceId];
+            const MeshTransform& transform = scene.pTransforms[object.transformId];
+            uint32_t postPass = surface.flags & ce_surfaceCullPostPass;
+
+            // The late shader does nothing without OCCLUSION_ENABLED, the initial one skips what was not visible
+            if(settings.bLatePass)
+            {
+                if(!settings.bOcclusion || postPass != settings.bPostPass)
+                    continue;
+            }
+            else if((settings.bOcclusion && pVisibilities[objectIndex] == 0) || postPass)
+                continue;
+
+            RenderWorldBounds worldBounds{};
+            worldBounds.radius = ce_dynamicWorldBounds;
+            if(scene.pWorldBounds)
+                worldBounds = scene.pWorldBounds[objectIndex];
+            uint8_t bStatic = worldBounds.radius >= 0.f;
+
+            BlitML::vec3 center = bStatic ? worldBounds.center :
+            BlitML::RotateQuat(surface.center, transform.orientation) * transform.scale + transform.pos;
+            center = ViewMul(view, center, 1.f);
+            float radius = bStatic ? worldBounds.radius : surface.radius * transform.scale;
+
+            uint8_t visible = ShaderSphereInFrustum(view, center, radius);
+            visible = visible && (bStatic ? ShaderWorldBoxInFrustum(view, worldBounds) : ShaderBoxInFrustum(view, surface, transform));
+            visible = visible && !(settings.bConeCulling && ShaderConeCulled(view, surface, transform, center, radius));
+
+            uint8_t bDraw = visible;
+            if(settings.bLatePass)
+            {
+                bDraw = visible && (pVisibilities[objectIndex] == 0 || settings.bPostPass);
+                pVisibilities[objectIndex] = visible;
+            }
+            if(!bDraw)
+                continue;
+
+            uint32_t lodIndex = 0;
+            if(settings.bLod)
+            {
+                float distance = BlitML::Max(BlitML::Length(center) - radius, 0.f);
+                float threshold = distance * view.lodTarget / transform.scale;
+                for(uint32_t i = 1; i < surface.lodCount; ++i)
+                    if(meshopt_dequantizeHalf(surface.lodErrors[i - 1]) < threshold)
+                        lodIndex = i;
+            }
+            uint32_t lodDrawIndex = object.surfaceId * ce_primitiveSurfaceMaxLODCount + lodIndex;
+            const SurfaceLodDraw& lod = scene.pLodDraws[lodDrawIndex];
+
+            CpuDrawCommand& command = (surface.flags & ce_surfaceCullIndices16) ?
+            pCommands[scene.renderCount + counts.drawCount16++] : pCommands[counts.drawCount++];
+            command.objectId = objectIndex;
+            command.indexCount = lod.indexCount;
+            command.instanceCount = 1;
+            command.firstIndex = lod.firstIndex;
+            command.vertexOffset = lod.vertexOffset;
+            command.firstInstance = settings.bInstancedDraws ? lodDrawIndex : 0;
+        }
+    }
+
+    static uint8_t SameDraws(uint32_t renderCount, const CpuDrawCounts& counts, const CpuDrawCommand* pCommands,
+    const CpuDrawCounts& expectedCounts, const CpuDrawCommand* pExpected)
+    {
+        return counts.drawCount == expectedCounts.drawCount && counts.drawCount16 == expectedCounts.drawCount16 &&
+        memcmp(pCommands, pExpected, counts.drawCount * sizeof(CpuDrawCommand)) == 0 &&
+        memcmp(pCommands + renderCount, pExpected + renderCount, counts.drawCount16 * sizeof(CpuDrawCommand)) == 0;
+    }
+
+    // The DrawBucket shaders, one bucket at a time: the objects of each bucket in the order of their commands, 
+    // then one command for each bucket that has any
+    static void ShaderDrawBuckets(const CpuCullScene& scene, uint32_t surfaceCount, const CpuDrawCommand* pCommands, 
+    const CpuDrawCounts& counts, CpuDrawCommand* pBucketCommands, CpuDrawCounts& bucketCounts, std::vector<uint32_t>& instances)
+    {
+        instances.clear();
+        bucketCounts = {0, 0};
+        for(uint32_t bucket = 0; bucket < surfaceCount * ce_primitiveSurfaceMaxLODCount; ++bucket)
+        {
+            uint32_t firstInstance = static_cast<uint32_t>(instances.size());
+            for(uint32_t i = 0; i < counts.drawCount + counts.drawCount16; ++i)
+            {
+                const CpuDrawCommand& command = i < counts.drawCount ? pCommands[i] : pCommands[scene.renderCount + i - counts.drawCount];
+                if(command.firstInstance == bucket)
+                    instances.push_back(command.objectId);
+            }
+            if(instances.size() == firstInstance)
+                continue;
+
+            const SurfaceLodDraw& lod = scene.pLodDraws[bucket];
+            CpuDrawCommand& command = (scene.pSurfaces[bucket / ce_primitiveSurfaceMaxLODCount].flags & ce_surfaceCullIndices16) ?
+            pBucketCommands[scene.renderCount + bucketCounts.drawCount16++] : pBucketCommands[bucketCounts.drawCount++];
+            command = {bucket, lod.indexCount, static_cast<uint32_t>(instances.size()) - firstInstance, lod.firstIndex, lod.vertexOffset, 
+            firstInstance};
+        }
+    }
+
+    /*----------------------------------------
+        Tests
+    ----------------------------------------*/
+
+    // Every pass and setting, split between 1 thread, a thread count that does not divide the blocks and every hardware thread
+    static void TestCullMatchesShaders(ReferenceScene& reference)
+    {
+        const uint32_t threadCounts[] = {1, 3, 0};
+        uint32_t drawingConfigs = 0;
+        for(uint8_t bWorldBounds = 0; bWorldBounds < 2; ++bWorldBounds)
+        {
+            CpuCullScene scene = ReferenceCullScene(reference, bWorldBounds);
+            for(uint32_t config = 0; config < ce_cullTestConfigCount; ++config)
+            {
+                CpuCullSettings settings = ConfigSettings(config);
+
+                std::vector<uint32_t> expectedVisibilities = reference.visibilities;
+                std::vector<CpuDrawCommand> expectedCommands(size_t(ce_cullTestObjectCount) * 2);
+                CpuDrawCounts expectedCounts;
+                ShaderDrawCull(scene, reference.view, settings, expectedVisibilities.data(), expectedCommands.data(), expectedCounts);
+                drawingConfigs += expectedCounts.drawCount != 0 && expectedCounts.drawCount16 != 0;
+
+                for(uint32_t threadCount : threadCounts)
+                {
+                    std::vector<uint32_t> visibilities = reference.visibilities;
+                    std::vector<CpuDrawCommand> commands(size_t(ce_cullTestObjectCount) * 2);
+                    CpuDrawCounts counts;
+                    CpuDrawCull(scene, reference.view, settings, visibilities.data(), commands.data(), counts, threadCount);
+
+                    BLIT_TEST_CHECK(SameDraws(ce_cullTestObjectCount, counts, commands.data(), expectedCounts, expectedCommands.data()))
+                    BLIT_TEST_CHECK(visibilities == expectedVisibilities)
+                }
+            }
+        }
+
+        // Configurations that draw nothing are the late pass without occlusion. The rest should draw from both index buffers
+        BLIT_TEST_CHECK(drawingConfigs == 2 * ce_cullTestConfigCount * 3 / 4)
+    }
+
+    struct FramePassCheck
+    {
+        ReferenceScene* pReference;
+        std::vector<uint32_t> visibilities;
+        uint32_t passCount;
+    };
+
+    // Runs the pass through the shaders with the visibilities that they would see, and compares
+    static void CheckFramePass(CpuFrameContext& frame, const CpuCullSettings& pass, void* pUserData)
+    {
+        FramePassCheck& check = *static_cast<FramePassCheck*>(pUserData);
+        std::vector<CpuDrawCommand> expectedCommands(size_t(ce_cullTestObjectCount) * 2);
+        CpuDrawCounts expectedCounts;
+        ShaderDrawCull(frame.scene, check.pReference->view, pass, check.visibilities.data(), expectedCommands.data(), expectedCounts);
+
+        BLIT_TEST_CHECK(SameDraws(ce_cullTestObjectCount, frame.counts, frame.commands.Data(), expectedCounts, expectedCommands.data()))
+        BLIT_TEST_CHECK(memcmp(frame.visibilities.Data(), check.visibilities.data(), check.visibilities.size() * sizeof(uint32_t)) == 0)
+        BLIT_TEST_CHECK(frame.stats.passDraws[check.passCount] == expectedCounts.drawCount + expectedCounts.drawCount16)
+        check.passCount++;
+    }
+
+    // A frame runs the passes in the order of the renderer and keeps the visibilities for the next one
+    static void TestFrameMatchesShaders(ReferenceScene& reference)
+    {
+        CpuCullScene scene = ReferenceCullScene(reference, 0);
+        CpuFrameContext frame;
+        CreateCpuFrame(scene, ce_cullTestSurfaceCount, reference.transforms.size(), reference.dynamicTransforms, frame, 3);
+        BLIT_TEST_CHECK(frame.scene.pWorldBounds != nullptr)
+
+        // The shaders cull every object, the hierarchy is compared with them separately
+        frame.bHierarchyCull = 0;
+
+        FramePassCheck check;
+        check.pReference = &reference;
+        check.visibilities.assign(ce_cullTestObjectCount, 0);
+        const uint8_t occlusionSettings[] = {1, 0};
+        for(uint8_t bOcclusion : occlusionSettings)
+        {
+            frame.settings.bOcclusion = bOcclusion;
+            for(uint32_t frameIndex = 0; frameIndex < 2; ++frameIndex)
+            {
+                check.passCount = 0;
+                CpuDrawFrame(frame, reference.view, CheckFramePass, &check);
+                BLIT_TEST_CHECK(check.passCount == (bOcclusion ? ce_cpuFramePassCount : 1u))
+            }
+
+            // The first frame draws nothing in the initial pass, the second one draws what the first one found
+            if(bOcclusion)
+            {
+                BLIT_TEST_CHECK(frame.stats.passDraws[0] != 0)
+                BLIT_TEST_CHECK(frame.stats.passDraws[1] == 0)
+            }
+        }
+    }
+
+    // Every pass of a frame, for frames that are compared after they have run
+    struct FrameRecord
+    {
+        std::vector<CpuDrawCommand> commands[ce_cpuFramePassCount];
+        CpuDrawCounts counts[ce_cpuFramePassCount];
+    };
+
+    static void RecordFramePass(CpuFrameContext& frame, const CpuCullSettings& pass, void* pUserData)
+    {
+        FrameRecord& record = *static_cast<FrameRecord*>(pUserData);
+        uint32_t passIndex = pass.bPostPass ? 2 : pass.bLatePass;
+        record.commands[passIndex].assign(frame.commands.Data(), frame.commands.Data() + frame.commands.GetSize());
+        record.counts[passIndex] = frame.counts;
+    }
+
+    // The hierarchy only lets through the objects in the frustum. With every object's center in front of the camera, 
+    // the shaders reject the rest as well, so a frame gives the same commands and visibilities with or without it, 
+    // also while dynamic objects move and the hierarchy is refitted
+    static void TestHierarchyMatchesFullCull(ReferenceScene& reference)
+    {
+        std::vector<MeshTransform> startTransforms = reference.transforms;
+        CpuCullScene scene = ReferenceCullScene(reference, 0);
+        CpuFrameContext hierarchyFrame;
+        CpuFrameContext fullFrame;
+        CreateCpuFrame(scene, ce_cullTestSurfaceCount, reference.transforms.size(), reference.dynamicTransforms, hierarchyFrame, 3);
+        CreateCpuFrame(scene, ce_cullTestSurfaceCount, reference.transforms.size(), reference.dynamicTransforms, fullFrame, 3);
+        fullFrame.bHierarchyCull = 0;
+        BLIT_TEST_CHECK(hierarchyFrame.bvh.nodes.GetSize() != 0)
+
+        // From this far back, every object is in front of the camera
+        const float yaws[] = {0.9f, -0.9f, 0.85f, 0.95f, -0.85f};
+        constexpr uint32_t ce_frameCount = sizeof(yaws) / sizeof(yaws[0]);
+        for(uint32_t frameIndex = 0; frameIndex < ce_frameCount; ++frameIndex)
+        {
+            CameraViewData view = ReferenceView(BlitML::vec3(frameIndex * 30.f, 0.f, -1500.f), yaws[frameIndex], 3000.f);
+
+            // The dynamic objects slide sideways and turn
+            BlitML::quat turn = BlitML::QuatFromAngleAxis(BlitML::vec3(0.f, 1.f, 0.f), frameIndex * 0.7f, 0);
+            for(size_t i = 0; i < reference.dynamicTransforms.GetSize(); ++i)
+            {
+                uint32_t transformId = reference.dynamicTransforms[i];
+                MeshTransform& transform = reference.transforms[transformId];
+                transform.pos = startTransforms[transformId].pos + BlitML::vec3(frameIndex * 20.f, 0.f, 0.f);
+                transform.orientation = BlitML::MulitplyQuat(startTransforms[transformId].orientation, turn);
+            }
+            hierarchyFrame.bTransformsMoved = 1;
+
+            FrameRecord hierarchyRecord;
+            FrameRecord fullRecord;
+            CpuDrawFrame(hierarchyFrame, view, RecordFramePass, &hierarchyRecord);
+            CpuDrawFrame(fullFrame, view, RecordFramePass, &fullRecord);
+
+            BLIT_TEST_CHECK(hierarchyFrame.stats.culledObjects < ce_cullTestObjectCount * 3 / 4)
+            BLIT_TEST_CHECK(fullFrame.stats.culledObjects == ce_cullTestObjectCount)
+            for(uint32_t pass = 0; pass < ce_cpuFramePassCount; ++pass)
+            {
+                BLIT_TEST_CHECK(SameDraws(ce_cullTestObjectCount, hierarchyRecord.counts[pass], hierarchyRecord.commands[pass].data(), 
+                fullRecord.counts[pass], fullRecord.commands[pass].data()))
+            }
+            BLIT_TEST_CHECK(hierarchyFrame.stats.passDraws[0] + hierarchyFrame.stats.passDraws[1] != 0)
+            BLIT_TEST_CHECK(memcmp(hierarchyFrame.visibilities.Data(), fullFrame.visibilities.Data(), 
+            ce_cullTestObjectCount * sizeof(uint32_t)) == 0)
+        }
+        reference.transforms = startTransforms;
+    }
+
+    // Five visible objects in three buckets, one of them with 16-bit indices
+    static void TestCompactKnownDraws()
+    {
+        SurfaceCullData surfaces[2] = {};
+        surfaces[1].flags = ce_surfaceCullIndices16;
+        std::vector<SurfaceLodDraw> lodDraws(2 * ce_primitiveSurfaceMaxLODCount);
+        for(uint32_t i = 0; i < lodDraws.size(); ++i)
+            lodDraws[i] = {100 + i, 200 + i, 300 + i};
+
+        CpuCullScene scene;
+        scene.renderCount = 6;
+        scene.pSurfaces = surfaces;
+        scene.pLodDraws = lodDraws.data();
+
+        // Objects 0, 3 and 5 use surface 0 at lods 0, 0 and 2, objects 2 and 4 use surface 1 at lod 1
+        const uint32_t bucket16 = ce_primitiveSurfaceMaxLODCount + 1;
+        const uint32_t threadCounts[] = {1, 3, 0};
+        for(uint32_t threadCount : threadCounts)
+        {
+            CpuDrawCommand commands[12] = {};
+            commands[0] = {0, 100, 1, 200, 300, 0};
+            commands[1] = {3, 100, 1, 200, 300, 0};
+            commands[2] = {5, 102, 1, 202, 302, 2};
+            commands[6] = {2, 100 + bucket16, 1, 200 + bucket16, 300 + bucket16, bucket16};
+            commands[7] = {4, 100 + bucket16, 1, 200 + bucket16, 300 + bucket16, bucket16};
+            CpuDrawCounts counts = {3, 2};
+
+            CpuInstancedDraws draws;
+            CpuCompactInstancedDraws(scene, 2, commands, counts, draws, threadCount);
+            BLIT_TEST_CHECK(counts.drawCount == 2)
+            BLIT_TEST_CHECK(counts.drawCount16 == 1)
+
+            BLIT_TEST_CHECK(commands[0].objectId == 0)
+            BLIT_TEST_CHECK(commands[0].indexCount == 100)
+            BLIT_TEST_CHECK(commands[0].instanceCount == 2)
+            BLIT_TEST_CHECK(commands[0].firstInstance == 0)
+            BLIT_TEST_CHECK(commands[1].objectId == 2)
+            BLIT_TEST_CHECK(commands[1].firstIndex == 202)
+            BLIT_TEST_CHECK(commands[1].instanceCount == 1)
+            BLIT_TEST_CHECK(commands[1].firstInstance == 2)
+            BLIT_TEST_CHECK(commands[6].objectId == bucket16)
+            BLIT_TEST_CHECK(commands[6].vertexOffset == 300 + bucket16)
+            BLIT_TEST_CHECK(commands[6].instanceCount == 2)
+            BLIT_TEST_CHECK(commands[6].firstInstance == 3)
+
+            const uint32_t expectedInstances[] = {0, 3, 5, 2, 4};
+            BLIT_TEST_CHECK(draws.instances.GetSize() == 5)
+            BLIT_TEST_CHECK(memcmp(draws.instances.Data(), expectedInstances, sizeof(expectedInstances)) == 0)
+            BLIT_TEST_CHECK(draws.bucketCounts[0] == 2 && draws.bucketCounts[1] == 0 && draws.bucketCounts[2] == 1)
+            BLIT_TEST_CHECK(draws.bucketOffsets[bucket16] == 3)
+        }
+    }
+
+    static uint8_t SameInstancedDraws(uint32_t renderCount, const CpuDrawCounts& counts, const CpuDrawCommand* pCommands,
+    CpuInstancedDraws& draws, const CpuDrawCounts& expectedCounts, const CpuDrawCommand* pExpected, 
+    const std::vector<uint32_t>& expectedInstances)
+    {
+        return SameDraws(renderCount, counts, pCommands, expectedCounts, pExpected) && 
+        draws.instances.GetSize() == expectedInstances.size() &&
+        memcmp(draws.instances.Data(), expectedInstances.data(), expectedInstances.size() * sizeof(uint32_t)) == 0;
+    }
+
+    // Enough visible objects that the compaction is split between threads, and a frame that compacts every pass
+    static void TestCompactMatchesBuckets(ReferenceScene& reference)
+    {
+        // From far back most of the scene is in view
+        CameraViewData view = ReferenceView(BlitML::vec3(0.f, 0.f, -1500.f), 0.f, 3000.f);
+        CpuCullScene scene = ReferenceCullScene(reference, 1);
+        CpuCullSettings settings;
+        settings.bOcclusion = 0;
+        settings.bInstancedDraws = 1;
+        std::vector<uint32_t> visibilities = reference.visibilities;
+        std::vector<CpuDrawCommand> objectCommands(size_t(ce_cullTestObjectCount) * 2);
+        CpuDrawCounts objectCounts;
+        CpuDrawCull(scene, view, settings, visibilities.data(), objectCommands.data(), objectCounts, 1);
+        // The compaction gives each thread at least a bucket row's worth of commands
+        BLIT_TEST_CHECK(objectCounts.drawCount + objectCounts.drawCount16 > 8 * ce_cullTestSurfaceCount * ce_primitiveSurfaceMaxLODCount)
+
+        std::vector<CpuDrawCommand> expectedCommands(size_t(ce_cullTestObjectCount) * 2);
+        CpuDrawCounts expectedCounts;
+        std::vector<uint32_t> expectedInstances;
+        ShaderDrawBuckets(scene, ce_cullTestSurfaceCount, objectCommands.data(), objectCounts, expectedCommands.data(), expectedCounts, 
+        expectedInstances);
+        BLIT_TEST_CHECK(expectedCounts.drawCount != 0 && expectedCounts.drawCount16 != 0)
+
+        const uint32_t threadCounts[] = {1, 3, 0};
+        for(uint32_t threadCount : threadCounts)
+        {
+            std::vector<CpuDrawCommand> commands = objectCommands;
+            CpuDrawCounts counts = objectCounts;
+            CpuInstancedDraws draws;
+            CpuCompactInstancedDraws(scene, ce_cullTestSurfaceCount, commands.data(), counts, draws, threadCount);
+            BLIT_TEST_CHECK(SameInstancedDraws(ce_cullTestObjectCount, counts, commands.data(), draws, expectedCounts, 
+            expectedCommands.data(), expectedInstances))
+        }
+
+        CpuFrameContext frame;
+        CreateCpuFrame(scene, ce_cullTestSurfaceCount, reference.transforms.size(), reference.dynamicTransforms, frame, 3);
+        frame.bHierarchyCull = 0;
+        frame.settings = settings;
+        CpuDrawFrame(frame, view);
+        BLIT_TEST_CHECK(frame.stats.passDraws[0] == objectCounts.drawCount + objectCounts.drawCount16)
+        BLIT_TEST_CHECK(SameInstancedDraws(ce_cullTestObjectCount, frame.counts, frame.commands.Data(), frame.instancedDraws, expectedCounts, 
+        expectedCommands.data(), expectedInstances))
+    }
+
+    // A wall close to the camera, a sphere right behind it and another one off to the side.
+    // The wall is drawn by the initial pass once it has been seen, so from then on the late pass finds the sphere behind it hidden
+    static void TestOccluderHidesSphere()
+    {
+        SurfaceCullData surfaces[2] = {};
+        surfaces[0].center = BlitML::vec3(0.f);
+        surfaces[0].radius = sqrtf(2.f);
+        surfaces[1].center = BlitML::vec3(0.f);
+        surfaces[1].radius = 1.f;
+        const float extents[2][3] = {{1.f, 1.f, 0.f}, {0.8f, 0.8f, 0.8f}};
+        for(uint32_t i = 0; i < 2; ++i)
+        {
+            surfaces[i].lodCount = 1;
+            for(uint32_t axis = 0; axis < 3; ++axis)
+            {
+                surfaces[i].aabbMin[axis] = QuantizeHalfConservative(-extents[i][axis], 0);
+                surfaces[i].aabbMax[axis] = QuantizeHalfConservative(extents[i][axis], 1);
+            }
+        }
+        std::vector<SurfaceLodDraw> lodDraws(2 * ce_primitiveSurfaceMaxLODCount, SurfaceLodDraw{6, 0, 0});
+
+        // Only the wall has an occluder
+        const OccluderMesh occluderMeshes[2] = {{0, 4, 0, 6}, {4, 0, 6, 0}};
+        const BlitML::vec3 occluderVertices[4] = {BlitML::vec3(-1.f, -1.f, 0.f), BlitML::vec3(1.f, -1.f, 0.f), 
+            BlitML::vec3(1.f, 1.f, 0.f), BlitML::vec3(-1.f, 1.f, 0.f)};
+        const uint32_t occluderIndices[6] = {0, 1, 2, 0, 2, 3};
+
+        const BlitML::quat identity(0.f, 0.f, 0.f, 1.f);
+        MeshTransform transforms[3];
+        transforms[0] = {BlitML::vec3(0.f, 0.f, 10.f), 5.f, identity};
+        transforms[1] = {BlitML::vec3(0.f, 0.f, 50.f), 1.f, identity};
+        transforms[2] = {BlitML::vec3(40.f, 0.f, 50.f), 1.f, identity};
+        const RenderObject renders[3] = {{0, 0}, {1, 1}, {2, 1}};
+
+        CpuCullScene scene;
+        scene.pRenders = renders;
+        scene.renderCount = 3;
+        scene.pTransforms = transforms;
+        scene.pSurfaces = surfaces;
+        scene.pLodDraws = lodDraws.data();
+        BlitCL::DynamicArray<uint32_t> dynamicTransforms;
+
+        CameraViewData view = ReferenceView(BlitML::vec3(0.f), 0.f, 100.f);
+        const uint8_t occluderSettings[] = {1, 0};
+        for(uint8_t bOccluders : occluderSettings)
+        {
+            CpuFrameContext frame;
+            CreateCpuFrame(scene, 2, 3, dynamicTransforms, frame, 2);
+            frame.settings.bOcclusion = 1;
+            if(bOccluders)
+            {
+                frame.pOccluderMeshes = occluderMeshes;
+                frame.pOccluderVertices = occluderVertices;
+                frame.pOccluderIndices = occluderIndices;
+            }
+
+            // Nothing was visible before the first frame, so its depth buffer is empty and the late pass draws everything
+            CpuDrawFrame(frame, view);
+            BLIT_TEST_CHECK(frame.stats.passDraws[0] == 0)
+            BLIT_TEST_CHECK(frame.stats.passDraws[1] == 3)
+            BLIT_TEST_CHECK(frame.stats.occluders == 0)
+
+            // The wall is drawn first from now on
+            CpuDrawFrame(frame, view);
+            BLIT_TEST_CHECK(frame.stats.passDraws[0] == 3)
+            BLIT_TEST_CHECK(frame.stats.passDraws[1] == 0)
+            BLIT_TEST_CHECK(frame.stats.occluders == bOccluders)
+            BLIT_TEST_CHECK(frame.visibilities[0] == 1)
+            BLIT_TEST_CHECK(frame.visibilities[1] == uint32_t(!bOccluders))
+            BLIT_TEST_CHECK(frame.visibilities[2] == 1)
+
+            CpuDrawFrame(frame, view);
+            BLIT_TEST_CHECK(frame.stats.passDraws[0] == (bOccluders ? 2u : 3u))
+            BLIT_TEST_CHECK(frame.stats.passDraws[1] == 0)
+            BLIT_TEST_CHECK(frame.visibilities[1] == uint32_t(!bOccluders))
+        }
+    }
+}
+
+int main()
+{
+    using namespace BlitzenTest;
+
+    ReferenceScene reference;
+    BuildReferenceScene(reference);
+    TestCullMatchesShaders(reference);
+    TestFrameMatchesShaders(reference);
+    TestHierarchyMatchesFullCull(reference);
+    TestOccluderHidesSphere();
+    TestCompactKnownDraws();
+    TestCompactMatchesBuckets(reference);
+    return TestResult("CpuCullMatchesShaders");
+}
@@ -0,0 +1,346 @@
+// Built once for each instruction set of the math library (Tests/CMakeLists.txt).
+// The scalar build writes the results of every function that has a SIMD path to a file,
+// the SSE4 and AVX2 builds compute the same results and compare them with the file to the bit
+#include "BlitzenMathLibrary/blitML.h"
+#include "BlitzenMathLibrary/blitMLBatch.h"
+#include "BlitzenMathLibrary/blitMLRandom.h"
+#include "blitTest.h"
+
+#include <string.h>
+#include <vector>
+
+namespace BlitzenTest
+{
+    constexpr uint64_t ce_mathTestSeed = 41;
+    constexpr uint32_t ce_mathTestCaseCount = 500;
+
+    // Results of one function as raw bits, so that signed zeros and NaNs have to match as well
+    struct MathResults
+    {
+        const char* name;
+        std::vector<uint32_t> bits;
+    };
+
+    // Stream lengths of the batch kernels. AVX2 does 8 elements at a time, so every length that is not a multiple of 8 ends in a masked block
+    constexpr size_t ce_batchTestCounts[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 1003};
+
+    // Outputs of the batch kernels have this many more elements than the stream, holding ce_batchTestGuard.
+    // They are recorded as well, so a masked store that writes past the stream is a mismatch
+    constexpr size_t ce_batchTestGuardCount = 8;
+    constexpr float ce_batchTestGuard = 12345.f;
+    constexpr uint8_t ce_batchTestFlagGuard = 0xAB;
+
+    static void RecordFloats(MathResults& results, const float* pValues, size_t count)
+    {
+        size_t first = results.bits.size();
+        results.bits.resize(first + count);
+        memcpy(results.bits.data() + first, pValues, count * sizeof(float));
+    }
+
+    static void RecordFlags(MathResults& results, const std::vector<uint8_t>& flags)
+    {
+        for(uint8_t flag : flags)
+            results.bits.push_back(flag);
+    }
+
+    // Matrices with entries of very different sizes, so that the order of the sums shows up in the low bits
+    static BlitML::mat4 RandomMatrix(BlitML::RandomState& random)
+    {
+        BlitML::mat4 matrix(0);
+        for(uint8_t i = 0; i < 16; ++i)
+            matrix.data[i] = BlitML::RandomFloatInRange(random, -10.f, 10.f) * (i % 3 == 0 ? 1000.f : 1.f);
+        return matrix;
+    }
+
+    // Quaternions that are not normalized, a few of them with negative zeros
+    static BlitML::quat RandomQuatComponents(BlitML::RandomState& random)
+    {
+        BlitML::quat q;
+        for(uint8_t i = 0; i < 4; ++i)
+            q.elements[i] = BlitML::RandomUint32Below(random, 16) == 0 ? -0.f : BlitML::RandomFloatInRange(random, -2.f, 2.f);
+        return q;
+    }
+
+    static std::vector<float> RandomValues(BlitML::RandomState& random, size_t count, float low, float high)
+    {
+        std::vector<float> values(count);
+        for(float& value : values)
+            value = BlitML::RandomFloatInRange(random, low, high);
+        return values;
+    }
+
+    static void RunBatchFunctions(std::vector<MathResults>& results)
+    {
+        BlitML::RandomState random = BlitML::RandomStream(ce_mathTestSeed, 1);
+        BlitML::mat4 view = RandomMatrix(random);
+        BlitML::ViewFrustum frustum{0.8f, 0.6f, 0.9f, 0.45f, 1.f, 80.f};
+
+        MathResults rotations{"BatchRotateQuat"};
+        MathResults viewSpheres{"BatchTransformSpheresToView"};
+        MathResults frustumTests{"BatchSpheresInFrustum"};
+        MathResults projections{"BatchProjectSpheres"};
+        MathResults matrices{"BatchQuatToMat4"};
+        for(size_t count : ce_batchTestCounts)
+        {
+            size_t guarded = count + ce_batchTestGuardCount;
+            std::vector<float> q[4];
+            for(std::vector<float>& component : q)
+                component = RandomValues(random, count, -2.f, 2.f);
+            std::vector<float> v[3];
+            for(std::vector<float>& component : v)
+                component = RandomValues(random, count, -20.f, 20.f);
+            BlitML::QuatStream quats{q[0].data(), q[1].data(), q[2].data(), q[3].data()};
+            BlitML::Vec3Stream vectors{v[0].data(), v[1].data(), v[2].data()};
+
+            std::vector<float> rotated[3];
+            for(std::vector<float>& component : rotated)
+                component.assign(guarded, ce_batchTestGuard);
+            BlitML::Vec3Stream rotatedStream{rotated[0].data(), rotated[1].data(), rotated[2].data()};
+            BlitML::BatchRotateQuat(quats, vectors, rotatedStream, count);
+            for(std::vector<float>& component : rotated)
+                RecordFloats(rotations, component.data(), guarded);
+
+            // The vectors are the model space centers, the quaternions the orientations
+            std::vector<float> radii = RandomValues(random, count, 0.f, 10.f);
+            std::vector<float> pos[3];
+            for(std::vector<float>& component : pos)
+                component = RandomValues(random, count, -100.f, 100.f);
+            std::vector<float> scales = RandomValues(random, count, 0.1f, 5.f);
+            BlitML::SphereStream spheres{v[0].data(), v[1].data(), v[2].data(), radii.data()};
+            BlitML::TransformStream transforms{pos[0].data(), pos[1].data(), pos[2].data(), scales.data(), quats};
+            std::vector<float> viewed[4];
+            for(std::vector<float>& component : viewed)
+                component.assign(guarded, ce_batchTestGuard);
+            BlitML::SphereStream viewedStream{viewed[0].data(), viewed[1].data(), viewed[2].data(), viewed[3].data()};
+            BlitML::BatchTransformSpheresToView(spheres, transforms, view, viewedStream, count);
+            for(std::vector<float>& component : viewed)
+                RecordFloats(viewSpheres, component.data(), guarded);
+
+            // View space spheres on both sides of every plane. Some cross the near plane, so they have no rectangle
+            std::vector<float> x = RandomValues(random, count, -60.f, 60.f);
+            std::vector<float> y = RandomValues(random, count, -60.f, 60.f);
+            std::vector<float> z = RandomValues(random, count, -10.f, 100.f);
+            std::vector<float> r = RandomValues(random, count, 0.f, 10.f);
+            BlitML::SphereStream testSpheres{x.data(), y.data(), z.data(), r.data()};
+            std::vector<uint8_t> visible(guarded, ce_batchTestFlagGuard);
+            BlitML::BatchSpheresInFrustum(testSpheres, frustum, visible.data(), count);
+            RecordFlags(frustumTests, visible);
+
+            std::vector<float> rect[4];
+            for(std::vector<float>& component : rect)
+                component.assign(guarded, ce_batchTestGuard);
+            BlitML::RectStream rects{rect[0].data(), rect[1].data(), rect[2].data(), rect[3].data()};
+            std::vector<uint8_t> valid(guarded, ce_batchTestFlagGuard);
+            BlitML::BatchProjectSpheres(testSpheres, frustum.zNear, 1.3f, 1.7f, rects, valid.data(), count);
+            for(std::vector<float>& component : rect)
+                RecordFloats(projections, component.data(), guarded);
+            RecordFlags(projections, valid);
+
+            std::vector<BlitML::mat4> rotationMatrices(guarded);
+            for(BlitML::mat4& matrix : rotationMatrices)
+                for(float& element : matrix.data)
+                    element = ce_batchTestGuard;
+            BlitML::BatchQuatToMat4(quats, rotationMatrices.data(), count);
+            for(BlitML::mat4& matrix : rotationMatrices)
+                RecordFloats(matrices, matrix.data, 16);
+        }
+        results.push_back(rotations);
+        results.push_back(viewSpheres);
+        results.push_back(frustumTests);
+        results.push_back(projections);
+        results.push_back(matrices);
+    }
+
+    // The bulk generator with the same lengths as the batch kernels. The state after each fill is recorded too,
+    // since the fills of the next length go on from it
+    static void RunRandomBulkFunctions(std::vector<MathResults>& results)
+    {
+        BlitML::RandomBulkState bulk;
+        BlitML::SeedRandomBulk(bulk, ce_mathTestSeed, 0);
+
+        MathResults floats{"RandomFillFloats"};
+        MathResults vectors{"RandomFillUnitVectors"};
+        MathResults quats{"RandomFillQuats"};
+        MathResults states{"RandomBulkState"};
+        auto recordState = [&states, &bulk]()
+        {
+            for(uint8_t w = 0; w < 4; ++w)
+                for(uint8_t lane = 0; lane < BlitML::ce_randomBulkLanes; ++lane)
+                {
+                    states.bits.push_back(static_cast<uint32_t>(bulk.s[w][lane]));
+                    states.bits.push_back(static_cast<uint32_t>(bulk.s[w][lane] >> 32));
+                }
+        };
+        for(size_t count : ce_batchTestCounts)
+        {
+            size_t guarded = count + ce_batchTestGuardCount;
+            std::vector<float> values(guarded, ce_batchTestGuard);
+            BlitML::RandomFillFloats(bulk, values.data(), count);
+            RecordFloats(floats, values.data(), guarded);
+            recordState();
+
+            std::vector<float> v[3];
+            for(std::vector<float>& component : v)
+                component.assign(guarded, ce_batchTestGuard);
+            BlitML::Vec3Stream vectorStream{v[0].data(), v[1].data(), v[2].data()};
+            BlitML::RandomFillUnitVectors(bulk, vectorStream, count);
+            for(std::vector<float>& component : v)
+                RecordFloats(vectors, component.data(), guarded);
+            recordState();
+
+            std::vector<float> q[4];
+            for(std::vector<float>& component : q)
+                component.assign(guarded, ce_batchTestGuard);
+            BlitML::QuatStream quatStream{q[0].data(), q[1].data(), q[2].data(), q[3].data()};
+            BlitML::RandomFillQuats(bulk, quatStream, count);
+            for(std::vector<float>& component : q)
+                RecordFloats(quats, component.data(), guarded);
+            recordState();
+        }
+        results.push_back(floats);
+        results.push_back(vectors);
+        results.push_back(quats);
+        results.push_back(states);
+    }
+
+    static void RunMathFunctions(std::vector<MathResults>& results)
+    {
+        BlitML::RandomState random = BlitML::RandomStream(ce_mathTestSeed, 0);
+
+        MathResults constructors{"mat4 constructor"};
+        for(uint8_t identity = 0; identity < 3; ++identity)
+        {
+            BlitML::mat4 matrix(identity);
+            RecordFloats(constructors, matrix.data, 16);
+        }
+        results.push_back(constructors);
+
+        MathResults products{"mat4 operator *"};
+        MathResults inverses{"Mat4Inverse"};
+        for(uint32_t i = 0; i < ce_mathTestCaseCount; ++i)
+        {
+            BlitML::mat4 m1 = RandomMatrix(random);
+            BlitML::mat4 m2 = RandomMatrix(random);
+            BlitML::mat4 product = m1 * m2;
+            RecordFloats(products, product.data, 16);
+
+            BlitML::mat4 inverse = BlitML::Mat4Inverse(m1);
+            RecordFloats(inverses, inverse.data, 16);
+        }
+        results.push_back(products);
+        results.push_back(inverses);
+
+        MathResults normalized{"NormalizeQuat"};
+        MathResults rotations{"QuatToMat4"};
+        for(uint32_t i = 0; i < ce_mathTestCaseCount; ++i)
+        {
+            BlitML::quat q = RandomQuatComponents(random);
+            BlitML::quat normal = BlitML::NormalizeQuat(q);
+            RecordFloats(normalized, normal.elements, 4);
+
+            BlitML::mat4 rotation = BlitML::QuatToMat4(q);
+            RecordFloats(rotations, rotation.data, 16);
+        }
+        results.push_back(normalized);
+        results.push_back(rotations);
+
+        // Every branch of slerp: the general case, the flipped second quaternion and the nearly equal quaternions that are lerped
+        MathResults slerps{"QuatSlerp"};
+        for(uint32_t i = 0; i < ce_mathTestCaseCount; ++i)
+        {
+            BlitML::quat q0 = RandomQuatComponents(random);
+            BlitML::quat q1 = RandomQuatComponents(random);
+            if(i % 3 == 1)
+                q1 = BlitML::quat(q0.x * 1.0001f, q0.y, q0.z * 0.9999f, q0.w);
+            else if(i % 3 == 2)
+                q1 = BlitML::quat(-q0.x, -q0.y * 1.1f, -q0.z, -q0.w);
+
+            BlitML::quat slerp = BlitML::QuatSlerp(q0, q1, BlitML::RandomFloat(random));
+            RecordFloats(slerps, slerp.elements, 4);
+        }
+        results.push_back(slerps);
+
+        RunBatchFunctions(results);
+        RunRandomBulkFunctions(results);
+    }
+
+    // Prints the first differing value of every function whose results do not match the reference
+    static void CompareMathResults(const std::vector<MathResults>& results, const std::vector<uint32_t>& reference)
+    {
+        size_t offset = 0;
+        for(const MathResults& function : results)
+        {
+            size_t count = function.bits.size();
+            BLIT_TEST_CHECK(offset + count <= reference.size())
+            if(offset + count > reference.size())
+                return;
+
+            for(size_t i = 0; i < count; ++i)
+            {
+                if(function.bits[i] != reference[offset + i])
+                {
+                    printf("%s: value %zu is 0x%08x, the scalar code gives 0x%08x\n", function.name, i, function.bits[i], reference[offset + i]);
+                    ++s_failedChecks;
+                    break;
+                }
+            }
+            offset += count;
+        }
+        BLIT_TEST_CHECK(offset == reference.size())
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace BlitzenTest;
+
+    if(argc != 2)
+    {
+        printf("Usage: %s <scalar results file>\n", argv[0]);
+        return 1;
+    }
+
+    #if defined(BLIT_ML_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    if(!__builtin_cpu_supports("avx2"))
+    {
+        printf("The cpu does not support AVX2\n");
+        return ce_testSkipped;
+    }
+    #endif
+
+    std::vector<MathResults> results;
+    RunMathFunctions(results);
+
+    #if defined(BLIT_ML_SCALAR)
+    // The scalar build writes the reference
+    FILE* pFile = fopen(argv[1], "wb");
+    BLIT_TEST_CHECK(pFile)
+    if(!pFile)
+        return TestResult("MathScalarReference");
+    for(const MathResults& function : results)
+        fwrite(function.bits.data(), sizeof(uint32_t), function.bits.size(), pFile);
+    fclose(pFile);
+    return TestResult("MathScalarReference");
+
+    #else
+    FILE* pFile = fopen(argv[1], "rb");
+    BLIT_TEST_CHECK(pFile)
+    if(!pFile)
+        return TestResult("MathSimdMatchesScalar");
+    std::vector<uint32_t> reference;
+    uint32_t value;
+    while(fread(&value, sizeof(uint32_t), 1, pFile) == 1)
+        reference.push_back(value);
+    fclose(pFile);
+
+    #if defined(BLIT_ML_AVX2)
+    printf("Comparing the AVX2 results with the scalar code\n");
+    #elif defined(BLIT_ML_SSE4)
+    printf("Comparing the SSE4 results with the scalar code\n");
+    #else
+    printf("The compiler does not target SSE4.1, this build runs the scalar code\n");
+    #endif
+    CompareMathResults(results, reference);
+    return TestResult("MathSimdMatchesScalar");
+    #endif
+}
@@ -0,0 +1,146 @@
+// Checks that the bulk random generator gives what its users expect: floats spread evenly over [0, 1),
+// unit vectors of length 1 spread evenly over the sphere and normalized quaternions spread evenly over rotations.
+// The SIMD paths give the same values as the scalar ones to the bit (blitzenMathSimdTest.cpp), so one build is enough
+#include "BlitzenMathLibrary/blitMLRandom.h"
+#include "blitTest.h"
+
+#include <math.h>
+#include <vector>
+
+namespace BlitzenTest
+{
+    constexpr uint64_t ce_randomTestSeed = 44;
+    constexpr size_t ce_randomTestSampleCount = 1 << 17;
+
+    // Largest difference between a sample average and the value it should have. Several standard deviations of the average
+    constexpr double ce_randomTestMeanTolerance = 0.01;
+
+    // Largest difference between the length of a generated vector or quaternion and 1
+    constexpr float ce_randomTestLengthTolerance = 1e-5f;
+
+    static uint8_t NearlyEqual(double value, double expected, double tolerance)
+    {
+        return fabs(value - expected) <= tolerance;
+    }
+
+    // The height of a uniform unit vector is uniform in [-1, 1], so every tenth of it should get a tenth of the vectors
+    static void CheckHistogram(const std::vector<float>& values, float low, float high)
+    {
+        constexpr uint32_t ce_bucketCount = 10;
+        uint32_t buckets[ce_bucketCount] = {};
+        for(float value : values)
+        {
+            uint32_t bucket = static_cast<uint32_t>((value - low) / (high - low) * ce_bucketCount);
+            buckets[bucket < ce_bucketCount ? bucket : ce_bucketCount - 1]++;
+        }
+
+        double expected = double(values.size()) / ce_bucketCount;
+        for(uint32_t bucket : buckets)
+            BLIT_TEST_CHECK(NearlyEqual(bucket, expected, expected * 0.05))
+    }
+
+    static void TestRandomFloats(BlitML::RandomBulkState& bulk)
+    {
+        std::vector<float> values(ce_randomTestSampleCount);
+        BlitML::RandomFillFloats(bulk, values.data(), values.size());
+
+        double sum = 0;
+        double squares = 0;
+        uint8_t bInRange = 1;
+        for(float value : values)
+        {
+            bInRange = bInRange && value >= 0.f && value < 1.f;
+            sum += value;
+            squares += double(value) * value;
+        }
+        double mean = sum / values.size();
+        BLIT_TEST_CHECK(bInRange)
+        BLIT_TEST_CHECK(NearlyEqual(mean, 0.5, ce_randomTestMeanTolerance))
+        BLIT_TEST_CHECK(NearlyEqual(squares / values.size() - mean * mean, 1.0 / 12.0, ce_randomTestMeanTolerance))
+        CheckHistogram(values, 0.f, 1.f);
+    }
+
+    // A component of a uniform point on the unit sphere in n dimensions has E[x^2] = 1 / n and E[x^4] = 3 / (n * (n + 2)).
+    // Points that are normalized from a cube or taken with uneven angles get the second one wrong even when the first is right
+    static void CheckSphereMoments(const std::vector<float>* pComponents, uint32_t dimensions)
+    {
+        size_t count = pComponents[0].size();
+        uint8_t bUnitLength = 1;
+        for(size_t i = 0; i < count; ++i)
+        {
+            float lengthSquared = 0.f;
+            for(uint32_t c = 0; c < dimensions; ++c)
+                lengthSquared += pComponents[c][i] * pComponents[c][i];
+            bUnitLength = bUnitLength && fabsf(sqrtf(lengthSquared) - 1.f) <= ce_randomTestLengthTolerance;
+        }
+        BLIT_TEST_CHECK(bUnitLength)
+
+        for(uint32_t c = 0; c < dimensions; ++c)
+        {
+            double sum = 0;
+            double squares = 0;
+            double fourthPowers = 0;
+            for(float value : pComponents[c])
+            {
+                double square = double(value) * value;
+                sum += value;
+                squares += square;
+                fourthPowers += square * square;
+            }
+            BLIT_TEST_CHECK(NearlyEqual(sum / count, 0.0, ce_randomTestMeanTolerance))
+            BLIT_TEST_CHECK(NearlyEqual(squares / count, 1.0 / dimensions, ce_randomTestMeanTolerance))
+            BLIT_TEST_CHECK(NearlyEqual(fourthPowers / count, 3.0 / (dimensions * (dimensions + 2)), ce_randomTestMeanTolerance))
+        }
+    }
+
+    static void TestRandomUnitVectors(BlitML::RandomBulkState& bulk)
+    {
+        std::vector<float> v[3];
+        for(std::vector<float>& component : v)
+            component.resize(ce_randomTestSampleCount);
+        BlitML::Vec3Stream vectors{v[0].data(), v[1].data(), v[2].data()};
+        BlitML::RandomFillUnitVectors(bulk, vectors, ce_randomTestSampleCount);
+
+        CheckSphereMoments(v, 3);
+        for(std::vector<float>& component : v)
+            CheckHistogram(component, -1.f, 1.f);
+    }
+
+    static void TestRandomQuats(BlitML::RandomBulkState& bulk)
+    {
+        std::vector<float> q[4];
+        for(std::vector<float>& component : q)
+            component.resize(ce_randomTestSampleCount);
+        BlitML::QuatStream quats{q[0].data(), q[1].data(), q[2].data(), q[3].data()};
+        BlitML::RandomFillQuats(bulk, quats, ce_randomTestSampleCount);
+
+        // Uniform rotations are uniform points on the unit sphere of 4 dimensions
+        CheckSphereMoments(q, 4);
+
+        // The rotated axes should be uniform unit vectors as well
+        std::vector<float> axis[3];
+        for(std::vector<float>& component : axis)
+            component.resize(ce_randomTestSampleCount);
+        for(size_t i = 0; i < ce_randomTestSampleCount; ++i)
+        {
+            BlitML::vec3 rotated = BlitML::RotateQuat(BlitML::vec3(0.f, 0.f, 1.f), BlitML::quat(q[0][i], q[1][i], q[2][i], q[3][i]));
+            axis[0][i] = rotated.x;
+            axis[1][i] = rotated.y;
+            axis[2][i] = rotated.z;
+        }
+        CheckSphereMoments(axis, 3);
+        CheckHistogram(axis[2], -1.f, 1.f);
+    }
+}
+
+int main()
+{
+    using namespace BlitzenTest;
+
+    BlitML::RandomBulkState bulk;
+    BlitML::SeedRandomBulk(bulk, ce_randomTestSeed, 0);
+    TestRandomFloats(bulk);
+    TestRandomUnitVectors(bulk);
+    TestRandomQuats(bulk);
+    return TestResult("RandomDistribution");
+}
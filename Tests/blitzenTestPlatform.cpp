@@ -0,0 +1,85 @@
+// Stands in for platform.cpp and blitzenMemory.cpp in the test executables.
+// Tests run without a window or a memory manager, so allocations go straight to the C runtime
+#include "Platform/platform.h"
+#include "Core/blitMemory.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+namespace BlitzenPlatform
+{
+    void* PlatformMalloc(size_t size, uint8_t aligned)
+    {
+        return malloc(size);
+    }
+
+    void PlatformFree(void* pBlock, uint8_t aligned)
+    {
+        free(pBlock);
+    }
+
+    void* PlatformMemZero(void* pBlock, size_t size)
+    {
+        return memset(pBlock, 0, size);
+    }
+
+    void* PlatformMemCopy(void* pDst, void* pSrc, size_t size)
+    {
+        return memcpy(pDst, pSrc, size);
+    }
+
+    void* PlatformMemSet(void* pDst, int32_t value, size_t size)
+    {
+        return memset(pDst, value, size);
+    }
+
+    void PlatformConsoleWrite(const char* message, uint8_t color)
+    {
+        printf("%s", message);
+    }
+
+    void PlatformConsoleError(const char* message, uint8_t color)
+    {
+        fprintf(stderr, "%s", message);
+    }
+
+    double PlatformGetAbsoluteTime()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void PlatformSleep(uint64_t ms)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+namespace BlitzenCore
+{
+    void BlitMemCopy(void* pDst, void* pSrc, size_t size)
+    {
+        BlitzenPlatform::PlatformMemCopy(pDst, pSrc, size);
+    }
+
+    void BlitMemSet(void* pDst, int32_t value, size_t size)
+    {
+        BlitzenPlatform::PlatformMemSet(pDst, value, size);
+    }
+
+    void BlitZeroMemory(void* pBlock, size_t size)
+    {
+        BlitzenPlatform::PlatformMemZero(pBlock, size);
+    }
+
+    // Allocations are not tracked
+    void LogAllocation(AllocationType alloc, size_t size) {}
+    void LogFree(AllocationType alloc, size_t size) {}
+
+    // Nothing is freed before the test exits, so the linear allocator is a plain malloc
+    void* BlitAllocLinear(AllocationType alloc, size_t size)
+    {
+        return BlitzenPlatform::PlatformMalloc(size, 0);
+    }
+}
@@ -4,6 +4,10 @@
 #define LOD_ENABLED
 #define OCCLUSION_ENABLED
 
+// Surfaces are drawn with VK_CULL_MODE_NONE, so their back faces are visible and the normal cone test would cull visible surfaces.
+// Should be defined once the geometry pipeline culls back faces
+// #define CONE_CULLING_ENABLED
+
 layout (push_constant) uniform CullingConstants
 {
     uint drawCount;
@@ -39,13 +43,201 @@ bool projectSphere(vec3 c, float r, float znear, float P00, float P11, out vec4
 	return true;
 }
 
-// The indirect count buffer holds a single integer that is the draw count for VkCmdDrawIndexedIndirectCount. 
+// The indirect count buffer holds the draw counts for the 2 VkCmdDrawIndexedIndirectCount calls (32-bit and 16-bit indices). 
 // Will be incremented when necessary by a compute shader
-layout(set = 0, binding = 9, std430) writeonly buffer IndirectCount
+layout(set = 0, binding = 9, std430) buffer IndirectCount
 {
     uint drawCount;
+    uint drawCount16;
 }indirectCountBuffer;
 
+// Flags of SurfaceCull
+#define SURFACE_CULL_POST_PASS 1u
+#define SURFACE_CULL_INDICES16 2u
+
+// The part of a surface that is read for every object. Same layout as BlitzenEngine::SurfaceCullData (blitSurfaceCullData.h)
+struct SurfaceCull
+{
+    // Bounding sphere
+    vec3 center;
+    float radius;
+
+    // Errors of lods 1 to lodCount - 1, the error of lod 0 is always 0
+    float16_t lodErrors[7];
+
+    uint8_t lodCount;
+    uint8_t flags;
+
+    // Model space bounding box, rounded outwards
+    float16_t aabbMin[3];
+    float16_t aabbMax[3];
+
+    // Normal cone of every triangle of the surface, same encoding as meshlet cones
+    int8_t coneAxis[3];
+    int8_t coneCutoff;
+};
+
+layout(set = 0, binding = 14, std430) readonly buffer SurfaceCullBuffer
+{
+    SurfaceCull surfaces[];
+}surfaceCullBuffer;
+
+// Only read for objects that get a draw command. Same layout as BlitzenEngine::SurfaceLodDraw
+struct SurfaceLodDraw
+{
+    uint indexCount;
+    uint firstIndex;
+    uint vertexOffset;
+};
+
+// Each surface has 8 elements, one for each possible lod
+layout(set = 0, binding = 15, std430) readonly buffer SurfaceLodDrawBuffer
+{
+    SurfaceLodDraw draws[];
+}surfaceLodDrawBuffer;
+
+// World space bounding sphere and box of a render object, baked at upload for objects whose transform never changes.
+// Same layout as BlitzenEngine::RenderWorldBounds (blitSurfaceCullData.h). Objects with a dynamic transform have a negative radius
+struct WorldBounds
+{
+    vec3 center;
+    float radius;
+
+    vec3 boundsMin;
+    float padding0;
+    vec3 boundsMax;
+    float padding1;
+};
+
+layout(set = 0, binding = 17, std430) readonly buffer WorldBoundsBuffer
+{
+    WorldBounds bounds[];
+}worldBoundsBuffer;
+
+// Tests a view space bounding sphere against the view frustum
+bool SphereInFrustum(vec3 center, float radius)
+{
+    // the left/top/right/bottom plane culling utilizes frustum symmetry to cull against two planes at the same time
+    // Formula taken from Arseny Kapoulkine's Niagara renderer https://github.com/zeux/niagara
+    // It is also referenced in VKguide's GPU driven rendering articles https://vkguide.dev/docs/gpudriven/compute_culling/
+    bool visible = center.z * viewData.frustumLeft - abs(center.x) * viewData.frustumRight > -radius;
+	visible = visible && center.z * viewData.frustumBottom - abs(center.y) * viewData.frustumTop > -radius;
+	// the near/far plane culling uses camera space Z directly
+	visible = visible && center.z + radius > viewData.zNear && center.z - radius < viewData.zFar;
+    return visible;
+}
+
+// Radius of the box along a direction, the box's axes are scaled by its half extents
+float BoxProjectedRadius(vec3 direction, vec3 axisX, vec3 axisY, vec3 axisZ)
+{
+    return abs(dot(direction, axisX)) + abs(dot(direction, axisY)) + abs(dot(direction, axisZ));
+}
+
+// Tests a view space box against the same frustum planes as the bounding sphere test. The box's axes are scaled by its half extents
+bool ViewBoxInFrustum(vec3 center, vec3 axisX, vec3 axisY, vec3 axisZ)
+{
+    // Like the sphere test, only the plane on the side of the center is tested
+    vec3 sidePlane = vec3(center.x >= 0 ? -viewData.frustumRight : viewData.frustumRight, 0, viewData.frustumLeft);
+    vec3 verticalPlane = vec3(0, center.y >= 0 ? -viewData.frustumTop : viewData.frustumTop, viewData.frustumBottom);
+    float depthRadius = BoxProjectedRadius(vec3(0, 0, 1), axisX, axisY, axisZ);
+
+    bool visible = dot(sidePlane, center) > -BoxProjectedRadius(sidePlane, axisX, axisY, axisZ);
+    visible = visible && dot(verticalPlane, center) > -BoxProjectedRadius(verticalPlane, axisX, axisY, axisZ);
+    visible = visible && center.z + depthRadius > viewData.zNear && center.z - depthRadius < viewData.zFar;
+    return visible;
+}
+
+// Tests the surface's box after the transform. Tighter than the sphere for long or flat surfaces
+bool BoxInFrustum(SurfaceCull surface, Transform transform)
+{
+    vec3 boxMin = vec3(surface.aabbMin[0], surface.aabbMin[1], surface.aabbMin[2]);
+    vec3 boxMax = vec3(surface.aabbMax[0], surface.aabbMax[1], surface.aabbMax[2]);
+    vec3 extents = (boxMax - boxMin) * 0.5 * transform.scale;
+
+    // The box's axes in view space
+    mat3 viewRotation = mat3(viewData.view);
+    vec3 axisX = viewRotation * RotateQuat(vec3(1, 0, 0), transform.orientation) * extents.x;
+    vec3 axisY = viewRotation * RotateQuat(vec3(0, 1, 0), transform.orientation) * extents.y;
+    vec3 axisZ = viewRotation * RotateQuat(vec3(0, 0, 1), transform.orientation) * extents.z;
+
+    vec3 center = RotateQuat((boxMin + boxMax) * 0.5, transform.orientation) * transform.scale + transform.pos;
+    center = (viewData.view * vec4(center, 1)).xyz;
+
+    return ViewBoxInFrustum(center, axisX, axisY, axisZ);
+}
+
+// Tests the baked world box of a static object, without its surface or transform.
+// The box's axes are the world axes, so their view space versions are the columns of the view rotation
+bool WorldBoxInFrustum(WorldBounds bounds)
+{
+    vec3 extents = (bounds.boundsMax - bounds.boundsMin) * 0.5;
+    mat3 viewRotation = mat3(viewData.view);
+    vec3 center = (viewData.view * vec4((bounds.boundsMin + bounds.boundsMax) * 0.5, 1)).xyz;
+    return ViewBoxInFrustum(center, viewRotation[0] * extents.x, viewRotation[1] * extents.y, viewRotation[2] * extents.z);
+}
+
+// Same as the meshlet cone test. Center and radius are the bounding sphere in view space, so the camera is at the origin
+bool ConeCulled(SurfaceCull surface, Transform transform, vec3 center, float radius)
+{
+    vec3 axis = vec3(int(surface.coneAxis[0]), int(surface.coneAxis[1]), int(surface.coneAxis[2])) / 127.0;
+    float cutoff = int(surface.coneCutoff) / 127.0;
+    axis = mat3(viewData.view) * RotateQuat(axis, transform.orientation);
+    return dot(center, axis) >= cutoff * length(center) + radius;
+}
+
+// Picks the least detailed lod whose error is below the threshold
+uint SelectLod(SurfaceCull surface, float threshold)
+{
+    uint lodIndex = 0;
+    for (uint i = 1; i < uint(surface.lodCount); ++i)
+        if (float(surface.lodErrors[i - 1]) < threshold)
+            lodIndex = i;
+    return lodIndex;
+}
+
+// Element of the lod draw table. Also the bucket of the objects drawn with this lod when draws are instanced
+uint LodDrawIndex(uint surfaceId, uint lodIndex)
+{
+    return surfaceId * 8 + lodIndex;
+}
+
+SurfaceLodDraw LoadLodDraw(uint surfaceId, uint lodIndex)
+{
+    return surfaceLodDrawBuffer.draws[LodDrawIndex(surfaceId, lodIndex)];
+}
+
+// Returns the element of the indirect draw buffer where the surface's draw command should go. 
+// Surfaces with 16-bit indices use a different index buffer, so their commands are placed after the first drawCount elements
+uint AllocateDrawCommand(uint8_t flags)
+{
+    if((uint(flags) & SURFACE_CULL_INDICES16) != 0)
+        return cullPC.drawCount + atomicAdd(indirectCountBuffer.drawCount16, 1);
+    
+    return atomicAdd(indirectCountBuffer.drawCount, 1);
+}
+
+// True for the elements of the indirect draw buffer that the culling shader wrote a command to
+bool DrawCommandWritten(uint drawIndex)
+{
+    if(drawIndex < cullPC.drawCount)
+        return drawIndex < indirectCountBuffer.drawCount;
+
+    return drawIndex - cullPC.drawCount < indirectCountBuffer.drawCount16;
+}
+
+// One bucket for every element of the lod draw table, only used when draws are instanced.
+// Count is the amount of visible objects drawn with the lod, offset is where they start in the instance buffer
+struct DrawBucket
+{
+    uint count;
+    uint offset;
+};
+
+layout(set = 0, binding = 19, std430) buffer DrawBucketBuffer
+{
+    DrawBucket buckets[];
+}drawBucketBuffer;
+
 layout(set = 0, binding = 10, std430) buffer VisibilityBuffer
 {
     uint visibilities[];
@@ -17,6 +17,26 @@ layout(set = 0, binding = 1, std430) readonly buffer VertexBuffer
     Vertex vertices[];
 }vertexBuffer;
 
+// 16 byte vertex, selected at import. Positions are relative to the surface's bounding sphere, normals and tangents are octahedral
+struct CompactVertex
+{
+    int16_t positionX, positionY, positionZ;
+    int8_t normalX, normalY;
+    float16_t uvX, uvY;
+    int8_t tangentX, tangentY;
+    int8_t tangentW;
+    uint8_t padding;
+};
+
+// Same binding as the vertex buffer above, only one of the two layouts is ever read
+layout(set = 0, binding = 1, std430) readonly buffer CompactVertexBuffer
+{
+    CompactVertex vertices[];
+}compactVertexBuffer;
+
+// Set by the renderer when the loaded geometry uses compact vertices
+layout(constant_id = 1) const uint COMPACT_VERTICES = 0;
+
 // Meshlet used in the mesh shader to draw a surface or mesh
 struct Meshlet
 {
@@ -44,6 +64,29 @@ layout(set = 0, binding = 13, std430) readonly buffer MeshletDataBuffer
     uint data[];
 }meshletDataBuffer;
 
+// A cluster of a surface's lod hierarchy, same as BlitzenEngine::LodCluster
+struct LodCluster
+{
+    // Bounds and error of the group that the cluster was built from
+    vec3 center;
+    float radius;
+
+    // Bounds and error of the group that the cluster was simplified into
+    vec3 parentCenter;
+    float parentRadius;
+
+    float error;
+    float parentError;
+
+    uint meshlet;
+    uint depth;
+};
+
+layout(set = 0, binding = 16, std430) readonly buffer LodClusterBuffer
+{
+    LodCluster clusters[];
+}lodClusterBuffer;
+
 // Holds a specific level of detail's index offset and count (as well as the according data for mesh shaders)
 struct MeshLod
 {
@@ -63,6 +106,15 @@ struct Surface
     vec3 center;
     float radius;
 
+    // Axis aligned bounding box in model space
+    vec3 aabbMin;
+
+    // Normal cone of every triangle of the surface
+    int8_t coneAxis[3];
+    int8_t coneCutoff;
+
+    vec3 aabbMax;
+
     // Holds up to 8 level of detail data structs
     MeshLod lod[8];
     
@@ -75,6 +127,13 @@ struct Surface
     uint materialTag;
 
     uint8_t postPass;
+
+    // The lod indices are in the 16-bit index buffer
+    uint8_t indices16;
+
+    // The surface's clusters in the lod cluster buffer, 0 when it has no cluster lod hierarchy
+    uint firstLodCluster;
+    uint lodClusterCount;
 };
 
 layout(set = 0, binding = 2, std430) readonly buffer SurfaceBuffer
@@ -82,6 +141,50 @@ layout(set = 0, binding = 2, std430) readonly buffer SurfaceBuffer
     Surface surfaces[];
 }surfaceBuffer;
 
+// Vertex attributes after decoding, the same for both vertex layouts
+struct VertexAttributes
+{
+    vec3 position;
+    vec2 uv;
+    vec3 normal;
+    vec4 tangent;
+};
+
+// Same as DecodeOctahedralSnorm8 in blitVertexQuantization.h
+vec3 DecodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// Reads and decodes a vertex of the surface, vertexIndex already includes the surface's vertex offset
+VertexAttributes LoadVertex(uint vertexIndex, vec3 surfaceCenter, float surfaceRadius)
+{
+    VertexAttributes attributes;
+    if(COMPACT_VERTICES != 0)
+    {
+        CompactVertex vertex = compactVertexBuffer.vertices[vertexIndex];
+        vec3 position = max(vec3(vertex.positionX, vertex.positionY, vertex.positionZ) / 32767.0, -1.0);
+        attributes.position = surfaceCenter + position * surfaceRadius;
+        attributes.uv = vec2(vertex.uvX, vertex.uvY);
+        attributes.normal = DecodeOctahedral(max(vec2(vertex.normalX, vertex.normalY) / 127.0, -1.0));
+        attributes.tangent = vec4(DecodeOctahedral(max(vec2(vertex.tangentX, vertex.tangentY) / 127.0, -1.0)), 
+        float(vertex.tangentW));
+    }
+    else
+    {
+        Vertex vertex = vertexBuffer.vertices[vertexIndex];
+        attributes.position = vertex.position;
+        attributes.uv = vec2(vertex.uvX, vertex.uvY);
+        attributes.normal = vec3(vertex.normalX, vertex.normalY, vertex.normalZ) / 127.0 - 1.0;
+        attributes.tangent = vec4(vertex.tangentX, vertex.tangentY, vertex.tangentZ, vertex.tangentW) / 127.0 - 1.0;
+    }
+    return attributes;
+}
+
 // Draw indirect struct. Accessed by the vkCmdDrawIndexedIndirectCount command, but also written into by the culling compute shader
 struct IndirectDraw
 {
@@ -109,9 +212,10 @@ struct IndirectTask
 };
 
 // The below are the same buffer but it is defined differently in the compute pipeline
-// This will be the final buffer used by vkCmdDrawIndexedIndirect and will be filled by a compute shader after doing culling and other operations
+// This will be the final buffer used by vkCmdDrawIndexedIndirect and will be filled by a compute shader after doing culling and other operations.
+// The DrawBucket shaders read the commands of the culling shaders back, so it is not write only there
 #ifdef COMPUTE_PIPELINE
-    layout(set = 0, binding = 7, std430) writeonly buffer IndirectDrawBuffer
+    layout(set = 0, binding = 7, std430) buffer IndirectDrawBuffer
     {
         IndirectDraw draws[];
     }indirectDrawBuffer;
@@ -133,6 +237,24 @@ struct IndirectTask
     }indirectTaskBuffer;
 #endif
 
+// Set by the renderer when visible objects are drawn instanced, with one command for every lod of every surface that has visible objects.
+// The culling shaders then leave the lod draw index of the object in the firstInstance of its command, for the DrawBucket shaders
+layout(constant_id = 3) const uint INSTANCED_DRAWS = 0;
+
+// Object ids of instanced draws, grouped by the lod that they are drawn with. Instance i of a command is the object in element gl_InstanceIndex,
+// since the command's firstInstance is where its objects start. Written by DrawBucketScatter.comp.glsl
+#ifdef COMPUTE_PIPELINE
+    layout(set = 0, binding = 18, std430) writeonly buffer InstanceBuffer
+    {
+        uint objectIds[];
+    }instanceBuffer;
+#else
+    layout(set = 0, binding = 18, std430) readonly buffer InstanceBuffer
+    {
+        uint objectIds[];
+    }instanceBuffer;
+#endif
+
 // Every possible draw call has one of these structs
 struct RenderObject
 {
@@ -158,6 +280,64 @@ layout(set = 0, binding = 5, std430) readonly buffer TransformBuffer
     Transform instances[];
 }transformBuffer;
 
+// 16 byte transform, selected at upload. Same layout as BlitzenEngine::PackedTransform (blitTransformQuantization.h)
+struct PackedTransform
+{
+    uint positionXY;
+    uint positionZCell;
+    uint orientationLow;
+    uint orientationHighScale;
+};
+
+// Same binding as the transform buffer above, only one of the two layouts is ever read
+layout(set = 0, binding = 5, std430) readonly buffer PackedTransformBuffer
+{
+    PackedTransform instances[];
+}packedTransformBuffer;
+
+// Origin of each cell that packed transforms are relative to, the 4th component is the cell size
+layout(set = 0, binding = 11, std430) readonly buffer TransformCellBuffer
+{
+    vec4 origins[];
+}transformCellBuffer;
+
+// Set by the renderer when the transforms were packed
+layout(constant_id = 2) const uint PACKED_TRANSFORMS = 0;
+
+// Same as DecodeSmallestThreeQuat in blitTransformQuantization.h. The 48 bits start from the low word
+vec4 DecodeSmallestThreeQuat(uint low, uint high)
+{
+    uint largest = low & 3u;
+    vec3 smallest = vec3((low >> 2) & 0x7FFFu, (low >> 17) & 0x7FFFu, high & 0x7FFFu) / 32767.0 * 2.0 - 1.0;
+    smallest *= 0.70710678;
+    float largestValue = sqrt(max(1.0 - dot(smallest, smallest), 0.0));
+
+    if(largest == 0)
+        return vec4(largestValue, smallest);
+    if(largest == 1)
+        return vec4(smallest.x, largestValue, smallest.yz);
+    if(largest == 2)
+        return vec4(smallest.xy, largestValue, smallest.z);
+    return vec4(smallest, largestValue);
+}
+
+// Reads and decodes the transform, from whichever layout was uploaded
+Transform LoadTransform(uint transformId)
+{
+    if(PACKED_TRANSFORMS == 0)
+        return transformBuffer.instances[transformId];
+
+    PackedTransform packedTransform = packedTransformBuffer.instances[transformId];
+    vec4 cell = transformCellBuffer.origins[packedTransform.positionZCell >> 16];
+
+    Transform transform;
+    vec3 position = vec3(packedTransform.positionXY & 0xFFFFu, packedTransform.positionXY >> 16, packedTransform.positionZCell & 0xFFFFu) / 65535.0;
+    transform.pos = cell.xyz + position * cell.w;
+    transform.orientation = DecodeSmallestThreeQuat(packedTransform.orientationLow, packedTransform.orientationHighScale);
+    transform.scale = unpackHalf2x16(packedTransform.orientationHighScale >> 16).x;
+    return transform;
+}
+
 // Holds data that defines the material of a surface
 struct Material
 {
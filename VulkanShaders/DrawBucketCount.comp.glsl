@@ -0,0 +1,24 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#define COMPUTE_PIPELINE
+
+#include "../VulkanShaderHeaders/ShaderBuffers.glsl"
+#include "../VulkanShaderHeaders/CullingShaderData.glsl"
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// First of the instanced draw passes, dispatched after a culling shader for every element of the indirect draw buffer.
+// Counts the visible objects of each bucket
+void main()
+{
+    uint drawIndex = gl_GlobalInvocationID.x;
+    if(!DrawCommandWritten(drawIndex))
+        return;
+
+    // The culling shader left the object's bucket in the first instance. 
+    // The object's place in its bucket is kept in the instance count, since this command is never drawn
+    uint bucket = indirectDrawBuffer.draws[drawIndex].firstInstance;
+    indirectDrawBuffer.draws[drawIndex].instanceCount = atomicAdd(drawBucketBuffer.buckets[bucket].count, 1);
+}
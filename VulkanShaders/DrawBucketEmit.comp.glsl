@@ -0,0 +1,37 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#define COMPUTE_PIPELINE
+
+#include "../VulkanShaderHeaders/ShaderBuffers.glsl"
+#include "../VulkanShaderHeaders/CullingShaderData.glsl"
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// Last of the instanced draw passes, dispatched for every bucket once the instance buffer is written and the indirect count buffer is zeroed.
+// Replaces the commands of the culling shader with one instanced command for every bucket with visible objects
+void main()
+{
+    uint bucket = gl_GlobalInvocationID.x;
+    if(bucket >= uint(drawBucketBuffer.buckets.length()))
+        return;
+
+    DrawBucket drawBucket = drawBucketBuffer.buckets[bucket];
+    if(drawBucket.count == 0)
+        return;
+
+    // Buckets are elements of the lod draw table
+    uint surfaceId = bucket / 8;
+    SurfaceLodDraw lod = LoadLodDraw(surfaceId, bucket % 8);
+    uint drawIndex = AllocateDrawCommand(surfaceCullBuffer.surfaces[surfaceId].flags);
+
+    // The object id is not read by instanced draws, the bucket is kept there for debugging
+    indirectDrawBuffer.draws[drawIndex].objectId = bucket;
+
+    indirectDrawBuffer.draws[drawIndex].indexCount = lod.indexCount;
+    indirectDrawBuffer.draws[drawIndex].instanceCount = drawBucket.count;
+    indirectDrawBuffer.draws[drawIndex].firstIndex = lod.firstIndex;
+    indirectDrawBuffer.draws[drawIndex].vertexOffset = lod.vertexOffset;
+    indirectDrawBuffer.draws[drawIndex].firstInstance = drawBucket.offset;
+}
@@ -0,0 +1,49 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#define COMPUTE_PIPELINE
+
+#include "../VulkanShaderHeaders/ShaderBuffers.glsl"
+#include "../VulkanShaderHeaders/CullingShaderData.glsl"
+
+#define SCAN_THREAD_COUNT 256
+
+layout(local_size_x = SCAN_THREAD_COUNT, local_size_y = 1, local_size_z = 1) in;
+
+shared uint chunkSums[SCAN_THREAD_COUNT];
+
+// Dispatched as a single workgroup after DrawBucketCount.comp.glsl. 
+// Sets the offset of every bucket to the sum of the counts of the buckets before it (exclusive prefix sum)
+void main()
+{
+    uint thread = gl_LocalInvocationID.x;
+
+    // Each thread takes a contiguous chunk of buckets
+    uint bucketCount = uint(drawBucketBuffer.buckets.length());
+    uint chunkSize = (bucketCount + SCAN_THREAD_COUNT - 1) / SCAN_THREAD_COUNT;
+    uint first = min(thread * chunkSize, bucketCount);
+    uint last = min(first + chunkSize, bucketCount);
+
+    uint chunkSum = 0;
+    for(uint i = first; i < last; ++i)
+        chunkSum += drawBucketBuffer.buckets[i].count;
+    chunkSums[thread] = chunkSum;
+    barrier();
+
+    // Inclusive scan of the chunk sums, each step adds the sum from stride threads before
+    for(uint stride = 1; stride < SCAN_THREAD_COUNT; stride *= 2)
+    {
+        uint previous = thread >= stride ? chunkSums[thread - stride] : 0;
+        barrier();
+        chunkSums[thread] += previous;
+        barrier();
+    }
+
+    uint offset = chunkSums[thread] - chunkSum;
+    for(uint i = first; i < last; ++i)
+    {
+        drawBucketBuffer.buckets[i].offset = offset;
+        offset += drawBucketBuffer.buckets[i].count;
+    }
+}
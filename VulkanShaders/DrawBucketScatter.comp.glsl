@@ -0,0 +1,23 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+
+#define COMPUTE_PIPELINE
+
+#include "../VulkanShaderHeaders/ShaderBuffers.glsl"
+#include "../VulkanShaderHeaders/CullingShaderData.glsl"
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// Dispatched after DrawBucketScan.comp.glsl for every element of the indirect draw buffer.
+// Places the id of every visible object in its bucket's part of the instance buffer
+void main()
+{
+    uint drawIndex = gl_GlobalInvocationID.x;
+    if(!DrawCommandWritten(drawIndex))
+        return;
+
+    // The first instance holds the bucket and the instance count the object's place in it (DrawBucketCount.comp.glsl)
+    IndirectDraw command = indirectDrawBuffer.draws[drawIndex];
+    instanceBuffer.objectIds[drawBucketBuffer.buckets[command.firstInstance].offset + command.instanceCount] = command.objectId;
+}
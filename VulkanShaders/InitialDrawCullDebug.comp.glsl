@@ -24,37 +24,44 @@ void main()
     if(visibilityBuffer.visibilities[objectIndex] == 0)
         return;
 
+    // Static objects have their world space sphere and box baked, so the ones outside the frustum are rejected
+    // before their render object, transform and surface are read
+    WorldBounds worldBounds = worldBoundsBuffer.bounds[objectIndex];
+    bool bStatic = worldBounds.radius >= 0;
+    if(bStatic && !SphereInFrustum((viewData.view * vec4(worldBounds.center, 1)).xyz, worldBounds.radius))
+        return;
+
     // Gets the current object using the global invocation ID. It also retrieves the surface that the objects points to and the transform data
     RenderObject currentObject = objectBuffer.objects[objectIndex];
-    Transform transform = transformBuffer.instances[currentObject.meshInstanceId];
-    Surface surface = surfaceBuffer.surfaces[currentObject.surfaceId];
+    Transform transform = LoadTransform(currentObject.meshInstanceId);
+    // Only the cull record of the surface is read here, the lod draw table is read after the object passes culling
+    SurfaceCull surface = surfaceCullBuffer.surfaces[currentObject.surfaceId];
 
     // The initial culling pass does not touch transparent objects
-    if(surface.postPass == 1)
+    if((uint(surface.flags) & SURFACE_CULL_POST_PASS) != 0)
         return;
 
     // Promotes the bounding sphere's center to model and the view coordinates (frustum culling will be done on view space)
-    vec3 center = RotateQuat(surface.center, transform.orientation) * transform.scale + transform.pos;
+    vec3 center = bStatic ? worldBounds.center : RotateQuat(surface.center, transform.orientation) * transform.scale + transform.pos;
     center = (viewData.view * vec4(center, 1)).xyz;
 
     // The bounding sphere's radius only needs to be multiplied by the object's scale
-	float radius = surface.radius * transform.scale;
-
-    // Check that the bounding sphere is inside the view frustum(frustum culling)
-	bool visible = true;
-    // the left/top/right/bottom plane culling utilizes frustum symmetry to cull against two planes at the same time
-    // Formula taken from Arseny Kapoulkine's Niagara renderer https://github.com/zeux/niagara
-    // It is also referenced in VKguide's GPU driven rendering articles https://vkguide.dev/docs/gpudriven/compute_culling/
-    visible = visible && center.z * viewData.frustumLeft - abs(center.x) * viewData.frustumRight > -radius;
-	visible = visible && center.z * viewData.frustumBottom - abs(center.y) * viewData.frustumTop > -radius;
-	// the near/far plane culling uses camera space Z directly
-	visible = visible && center.z + radius > viewData.zNear && center.z - radius < viewData.zFar;
+	float radius = bStatic ? worldBounds.radius : surface.radius * transform.scale;
+
+    // Check that the bounding sphere is inside the view frustum(frustum culling), static objects have already passed
+	bool visible = bStatic || SphereInFrustum(center, radius);
+
+    // Objects whose sphere passed are tested again with their box, the baked one for static objects
+    visible = visible && (bStatic ? WorldBoxInFrustum(worldBounds) : BoxInFrustum(surface, transform));
+    #ifdef CONE_CULLING_ENABLED
+    visible = visible && !ConeCulled(surface, transform, center, radius);
+    #endif
 	
     // Create draw commands for the objects that passed frustum culling
     if(visible)
     {
         // With each element that is added to the draw list, increment the count buffer
-        uint drawIndex = atomicAdd(indirectCountBuffer.drawCount, 1);
+        uint drawIndex = AllocateDrawCommand(surface.flags);
 
         // The lod index is declared here. if LODs are not enabled the most detailed version of an object will be used by default
         uint lodIndex = 0;
@@ -67,13 +74,11 @@ void main()
 		{
 			float distance = max(length(center) - radius, 0);
 			float threshold = distance * viewData.lodTarget / transform.scale;
-			for (uint i = 1; i < surface.lodCount; ++i)
-				if (surface.lod[i].error < threshold)
-					lodIndex = i;
+			lodIndex = SelectLod(surface, threshold);
 		}
 
         // Get the selected LOD
-        MeshLod currentLod = surface.lod[lodIndex];
+        SurfaceLodDraw currentLod = LoadLodDraw(currentObject.surfaceId, lodIndex);
 
         // The object index is needed to know which element to access in the per object data buffer
         indirectDrawBuffer.draws[drawIndex].objectId = objectIndex;
@@ -82,7 +87,8 @@ void main()
         indirectDrawBuffer.draws[drawIndex].indexCount = currentLod.indexCount;
         indirectDrawBuffer.draws[drawIndex].instanceCount = 1;
         indirectDrawBuffer.draws[drawIndex].firstIndex = currentLod.firstIndex;
-        indirectDrawBuffer.draws[drawIndex].vertexOffset = surface.vertexOffset;
-        indirectDrawBuffer.draws[drawIndex].firstInstance = 0;
+        indirectDrawBuffer.draws[drawIndex].vertexOffset = currentLod.vertexOffset;
+        // Instanced draws use the first instance to find the object's bucket, the command is replaced before it is drawn
+        indirectDrawBuffer.draws[drawIndex].firstInstance = INSTANCED_DRAWS != 0 ? LodDrawIndex(currentObject.surfaceId, lodIndex) : 0;
     } 
 }
\ No newline at end of file
@@ -21,31 +21,39 @@ void main()
     if(cullPC.drawCount <= objectIndex)
         return;
 
-    // Access the object's data
+    // Access the object's data. The late pass needs the surface's flags even for objects outside the frustum, since it writes their visibility
     RenderObject object = objectBuffer.objects[objectIndex];
-    Transform transform = transformBuffer.instances[object.meshInstanceId];
-    Surface surface = surfaceBuffer.surfaces[object.surfaceId];
+    // Only the cull record of the surface is read here, the lod draw table is read after the object passes culling
+    SurfaceCull surface = surfaceCullBuffer.surfaces[object.surfaceId];
 
     // If the late culling shader does not match the pass of the current surface it exits
-    if(surface.postPass != cullPC.postPass)
+    if((uint(surface.flags) & SURFACE_CULL_POST_PASS) != uint(cullPC.postPass))
         return;
+
+    // Static objects have their world space sphere and box baked, so their transform is only read once both pass
+    WorldBounds worldBounds = worldBoundsBuffer.bounds[objectIndex];
+    bool bStatic = worldBounds.radius >= 0;
+    Transform transform;
+    if(!bStatic)
+        transform = LoadTransform(object.meshInstanceId);
     
     // Promotes the bounding sphere's center to model and the view coordinates (frustum culling will be done on view space)
-    vec3 center = RotateQuat(surface.center, transform.orientation) * transform.scale + transform.pos;
+    vec3 center = bStatic ? worldBounds.center : RotateQuat(surface.center, transform.orientation) * transform.scale + transform.pos;
     center = (viewData.view * vec4(center, 1)).xyz;
 
     // The bounding sphere's radius only needs to be multiplied by the object's scale
-	float radius = surface.radius * transform.scale;
+	float radius = bStatic ? worldBounds.radius : surface.radius * transform.scale;
 
     // Check that the bounding sphere is inside the view frustum(frustum culling)
-	bool visible = true;
-    // the left/top/right/bottom plane culling utilizes frustum symmetry to cull against two planes at the same time
-    // Formula taken from Arseny Kapoulkine's Niagara renderer https://github.com/zeux/niagara
-    // It is also referenced in VKguide's GPU driven rendering articles https://vkguide.dev/docs/gpudriven/compute_culling/
-    visible = visible && center.z * viewData.frustumLeft - abs(center.x) * viewData.frustumRight > -radius;
-	visible = visible && center.z * viewData.frustumBottom - abs(center.y) * viewData.frustumTop > -radius;
-	// the near/far plane culling uses camera space Z directly
-	visible = visible && center.z + radius > viewData.zNear && center.z - radius < viewData.zFar;
+	bool visible = SphereInFrustum(center, radius);
+
+    // Objects whose sphere passed are tested again with their box, the baked one for static objects
+    visible = visible && (bStatic ? WorldBoxInFrustum(worldBounds) : BoxInFrustum(surface, transform));
+    if(visible && bStatic)
+        transform = LoadTransform(object.meshInstanceId);
+    #ifdef CONE_CULLING_ENABLED
+    visible = visible && !ConeCulled(surface, transform, center, radius);
+    #endif
 
     // Later draw culling also does occlusion culling on objects that passed the frustum culling test above
     if (visible && uint(cullPC.occlusionEnabled) == 1)
@@ -72,7 +80,7 @@ void main()
     if(visible && (visibilityBuffer.visibilities[objectIndex] == 0 || cullPC.postPass != 0))
     {
         // With each element that is added to the draw list, increment the count buffer
-        uint drawIndex = atomicAdd(indirectCountBuffer.drawCount, 1);
+        uint drawIndex = AllocateDrawCommand(surface.flags);
 
         // The lod index is declared here. if LODs are not enabled the most detailed version of an object will be used by default
         uint lodIndex = 0;
@@ -85,13 +93,11 @@ void main()
 		{
 			float distance = max(length(center) - radius, 0);
 			float threshold = distance * viewData.lodTarget / transform.scale;
-			for (uint i = 1; i < surface.lodCount; ++i)
-				if (surface.lod[i].error < threshold)
-					lodIndex = i;
+			lodIndex = SelectLod(surface, threshold);
 		}
 
         // Get the selected LOD
-        MeshLod currentLod = surface.lod[lodIndex];
+        SurfaceLodDraw currentLod = LoadLodDraw(object.surfaceId, lodIndex);
 
         // The object index is needed to know which element to access in the per object data buffer
         indirectDrawBuffer.draws[drawIndex].objectId = objectIndex;
@@ -100,8 +106,9 @@ void main()
         indirectDrawBuffer.draws[drawIndex].indexCount = currentLod.indexCount;
         indirectDrawBuffer.draws[drawIndex].instanceCount = 1;
         indirectDrawBuffer.draws[drawIndex].firstIndex = currentLod.firstIndex;
-        indirectDrawBuffer.draws[drawIndex].vertexOffset = surface.vertexOffset;
-        indirectDrawBuffer.draws[drawIndex].firstInstance = 0;
+        indirectDrawBuffer.draws[drawIndex].vertexOffset = currentLod.vertexOffset;
+        // Instanced draws use the first instance to find the object's bucket, the command is replaced before it is drawn
+        indirectDrawBuffer.draws[drawIndex].firstInstance = INSTANCED_DRAWS != 0 ? LodDrawIndex(object.surfaceId, lodIndex) : 0;
     }
 
     // Any object that passed both occlusion and frustum culling, will have its visibility set to 1 for next frame
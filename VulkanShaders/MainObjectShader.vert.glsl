@@ -14,32 +14,38 @@ layout(location = 2) out vec4 outTangent;
 layout(location = 3) out uint outMaterialTag;
 layout(location = 4) out vec3 outModel;
 
+// Where the commands of the current indirect call begin in the indirect draw buffer. 
+// gl_DrawIDARB starts from 0 again for the 16-bit index call
+layout(push_constant) uniform DrawConstants
+{
+    uint drawOffset;
+}drawPC;
+
 void main()
 {
-    // Access the current vertex
-    Vertex vertex = vertexBuffer.vertices[gl_VertexIndex];
+    // Access the current object data. Instanced commands draw every object of their bucket, the others hold their object's id
+    uint objectId = INSTANCED_DRAWS != 0 ? instanceBuffer.objectIds[gl_InstanceIndex] : 
+    indirectDrawBuffer.draws[gl_DrawIDARB + drawPC.drawOffset].objectId;
+    RenderObject object = objectBuffer.objects[objectId];
+    Transform transform = LoadTransform(object.meshInstanceId);
+    Surface surface = surfaceBuffer.surfaces[object.surfaceId];
 
-    // Access the current object data
-    RenderObject object = objectBuffer.objects[indirectDrawBuffer.draws[gl_DrawIDARB].objectId];
-    Transform transform = transformBuffer.instances[object.meshInstanceId];
+    // Access the current vertex, decoded from whichever layout was loaded
+    VertexAttributes vertex = LoadVertex(gl_VertexIndex, surface.center, surface.radius);
 
     // Calculate the model position by using the current transform data(the model position will be passed to the fragment shader and for gl_position)
     vec3 modelPosition = RotateQuat(vertex.position, transform.orientation) * transform.scale + transform.pos;
     // Calculate final gl_position by projecting model position to clip coordinates
     gl_Position = viewData.projectionView * vec4(modelPosition, 1.0);
 
-    // Create a vec2 from the uvMap halfFloats to be passed to the fragment shader
-    outUv = vec2(float(vertex.uvX), float(vertex.uvY));
+    outUv = vertex.uv;
 
-    outMaterialTag = surfaceBuffer.surfaces[object.surfaceId].materialTag;
+    outMaterialTag = surface.materialTag;
     
-    // Unpack surface normals
-    vec3 normal = vec3(vertex.normalX, vertex.normalY, vertex.normalZ) / 127.0 - 1.0;
     // Pass the normal after promoting it to model coordinates
-    outNormal =  RotateQuat(normal, transform.orientation);
+    outNormal =  RotateQuat(vertex.normal, transform.orientation);
 
-    // Unpack tangents
-    vec4 tangent = vec4(vertex.tangentX, vertex.tangentY, vertex.tangentZ, vertex.tangentW) / 127.0 - 1.0;
+    vec4 tangent = vertex.tangent;
     tangent.xyz = RotateQuat(tangent.xyz, transform.orientation);
     outTangent = tangent;
 
@@ -23,7 +23,7 @@ void main()
 
     // Access the current object data
     RenderObject currentObject = objectBuffer.objects[payload.drawId];
-    Transform currentInstance = transformBuffer.instances[currentObject.meshInstanceId];
+    Transform currentInstance = LoadTransform(currentObject.meshInstanceId);
     Surface currentSurface = surfaceBuffer.surfaces[currentObject.surfaceId];
 
     // Meshlet data
@@ -37,12 +37,11 @@ void main()
     for(uint i = threadId; i < vertexCount; i += 64)
     {
         uint vertexIndex = meshletDataBuffer.data[vertexOffset + i] + currentSurface.vertexOffset;
-        Vertex currentVertex = vertexBuffer.vertices[vertexIndex];
+        VertexAttributes currentVertex = LoadVertex(vertexIndex, currentSurface.center, currentSurface.radius);
 
         vec3 position = currentVertex.position;
-        vec3 n = vec3(currentVertex.normalX, currentVertex.normalY, currentVertex.normalZ);
-		vec3 normal = RotateQuat(n, currentInstance.orientation);
-		vec2 uv = vec2(currentVertex.uvX, currentVertex.uvY);
+		vec3 normal = RotateQuat(currentVertex.normal, currentInstance.orientation);
+		vec2 uv = currentVertex.uv;
 
         gl_MeshVerticesEXT[i].gl_Position = viewData.projectionView * 
         vec4(RotateQuat(position, currentInstance.orientation) * currentInstance.scale + currentInstance.pos, 1);
@@ -15,6 +15,17 @@ bool coneCull(vec4 cone, vec3 view)
 	return dot(cone.xyz, view) > cone.w;
 }
 
+// Selected clusters of the cluster lod path are compacted here before they are emitted
+shared uint selectedClusterCount;
+
+// Whether a group with these bounds and error can be drawn from the current view, same test as the discrete lod selection
+bool LodErrorAcceptable(vec3 center, float radius, float error, Transform transform)
+{
+	vec3 worldCenter = RotateQuat(center, transform.orientation) * transform.scale + transform.pos;
+	float distance = max(length(worldCenter - viewData.position) - radius * transform.scale, 0.0);
+	return error * transform.scale <= distance * viewData.lodTarget;
+}
+
 void main()
 {
     uint threadIndex = gl_LocalInvocationID.x;
@@ -22,12 +33,38 @@ void main()
 
 	uint drawId = indirectDrawBuffer.draws[gl_DrawIDARB].objectId;
     RenderObject currentObject = objectBuffer.objects[drawId];
-	Transform meshDraw = transformBuffer.instances[currentObject.meshInstanceId];
+	Transform meshDraw = LoadTransform(currentObject.meshInstanceId);
     Surface currentSurface = surfaceBuffer.surfaces[currentObject.surfaceId];
 
-    uint meshletIndex = meshletGroupIndex * 32 + threadIndex + indirectTaskBuffer.tasks[gl_DrawIDARB].taskId;
-
     payload.drawId = drawId;
-    payload.meshletIndices[threadIndex] = meshletIndex;
-    EmitMeshTasksEXT(32, 1, 1);
-}
\ No newline at end of file
+
+    // Surfaces with a cluster lod hierarchy draw every cluster whose own error is acceptable while its parent's is not
+    if(currentSurface.lodClusterCount != 0)
+    {
+        if(threadIndex == 0)
+            selectedClusterCount = 0;
+        barrier();
+
+        uint clusterIndex = meshletGroupIndex * 32 + threadIndex;
+        if(clusterIndex < currentSurface.lodClusterCount)
+        {
+            LodCluster cluster = lodClusterBuffer.clusters[currentSurface.firstLodCluster + clusterIndex];
+            if(LodErrorAcceptable(cluster.center, cluster.radius, cluster.error, meshDraw) && 
+            !LodErrorAcceptable(cluster.parentCenter, cluster.parentRadius, cluster.parentError, meshDraw))
+            {
+                uint selectedIndex = atomicAdd(selectedClusterCount, 1);
+                payload.meshletIndices[selectedIndex] = cluster.meshlet;
+            }
+        }
+        barrier();
+    }
+    else
+    {
+        if(threadIndex == 0)
+            selectedClusterCount = 32;
+        payload.meshletIndices[threadIndex] = meshletGroupIndex * 32 + threadIndex + indirectTaskBuffer.tasks[gl_DrawIDARB].taskId;
+        barrier();
+    }
+
+    EmitMeshTasksEXT(selectedClusterCount, 1, 1);
+}
@@ -61,6 +61,20 @@ namespace BlitzenGL
 
     uint8_t OpenglRenderer::SetupForRendering(BlitzenEngine::RenderingResources* pResources, float& pyramidWidth, float& pyramidHeight)
     {
+        // The draw call below only handles 32-bit triangle lists
+        if(pResources->indices16.GetSize() || pResources->bStripIndices)
+        {
+            BLIT_ERROR("The Opengl renderer does not support 16-bit or strip indices")
+            return 0;
+        }
+
+        // The vertex shader reads full vertices, compact ones leave the vertices array empty
+        if(pResources->bCompactVertices)
+        {
+            BLIT_ERROR("The Opengl renderer does not support compact vertices")
+            return 0;
+        }
+
         // Generates the vertex array. I don't know why this needs to be here since I am not using vertex attributes, 
         // but if I don't have it, OpenGL will draw nothing -_-
         glGenVertexArrays(1, &m_vertexArray);
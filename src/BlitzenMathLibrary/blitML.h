@@ -42,6 +42,10 @@ namespace BlitML
     inline float Abs(float x) {return fabsf(x);}
     inline float Max(float x, float y) { return (x > y) ? x : y; }
     inline uint32_t Max(uint32_t x, uint32_t y) { return (x > y) ? x : y; }
+    inline int32_t Max(int32_t x, int32_t y) { return (x > y) ? x : y; }
+    inline float Min(float x, float y) { return (x < y) ? x : y; }
+    inline uint32_t Min(uint32_t x, uint32_t y) { return (x < y) ? x : y; }
+    inline int32_t Min(int32_t x, int32_t y) { return (x < y) ? x : y; }
 
     inline uint32_t Clamp(uint32_t initial, uint32_t upper, uint32_t lower) { 
         return (initial >= upper) ? upper
@@ -60,29 +64,22 @@ namespace BlitML
         return result;
     }
 
-    static uint8_t sRandSeeded = 0;
-
-    inline int32_t Rand() 
-    {
-        if(!sRandSeeded)
-        {
-            srand(static_cast<uint32_t>(BlitzenPlatform::PlatformGetAbsoluteTime()));
-            sRandSeeded = 1;
-        }
-        return rand();
+    // Spreads the low 10 bits of value so that there are 2 zero bits between each of them
+    inline uint32_t SpreadBits10(uint32_t value) {
+        value &= 0x3FF;
+        value = (value * 0x00010001u) & 0xFF0000FFu;
+        value = (value * 0x00000101u) & 0x0F00F00Fu;
+        value = (value * 0x00000011u) & 0xC30C30C3u;
+        value = (value * 0x00000005u) & 0x49249249u;
+        return value;
     }
-    inline int32_t RandInRange(int32_t min, int32_t max)
-    {
-        if (!sRandSeeded) 
-        {
-            srand(static_cast<uint32_t>(BlitzenPlatform::PlatformGetAbsoluteTime()));
-            sRandSeeded = 1;
-        }
-        return (rand() % (max - min + 1)) + min;
+
+    // 30-bit morton code of 3 10-bit coordinates, x takes the highest bit of each triple
+    inline uint32_t MortonCode3(uint32_t x, uint32_t y, uint32_t z) {
+        return (SpreadBits10(x) << 2) | (SpreadBits10(y) << 1) | SpreadBits10(z);
     }
 
-    inline float FRand();
-    inline float FRandInRange(float min, float max);
+    // Rand, RandInRange, FRand and FRandInRange are in blitMLRandom.h, with the seeded generators
 
 
     /*-----------------------
@@ -338,6 +335,30 @@ namespace BlitML
         float t23 = m[4] * m[1];
         mat4 res;
         float* pRes = res.data;
+        #ifdef BLIT_ML_SSE4
+        // Each group of 4 elements is 2 sums of 3 products, with the cofactors of the 4 elements in the lanes
+        const float t[24] = {t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19, t20, t21, t22, t23};
+        auto products = [&t, m](int a0, int b0, int a1, int b1, int a2, int b2, int a3, int b3){
+            return _mm_mul_ps(_mm_setr_ps(t[a0], t[a1], t[a2], t[a3]), _mm_setr_ps(m[b0], m[b1], m[b2], m[b3]));
+        };
+        auto sum3 = [](__m128 p0, __m128 p1, __m128 p2){ return _mm_add_ps(_mm_add_ps(p0, p1), p2); };
+
+        __m128 c0 = _mm_sub_ps(sum3(products(0, 5, 1, 1, 2, 1, 5, 1), products(3, 9, 6, 9, 7, 5, 8, 5), products(4, 13, 9, 13, 10, 13, 11, 9)),
+        sum3(products(1, 5, 0, 1, 3, 1, 4, 1), products(2, 9, 7, 9, 6, 5, 9, 5), products(5, 13, 8, 13, 11, 13, 10, 9)));
+        __m128 c1 = _mm_sub_ps(sum3(products(1, 4, 0, 0, 3, 0, 4, 0), products(2, 8, 7, 8, 6, 4, 9, 4), products(5, 12, 8, 12, 11, 12, 10, 8)),
+        sum3(products(0, 4, 1, 0, 2, 0, 5, 0), products(3, 8, 6, 8, 7, 4, 8, 4), products(4, 12, 9, 12, 10, 12, 11, 8)));
+        __m128 c2 = _mm_sub_ps(sum3(products(12, 7, 13, 3, 14, 3, 17, 3), products(15, 11, 18, 11, 19, 7, 20, 7), products(16, 15, 21, 15, 22, 15, 23, 11)),
+        sum3(products(13, 7, 12, 3, 15, 3, 16, 3), products(14, 11, 19, 11, 18, 7, 21, 7), products(17, 15, 20, 15, 23, 15, 22, 11)));
+        __m128 c3 = _mm_sub_ps(sum3(products(14, 10, 20, 14, 18, 6, 22, 10), products(17, 14, 12, 2, 23, 14, 16, 2), products(13, 6, 19, 10, 15, 2, 21, 6)),
+        sum3(products(16, 14, 18, 10, 22, 14, 20, 6), products(12, 6, 21, 14, 14, 2, 23, 10), products(15, 10, 13, 2, 19, 6, 17, 2)));
+
+        __m128 determinant = _mm_div_ss(_mm_set_ss(1.f), SimdDot4(_mm_setr_ps(m[0], m[4], m[8], m[12]), c0));
+        determinant = _mm_shuffle_ps(determinant, determinant, _MM_SHUFFLE(0, 0, 0, 0));
+        _mm_storeu_ps(pRes, _mm_mul_ps(determinant, c0));
+        _mm_storeu_ps(pRes + 4, _mm_mul_ps(determinant, c1));
+        _mm_storeu_ps(pRes + 8, _mm_mul_ps(determinant, c2));
+        _mm_storeu_ps(pRes + 12, _mm_mul_ps(determinant, c3));
+        #else
         pRes[0] = (t0 * m[5] + t3 * m[9] + t4 * m[13]) - (t1 * m[5] + t2 * m[9] + t5 * m[13]);
         pRes[1] = (t1 * m[1] + t6 * m[9] + t9 * m[13]) - (t0 * m[1] + t7 * m[9] + t8 * m[13]);
         pRes[2] = (t2 * m[1] + t7 * m[5] + t10 * m[13]) - (t3 * m[1] + t6 * m[5] + t11 * m[13]);
@@ -359,6 +380,7 @@ namespace BlitML
         pRes[13] = d * ((t20 * m[14] + t12 * m[2] + t19 * m[10]) - (t18 * m[10] + t21 * m[14] + t13 * m[2]));
         pRes[14] = d * ((t18 * m[6] + t23 * m[14] + t15 * m[2]) - (t22 * m[14] + t14 * m[2] + t19 * m[6]));
         pRes[15] = d * ((t22 * m[10] + t16 * m[2] + t21 * m[6]) - (t20 * m[6] + t23 * m[10] + t17 * m[2]));
+        #endif
         return res;
     }
 
@@ -497,8 +519,14 @@ namespace BlitML
     inline float QuatNormal(const quat& q){ return Sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w); }
 
     inline quat NormalizeQuat(const quat& q) {
+        #ifdef BLIT_ML_SSE4
+        quat res;
+        _mm_storeu_ps(res.elements, SimdNormalize4(_mm_loadu_ps(q.elements)));
+        return res;
+        #else
         float normal = QuatNormal(q);
         return quat(q.x / normal, q.y / normal , q.z / normal, q.w / normal);
+        #endif
     }
 
     inline quat QuatConjugate(const quat& q) { return quat(-q.x, -q.y, -q.z, q.w); }
@@ -510,16 +538,47 @@ namespace BlitML
         quat res;
         res.x = q1.x * q2.w + q1.y * q2.z - q1.z * q2.y + q1.w * q2.x;
         res.y = -q1.x * q2.z + q1.y * q2.w + q1.z * q2.x + q1.w * q2.y;
-        res.z = q1.x * q1.y - q1.y * q2.x + q1.z * q2.w + q1.w * q2.z;
+        res.z = q1.x * q2.y - q1.y * q2.x + q1.z * q2.w + q1.w * q2.z;
         res.w = -q1.x * q2.x -q1.y * q2.y -q1.z * q2.z + q1.w * q2.w;
         return res;
     }
 
+    // Same as RotateQuat in the shaders. The quaternion is expected to be normalized
+    inline vec3 RotateQuat(const vec3& v, const quat& q)
+    {
+        vec3 axis(q.x, q.y, q.z);
+        return v + Cross(axis, Cross(axis, v) + v * q.w) * 2.f;
+    }
+
     inline float QuatDot(const quat& q1, const quat& q2) { return q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w; }
 
     inline mat4 QuatToMat4(const quat& q) 
     {
         mat4 res;
+        #ifdef BLIT_ML_SSE4
+        // Each column is a - b. The diagonal element starts as 1 - a and the elements that add b subtract it negated
+        const __m128 n = SimdNormalize4(_mm_loadu_ps(q.elements));
+        const __m128 n2 = _mm_mul_ps(_mm_set1_ps(2.f), n);
+        const __m128 one = _mm_set1_ps(1.f);
+
+        // 2yy, 2xy, 2xz and 2zz, 2zw, 2yw
+        __m128 a = _mm_mul_ps(_mm_shuffle_ps(n2, n2, _MM_SHUFFLE(0, 0, 0, 1)), _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 2, 1, 1)));
+        __m128 b = _mm_mul_ps(_mm_shuffle_ps(n2, n2, _MM_SHUFFLE(0, 1, 2, 2)), _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 3, 3, 2)));
+        __m128 column = _mm_sub_ps(_mm_blend_ps(a, _mm_sub_ps(one, a), 0x1), SimdNegateLanes<0x4>(b));
+        _mm_storeu_ps(res.data, _mm_blend_ps(column, _mm_setzero_ps(), 0x8));
+
+        // 2xy, 2xx, 2yz and 2zw, 2zz, 2xw
+        a = _mm_mul_ps(_mm_shuffle_ps(n2, n2, _MM_SHUFFLE(0, 1, 0, 0)), _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 2, 0, 1)));
+        b = _mm_mul_ps(_mm_shuffle_ps(n2, n2, _MM_SHUFFLE(0, 0, 2, 2)), _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 3, 2, 3)));
+        column = _mm_sub_ps(_mm_blend_ps(a, _mm_sub_ps(one, a), 0x2), SimdNegateLanes<0x1>(b));
+        _mm_storeu_ps(res.data + 4, _mm_blend_ps(column, _mm_setzero_ps(), 0x8));
+
+        // 2xz, 2yz, 2xx and 2yw, 2xw, 2yy
+        a = _mm_mul_ps(_mm_shuffle_ps(n2, n2, _MM_SHUFFLE(0, 0, 1, 0)), _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 0, 2, 2)));
+        b = _mm_mul_ps(_mm_shuffle_ps(n2, n2, _MM_SHUFFLE(0, 1, 0, 1)), _mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 1, 3, 3)));
+        column = _mm_sub_ps(_mm_blend_ps(a, _mm_sub_ps(one, a), 0x4), SimdNegateLanes<0x2>(b));
+        _mm_storeu_ps(res.data + 8, _mm_blend_ps(column, _mm_setzero_ps(), 0x8));
+        #else
         quat n = NormalizeQuat(q);
         res.data[0] = 1.0f - 2.0f * n.y * n.y - 2.0f * n.z * n.z;
         res.data[1] = 2.0f * n.x * n.y - 2.0f * n.z * n.w;
@@ -530,6 +589,7 @@ namespace BlitML
         res.data[8] = 2.0f * n.x * n.z - 2.0f * n.y * n.w;
         res.data[9] = 2.0f * n.y * n.z + 2.0f * n.x * n.w;
         res.data[10] = 1.0f - 2.0f * n.x * n.x - 2.0f * n.y * n.y;
+        #endif
         return res;
     }
 
@@ -573,6 +633,30 @@ namespace BlitML
     inline quat QuatSlerp(const quat& q_0, const quat& q_1, float percentage) 
     {
         quat res;
+        #ifdef BLIT_ML_SSE4
+        // Same steps as the scalar version below, with the 4 components in one register
+        __m128 v0 = SimdNormalize4(_mm_loadu_ps(q_0.elements));
+        __m128 v1 = SimdNormalize4(_mm_loadu_ps(q_1.elements));
+        float dot = _mm_cvtss_f32(SimdDot4(v0, v1));
+        if (dot < 0.0f) {
+            v1 = _mm_xor_ps(v1, _mm_set1_ps(-0.f));
+            dot = -dot;
+        }
+        const float DOT_THRESHOLD = 0.9995f;
+        if (dot > DOT_THRESHOLD) {
+            __m128 lerp = _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(v1, v0), _mm_set1_ps(percentage)));
+            _mm_storeu_ps(res.elements, SimdNormalize4(lerp));
+            return res;
+        }
+        float theta_0 = Acos(dot);
+        float theta = theta_0 * percentage;
+        float sin_theta = Sin(theta);
+        float sin_theta_0 = Sin(theta_0);
+        float s0 = Cos(theta) - dot * sin_theta / sin_theta_0;
+        float s1 = sin_theta / sin_theta_0;
+        _mm_storeu_ps(res.elements, _mm_add_ps(_mm_mul_ps(v0, _mm_set1_ps(s0)), _mm_mul_ps(v1, _mm_set1_ps(s1))));
+        return res;
+        #else
         // Source: https://en.wikipedia.org/wiki/Slerp
         // Only unit quaternions are valid rotations.
         // Normalize to avoid undefined behavior.
@@ -607,6 +691,7 @@ namespace BlitML
         float s0 = Cos(theta) - dot * sin_theta / sin_theta_0;  // == sin(theta_0 - theta) / sin(theta_0)
         float s1 = sin_theta / sin_theta_0;
         return quat((v0.x * s0) + (v1.x * s1), (v0.y * s0) + (v1.y * s1), (v0.z * s0) + (v1.z * s1), (v0.w * s0) + (v1.w * s1));
+        #endif
     }
 
     // Could make these constexpr functions, but there might be some functionality with the field of view in the future that does not allow them to be
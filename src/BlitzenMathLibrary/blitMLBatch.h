@@ -0,0 +1,404 @@
+#pragma once
+
+#include "blitML.h"
+
+// Batch versions of the math that culling, physics and animation run on every object.
+// The data is passed as structure of arrays streams. With AVX2, 8 elements are done at a time and the last block is loaded and stored with a mask,
+// so the streams do not need to be padded. Without it, each element goes through the per element function, which gives the same result to the bit
+namespace BlitML
+{
+    // Streams of count elements. Input streams are only read, output streams may not alias inputs of the same call unless they are the same stream
+    struct Vec3Stream
+    {
+        float* x;
+        float* y;
+        float* z;
+    };
+
+    struct QuatStream
+    {
+        float* x;
+        float* y;
+        float* z;
+        float* w;
+    };
+
+    struct SphereStream
+    {
+        float* x;
+        float* y;
+        float* z;
+        float* radius;
+    };
+
+    // Same data as MeshTransform
+    struct TransformStream
+    {
+        float* posX;
+        float* posY;
+        float* posZ;
+        float* scale;
+        QuatStream orientation;
+    };
+
+    // Screen rectangles in uv space, like the aabb of projectSphere in the culling shaders
+    struct RectStream
+    {
+        float* minX;
+        float* minY;
+        float* maxX;
+        float* maxY;
+    };
+
+    // The frustum values of the camera's view data. The frustum is symmetric, so two planes are tested at the same time
+    struct ViewFrustum
+    {
+        float frustumRight;
+        float frustumLeft;
+        float frustumTop;
+        float frustumBottom;
+        float zNear;
+        float zFar;
+    };
+
+
+
+    /*----------------------------------------
+        Per element versions
+    ----------------------------------------*/
+
+    // Sphere from model space to view space, like the culling shaders do before testing it
+    inline void TransformSphereToView(const vec3& center, float radius, const vec3& pos, float scale, const quat& orientation,
+    const mat4& view, vec3& viewCenter, float& viewRadius)
+    {
+        vec3 world = RotateQuat(center, orientation) * scale + pos;
+        const float* m = view.data;
+        viewCenter.x = m[0] * world.x + m[4] * world.y + m[8] * world.z + m[12];
+        viewCenter.y = m[1] * world.x + m[5] * world.y + m[9] * world.z + m[13];
+        viewCenter.z = m[2] * world.x + m[6] * world.y + m[10] * world.z + m[14];
+        viewRadius = radius * scale;
+    }
+
+    // Same test as InitialDrawCull.comp.glsl
+    inline uint8_t SphereInFrustum(const vec3& center, float radius, const ViewFrustum& frustum)
+    {
+        uint8_t visible = center.z * frustum.frustumLeft - Abs(center.x) * frustum.frustumRight > -radius;
+        visible = visible && center.z * frustum.frustumBottom - Abs(center.y) * frustum.frustumTop > -radius;
+        visible = visible && center.z + radius > frustum.zNear && center.z - radius < frustum.zFar;
+        return visible;
+    }
+
+    // Same as projectSphere in CullingShaderData.glsl. Returns 0 when the sphere crosses the near plane, the rectangle is set to 0 in that case
+    inline uint8_t ProjectSphere(const vec3& c, float r, float zNear, float P00, float P11, vec4& rect)
+    {
+        if(c.z < r + zNear)
+        {
+            rect = vec4(0.f);
+            return 0;
+        }
+
+        vec3 cr = c * r;
+        float czr2 = c.z * c.z - r * r;
+
+        float vx = Sqrt(c.x * c.x + czr2);
+        float minx = (vx * c.x - cr.z) / (vx * c.z + cr.x);
+        float maxx = (vx * c.x + cr.z) / (vx * c.z - cr.x);
+
+        float vy = Sqrt(c.y * c.y + czr2);
+        float miny = (vy * c.y - cr.z) / (vy * c.z + cr.y);
+        float maxy = (vy * c.y + cr.z) / (vy * c.z - cr.y);
+
+        // Clip space to uv space, y is flipped so the min and max of y swap
+        rect.x = minx * P00 * 0.5f + 0.5f;
+        rect.y = maxy * P11 * -0.5f + 0.5f;
+        rect.z = maxx * P00 * 0.5f + 0.5f;
+        rect.w = miny * P11 * -0.5f + 0.5f;
+        return 1;
+    }
+
+
+
+    /*----------------------------------------
+        AVX2 helpers
+    ----------------------------------------*/
+
+    #ifdef BLIT_ML_AVX2
+    // Lanes below remaining are set
+    inline __m256i BatchMask(size_t remaining)
+    {
+        int lanes = remaining < 8 ? static_cast<int>(remaining) : 8;
+        return _mm256_cmpgt_epi32(_mm256_set1_epi32(lanes), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+
+    // Only the last block of a stream uses the masked load and store, the lanes past the end are never touched
+    inline __m256 BatchLoad(const float* p, size_t remaining, __m256i mask)
+    {
+        return remaining >= 8 ? _mm256_loadu_ps(p) : _mm256_maskload_ps(p, mask);
+    }
+
+    inline void BatchStore(float* p, size_t remaining, __m256i mask, __m256 v)
+    {
+        if(remaining >= 8)
+            _mm256_storeu_ps(p, v);
+        else
+            _mm256_maskstore_ps(p, mask, v);
+    }
+
+    inline void BatchStoreFlags(uint8_t* p, size_t remaining, __m256 v)
+    {
+        int bits = _mm256_movemask_ps(v);
+        size_t lanes = remaining < 8 ? remaining : 8;
+        for(size_t l = 0; l < lanes; ++l)
+            p[l] = (bits >> l) & 1;
+    }
+
+    inline __m256 BatchAbs(__m256 v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v); }
+
+    // Same steps as RotateQuat, with the operations in the same order
+    inline void BatchRotateQuat(__m256 vx, __m256 vy, __m256 vz, __m256 qx, __m256 qy, __m256 qz, __m256 qw,
+    __m256& rx, __m256& ry, __m256& rz)
+    {
+        __m256 tx = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(qy, vz), _mm256_mul_ps(qz, vy)), _mm256_mul_ps(vx, qw));
+        __m256 ty = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(qz, vx), _mm256_mul_ps(qx, vz)), _mm256_mul_ps(vy, qw));
+        __m256 tz = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(qx, vy), _mm256_mul_ps(qy, vx)), _mm256_mul_ps(vz, qw));
+
+        const __m256 two = _mm256_set1_ps(2.f);
+        rx = _mm256_add_ps(vx, _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(qy, tz), _mm256_mul_ps(qz, ty)), two));
+        ry = _mm256_add_ps(vy, _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(qz, tx), _mm256_mul_ps(qx, tz)), two));
+        rz = _mm256_add_ps(vz, _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(qx, ty), _mm256_mul_ps(qy, tx)), two));
+    }
+    #endif
+
+
+
+    /*----------------------------------------
+        Batch kernels
+    ----------------------------------------*/
+
+    // Rotates each vector by the quaternion of the same element
+    inline void BatchRotateQuat(const QuatStream& q, const Vec3Stream& v, Vec3Stream& out, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            __m256i mask = BatchMask(remaining);
+            __m256 rx, ry, rz;
+            BatchRotateQuat(BatchLoad(v.x + i, remaining, mask), BatchLoad(v.y + i, remaining, mask), BatchLoad(v.z + i, remaining, mask),
+            BatchLoad(q.x + i, remaining, mask), BatchLoad(q.y + i, remaining, mask), BatchLoad(q.z + i, remaining, mask),
+            BatchLoad(q.w + i, remaining, mask), rx, ry, rz);
+            BatchStore(out.x + i, remaining, mask, rx);
+            BatchStore(out.y + i, remaining, mask, ry);
+            BatchStore(out.z + i, remaining, mask, rz);
+        }
+        #else
+        for(size_t i = 0; i < count; ++i)
+        {
+            vec3 r = RotateQuat(vec3(v.x[i], v.y[i], v.z[i]), quat(q.x[i], q.y[i], q.z[i], q.w[i]));
+            out.x[i] = r.x;
+            out.y[i] = r.y;
+            out.z[i] = r.z;
+        }
+        #endif
+    }
+
+    // Moves model space spheres to view space with the transform of the same element and the view matrix
+    inline void BatchTransformSpheresToView(const SphereStream& spheres, const TransformStream& transforms, const mat4& view,
+    SphereStream& out, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        __m256 m[16];
+        for(uint8_t e = 0; e < 16; ++e)
+            m[e] = _mm256_set1_ps(view.data[e]);
+
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            __m256i mask = BatchMask(remaining);
+            __m256 scale = BatchLoad(transforms.scale + i, remaining, mask);
+
+            __m256 wx, wy, wz;
+            BatchRotateQuat(BatchLoad(spheres.x + i, remaining, mask), BatchLoad(spheres.y + i, remaining, mask),
+            BatchLoad(spheres.z + i, remaining, mask), BatchLoad(transforms.orientation.x + i, remaining, mask),
+            BatchLoad(transforms.orientation.y + i, remaining, mask), BatchLoad(transforms.orientation.z + i, remaining, mask),
+            BatchLoad(transforms.orientation.w + i, remaining, mask), wx, wy, wz);
+            wx = _mm256_add_ps(_mm256_mul_ps(wx, scale), BatchLoad(transforms.posX + i, remaining, mask));
+            wy = _mm256_add_ps(_mm256_mul_ps(wy, scale), BatchLoad(transforms.posY + i, remaining, mask));
+            wz = _mm256_add_ps(_mm256_mul_ps(wz, scale), BatchLoad(transforms.posZ + i, remaining, mask));
+
+            for(uint8_t row = 0; row < 3; ++row)
+            {
+                __m256 r = _mm256_add_ps(_mm256_mul_ps(m[row], wx), _mm256_mul_ps(m[4 + row], wy));
+                r = _mm256_add_ps(_mm256_add_ps(r, _mm256_mul_ps(m[8 + row], wz)), m[12 + row]);
+                BatchStore((row == 0 ? out.x : row == 1 ? out.y : out.z) + i, remaining, mask, r);
+            }
+            BatchStore(out.radius + i, remaining, mask, _mm256_mul_ps(BatchLoad(spheres.radius + i, remaining, mask), scale));
+        }
+        #else
+        for(size_t i = 0; i < count; ++i)
+        {
+            vec3 center;
+            TransformSphereToView(vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i],
+            vec3(transforms.posX[i], transforms.posY[i], transforms.posZ[i]), transforms.scale[i],
+            quat(transforms.orientation.x[i], transforms.orientation.y[i], transforms.orientation.z[i], transforms.orientation.w[i]),
+            view, center, out.radius[i]);
+            out.x[i] = center.x;
+            out.y[i] = center.y;
+            out.z[i] = center.z;
+        }
+        #endif
+    }
+
+    // Writes 1 to pVisible for view space spheres that are inside the frustum and 0 for the rest
+    inline void BatchSpheresInFrustum(const SphereStream& spheres, const ViewFrustum& frustum, uint8_t* pVisible, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        const __m256 left = _mm256_set1_ps(frustum.frustumLeft);
+        const __m256 right = _mm256_set1_ps(frustum.frustumRight);
+        const __m256 top = _mm256_set1_ps(frustum.frustumTop);
+        const __m256 bottom = _mm256_set1_ps(frustum.frustumBottom);
+        const __m256 zNear = _mm256_set1_ps(frustum.zNear);
+        const __m256 zFar = _mm256_set1_ps(frustum.zFar);
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            __m256i mask = BatchMask(remaining);
+            __m256 x = BatchLoad(spheres.x + i, remaining, mask);
+            __m256 y = BatchLoad(spheres.y + i, remaining, mask);
+            __m256 z = BatchLoad(spheres.z + i, remaining, mask);
+            __m256 radius = BatchLoad(spheres.radius + i, remaining, mask);
+            __m256 negRadius = _mm256_xor_ps(radius, _mm256_set1_ps(-0.f));
+
+            __m256 visible = _mm256_cmp_ps(_mm256_sub_ps(_mm256_mul_ps(z, left), _mm256_mul_ps(BatchAbs(x), right)), negRadius, _CMP_GT_OQ);
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_sub_ps(_mm256_mul_ps(z, bottom),
+            _mm256_mul_ps(BatchAbs(y), top)), negRadius, _CMP_GT_OQ));
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(z, radius), zNear, _CMP_GT_OQ));
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_sub_ps(z, radius), zFar, _CMP_LT_OQ));
+            BatchStoreFlags(pVisible + i, remaining, visible);
+        }
+        #else
+        for(size_t i = 0; i < count; ++i)
+            pVisible[i] = SphereInFrustum(vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i], frustum);
+        #endif
+    }
+
+    // Projects view space spheres to uv space rectangles. pValid is 0 for spheres that cross the near plane, their rectangle is set to 0
+    inline void BatchProjectSpheres(const SphereStream& spheres, float zNear, float P00, float P11, RectStream& out,
+    uint8_t* pValid, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        const __m256 nearPlane = _mm256_set1_ps(zNear);
+        const __m256 p00 = _mm256_set1_ps(P00);
+        const __m256 p11 = _mm256_set1_ps(P11);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 negHalf = _mm256_set1_ps(-0.5f);
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            __m256i mask = BatchMask(remaining);
+            __m256 cx = BatchLoad(spheres.x + i, remaining, mask);
+            __m256 cy = BatchLoad(spheres.y + i, remaining, mask);
+            __m256 cz = BatchLoad(spheres.z + i, remaining, mask);
+            __m256 r = BatchLoad(spheres.radius + i, remaining, mask);
+            __m256 valid = _mm256_cmp_ps(cz, _mm256_add_ps(r, nearPlane), _CMP_NLT_UQ);
+
+            __m256 crx = _mm256_mul_ps(cx, r);
+            __m256 cry = _mm256_mul_ps(cy, r);
+            __m256 crz = _mm256_mul_ps(cz, r);
+            __m256 czr2 = _mm256_sub_ps(_mm256_mul_ps(cz, cz), _mm256_mul_ps(r, r));
+
+            __m256 vx = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), czr2));
+            __m256 minx = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(vx, cx), crz), _mm256_add_ps(_mm256_mul_ps(vx, cz), crx));
+            __m256 maxx = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(vx, cx), crz), _mm256_sub_ps(_mm256_mul_ps(vx, cz), crx));
+
+            __m256 vy = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(cy, cy), czr2));
+            __m256 miny = _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(vy, cy), crz), _mm256_add_ps(_mm256_mul_ps(vy, cz), cry));
+            __m256 maxy = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(vy, cy), crz), _mm256_sub_ps(_mm256_mul_ps(vy, cz), cry));
+
+            // Invalid lanes may hold anything, they are replaced with 0
+            BatchStore(out.minX + i, remaining, mask, _mm256_and_ps(valid, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(minx, p00), half), half)));
+            BatchStore(out.minY + i, remaining, mask, _mm256_and_ps(valid, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(maxy, p11), negHalf), half)));
+            BatchStore(out.maxX + i, remaining, mask, _mm256_and_ps(valid, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(maxx, p00), half), half)));
+            BatchStore(out.maxY + i, remaining, mask, _mm256_and_ps(valid, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(miny, p11), negHalf), half)));
+            BatchStoreFlags(pValid + i, remaining, valid);
+        }
+        #else
+        for(size_t i = 0; i < count; ++i)
+        {
+            vec4 rect;
+            pValid[i] = ProjectSphere(vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i], zNear, P00, P11, rect);
+            out.minX[i] = rect.x;
+            out.minY[i] = rect.y;
+            out.maxX[i] = rect.z;
+            out.maxY[i] = rect.w;
+        }
+        #endif
+    }
+
+    // Writes the same matrices as QuatToMat4 to pOut
+    inline void BatchQuatToMat4(const QuatStream& q, mat4* pOut, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            __m256i mask = BatchMask(remaining);
+            __m256 x = BatchLoad(q.x + i, remaining, mask);
+            __m256 y = BatchLoad(q.y + i, remaining, mask);
+            __m256 z = BatchLoad(q.z + i, remaining, mask);
+            __m256 w = BatchLoad(q.w + i, remaining, mask);
+
+            // Normalized like NormalizeQuat
+            __m256 length = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+            length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(length, _mm256_mul_ps(z, z)), _mm256_mul_ps(w, w)));
+            x = _mm256_div_ps(x, length);
+            y = _mm256_div_ps(y, length);
+            z = _mm256_div_ps(z, length);
+            w = _mm256_div_ps(w, length);
+
+            const __m256 one = _mm256_set1_ps(1.f);
+            const __m256 two = _mm256_set1_ps(2.f);
+            __m256 x2 = _mm256_mul_ps(two, x);
+            __m256 y2 = _mm256_mul_ps(two, y);
+            __m256 z2 = _mm256_mul_ps(two, z);
+            __m256 xx = _mm256_mul_ps(x2, x);
+            __m256 yy = _mm256_mul_ps(y2, y);
+            __m256 zz = _mm256_mul_ps(z2, z);
+            __m256 xy = _mm256_mul_ps(x2, y);
+            __m256 xz = _mm256_mul_ps(x2, z);
+            __m256 yz = _mm256_mul_ps(y2, z);
+            __m256 xw = _mm256_mul_ps(x2, w);
+            __m256 yw = _mm256_mul_ps(y2, w);
+            __m256 zw = _mm256_mul_ps(z2, w);
+
+            // The 3x3 rotation part, in the element order of the matrix
+            alignas(32) float elements[9][8];
+            _mm256_store_ps(elements[0], _mm256_sub_ps(_mm256_sub_ps(one, yy), zz));
+            _mm256_store_ps(elements[1], _mm256_sub_ps(xy, zw));
+            _mm256_store_ps(elements[2], _mm256_add_ps(xz, yw));
+            _mm256_store_ps(elements[3], _mm256_add_ps(xy, zw));
+            _mm256_store_ps(elements[4], _mm256_sub_ps(_mm256_sub_ps(one, xx), zz));
+            _mm256_store_ps(elements[5], _mm256_sub_ps(yz, xw));
+            _mm256_store_ps(elements[6], _mm256_sub_ps(xz, yw));
+            _mm256_store_ps(elements[7], _mm256_add_ps(yz, xw));
+            _mm256_store_ps(elements[8], _mm256_sub_ps(_mm256_sub_ps(one, xx), yy));
+
+            size_t lanes = remaining < 8 ? remaining : 8;
+            for(size_t l = 0; l < lanes; ++l)
+            {
+                mat4& res = pOut[i + l];
+                res = mat4();
+                for(uint8_t c = 0; c < 3; ++c)
+                {
+                    res.data[c * 4] = elements[c * 3][l];
+                    res.data[c * 4 + 1] = elements[c * 3 + 1][l];
+                    res.data[c * 4 + 2] = elements[c * 3 + 2][l];
+                }
+            }
+        }
+        #else
+        for(size_t i = 0; i < count; ++i)
+            pOut[i] = QuatToMat4(quat(q.x[i], q.y[i], q.z[i], q.w[i]));
+        #endif
+    }
+}
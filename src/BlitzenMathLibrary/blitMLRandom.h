@@ -0,0 +1,395 @@
+#pragma once
+
+#include "blitMLBatch.h"
+
+// Random numbers with xoshiro256++ by David Blackman and Sebastiano Vigna https://prng.di.unimi.it/
+// Every generator is seeded explicitly, so the same seed gives the same numbers on every platform and in every build.
+// Parallel code splits a seed into streams with RandomJump instead of sharing one generator
+namespace BlitML
+{
+    struct RandomState
+    {
+        uint64_t s[4];
+    };
+
+    inline uint64_t RandomRotateLeft(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    // splitmix64 expands the seed, so that similar seeds still give unrelated states
+    inline void SeedRandom(RandomState& state, uint64_t seed)
+    {
+        for(uint8_t i = 0; i < 4; ++i)
+        {
+            seed += 0x9e3779b97f4a7c15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            state.s[i] = z ^ (z >> 31);
+        }
+    }
+
+    inline uint64_t RandomNext(RandomState& state)
+    {
+        uint64_t* s = state.s;
+        uint64_t result = RandomRotateLeft(s[0] + s[3], 23) + s[0];
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = RandomRotateLeft(s[3], 45);
+        return result;
+    }
+
+    inline void RandomJumpWith(RandomState& state, const uint64_t* pPolynomial)
+    {
+        uint64_t jumped[4] = {0, 0, 0, 0};
+        for(uint8_t i = 0; i < 4; ++i)
+        {
+            for(uint8_t b = 0; b < 64; ++b)
+            {
+                if(pPolynomial[i] & (1ull << b))
+                {
+                    for(uint8_t w = 0; w < 4; ++w)
+                        jumped[w] ^= state.s[w];
+                }
+                RandomNext(state);
+            }
+        }
+        for(uint8_t w = 0; w < 4; ++w)
+            state.s[w] = jumped[w];
+    }
+
+    // Advances the state by 2^128 numbers, the start of the next stream
+    inline void RandomJump(RandomState& state)
+    {
+        const uint64_t polynomial[4] = {0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull};
+        RandomJumpWith(state, polynomial);
+    }
+
+    // Advances the state by 2^192 numbers, for splitting a seed between systems that split their part again with RandomJump
+    inline void RandomLongJump(RandomState& state)
+    {
+        const uint64_t polynomial[4] = {0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull, 0x39109bb02acbe635ull};
+        RandomJumpWith(state, polynomial);
+    }
+
+    // Stream streamIndex of the seed. The same seed and stream give the same numbers no matter which thread asks for them.
+    // Costs one jump per stream index, so callers that need many streams should keep their index small or jump incrementally
+    inline RandomState RandomStream(uint64_t seed, uint64_t streamIndex)
+    {
+        RandomState state;
+        SeedRandom(state, seed);
+        for(uint64_t i = 0; i < streamIndex; ++i)
+            RandomJump(state);
+        return state;
+    }
+
+    inline uint32_t RandomUint32(RandomState& state) { return static_cast<uint32_t>(RandomNext(state) >> 32); }
+
+    // Multiply and shift instead of a modulo, which is faster and only as biased as range / 2^32
+    inline uint32_t RandomUint32Below(RandomState& state, uint32_t range)
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(RandomUint32(state)) * range) >> 32);
+    }
+
+    // The top 24 bits to [0, 1), every result is exact
+    inline float RandomBitsToFloat(uint32_t bits) { return static_cast<float>(bits >> 8) * (1.f / 16777216.f); }
+
+    inline float RandomFloat(RandomState& state) { return RandomBitsToFloat(RandomUint32(state)); }
+
+    inline float RandomFloatInRange(RandomState& state, float min, float max) { return min + RandomFloat(state) * (max - min); }
+
+    // Sine and cosine of 2 * pi * turns, for turns in [0, 1). The quarter turn is done with Taylor polynomials instead of sinf and cosf,
+    // so that the AVX2 bulk functions can give the same results. The error is about 2e-7
+    inline void RandomSinCosTurns(float turns, float& outSin, float& outCos)
+    {
+        float quarters = turns * 4.f;
+        int32_t quadrant = static_cast<int32_t>(quarters);
+        float x = (quarters - static_cast<float>(quadrant)) * blit_halfPi;
+        float x2 = x * x;
+        float s = x * (1.f + x2 * (-1.f / 6.f + x2 * (1.f / 120.f + x2 * (-1.f / 5040.f + x2 * (1.f / 362880.f + x2 * (-1.f / 39916800.f))))));
+        float c = 1.f + x2 * (-0.5f + x2 * (1.f / 24.f + x2 * (-1.f / 720.f + x2 * (1.f / 40320.f + x2 * (-1.f / 3628800.f + x2 * (1.f / 479001600.f))))));
+
+        // Rotates the quarter turn to its quadrant
+        outSin = (quadrant & 1) ? c : s;
+        outCos = (quadrant & 1) ? s : c;
+        outSin = (quadrant & 2) ? -outSin : outSin;
+        outCos = ((quadrant ^ (quadrant >> 1)) & 1) ? -outCos : outCos;
+    }
+
+    // Uniform on the sphere, from a uniform height and angle
+    inline vec3 RandomUnitVectorFrom(float heightBits, float angleTurns)
+    {
+        float z = heightBits * 2.f - 1.f;
+        float r = Sqrt(1.f - z * z);
+        float s, c;
+        RandomSinCosTurns(angleTurns, s, c);
+        return vec3(r * c, r * s, z);
+    }
+
+    inline vec3 RandomUnitVector(RandomState& state)
+    {
+        float height = RandomFloat(state);
+        return RandomUnitVectorFrom(height, RandomFloat(state));
+    }
+
+    // Uniform rotation, with Shoemake's method from 3 uniform numbers
+    inline quat RandomQuatFrom(float u1, float u2, float u3)
+    {
+        float a = Sqrt(1.f - u1);
+        float b = Sqrt(u1);
+        float s2, c2, s3, c3;
+        RandomSinCosTurns(u2, s2, c2);
+        RandomSinCosTurns(u3, s3, c3);
+        return quat(a * s2, a * c2, b * s3, b * c3);
+    }
+
+    inline quat RandomQuat(RandomState& state)
+    {
+        float u1 = RandomFloat(state);
+        float u2 = RandomFloat(state);
+        return RandomQuatFrom(u1, u2, RandomFloat(state));
+    }
+
+    // One generator for each thread, seeded from the clock the first time it is used. For code that does not need to be reproducible
+    inline RandomState& GetThreadRandomState()
+    {
+        static thread_local uint8_t bSeeded = 0;
+        static thread_local RandomState state;
+        if(!bSeeded)
+        {
+            SeedRandom(state, static_cast<uint64_t>(BlitzenPlatform::PlatformGetAbsoluteTime() * 1'000'000.0) ^
+            reinterpret_cast<uintptr_t>(&state));
+            bSeeded = 1;
+        }
+        return state;
+    }
+
+    // Same range as rand()
+    inline int32_t Rand() { return static_cast<int32_t>(RandomUint32(GetThreadRandomState()) >> 1); }
+
+    inline int32_t RandInRange(int32_t min, int32_t max)
+    {
+        return min + static_cast<int32_t>(RandomUint32Below(GetThreadRandomState(), static_cast<uint32_t>(max - min) + 1));
+    }
+
+    inline float FRand() { return RandomFloat(GetThreadRandomState()); }
+
+    inline float FRandInRange(float min, float max) { return RandomFloatInRange(GetThreadRandomState(), min, max); }
+
+
+
+    /*----------------------------------------
+        Bulk generation
+    ----------------------------------------*/
+
+    // Streams that the bulk functions advance together
+    constexpr uint8_t ce_randomBulkLanes = 4;
+
+    // ce_randomBulkLanes generators side by side, s[word][lane]. Each step of all the lanes gives 8 floats,
+    // from the high and the low half of each 64-bit result
+    struct RandomBulkState
+    {
+        uint64_t s[4][ce_randomBulkLanes];
+    };
+
+    // Lane k is stream firstStream + k of the seed. Threads that take ce_randomBulkLanes streams each get numbers that never overlap
+    inline void SeedRandomBulk(RandomBulkState& bulk, uint64_t seed, uint64_t firstStream)
+    {
+        RandomState state = RandomStream(seed, firstStream);
+        for(uint8_t lane = 0; lane < ce_randomBulkLanes; ++lane)
+        {
+            for(uint8_t w = 0; w < 4; ++w)
+                bulk.s[w][lane] = state.s[w];
+            RandomJump(state);
+        }
+    }
+
+    // Writes the 8 floats of the next step, in [0, 1)
+    inline void RandomBulkStep(RandomBulkState& bulk, float* pOut)
+    {
+        for(uint8_t lane = 0; lane < ce_randomBulkLanes; ++lane)
+        {
+            RandomState state = {{bulk.s[0][lane], bulk.s[1][lane], bulk.s[2][lane], bulk.s[3][lane]}};
+            uint64_t result = RandomNext(state);
+            for(uint8_t w = 0; w < 4; ++w)
+                bulk.s[w][lane] = state.s[w];
+            pOut[lane * 2] = RandomBitsToFloat(static_cast<uint32_t>(result));
+            pOut[lane * 2 + 1] = RandomBitsToFloat(static_cast<uint32_t>(result >> 32));
+        }
+    }
+
+    #ifdef BLIT_ML_AVX2
+    inline __m256i RandomRotateLeftWide(__m256i x, int k)
+    {
+        return _mm256_or_si256(_mm256_sll_epi64(x, _mm_cvtsi32_si128(k)), _mm256_srl_epi64(x, _mm_cvtsi32_si128(64 - k)));
+    }
+
+    // Same as RandomBulkStep, the 4 lanes are the 4 64-bit elements of each register
+    inline __m256 RandomBulkStepWide(__m256i* s)
+    {
+        __m256i result = _mm256_add_epi64(RandomRotateLeftWide(_mm256_add_epi64(s[0], s[3]), 23), s[0]);
+        __m256i t = _mm256_slli_epi64(s[1], 17);
+        s[2] = _mm256_xor_si256(s[2], s[0]);
+        s[3] = _mm256_xor_si256(s[3], s[1]);
+        s[1] = _mm256_xor_si256(s[1], s[2]);
+        s[0] = _mm256_xor_si256(s[0], s[3]);
+        s[2] = _mm256_xor_si256(s[2], t);
+        s[3] = RandomRotateLeftWide(s[3], 45);
+
+        // The low half of each result comes first in memory, like in RandomBulkStep
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(result, 8)), _mm256_set1_ps(1.f / 16777216.f));
+    }
+
+    inline void RandomSinCosTurnsWide(__m256 turns, __m256& outSin, __m256& outCos)
+    {
+        __m256 quarters = _mm256_mul_ps(turns, _mm256_set1_ps(4.f));
+        __m256i quadrant = _mm256_cvttps_epi32(quarters);
+        __m256 x = _mm256_mul_ps(_mm256_sub_ps(quarters, _mm256_cvtepi32_ps(quadrant)), _mm256_set1_ps(blit_halfPi));
+        __m256 x2 = _mm256_mul_ps(x, x);
+
+        __m256 s = _mm256_add_ps(_mm256_set1_ps(1.f / 362880.f), _mm256_mul_ps(x2, _mm256_set1_ps(-1.f / 39916800.f)));
+        s = _mm256_add_ps(_mm256_set1_ps(-1.f / 5040.f), _mm256_mul_ps(x2, s));
+        s = _mm256_add_ps(_mm256_set1_ps(1.f / 120.f), _mm256_mul_ps(x2, s));
+        s = _mm256_add_ps(_mm256_set1_ps(-1.f / 6.f), _mm256_mul_ps(x2, s));
+        s = _mm256_mul_ps(x, _mm256_add_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(x2, s)));
+
+        __m256 c = _mm256_add_ps(_mm256_set1_ps(-1.f / 3628800.f), _mm256_mul_ps(x2, _mm256_set1_ps(1.f / 479001600.f)));
+        c = _mm256_add_ps(_mm256_set1_ps(1.f / 40320.f), _mm256_mul_ps(x2, c));
+        c = _mm256_add_ps(_mm256_set1_ps(-1.f / 720.f), _mm256_mul_ps(x2, c));
+        c = _mm256_add_ps(_mm256_set1_ps(1.f / 24.f), _mm256_mul_ps(x2, c));
+        c = _mm256_add_ps(_mm256_set1_ps(-0.5f), _mm256_mul_ps(x2, c));
+        c = _mm256_add_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(x2, c));
+
+        const __m256i one = _mm256_set1_epi32(1);
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+        __m256 negateSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(quadrant, 1), 31));
+        __m256 negateCos = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_xor_si256(quadrant, _mm256_srli_epi32(quadrant, 1)), 31));
+        outSin = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), negateSin);
+        outCos = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), negateCos);
+    }
+
+    inline void LoadRandomBulkState(const RandomBulkState& bulk, __m256i* s)
+    {
+        for(uint8_t w = 0; w < 4; ++w)
+            s[w] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bulk.s[w]));
+    }
+
+    inline void StoreRandomBulkState(RandomBulkState& bulk, const __m256i* s)
+    {
+        for(uint8_t w = 0; w < 4; ++w)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(bulk.s[w]), s[w]);
+    }
+    #endif
+
+    // Fills pOut with count floats in [0, 1). When count is not a multiple of 8, the rest of the last step is dropped
+    inline void RandomFillFloats(RandomBulkState& bulk, float* pOut, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        __m256i s[4];
+        LoadRandomBulkState(bulk, s);
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            BatchStore(pOut + i, remaining, BatchMask(remaining), RandomBulkStepWide(s));
+        }
+        StoreRandomBulkState(bulk, s);
+        #else
+        for(size_t i = 0; i < count; i += 8)
+        {
+            float step[8];
+            RandomBulkStep(bulk, step);
+            for(size_t l = 0; l < 8 && i + l < count; ++l)
+                pOut[i + l] = step[l];
+        }
+        #endif
+    }
+
+    // Fills count unit vectors with RandomUnitVectorFrom. Each group of 8 takes 2 steps
+    inline void RandomFillUnitVectors(RandomBulkState& bulk, Vec3Stream& out, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        __m256i s[4];
+        LoadRandomBulkState(bulk, s);
+        const __m256 one = _mm256_set1_ps(1.f);
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            __m256i mask = BatchMask(remaining);
+            __m256 height = RandomBulkStepWide(s);
+            __m256 angle = RandomBulkStepWide(s);
+
+            __m256 z = _mm256_sub_ps(_mm256_mul_ps(height, _mm256_set1_ps(2.f)), one);
+            __m256 r = _mm256_sqrt_ps(_mm256_sub_ps(one, _mm256_mul_ps(z, z)));
+            __m256 sine, cosine;
+            RandomSinCosTurnsWide(angle, sine, cosine);
+            BatchStore(out.x + i, remaining, mask, _mm256_mul_ps(r, cosine));
+            BatchStore(out.y + i, remaining, mask, _mm256_mul_ps(r, sine));
+            BatchStore(out.z + i, remaining, mask, z);
+        }
+        StoreRandomBulkState(bulk, s);
+        #else
+        for(size_t i = 0; i < count; i += 8)
+        {
+            float height[8];
+            float angle[8];
+            RandomBulkStep(bulk, height);
+            RandomBulkStep(bulk, angle);
+            for(size_t l = 0; l < 8 && i + l < count; ++l)
+            {
+                vec3 v = RandomUnitVectorFrom(height[l], angle[l]);
+                out.x[i + l] = v.x;
+                out.y[i + l] = v.y;
+                out.z[i + l] = v.z;
+            }
+        }
+        #endif
+    }
+
+    // Fills count rotations with RandomQuatFrom. Each group of 8 takes 3 steps
+    inline void RandomFillQuats(RandomBulkState& bulk, QuatStream& out, size_t count)
+    {
+        #ifdef BLIT_ML_AVX2
+        __m256i s[4];
+        LoadRandomBulkState(bulk, s);
+        for(size_t i = 0; i < count; i += 8)
+        {
+            size_t remaining = count - i;
+            __m256i mask = BatchMask(remaining);
+            __m256 u1 = RandomBulkStepWide(s);
+            __m256 u2 = RandomBulkStepWide(s);
+            __m256 u3 = RandomBulkStepWide(s);
+
+            __m256 a = _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.f), u1));
+            __m256 b = _mm256_sqrt_ps(u1);
+            __m256 s2, c2, s3, c3;
+            RandomSinCosTurnsWide(u2, s2, c2);
+            RandomSinCosTurnsWide(u3, s3, c3);
+            BatchStore(out.x + i, remaining, mask, _mm256_mul_ps(a, s2));
+            BatchStore(out.y + i, remaining, mask, _mm256_mul_ps(a, c2));
+            BatchStore(out.z + i, remaining, mask, _mm256_mul_ps(b, s3));
+            BatchStore(out.w + i, remaining, mask, _mm256_mul_ps(b, c3));
+        }
+        StoreRandomBulkState(bulk, s);
+        #else
+        for(size_t i = 0; i < count; i += 8)
+        {
+            float u1[8];
+            float u2[8];
+            float u3[8];
+            RandomBulkStep(bulk, u1);
+            RandomBulkStep(bulk, u2);
+            RandomBulkStep(bulk, u3);
+            for(size_t l = 0; l < 8 && i + l < count; ++l)
+            {
+                quat q = RandomQuatFrom(u1[l], u2[l], u3[l]);
+                out.x[i + l] = q.x;
+                out.y[i + l] = q.y;
+                out.z[i + l] = q.z;
+                out.w[i + l] = q.w;
+            }
+        }
+        #endif
+    }
+}
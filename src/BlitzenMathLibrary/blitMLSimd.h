@@ -0,0 +1,56 @@
+#pragma once
+
+// The widest instruction set that the compiler targets is picked, BLITZEN_SIMD in CMakeLists.txt sets the compiler flags.
+// BLIT_ML_SCALAR forces the scalar code, so that the SIMD results can be compared with it (Tests/blitzenMathSimdTest.cpp)
+#ifndef BLIT_ML_SCALAR
+    #if defined(__AVX2__)
+        #define BLIT_ML_AVX2
+        #define BLIT_ML_SSE4
+        #include <immintrin.h>
+    #elif defined(__SSE4_1__) || defined(__AVX__)
+        #define BLIT_ML_SSE4
+        #include <smmintrin.h>
+    #endif
+#endif
+
+// Every SIMD function does the same operations in the same order as the scalar code that it replaces, so the results are identical to the bit.
+// Sums of 4 products are never done with horizontal adds or dot product instructions, since those add the lanes in a different order
+#ifdef BLIT_ML_SSE4
+namespace BlitML
+{
+    // Lane 0 of the result is ((x + y) + z) + w, the order of the scalar sums
+    inline __m128 SimdSumLanes(__m128 v)
+    {
+        __m128 sum = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+        return _mm_add_ss(sum, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+
+    // Lane 0 of the result is the dot product of the two vectors
+    inline __m128 SimdDot4(__m128 v1, __m128 v2) { return SimdSumLanes(_mm_mul_ps(v1, v2)); }
+
+    // Divides every lane by the length, like NormalizeQuat
+    inline __m128 SimdNormalize4(__m128 v)
+    {
+        __m128 length = _mm_sqrt_ss(SimdDot4(v, v));
+        return _mm_div_ps(v, _mm_shuffle_ps(length, length, _MM_SHUFFLE(0, 0, 0, 0)));
+    }
+
+    // Flips the sign of the lanes whose mask bit is set. Subtracting a negated value is the same as adding it, signed zeros included
+    template<int mask>
+    inline __m128 SimdNegateLanes(__m128 v)
+    {
+        const __m128 signs = _mm_blend_ps(_mm_setzero_ps(), _mm_set1_ps(-0.f), mask);
+        return _mm_xor_ps(v, signs);
+    }
+
+    // Column of a matrix product. Each lane is ((c0 * s.x + c1 * s.y) + c2 * s.z) + c3 * s.w
+    inline __m128 SimdCombineColumns(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 s)
+    {
+        __m128 res = _mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(s, s, _MM_SHUFFLE(0, 0, 0, 0))),
+        _mm_mul_ps(c1, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1))));
+        res = _mm_add_ps(res, _mm_mul_ps(c2, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2, 2, 2, 2))));
+        return _mm_add_ps(res, _mm_mul_ps(c3, _mm_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3))));
+    }
+}
+#endif
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include "Core/blitMemory.h"
+#include "blitMLSimd.h"
 
 namespace BlitML
 {
@@ -121,6 +122,18 @@ namespace BlitML
         // Creates and identity matrix if identity is defaulted or any value other than 1. Creates a matrix filled with zeroes otherwise
         inline mat4(uint8_t identity = 1)
         {
+            #if defined(BLIT_ML_AVX2)
+            // The columns are written 2 at a time, the diagonal is only set in the identity
+            const __m256 diagonal = identity ? _mm256_set1_ps(1.f) : _mm256_setzero_ps();
+            _mm256_storeu_ps(data, _mm256_blend_ps(_mm256_setzero_ps(), diagonal, 0x21));
+            _mm256_storeu_ps(data + 8, _mm256_blend_ps(_mm256_setzero_ps(), diagonal, 0x84));
+            #elif defined(BLIT_ML_SSE4)
+            const __m128 diagonal = identity ? _mm_set1_ps(1.f) : _mm_setzero_ps();
+            _mm_storeu_ps(data, _mm_blend_ps(_mm_setzero_ps(), diagonal, 0x1));
+            _mm_storeu_ps(data + 4, _mm_blend_ps(_mm_setzero_ps(), diagonal, 0x2));
+            _mm_storeu_ps(data + 8, _mm_blend_ps(_mm_setzero_ps(), diagonal, 0x4));
+            _mm_storeu_ps(data + 12, _mm_blend_ps(_mm_setzero_ps(), diagonal, 0x8));
+            #else
             BlitzenCore::BlitZeroMemory(this, sizeof(mat4));
 
             if(identity)
@@ -130,6 +143,7 @@ namespace BlitML
                 data[10] = 1.f;
                 data[15] = 1.f;
             }
+            #endif
         }
 
         inline float& operator [] (size_t index) { return this->data[index]; }
@@ -141,23 +155,52 @@ namespace BlitML
 
     inline mat4 operator * (mat4& mat1, mat4& mat2) 
     {
-        mat4 res;
+        mat4 res(0);
+        #if defined(BLIT_ML_AVX2)
+        // The columns of mat1 are repeated in both halves, so that 2 columns of the result are built at the same time
+        const __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(mat1.data));
+        const __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(mat1.data + 4));
+        const __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(mat1.data + 8));
+        const __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(mat1.data + 12));
+        for(uint8_t i = 0; i < 16; i += 8)
+        {
+            __m256 s = _mm256_loadu_ps(mat2.data + i);
+            __m256 column = _mm256_add_ps(_mm256_mul_ps(c0, _mm256_shuffle_ps(s, s, _MM_SHUFFLE(0, 0, 0, 0))),
+            _mm256_mul_ps(c1, _mm256_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1))));
+            column = _mm256_add_ps(column, _mm256_mul_ps(c2, _mm256_shuffle_ps(s, s, _MM_SHUFFLE(2, 2, 2, 2))));
+            column = _mm256_add_ps(column, _mm256_mul_ps(c3, _mm256_shuffle_ps(s, s, _MM_SHUFFLE(3, 3, 3, 3))));
+            _mm256_storeu_ps(res.data + i, column);
+        }
+        #elif defined(BLIT_ML_SSE4)
+        const __m128 c0 = _mm_loadu_ps(mat1.data);
+        const __m128 c1 = _mm_loadu_ps(mat1.data + 4);
+        const __m128 c2 = _mm_loadu_ps(mat1.data + 8);
+        const __m128 c3 = _mm_loadu_ps(mat1.data + 12);
+        for(uint8_t i = 0; i < 16; i += 4)
+            _mm_storeu_ps(res.data + i, SimdCombineColumns(c0, c1, c2, c3, _mm_loadu_ps(mat2.data + i)));
+        #else
         for (uint8_t i = 0; i < 4; ++i) {
             for (uint8_t j = 0; j < 4; ++j) 
             {
                 res[j + i * 4] = mat1[0 + j] * mat2[0 + i * 4] + mat1[4 + j] * mat2[1 + i * 4] + mat1[8 + j] * mat2[2 + i * 4] + mat1[12 + j] * mat2[3 + i * 4];
             }
         }
+        #endif
         return res;
     }
 
     inline vec4 operator * (mat4& mat, const vec4& vec)
     {
         vec4 res;
+        #ifdef BLIT_ML_SSE4
+        _mm_storeu_ps(res.elements, SimdCombineColumns(_mm_loadu_ps(mat.data), _mm_loadu_ps(mat.data + 4), 
+        _mm_loadu_ps(mat.data + 8), _mm_loadu_ps(mat.data + 12), _mm_loadu_ps(vec.elements)));
+        #else
         res.x = mat[0] * vec.x + vec.y * mat[4] + vec.z * mat[8] + vec.w * mat[12];
         res.y = mat[1] * vec.x + vec.y * mat[5] + vec.z * mat[9] + vec.w * mat[13];
         res.z = mat[2] * vec.x + vec.y * mat[6] + vec.z * mat[10] + vec.w * mat[14];
         res.w = mat[3] * vec.x + vec.y * mat[7] + vec.z * mat[11] + vec.w * mat[15];
+        #endif
 
         return res;
     }
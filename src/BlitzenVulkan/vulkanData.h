@@ -87,6 +87,25 @@ namespace BlitzenVulkan
 
         // Tells some independent function like texture loaders, if their resources are ready to be allocated
         uint8_t bResourceManagementReady = 0;
+
+        // Set when the uploaded geometry uses BlitzenEngine::CompactVertex. The vertex/mesh shaders and the BLAS build depend on it
+        uint8_t bCompactVertices = 0;
+
+        // Set when the uploaded lod indices are strips. The graphics pipeline uses strip topology with primitive restart
+        uint8_t bStripIndices = 0;
+
+        // Set when the transforms were uploaded as BlitzenEngine::PackedTransform. Every shader that reads transforms depends on it
+        uint8_t bPackedTransforms = 0;
+
+        // Commands with a first instance other than 0 can be drawn indirectly, instanced draws need it
+        uint8_t bDrawIndirectFirstInstance = 0;
+
+        // Set when the visible objects are drawn with one instanced command for every surface lod. 
+        // The culling shaders and the vertex shader depend on it, and the DrawBucket shaders are dispatched after culling
+        uint8_t bInstancedDraws = 0;
+
+        // Elements of the draw bucket buffer, one for every lod of every surface
+        uint32_t drawBucketCount = 0;
     };
 
 
@@ -250,7 +250,7 @@ namespace BlitzenVulkan
         PipelineBarrier(commandBuffer, 0, nullptr, 1, &waitBeforeZeroingCountBuffer, 0, nullptr);
 
         // Initialize the indirect count buffer as zero
-        vkCmdFillBuffer(commandBuffer, m_currentStaticBuffers.indirectCountBuffer.buffer.bufferHandle, 0, sizeof(uint32_t), 0);
+        vkCmdFillBuffer(commandBuffer, m_currentStaticBuffers.indirectCountBuffer.buffer.bufferHandle, 0, sizeof(uint32_t) * 2, 0);
 
         VkBufferMemoryBarrier2 waitBeforeDispatchingShaders[3] = {};
         // Before dispatching the compute shader, it needs to wait for the transfer command above to Zero out the indirect count buffer
@@ -306,7 +306,11 @@ namespace BlitzenVulkan
         sizeof(DrawCullShaderPushConstant), &pc);
         vkCmdDispatch(commandBuffer, (drawCount / 64) + 1, 1, 1);
 
-        VkBufferMemoryBarrier2 waitForCullingShader[3] = {};
+        // The commands of the culling shader are replaced by instanced ones before the barriers below
+        if(m_stats.bInstancedDraws)
+            CompactInstancedDraws(commandBuffer, drawCount);
+
+        VkBufferMemoryBarrier2 waitForCullingShader[4] = {};
         // Wait for the culling shader to write the indirect count buffer before reading in draw indirect stage
         BufferMemoryBarrier(m_currentStaticBuffers.indirectCountBuffer.buffer.bufferHandle, 
         waitForCullingShader[0], 
@@ -327,11 +331,65 @@ namespace BlitzenVulkan
         VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, 
         VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, 
         0, VK_WHOLE_SIZE);
+
+        // Wait for the instanced draw passes to write the object ids before the vertex shader reads them
+        BufferMemoryBarrier(m_currentStaticBuffers.instanceBuffer.buffer.bufferHandle, waitForCullingShader[3], 
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, 
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, 0, VK_WHOLE_SIZE);
         
         // Add the above barriers
         PipelineBarrier(commandBuffer, 0, nullptr, BLIT_ARRAY_SIZE(waitForCullingShader), waitForCullingShader, 0, nullptr);
     }
 
+    void VulkanRenderer::CompactInstancedDraws(VkCommandBuffer commandBuffer, uint32_t drawCount)
+    {
+        VkBufferMemoryBarrier2 waitBeforeBucketing[2] = {};
+        // The bucket counts of the previous culling dispatch need to be read by its passes before they are zeroed
+        BufferMemoryBarrier(m_currentStaticBuffers.drawBucketBuffer.buffer.bufferHandle, waitBeforeBucketing[0], 
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, 
+        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, 0, VK_WHOLE_SIZE);
+
+        // The previous draws need to be done with the object ids before the scatter pass writes them
+        BufferMemoryBarrier(m_currentStaticBuffers.instanceBuffer.buffer.bufferHandle, waitBeforeBucketing[1], 
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, 
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, 0, VK_WHOLE_SIZE);
+        PipelineBarrier(commandBuffer, 0, nullptr, BLIT_ARRAY_SIZE(waitBeforeBucketing), waitBeforeBucketing, 0, nullptr);
+
+        vkCmdFillBuffer(commandBuffer, m_currentStaticBuffers.drawBucketBuffer.buffer.bufferHandle, 0, VK_WHOLE_SIZE, 0);
+
+        // Each pass reads what the one before it wrote, through shaders or transfer commands
+        VkMemoryBarrier2 waitForPreviousPass{};
+        MemoryBarrier(waitForPreviousPass, 
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT, 
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT, 
+        VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+        // The culling shader's descriptors and push constants stay bound, since the passes use the same layout.
+        // Counts the objects of each bucket, the commands of both index buffers are checked
+        PipelineBarrier(commandBuffer, 1, &waitForPreviousPass, 0, nullptr, 0, nullptr);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_drawBucketCountPipeline.handle);
+        vkCmdDispatch(commandBuffer, (drawCount * 2 / 64) + 1, 1, 1);
+
+        // Sums the counts into the offsets of the buckets, in a single workgroup
+        PipelineBarrier(commandBuffer, 1, &waitForPreviousPass, 0, nullptr, 0, nullptr);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_drawBucketScanPipeline.handle);
+        vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+        // Writes the object ids to the instance buffer
+        PipelineBarrier(commandBuffer, 1, &waitForPreviousPass, 0, nullptr, 0, nullptr);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_drawBucketScatterPipeline.handle);
+        vkCmdDispatch(commandBuffer, (drawCount * 2 / 64) + 1, 1, 1);
+
+        // The object commands have been read, so the counts are zeroed for the instanced commands that replace them
+        PipelineBarrier(commandBuffer, 1, &waitForPreviousPass, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(commandBuffer, m_currentStaticBuffers.indirectCountBuffer.buffer.bufferHandle, 0, sizeof(uint32_t) * 2, 0);
+
+        // One command for every bucket with objects
+        PipelineBarrier(commandBuffer, 1, &waitForPreviousPass, 0, nullptr, 0, nullptr);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_drawBucketEmitPipeline.handle);
+        vkCmdDispatch(commandBuffer, (m_stats.drawBucketCount / 64) + 1, 1, 1);
+    }
+
     void VulkanRenderer::DrawGeometry(VkCommandBuffer commandBuffer, VkWriteDescriptorSet* pDescriptorWrites, uint32_t drawCount, 
     uint8_t latePass, VkPipeline pipeline)
     {
@@ -351,7 +409,7 @@ namespace BlitzenVulkan
 
         // Pushes all uniform buffer descriptors but the culling data one to the graphics pipelines
         PushDescriptors(m_instance, commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-        m_graphicsPipelineLayout.handle, 0, 7, pDescriptorWrites);
+        m_graphicsPipelineLayout.handle, 0, BLIT_ARRAY_SIZE(pushDescriptorWritesGraphics), pDescriptorWrites);
 
         // Bind the texture descriptor set. This one was allocated and written to in the UploadDataToGPU function
         vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipelineLayout.handle, 1,
@@ -371,14 +429,39 @@ namespace BlitzenVulkan
         }
         else
         {
-            // Binds the index buffer for the vertex shader path
-            vkCmdBindIndexBuffer(commandBuffer, m_currentStaticBuffers.indexBuffer.bufferHandle, 
-            0, VK_INDEX_TYPE_UINT32);
-
-            vkCmdDrawIndexedIndirectCount(commandBuffer, 
-            m_currentStaticBuffers.indirectDrawBuffer.buffer.bufferHandle, offsetof(IndirectDrawData, drawIndirect), // Draw buffer
-            m_currentStaticBuffers.indirectCountBuffer.buffer.bufferHandle, // Draw count buffer
-            0, drawCount, sizeof(IndirectDrawData));
+            // The culling shaders write the commands of 32-bit index surfaces from the start of the indirect buffer 
+            // and the commands of 16-bit index surfaces after the first drawCount elements, each with its own count
+            if(m_currentStaticBuffers.indexBuffer.bufferHandle != VK_NULL_HANDLE)
+            {
+                // Binds the index buffer for the vertex shader path
+                vkCmdBindIndexBuffer(commandBuffer, m_currentStaticBuffers.indexBuffer.bufferHandle, 
+                0, VK_INDEX_TYPE_UINT32);
+
+                uint32_t drawOffset = 0;
+                vkCmdPushConstants(commandBuffer, m_graphicsPipelineLayout.handle, VK_SHADER_STAGE_VERTEX_BIT, 0, 
+                sizeof(uint32_t), &drawOffset);
+
+                vkCmdDrawIndexedIndirectCount(commandBuffer, 
+                m_currentStaticBuffers.indirectDrawBuffer.buffer.bufferHandle, offsetof(IndirectDrawData, drawIndirect), // Draw buffer
+                m_currentStaticBuffers.indirectCountBuffer.buffer.bufferHandle, // Draw count buffer
+                0, drawCount, sizeof(IndirectDrawData));
+            }
+
+            if(m_currentStaticBuffers.index16Buffer.bufferHandle != VK_NULL_HANDLE)
+            {
+                vkCmdBindIndexBuffer(commandBuffer, m_currentStaticBuffers.index16Buffer.bufferHandle, 
+                0, VK_INDEX_TYPE_UINT16);
+
+                uint32_t drawOffset = drawCount;
+                vkCmdPushConstants(commandBuffer, m_graphicsPipelineLayout.handle, VK_SHADER_STAGE_VERTEX_BIT, 0, 
+                sizeof(uint32_t), &drawOffset);
+
+                vkCmdDrawIndexedIndirectCount(commandBuffer, 
+                m_currentStaticBuffers.indirectDrawBuffer.buffer.bufferHandle, 
+                sizeof(IndirectDrawData) * drawCount + offsetof(IndirectDrawData, drawIndirect), // Draw buffer
+                m_currentStaticBuffers.indirectCountBuffer.buffer.bufferHandle, // Draw count buffer
+                sizeof(uint32_t), drawCount, sizeof(IndirectDrawData));
+            }
         }
 
         vkCmdEndRendering(commandBuffer);
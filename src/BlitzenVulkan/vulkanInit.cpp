@@ -396,6 +396,9 @@ namespace BlitzenVulkan
         !features12.uniformAndStorageBuffer8BitAccess || !features12.storagePushConstant8 ||
         !features13.synchronization2 || !features13.dynamicRendering || !features13.maintenance4)
             return 0;
+
+        // Optional, the renderer falls back to a command for each object without it
+        stats.bDrawIndirectFirstInstance = features.drawIndirectFirstInstance;
         
         // Looks for the requested extensions. Fails if the required ones are not found
         if(!LookForRequestedExtensions(pdv, stats))
@@ -575,6 +578,9 @@ namespace BlitzenVulkan
         // Allows sampler anisotropy to be VK_TRUE when creating a VkSampler
         deviceFeatures.samplerAnisotropy = true;
 
+        // Allows indirect commands to start from an instance other than 0, used by instanced draws
+        deviceFeatures.drawIndirectFirstInstance = stats.bDrawIndirectFirstInstance;
+
         // Extended device features
         VkPhysicalDeviceVulkan11Features vulkan11Features{};
         vulkan11Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
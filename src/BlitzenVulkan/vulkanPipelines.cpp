@@ -9,24 +9,16 @@ namespace BlitzenVulkan
     uint8_t CreateShaderProgram(const VkDevice& device, const char* filepath, VkShaderStageFlagBits shaderStage, const char* entryPointName, 
     VkShaderModule& shaderModule, VkPipelineShaderStageCreateInfo& pipelineShaderStage, VkSpecializationInfo* pSpecializationInfo /*=nullptr*/)
     {
-        // Tries to open the file with the provided path
+        // Maps the spir-v file, the mapping is page aligned so the code can be handed to Vulkan without a copy
         BlitzenPlatform::FileHandle handle;
-        if(!handle.Open(filepath, BlitzenPlatform::FileModes::Read, 1))
+        if(!handle.OpenMapped(filepath, BlitzenPlatform::FileAccessHint::Sequential))
             return 0;
-        
-        // Reads the shader code in byte format
-        size_t filesize = 0;
-        BlitCL::StoragePointer<uint8_t, BlitzenCore::AllocationType::String> pBytes;
-        if(!BlitzenPlatform::FilesystemReadAllBytes(handle, pBytes, &filesize))
-        {
-            return 0;
-        }
 
         //Wraps the code in a shader module object
         VkShaderModuleCreateInfo shaderModuleInfo{};
         shaderModuleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        shaderModuleInfo.codeSize = static_cast<uint32_t>(filesize);
-        shaderModuleInfo.pCode = reinterpret_cast<uint32_t*>(pBytes.Data());
+        shaderModuleInfo.codeSize = handle.GetMappedSize();
+        shaderModuleInfo.pCode = reinterpret_cast<const uint32_t*>(handle.GetMappedData());
         VkResult res = vkCreateShaderModule(device, &shaderModuleInfo, nullptr, &shaderModule);
         if(res != VK_SUCCESS)
             return 0;
@@ -241,6 +233,25 @@ namespace BlitzenVulkan
         dynamicRenderingInfo.depthAttachmentFormat = VK_FORMAT_D32_SFLOAT;
         pipelineInfo.pNext = &dynamicRenderingInfo;
 
+        // The vertex and transform layouts are picked with specialization constants (COMPACT_VERTICES and PACKED_TRANSFORMS in ShaderBuffers.glsl).
+        // INSTANCED_DRAWS tells the vertex shader where to find the object id
+        uint32_t layoutConstants[3] = { m_stats.bCompactVertices, m_stats.bPackedTransforms, m_stats.bInstancedDraws };
+        VkSpecializationMapEntry vertexLayoutSpecializationMapEntries[3] = {};
+        vertexLayoutSpecializationMapEntries[0].constantID = 1;
+        vertexLayoutSpecializationMapEntries[0].offset = 0;
+        vertexLayoutSpecializationMapEntries[0].size = sizeof(uint32_t);
+        vertexLayoutSpecializationMapEntries[1].constantID = 2;
+        vertexLayoutSpecializationMapEntries[1].offset = sizeof(uint32_t);
+        vertexLayoutSpecializationMapEntries[1].size = sizeof(uint32_t);
+        vertexLayoutSpecializationMapEntries[2].constantID = 3;
+        vertexLayoutSpecializationMapEntries[2].offset = sizeof(uint32_t) * 2;
+        vertexLayoutSpecializationMapEntries[2].size = sizeof(uint32_t);
+        VkSpecializationInfo vertexLayoutSpecialization{};
+        vertexLayoutSpecialization.dataSize = sizeof(layoutConstants);
+        vertexLayoutSpecialization.mapEntryCount = BLIT_ARRAY_SIZE(vertexLayoutSpecializationMapEntries);
+        vertexLayoutSpecialization.pMapEntries = vertexLayoutSpecializationMapEntries;
+        vertexLayoutSpecialization.pData = layoutConstants;
+
         // Loading the vertex shader code (or mesh shading shader if mesh shading is used)
         ShaderModule vertexShaderModule;
         VkPipelineShaderStageCreateInfo shaderStages[3] = {};
@@ -248,14 +259,14 @@ namespace BlitzenVulkan
         if(m_stats.meshShaderSupport)
         {
             if(!CreateShaderProgram(m_device, "VulkanShaders/MeshShader.mesh.glsl.spv", 
-            VK_SHADER_STAGE_MESH_BIT_EXT, "main", vertexShaderModule.handle, shaderStages[0]))
+            VK_SHADER_STAGE_MESH_BIT_EXT, "main", vertexShaderModule.handle, shaderStages[0], &vertexLayoutSpecialization))
                 return 0;
         }
         // Create the vertex shader program for vertex processing if mesh shaders were not requested or not supported
         else
         {
             if(!CreateShaderProgram(m_device, "VulkanShaders/MainObjectShader.vert.glsl.spv", 
-            VK_SHADER_STAGE_VERTEX_BIT, "main", vertexShaderModule.handle, shaderStages[0]))
+            VK_SHADER_STAGE_VERTEX_BIT, "main", vertexShaderModule.handle, shaderStages[0], &vertexLayoutSpecialization))
                 return 0;
         }
 
@@ -270,7 +281,7 @@ namespace BlitzenVulkan
         if(m_stats.meshShaderSupport)
         {
             if(!CreateShaderProgram(m_device, "VulkanShaders/MeshShader.task.glsl.spv", 
-            VK_SHADER_STAGE_TASK_BIT_EXT, "main", taskShaderModule.handle, shaderStages[2]))
+            VK_SHADER_STAGE_TASK_BIT_EXT, "main", taskShaderModule.handle, shaderStages[2], &vertexLayoutSpecialization))
                 return 0;
         }
 
@@ -287,6 +298,12 @@ namespace BlitzenVulkan
 
         // Setting up triangle primitive assembly
         VkPipelineInputAssemblyStateCreateInfo inputAssembly = SetTriangleListInputAssembly();
+        // Strip indices separate their strips with the largest value of their index type
+        if(m_stats.bStripIndices)
+        {
+            inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+            inputAssembly.primitiveRestartEnable = VK_TRUE;
+        }
         pipelineInfo.pInputAssemblyState = &inputAssembly;
 
         // Setting the viewport and scissor as dynamic states
@@ -73,6 +73,10 @@ namespace BlitzenVulkan
         void DrawGeometry(VkCommandBuffer commandBuffer, VkWriteDescriptorSet* pDescriptorWrites, uint32_t drawCount, 
         uint8_t latePass, VkPipeline pipeline);
 
+        // Replaces the commands of the last culling dispatch with one instanced command for every surface lod that has visible objects.
+        // Expects the culling shader's descriptors and push constants to still be bound
+        void CompactInstancedDraws(VkCommandBuffer commandBuffer, uint32_t drawCount);
+
         // For occlusion culling to be possible a depth pyramid needs to be generated based on the depth attachment
         void GenerateDepthPyramid(VkCommandBuffer commandBuffer);
 
@@ -155,6 +159,9 @@ namespace BlitzenVulkan
 
             AllocatedBuffer indexBuffer;
 
+            // Holds the indices of surfaces with PrimitiveSurface::bIndices16. Might not be created if there are no such surfaces
+            AllocatedBuffer index16Buffer;
+
             // The meshlet / cluster buffer is a storage buffer that will be part of the push descirptor layout at binding 12
             // It will hold all meshlets for all the primitives on the scene
             PushDescriptorBuffer<void> meshletBuffer{12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
@@ -163,6 +170,10 @@ namespace BlitzenVulkan
             // It will hold indices to access the correct cluster in the meshlet buffer
             PushDescriptorBuffer<void> meshletDataBuffer{13, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
 
+            // The lod cluster buffer is a storage buffer that will be part of the push descriptor layout at binding 16
+            // It will hold the cluster lod hierarchies of large surfaces, read by the task shader (a single unused cluster if there are none)
+            PushDescriptorBuffer<void> lodClusterBuffer{16, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
             // The material buffer is a storage buffer that will be part of the push descriptor layout at binding 6
             // It will hold all the materials used in the scene
             PushDescriptorBuffer<void> materialBuffer{6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
@@ -175,10 +186,34 @@ namespace BlitzenVulkan
             // It will hold the data for all the primitive surfaces that will be used in the scene
             PushDescriptorBuffer<void> surfaceBuffer{2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
 
+            // The surface cull buffer is a storage buffer that will be part of the push descriptor layout at binding 14
+            // It will hold the compact part of each surface that the culling shaders read for every object (BlitzenEngine::SurfaceCullData)
+            PushDescriptorBuffer<void> surfaceCullBuffer{14, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
+            // The surface lod draw buffer is a storage buffer that will be part of the push descriptor layout at binding 15
+            // It will hold the draw data of every lod, read by the culling shaders only for objects that are drawn
+            PushDescriptorBuffer<void> surfaceLodDrawBuffer{15, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
+            // The world bounds buffer is a storage buffer that will be part of the push descriptor layout at binding 17
+            // It will hold the world space bounding sphere and box of every render object, baked at upload (BlitzenEngine::RenderWorldBounds)
+            PushDescriptorBuffer<void> worldBoundsBuffer{17, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
+            // The instance buffer is a storage buffer that will be part of the push descriptor layout at binding 18
+            // It will hold the object ids of instanced draws, grouped by the surface lod that they are drawn with
+            PushDescriptorBuffer<void> instanceBuffer{18, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
+            // The draw bucket buffer is a storage buffer that will be part of the push descriptor layout at binding 19
+            // It will hold the visible object count and instance buffer offset of every surface lod, for instanced draws
+            PushDescriptorBuffer<void> drawBucketBuffer{19, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
             // The transform buffer is a storage buffer that will be part of the push descriptor layout at bidning 5
             // It will hold the transforms of all the objects in the scene
             PushDescriptorBuffer<void> transformBuffer{5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
 
+            // The transform cell buffer is a storage buffer that will be part of the push descriptor layout at binding 11
+            // It will hold the cell origins of packed transforms (a single unused cell when the transforms are not packed)
+            PushDescriptorBuffer<void> transformCellBuffer{11, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+
             // The indirect draw buffer is a storage buffer that will be part of the push descriptor layout at binding 7
             // It will hold all the indirect draw commands for each frame
             PushDescriptorBuffer<void> indirectDrawBuffer{7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
@@ -216,8 +251,8 @@ namespace BlitzenVulkan
         // Layout for descriptors that will be using PushDescriptor extension. Has 10+ bindings
         DescriptorSetLayout m_pushDescriptorBufferLayout;
 
-        VkWriteDescriptorSet pushDescriptorWritesGraphics[7];
-        VkWriteDescriptorSet pushDescriptorWritesCompute[8];
+        VkWriteDescriptorSet pushDescriptorWritesGraphics[9];
+        VkWriteDescriptorSet pushDescriptorWritesCompute[13];
 
         // Layout for descriptor set that passes the source image and dst image for each depth pyramid mip
         DescriptorSetLayout m_depthPyramidDescriptorLayout;
@@ -266,6 +301,14 @@ namespace BlitzenVulkan
         // Sets up an indirect draw command buffer and indirect count buffer for objects that were not tagged as visible last frame
         PipelineProgram m_lateDrawCullProgram;
 
+        // Instanced draw passes, dispatched after each culling shader with its layout when instanced draws are used.
+        // They count the visible objects of each surface lod, sum the counts, scatter the object ids to the instance buffer
+        // and write one command for each surface lod with visible objects
+        PipelineObject m_drawBucketCountPipeline;
+        PipelineObject m_drawBucketScanPipeline;
+        PipelineObject m_drawBucketScatterPipeline;
+        PipelineObject m_drawBucketEmitPipeline;
+
         // The depth pyramid generation pipeline will hold a helper compute shader for the late culling pipeline.
         // It will generate the depth pyramid from the 1st pass' depth buffer. It will then be used for occlusion culling 
         PipelineObject m_depthPyramidGenerationPipeline;
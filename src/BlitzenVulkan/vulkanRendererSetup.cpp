@@ -1,5 +1,7 @@
 #define VMA_IMPLEMENTATION// Implements vma funcions. Header file included in vulkanData.h
 #include "vulkanRenderer.h"
+#include "Renderer/blitTransformQuantization.h"
+#include "Renderer/blitSurfaceCullData.h"
 
 namespace BlitzenVulkan
 {
@@ -190,11 +192,27 @@ namespace BlitzenVulkan
             return 0;
         }
         
+        // The culling shaders read transforms, so they need to know their layout (PACKED_TRANSFORMS in ShaderBuffers.glsl).
+        // They also write the commands differently for instanced draws (INSTANCED_DRAWS)
+        uint32_t cullConstants[2] = { m_stats.bPackedTransforms, m_stats.bInstancedDraws };
+        VkSpecializationMapEntry transformLayoutSpecializationMapEntries[2] = {};
+        transformLayoutSpecializationMapEntries[0].constantID = 2;
+        transformLayoutSpecializationMapEntries[0].offset = 0;
+        transformLayoutSpecializationMapEntries[0].size = sizeof(uint32_t);
+        transformLayoutSpecializationMapEntries[1].constantID = 3;
+        transformLayoutSpecializationMapEntries[1].offset = sizeof(uint32_t);
+        transformLayoutSpecializationMapEntries[1].size = sizeof(uint32_t);
+        VkSpecializationInfo transformLayoutSpecialization{};
+        transformLayoutSpecialization.dataSize = sizeof(cullConstants);
+        transformLayoutSpecialization.mapEntryCount = BLIT_ARRAY_SIZE(transformLayoutSpecializationMapEntries);
+        transformLayoutSpecialization.pMapEntries = transformLayoutSpecializationMapEntries;
+        transformLayoutSpecialization.pData = cullConstants;
+
         #ifdef NDEBUG
         // Creates pipeline for The initial culling shader that will be dispatched before the 1st pass. 
         // It performs frustum culling on objects that were visible last frame (visibility is set by the late culling shader)
         if(!CreateComputeShaderProgram(m_device, "VulkanShaders/InitialDrawCull.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
-        m_drawCullLayout.handle, &m_initialDrawCullPipeline.handle))
+        m_drawCullLayout.handle, &m_initialDrawCullPipeline.handle, &transformLayoutSpecialization))
         {
             BLIT_ERROR("Failed to create InitialDrawCull.comp shader program")
             return 0;
@@ -203,7 +221,7 @@ namespace BlitzenVulkan
         // Creates pipeline for The initial culling shader that will be dispatched before the 1st pass. 
         // It performs frustum culling on objects that were visible last frame (visibility is set by the late culling shader)
         if(!CreateComputeShaderProgram(m_device, "VulkanShaders/InitialDrawCullDebug.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
-        m_drawCullLayout.handle, &m_initialDrawCullPipeline.handle))
+        m_drawCullLayout.handle, &m_initialDrawCullPipeline.handle, &transformLayoutSpecialization))
         {
             BLIT_ERROR("Failed to create InitialDrawCull.comp shader program")
             return 0;
@@ -224,20 +242,52 @@ namespace BlitzenVulkan
         // It creates a draw command for the objects that were not tested by the previous shader
         // It also sets the visibility of each object for this frame, so that it can be accessed next frame
         if(!CreateComputeShaderProgram(m_device, "VulkanShaders/LateDrawCull.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
-        m_drawCullLayout.handle, &m_lateDrawCullPipeline.handle))
+        m_drawCullLayout.handle, &m_lateDrawCullPipeline.handle, &transformLayoutSpecialization))
         {
             BLIT_ERROR("Failed to create LateDrawCull.comp shader program")
             return 0;
         }
         #else
         if(!CreateComputeShaderProgram(m_device, "VulkanShaders/LateDrawCullDebug.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
-        m_drawCullLayout.handle, &m_lateDrawCullPipeline.handle))
+        m_drawCullLayout.handle, &m_lateDrawCullPipeline.handle, &transformLayoutSpecialization))
         {
             BLIT_ERROR("Failed to create LateDrawCull.comp shader program")
             return 0;
         }
         #endif
 
+        // Creates the instanced draw passes, they use the layout of the culling shaders
+        if(m_stats.bInstancedDraws)
+        {
+            if(!CreateComputeShaderProgram(m_device, "VulkanShaders/DrawBucketCount.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
+            m_drawCullLayout.handle, &m_drawBucketCountPipeline.handle))
+            {
+                BLIT_ERROR("Failed to create DrawBucketCount.comp shader program")
+                return 0;
+            }
+
+            if(!CreateComputeShaderProgram(m_device, "VulkanShaders/DrawBucketScan.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
+            m_drawCullLayout.handle, &m_drawBucketScanPipeline.handle))
+            {
+                BLIT_ERROR("Failed to create DrawBucketScan.comp shader program")
+                return 0;
+            }
+
+            if(!CreateComputeShaderProgram(m_device, "VulkanShaders/DrawBucketScatter.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
+            m_drawCullLayout.handle, &m_drawBucketScatterPipeline.handle))
+            {
+                BLIT_ERROR("Failed to create DrawBucketScatter.comp shader program")
+                return 0;
+            }
+
+            if(!CreateComputeShaderProgram(m_device, "VulkanShaders/DrawBucketEmit.comp.glsl.spv", VK_SHADER_STAGE_COMPUTE_BIT, "main", 
+            m_drawCullLayout.handle, &m_drawBucketEmitPipeline.handle))
+            {
+                BLIT_ERROR("Failed to create DrawBucketEmit.comp shader program")
+                return 0;
+            }
+        }
+
         // Create the background shader in case the renderer has not objects
         if(!CreateComputeShaderProgram(m_device, "VulkanShaders/BasicBackground.comp.glsl.spv", 
         VK_SHADER_STAGE_COMPUTE_BIT, "main", m_basicBackgroundLayout.handle, &m_basicBackgroundPipeline.handle))
@@ -266,6 +316,8 @@ namespace BlitzenVulkan
         pushDescriptorWritesGraphics[4] = m_currentStaticBuffers.materialBuffer.descriptorWrite; 
         pushDescriptorWritesGraphics[5] = m_currentStaticBuffers.indirectDrawBuffer.descriptorWrite;
         pushDescriptorWritesGraphics[6] = m_currentStaticBuffers.surfaceBuffer.descriptorWrite;
+        pushDescriptorWritesGraphics[7] = m_currentStaticBuffers.transformCellBuffer.descriptorWrite;
+        pushDescriptorWritesGraphics[8] = m_currentStaticBuffers.instanceBuffer.descriptorWrite;
 
         pushDescriptorWritesCompute[0] = {};// This will be where the global shader data write will be, but this one is not always static
         pushDescriptorWritesCompute[1] = m_currentStaticBuffers.renderObjectBuffer.descriptorWrite; 
@@ -273,8 +325,13 @@ namespace BlitzenVulkan
         pushDescriptorWritesCompute[3] = m_currentStaticBuffers.indirectDrawBuffer.descriptorWrite;
         pushDescriptorWritesCompute[4] = m_currentStaticBuffers.indirectCountBuffer.descriptorWrite; 
         pushDescriptorWritesCompute[5] = m_currentStaticBuffers.visibilityBuffer.descriptorWrite; 
-        pushDescriptorWritesCompute[6] = m_currentStaticBuffers.surfaceBuffer.descriptorWrite; 
-        pushDescriptorWritesCompute[7] = {};
+        pushDescriptorWritesCompute[6] = m_currentStaticBuffers.surfaceCullBuffer.descriptorWrite; 
+        pushDescriptorWritesCompute[7] = m_currentStaticBuffers.surfaceLodDrawBuffer.descriptorWrite; 
+        pushDescriptorWritesCompute[8] = m_currentStaticBuffers.transformCellBuffer.descriptorWrite;
+        pushDescriptorWritesCompute[9] = m_currentStaticBuffers.worldBoundsBuffer.descriptorWrite;
+        pushDescriptorWritesCompute[10] = m_currentStaticBuffers.instanceBuffer.descriptorWrite;
+        pushDescriptorWritesCompute[11] = m_currentStaticBuffers.drawBucketBuffer.descriptorWrite;
+        pushDescriptorWritesCompute[12] = {};
 
         return 1;
     }
@@ -410,10 +467,10 @@ namespace BlitzenVulkan
         CreateDescriptorSetLayoutBinding(vertexBufferBinding, m_currentStaticBuffers.vertexBuffer.descriptorBinding, 
         1, m_currentStaticBuffers.vertexBuffer.descriptorType, vertexBufferShaderStageFlags);
 
-        // Descriptor set layout binding for surface SSBO
+        // Descriptor set layout binding for surface SSBO. The culling shaders use the surface cull and lod draw buffers instead
         VkShaderStageFlags surfaceBufferShaderStageFlags = m_stats.meshShaderSupport ?
-        VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT :
-        VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+        VK_SHADER_STAGE_MESH_BIT_EXT | VK_SHADER_STAGE_TASK_BIT_EXT :
+        VK_SHADER_STAGE_VERTEX_BIT;
         CreateDescriptorSetLayoutBinding(surfaceBufferBinding, m_currentStaticBuffers.surfaceBuffer.descriptorBinding, 
         1, m_currentStaticBuffers.surfaceBuffer.descriptorType, surfaceBufferShaderStageFlags);
 
@@ -430,6 +487,13 @@ namespace BlitzenVulkan
         CreateDescriptorSetLayoutBinding(meshletDataBinding, m_currentStaticBuffers.meshletDataBuffer.descriptorBinding, 
         1, m_currentStaticBuffers.meshletDataBuffer.descriptorType, clusterDataBufferShaderStageFlags);
 
+        // Descriptor set layout binding for the cluster lod hierarchies, only the task shader selects clusters
+        VkDescriptorSetLayoutBinding lodClusterBinding{};
+        VkShaderStageFlags lodClusterBufferShaderStageFlags = m_stats.meshShaderSupport ? 
+        VK_SHADER_STAGE_TASK_BIT_EXT : VK_SHADER_STAGE_VERTEX_BIT;
+        CreateDescriptorSetLayoutBinding(lodClusterBinding, m_currentStaticBuffers.lodClusterBuffer.descriptorBinding, 
+        1, m_currentStaticBuffers.lodClusterBuffer.descriptorType, lodClusterBufferShaderStageFlags);
+
         // If mesh shaders are used the bindings needs to be accessed by mesh shaders, otherwise they will be accessed by vertex shader stage
         if(m_stats.meshShaderSupport)
             CreateDescriptorSetLayoutBinding(indirectTaskBufferBinding, m_currentStaticBuffers.indirectTaskBuffer.descriptorBinding, 
@@ -449,6 +513,10 @@ namespace BlitzenVulkan
         CreateDescriptorSetLayoutBinding(transformBufferBinding, m_currentStaticBuffers.transformBuffer.descriptorBinding, 
         1, m_currentStaticBuffers.renderObjectBuffer.descriptorType, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
 
+        VkDescriptorSetLayoutBinding transformCellBufferBinding{};
+        CreateDescriptorSetLayoutBinding(transformCellBufferBinding, m_currentStaticBuffers.transformCellBuffer.descriptorBinding, 
+        1, m_currentStaticBuffers.transformCellBuffer.descriptorType, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
         VkDescriptorSetLayoutBinding materialBufferBinding{};
         CreateDescriptorSetLayoutBinding(materialBufferBinding, m_currentStaticBuffers.materialBuffer.descriptorBinding, 
         1, m_currentStaticBuffers.materialBuffer.descriptorType, VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -464,13 +532,35 @@ namespace BlitzenVulkan
         VkDescriptorSetLayoutBinding visibilityBufferBinding{};
         CreateDescriptorSetLayoutBinding(visibilityBufferBinding, m_currentStaticBuffers.visibilityBuffer.descriptorBinding, 
         1, m_currentStaticBuffers.visibilityBuffer.descriptorType, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkDescriptorSetLayoutBinding surfaceCullBufferBinding{};
+        CreateDescriptorSetLayoutBinding(surfaceCullBufferBinding, m_currentStaticBuffers.surfaceCullBuffer.descriptorBinding, 
+        1, m_currentStaticBuffers.surfaceCullBuffer.descriptorType, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkDescriptorSetLayoutBinding surfaceLodDrawBufferBinding{};
+        CreateDescriptorSetLayoutBinding(surfaceLodDrawBufferBinding, m_currentStaticBuffers.surfaceLodDrawBuffer.descriptorBinding, 
+        1, m_currentStaticBuffers.surfaceLodDrawBuffer.descriptorType, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkDescriptorSetLayoutBinding worldBoundsBufferBinding{};
+        CreateDescriptorSetLayoutBinding(worldBoundsBufferBinding, m_currentStaticBuffers.worldBoundsBuffer.descriptorBinding, 
+        1, m_currentStaticBuffers.worldBoundsBuffer.descriptorType, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        // The instance buffer is written by the DrawBucket shaders and read by the vertex shader
+        VkDescriptorSetLayoutBinding instanceBufferBinding{};
+        CreateDescriptorSetLayoutBinding(instanceBufferBinding, m_currentStaticBuffers.instanceBuffer.descriptorBinding, 
+        1, m_currentStaticBuffers.instanceBuffer.descriptorType, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkDescriptorSetLayoutBinding drawBucketBufferBinding{};
+        CreateDescriptorSetLayoutBinding(drawBucketBufferBinding, m_currentStaticBuffers.drawBucketBuffer.descriptorBinding, 
+        1, m_currentStaticBuffers.drawBucketBuffer.descriptorType, VK_SHADER_STAGE_COMPUTE_BIT);
         
         // All bindings combined to create the global shader data descriptor set layout
-        VkDescriptorSetLayoutBinding shaderDataBindings[13] = {viewDataLayoutBinding, vertexBufferBinding, 
-        depthImageBinding, renderObjectBufferBinding, transformBufferBinding, materialBufferBinding, 
+        VkDescriptorSetLayoutBinding shaderDataBindings[20] = {viewDataLayoutBinding, vertexBufferBinding, 
+        depthImageBinding, renderObjectBufferBinding, transformBufferBinding, transformCellBufferBinding, materialBufferBinding, 
         indirectDrawBufferBinding, indirectDrawCountBinding, visibilityBufferBinding, 
-        surfaceBufferBinding, meshletBufferBinding, meshletDataBinding, indirectTaskBufferBinding};
-        m_pushDescriptorBufferLayout.handle = CreateDescriptorSetLayout(m_device, 12, shaderDataBindings, 
+        surfaceBufferBinding, surfaceCullBufferBinding, surfaceLodDrawBufferBinding, meshletBufferBinding, meshletDataBinding, 
+        lodClusterBinding, indirectTaskBufferBinding, worldBoundsBufferBinding, instanceBufferBinding, drawBucketBufferBinding};
+        m_pushDescriptorBufferLayout.handle = CreateDescriptorSetLayout(m_device, BLIT_ARRAY_SIZE(shaderDataBindings), shaderDataBindings, 
         VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
         if(m_pushDescriptorBufferLayout.handle == VK_NULL_HANDLE)
             return 0;
@@ -509,7 +599,10 @@ namespace BlitzenVulkan
 
         // The graphics pipeline will use 2 layouts, the one for push desciptors and the constant one for textures
         VkDescriptorSetLayout layouts[2] = { m_pushDescriptorBufferLayout.handle, m_textureDescriptorSetlayout.handle };
-        if(!CreatePipelineLayout(m_device, &m_graphicsPipelineLayout.handle, 2, layouts, 0, nullptr))
+        // The vertex shader also gets the offset of the current indirect draw call's commands as a push constant
+        VkPushConstantRange drawOffsetPushConstant{};
+        CreatePushConstantRange(drawOffsetPushConstant, VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t));
+        if(!CreatePipelineLayout(m_device, &m_graphicsPipelineLayout.handle, 2, layouts, 1, &drawOffsetPushConstant))
             return 0;
 
         // The layout for culling shaders uses the push descriptor layout but accesses more bindings for culling data and the depth pyramid
@@ -589,13 +682,33 @@ namespace BlitzenVulkan
         BlitCL::DynamicArray<uint32_t>& meshletData = pResources->meshletData;
 
 
+        // Strip indices draw fine with primitive restart, but acceleration structures can only be built from triangle lists
+        m_stats.bStripIndices = pResources->bStripIndices;
+        if(m_stats.bStripIndices && m_stats.bRayTracingSupported)
+        {
+            BLIT_WARN("Ray tracing acceleration structures need triangle list indices, ray tracing is disabled for strip indices")
+            m_stats.bRayTracingSupported = 0;
+        }
+
+        // Instanced commands start from the first instance of their bucket, and the mesh shader path has its own task commands
+        m_stats.bInstancedDraws = pResources->bInstancedDraws;
+        if(m_stats.bInstancedDraws && (!m_stats.bDrawIndirectFirstInstance || m_stats.meshShaderSupport))
+        {
+            BLIT_WARN("Instanced draws need drawIndirectFirstInstance and the vertex shader path, each object gets its own command")
+            m_stats.bInstancedDraws = 0;
+        }
+
         uint32_t geometryBuffersRaytracingFlags = m_stats.bRayTracingSupported ?
         VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
         : 0;
 
 
-        // Creates a storage buffer that will hold the vertices
-        VkDeviceSize vertexBufferSize = sizeof(BlitzenEngine::Vertex) * vertices.GetSize();
+        // Creates a storage buffer that will hold the vertices, in whichever layout the resources were loaded with
+        m_stats.bCompactVertices = pResources->bCompactVertices;
+        VkDeviceSize vertexBufferSize = m_stats.bCompactVertices ? 
+        sizeof(BlitzenEngine::CompactVertex) * pResources->compactVertices.GetSize() : sizeof(BlitzenEngine::Vertex) * vertices.GetSize();
+        void* pVertexData = m_stats.bCompactVertices ? 
+        static_cast<void*>(pResources->compactVertices.Data()) : static_cast<void*>(vertices.Data());
         // Fails if there are no vertices
         if(vertexBufferSize == 0)
             return 0;
@@ -604,22 +717,36 @@ namespace BlitzenVulkan
         // Initializes the push descritpor buffer struct that holds the vertex buffer
         if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.vertexBuffer, stagingVertexBuffer, 
         vertexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | 
-        geometryBuffersRaytracingFlags, vertices.Data()))
+        geometryBuffersRaytracingFlags, pVertexData))
             return 0;
 
-        // Creates an index buffer that will hold all the loaded indices
+        // Creates the index buffers that will hold all the loaded indices. 
+        // Surfaces with 16-bit indices have their own buffer, so either of the 2 might be empty, but not both
         VkDeviceSize indexBufferSize = sizeof(uint32_t) * indices.GetSize();
+        VkDeviceSize index16BufferSize = sizeof(uint16_t) * pResources->indices16.GetSize();
         // Fails if there are no indices
-        if(indexBufferSize == 0)
+        if(indexBufferSize == 0 && index16BufferSize == 0)
             return 0;
         // Creates a staging buffer to hold the index data and pass it to the index buffer later
         AllocatedBuffer stagingIndexBuffer;
-        CreateStorageBufferWithStagingBuffer(m_allocator, m_device, indices.Data(), m_currentStaticBuffers.indexBuffer, 
-        stagingIndexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | 
-        geometryBuffersRaytracingFlags, indexBufferSize);
-        // Checks if the above function failed
-        if(m_currentStaticBuffers.indexBuffer.bufferHandle == VK_NULL_HANDLE)
-            return 0;
+        if(indexBufferSize)
+        {
+            CreateStorageBufferWithStagingBuffer(m_allocator, m_device, indices.Data(), m_currentStaticBuffers.indexBuffer, 
+            stagingIndexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | 
+            geometryBuffersRaytracingFlags, indexBufferSize);
+            // Checks if the above function failed
+            if(m_currentStaticBuffers.indexBuffer.bufferHandle == VK_NULL_HANDLE)
+                return 0;
+        }
+        AllocatedBuffer stagingIndex16Buffer;
+        if(index16BufferSize)
+        {
+            CreateStorageBufferWithStagingBuffer(m_allocator, m_device, pResources->indices16.Data(), 
+            m_currentStaticBuffers.index16Buffer, stagingIndex16Buffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | 
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT | geometryBuffersRaytracingFlags, index16BufferSize);
+            if(m_currentStaticBuffers.index16Buffer.bufferHandle == VK_NULL_HANDLE)
+                return 0;
+        }
 
         // Creates an SSBO that will hold all the render objects that were loaded for the scene
         VkDeviceSize renderObjectBufferSize = sizeof(BlitzenEngine::RenderObject) * renderObjectCount;
@@ -642,6 +769,25 @@ namespace BlitzenVulkan
         surfaceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, surfaces.Data()))
             return 0;
 
+        // Splits the surfaces into the cull records and lod draw table that the culling shaders read
+        BlitCL::DynamicArray<BlitzenEngine::SurfaceCullData> surfaceCullData;
+        BlitCL::DynamicArray<BlitzenEngine::SurfaceLodDraw> surfaceLodDraws;
+        BlitzenEngine::BuildSurfaceCullTables(surfaces, surfaceCullData, surfaceLodDraws);
+
+        // Creates an SSBO that will hold the cull record of each surface
+        VkDeviceSize surfaceCullBufferSize = sizeof(BlitzenEngine::SurfaceCullData) * surfaceCullData.GetSize();
+        AllocatedBuffer surfaceCullStagingBuffer;
+        if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.surfaceCullBuffer, surfaceCullStagingBuffer, 
+        surfaceCullBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, surfaceCullData.Data()))
+            return 0;
+
+        // Creates an SSBO that will hold the lod draw table
+        VkDeviceSize surfaceLodDrawBufferSize = sizeof(BlitzenEngine::SurfaceLodDraw) * surfaceLodDraws.GetSize();
+        AllocatedBuffer surfaceLodDrawStagingBuffer;
+        if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.surfaceLodDrawBuffer, surfaceLodDrawStagingBuffer, 
+        surfaceLodDrawBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, surfaceLodDraws.Data()))
+            return 0;
+
         // Creates an SSBO that will hold all the materials that were loaded for the scene
         VkDeviceSize materialBufferSize = sizeof(BlitzenEngine::Material) * materialCount;
         if(materialBufferSize == 0)
@@ -653,18 +799,79 @@ namespace BlitzenVulkan
         materialBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, pMaterials))
             return 0;
 
+        // Packs the transforms if requested, they stay in full if they are spread over too many cells
+        BlitCL::DynamicArray<BlitzenEngine::PackedTransform> packedTransforms;
+        BlitCL::DynamicArray<BlitML::vec4> transformCells;
+        m_stats.bPackedTransforms = pResources->bPackedTransforms && 
+        BlitzenEngine::PackMeshTransforms(transforms, packedTransforms, transformCells);
+        // The cell buffer is always bound, so it gets a placeholder when it is not used
+        if(!m_stats.bPackedTransforms)
+        {
+            transformCells.Downsize(0);
+            transformCells.PushBack(BlitML::vec4(0.f));
+        }
+
         // Create an SSBO that will hold all the object transforms that were loaded for the scene
-        VkDeviceSize transformBufferSize = sizeof(BlitzenEngine::MeshTransform) * transforms.GetSize();
+        VkDeviceSize transformBufferSize = m_stats.bPackedTransforms ? 
+        sizeof(BlitzenEngine::PackedTransform) * packedTransforms.GetSize() : sizeof(BlitzenEngine::MeshTransform) * transforms.GetSize();
+        void* pTransformData = m_stats.bPackedTransforms ? 
+        static_cast<void*>(packedTransforms.Data()) : static_cast<void*>(transforms.Data());
         if(transformBufferSize == 0)
             return 0;
         // Creates a staging buffer that will hold the transform data and pass it to the transform buffer later
         AllocatedBuffer transformStagingBuffer; 
         if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.transformBuffer, transformStagingBuffer, 
-        transformBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, transforms.Data()))
+        transformBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, pTransformData))
+            return 0;
+
+        // Creates an SSBO that will hold the cell origins of packed transforms
+        VkDeviceSize transformCellBufferSize = sizeof(BlitML::vec4) * transformCells.GetSize();
+        AllocatedBuffer transformCellStagingBuffer;
+        if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.transformCellBuffer, transformCellStagingBuffer, 
+        transformCellBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, transformCells.Data()))
             return 0;
 
-        // Creates the buffer that will hold the indirect draw commands. It is set as an SSBO as well so that it can be written by the culling shaders
-        VkDeviceSize indirectDrawBufferSize = sizeof(IndirectDrawData) * renderObjectCount;
+        // Bakes the world space sphere and box of every render object whose transform does not change.
+        // Packed transforms are decoded first, so that the bounds match the transforms that the shaders read
+        BlitCL::DynamicArray<BlitzenEngine::MeshTransform> decodedTransforms;
+        if(m_stats.bPackedTransforms)
+        {
+            decodedTransforms.Resize(packedTransforms.GetSize());
+            for(size_t i = 0; i < packedTransforms.GetSize(); ++i)
+            {
+                BlitML::vec4& cell = transformCells[packedTransforms[i].positionZCell >> 16];
+                decodedTransforms[i] = BlitzenEngine::DecodePackedTransform(packedTransforms[i], 
+                BlitML::vec3(cell.x, cell.y, cell.z));
+            }
+        }
+        BlitCL::DynamicArray<BlitzenEngine::RenderWorldBounds> worldBounds;
+        BlitzenEngine::BuildRenderWorldBounds(pRenderObjects, renderObjectCount, 
+        m_stats.bPackedTransforms ? decodedTransforms.Data() : transforms.Data(), transforms.GetSize(), 
+        surfaceCullData.Data(), pResources->dynamicTransforms, worldBounds);
+
+        // Creates an SSBO that will hold the baked world space bounds
+        VkDeviceSize worldBoundsBufferSize = sizeof(BlitzenEngine::RenderWorldBounds) * worldBounds.GetSize();
+        AllocatedBuffer worldBoundsStagingBuffer;
+        if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.worldBoundsBuffer, worldBoundsStagingBuffer, 
+        worldBoundsBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, worldBounds.Data()))
+            return 0;
+
+        // Creates the buffers of instanced draws, one bucket for every element of the lod draw table. 
+        // They are always bound, so they get a single element when they are not used
+        m_stats.drawBucketCount = static_cast<uint32_t>(surfaceLodDraws.GetSize());
+        VkDeviceSize instanceBufferSize = sizeof(uint32_t) * (m_stats.bInstancedDraws ? renderObjectCount : 1);
+        if(!SetupPushDescriptorBuffer(m_allocator, VMA_MEMORY_USAGE_GPU_ONLY, m_currentStaticBuffers.instanceBuffer, 
+        instanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+            return 0;
+        VkDeviceSize drawBucketBufferSize = sizeof(uint32_t) * 2 * (m_stats.bInstancedDraws ? m_stats.drawBucketCount : 1);
+        if(!SetupPushDescriptorBuffer(m_allocator, VMA_MEMORY_USAGE_GPU_ONLY, m_currentStaticBuffers.drawBucketBuffer, 
+        drawBucketBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT))
+            return 0;
+
+        // Creates the buffer that will hold the indirect draw commands. It is set as an SSBO as well so that it can be written by the culling shaders.
+        // The commands of 16-bit index surfaces are drawn by a separate call after the 32-bit ones. 
+        // When there are any, the buffer has room for each render object twice
+        VkDeviceSize indirectDrawBufferSize = sizeof(IndirectDrawData) * renderObjectCount * (pResources->indices16.GetSize() != 0 ? 2 : 1);
         if(indirectDrawBufferSize == 0)
             return 0;
         // Initializes the push descriptor buffer that holds the indirect draw buffer
@@ -679,6 +886,13 @@ namespace BlitzenVulkan
         AllocatedBuffer meshletStagingBuffer;
         VkDeviceSize meshletDataBufferSize = sizeof(uint32_t) * meshletData.GetSize();
         AllocatedBuffer meshletDataStagingBuffer;
+        // Surfaces without a cluster lod hierarchy never read the buffer, but it still needs to exist
+        BlitzenEngine::LodCluster placeholderLodCluster{};
+        void* pLodClusterData = pResources->lodClusters.GetSize() ? 
+        static_cast<void*>(pResources->lodClusters.Data()) : static_cast<void*>(&placeholderLodCluster);
+        VkDeviceSize lodClusterBufferSize = sizeof(BlitzenEngine::LodCluster) * 
+        (pResources->lodClusters.GetSize() ? pResources->lodClusters.GetSize() : 1);
+        AllocatedBuffer lodClusterStagingBuffer;
         if(m_stats.meshShaderSupport)
         {
             if(indirectTaskBufferSize == 0)
@@ -703,11 +917,16 @@ namespace BlitzenVulkan
             if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.meshletDataBuffer, meshletDataStagingBuffer, 
             meshletDataBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, meshletData.Data()))
                 return 0;
+
+            // Initializes the push descriptor buffer that holds the lod clusters
+            if(!SetupPushDescriptorBuffer(m_device, m_allocator, m_currentStaticBuffers.lodClusterBuffer, lodClusterStagingBuffer, 
+            lodClusterBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, pLodClusterData))
+                return 0;
         }
 
-        // Initializes the push descriptor buffer that holds the indirect count buffer
+        // Initializes the push descriptor buffer that holds the indirect count buffer (one count for each index type)
         if(!SetupPushDescriptorBuffer(m_allocator, VMA_MEMORY_USAGE_GPU_ONLY, m_currentStaticBuffers.indirectCountBuffer, 
-        sizeof(uint32_t), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
+        sizeof(uint32_t) * 2, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT))
             return 0;
 
         // Creates an SSBO that will hold one integer for each object indicating if they were visible or not on the previous frame
@@ -728,10 +947,15 @@ namespace BlitzenVulkan
         m_currentStaticBuffers.vertexBuffer.buffer.bufferHandle, vertexBufferSize, 
         0, 0);
 
-        // Copies the index data held by the staging buffer to the index buffer
-        CopyBufferToBuffer(commandBuffer, stagingIndexBuffer.bufferHandle, 
-        m_currentStaticBuffers.indexBuffer.bufferHandle, indexBufferSize, 
-        0, 0);
+        // Copies the index data held by the staging buffers to the index buffers
+        if(indexBufferSize)
+            CopyBufferToBuffer(commandBuffer, stagingIndexBuffer.bufferHandle, 
+            m_currentStaticBuffers.indexBuffer.bufferHandle, indexBufferSize, 
+            0, 0);
+        if(index16BufferSize)
+            CopyBufferToBuffer(commandBuffer, stagingIndex16Buffer.bufferHandle, 
+            m_currentStaticBuffers.index16Buffer.bufferHandle, index16BufferSize, 
+            0, 0);
 
         // Copies the render object data held by the staging buffer to the render object buffer
         CopyBufferToBuffer(commandBuffer, renderObjectStagingBuffer.bufferHandle, 
@@ -743,6 +967,14 @@ namespace BlitzenVulkan
         m_currentStaticBuffers.surfaceBuffer.buffer.bufferHandle, surfaceBufferSize, 
         0, 0);
 
+        // Copies the surface cull records and lod draw table held by the staging buffers
+        CopyBufferToBuffer(commandBuffer, surfaceCullStagingBuffer.bufferHandle, 
+        m_currentStaticBuffers.surfaceCullBuffer.buffer.bufferHandle, surfaceCullBufferSize, 
+        0, 0);
+        CopyBufferToBuffer(commandBuffer, surfaceLodDrawStagingBuffer.bufferHandle, 
+        m_currentStaticBuffers.surfaceLodDrawBuffer.buffer.bufferHandle, surfaceLodDrawBufferSize, 
+        0, 0);
+
         // Copies the material data held by the staging buffer to the material buffer
         CopyBufferToBuffer(commandBuffer, materialStagingBuffer.bufferHandle, 
         m_currentStaticBuffers.materialBuffer.buffer.bufferHandle, materialBufferSize, 
@@ -752,6 +984,16 @@ namespace BlitzenVulkan
         CopyBufferToBuffer(commandBuffer, transformStagingBuffer.bufferHandle,
         m_currentStaticBuffers.transformBuffer.buffer.bufferHandle, transformBufferSize, 
         0, 0);
+
+        // Copies the cell origins held by the staging buffer to the transform cell buffer
+        CopyBufferToBuffer(commandBuffer, transformCellStagingBuffer.bufferHandle,
+        m_currentStaticBuffers.transformCellBuffer.buffer.bufferHandle, transformCellBufferSize, 
+        0, 0);
+
+        // Copies the baked world space bounds held by the staging buffer to the world bounds buffer
+        CopyBufferToBuffer(commandBuffer, worldBoundsStagingBuffer.bufferHandle,
+        m_currentStaticBuffers.worldBoundsBuffer.buffer.bufferHandle, worldBoundsBufferSize, 
+        0, 0);
         
         if(m_stats.meshShaderSupport)
         {
@@ -763,6 +1005,10 @@ namespace BlitzenVulkan
             CopyBufferToBuffer(commandBuffer, meshletDataStagingBuffer.bufferHandle, 
             m_currentStaticBuffers.meshletDataBuffer.buffer.bufferHandle, meshletDataBufferSize, 
             0, 0);
+
+            CopyBufferToBuffer(commandBuffer, lodClusterStagingBuffer.bufferHandle, 
+            m_currentStaticBuffers.lodClusterBuffer.buffer.bufferHandle, lodClusterBufferSize, 
+            0, 0);
         }
 
         // The visibility buffer will start the 1st frame with only zeroes(nothing will be drawn on the first frame but that is fine)
@@ -835,8 +1081,39 @@ namespace BlitzenVulkan
 
         VkDeviceAddress vertexBufferAddress = GetBufferAddress(m_device, 
         m_currentStaticBuffers.vertexBuffer.buffer.bufferHandle);
-	    VkDeviceAddress indexBufferAddress = GetBufferAddress(m_device, 
-        m_currentStaticBuffers.indexBuffer.bufferHandle);
+	    VkDeviceAddress indexBufferAddress = m_currentStaticBuffers.indexBuffer.bufferHandle != VK_NULL_HANDLE ? 
+        GetBufferAddress(m_device, m_currentStaticBuffers.indexBuffer.bufferHandle) : 0;
+        VkDeviceAddress index16BufferAddress = m_currentStaticBuffers.index16Buffer.bufferHandle != VK_NULL_HANDLE ? 
+        GetBufferAddress(m_device, m_currentStaticBuffers.index16Buffer.bufferHandle) : 0;
+
+        // Compact positions are snorm16 inside each surface's bounding sphere. 
+        // The build takes a transform per geometry, which scales them by the radius and moves them to the center
+        VkDeviceSize vertexStride = m_stats.bCompactVertices ? sizeof(BlitzenEngine::CompactVertex) : sizeof(BlitzenEngine::Vertex);
+        AllocatedBuffer dequantizationBuffer;
+        VkDeviceAddress dequantizationBufferAddress = 0;
+        if(m_stats.bCompactVertices)
+        {
+            if(!CreateBuffer(m_allocator, dequantizationBuffer, 
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 
+            VMA_MEMORY_USAGE_CPU_TO_GPU, sizeof(VkTransformMatrixKHR) * surfaces.GetSize(), VMA_ALLOCATION_CREATE_MAPPED_BIT))
+                return 0;
+
+            VkTransformMatrixKHR* pTransforms = reinterpret_cast<VkTransformMatrixKHR*>(dequantizationBuffer.allocationInfo.pMappedData);
+            for(size_t i = 0; i < surfaces.GetSize(); ++i)
+            {
+                const auto& surface = surfaces[i];
+                VkTransformMatrixKHR transform{};
+                transform.matrix[0][0] = surface.radius;
+                transform.matrix[1][1] = surface.radius;
+                transform.matrix[2][2] = surface.radius;
+                transform.matrix[0][3] = surface.center.x;
+                transform.matrix[1][3] = surface.center.y;
+                transform.matrix[2][3] = surface.center.z;
+                pTransforms[i] = transform;
+            }
+
+            dequantizationBufferAddress = GetBufferAddress(m_device, dequantizationBuffer.bufferHandle);
+        }
 
         for(size_t i = 0; i < surfaces.GetSize(); ++i)
         {
@@ -853,19 +1130,23 @@ namespace BlitzenVulkan
             geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
             geometry.geometry.triangles.pNext = nullptr;
 
-            // Passing vertex data
-            geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+            // Passing vertex data. The 4th snorm16 component of compact vertices holds the normal, the build ignores it
+            geometry.geometry.triangles.vertexFormat = m_stats.bCompactVertices ? 
+            VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
             // Get the precise address of the vertex buffer for the current surface (needs to be incremented by the vertex offset)
             geometry.geometry.triangles.vertexData.deviceAddress = 
-            static_cast<VkDeviceAddress>(vertexBufferAddress + surface.vertexOffset * sizeof(BlitzenEngine::Vertex));
-            geometry.geometry.triangles.vertexStride = sizeof(BlitzenEngine::Vertex);
+            static_cast<VkDeviceAddress>(vertexBufferAddress + surface.vertexOffset * vertexStride);
+            geometry.geometry.triangles.vertexStride = vertexStride;
+            // The transform offset of each surface is given with its build range
+            geometry.geometry.triangles.transformData.deviceAddress = dequantizationBufferAddress;
             // Primitive vertex count (at the moment), is an array created for this one, optinal line of code
             geometry.geometry.triangles.maxVertex = primitiveVertexCounts[i];
 
-            // Passing index data
-            geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+            // Passing index data, from whichever of the 2 index buffers the surface uses
+            geometry.geometry.triangles.indexType = surface.bIndices16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
             // Precise address of the index buffer
-            geometry.geometry.triangles.indexData.deviceAddress = 
+            geometry.geometry.triangles.indexData.deviceAddress = surface.bIndices16 ? 
+            static_cast<VkDeviceAddress>(index16BufferAddress + surface.meshLod[0].firstIndex * sizeof(uint16_t)) : 
             static_cast<VkDeviceAddress>(indexBufferAddress + surface.meshLod[0].firstIndex * sizeof(uint32_t));
             
 
@@ -931,6 +1212,8 @@ namespace BlitzenVulkan
 
             VkAccelerationStructureBuildRangeInfoKHR& buildRange = buildRanges[i];
 		    buildRanges[i].primitiveCount = primitiveCounts[i];
+            if(m_stats.bCompactVertices)
+                buildRanges[i].transformOffset = static_cast<uint32_t>(i * sizeof(VkTransformMatrixKHR));
 		    buildRangePtrs[i] = &buildRanges[i];
         }
 
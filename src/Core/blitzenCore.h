@@ -2,6 +2,7 @@
 
 #include "Core/blitLogger.h"
 #include "BlitzenVulkan/vulkanRenderer.h"
+#include <atomic>
 
 namespace BlitzenCore
 {
@@ -15,12 +16,13 @@ namespace BlitzenCore
     };
 
     // This is used to log every allocation and check if there are any memory leaks in the end
+    // The counters are atomic since loaders allocate from worker threads
     struct MemoryManagerState
     {
-        size_t totalAllocated = 0;
+        std::atomic<size_t> totalAllocated{0};
 
         // Keeps track of how much memory has been allocated for each type of allocation
-        size_t typeAllocations[static_cast<size_t>(AllocationType::MaxTypes)];
+        std::atomic<size_t> typeAllocations[static_cast<size_t>(AllocationType::MaxTypes)];
 
         LinearAllocator linearAlloc;
 
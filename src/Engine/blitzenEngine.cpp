@@ -5,7 +5,12 @@
  
 #include "Engine/blitzenEngine.h"
 #include "Platform/platform.h"
+#include "Platform/assetPack.h"
+#include <string.h>
+#include <stdlib.h>
 #include "Renderer/blitRenderer.h"
+#include "Renderer/blitImportReport.h"
+#include "Renderer/blitCpuFrame.h"
 #include "Core/blitzenCore.h"
 #include "Core/blitEvents.h"
 #include "Game/blitCamera.h"
@@ -35,6 +40,89 @@ namespace BlitzenEngine
 
 
 
+    // Object count of the rendering stress test
+    constexpr uint32_t ce_stressTestObjectCount = 1'000'000;
+
+    // The CPU culling benchmark turns the camera and moves the dynamic objects as if every frame took this long
+    constexpr uint32_t ce_cpuCullBenchmarkFrames = 300;
+    constexpr float ce_cpuCullBenchmarkFrameTime = 1.f / 60.f;
+    constexpr float ce_cpuCullBenchmarkYaw = 60.f;
+    constexpr float ce_cpuCullBenchmarkSpin = 2.f;
+    constexpr float ce_cpuCullBenchmarkBob = 5.f;
+
+    // Loads the stress test and culls it with the CPU frame for frameCount frames, without a window or a renderer.
+    // Dynamic objects spin and bob around where they were loaded, so their bounds are not the same between frames and the hierarchy is refitted
+    static void RunCpuCullBenchmark(uint32_t frameCount)
+    {
+        BlitCL::SmartPointer<BlitzenEngine::RenderingResources, BlitzenCore::AllocationType::Renderer> pResources;
+        if(BlitzenPlatform::FilepathExists(ce_defaultAssetPack))
+            BlitzenPlatform::VfsMountPack(ce_defaultAssetPack);
+        LoadRenderingResourceSystem(pResources.Data());
+        LoadGeometryStressTest(pResources.Data(), ce_stressTestObjectCount);
+        GatherDynamicTransforms(pResources.Data());
+        if(pResources->bSpatialReorder)
+            ReorderSceneSpatially(pResources.Data());
+
+        CpuFrameContext frame;
+        double setupStart = BlitzenPlatform::PlatformGetAbsoluteTime();
+        CreateCpuFrame(pResources.Data(), frame);
+        BLIT_INFO("CPU frame of %u render objects created in %.2f ms", frame.scene.renderCount,
+        (BlitzenPlatform::PlatformGetAbsoluteTime() - setupStart) * 1000.0)
+
+        Camera camera;
+        SetupCamera(camera, BlitML::Radians(ce_initialFOV), static_cast<float>(ce_initialWindowWidth), 
+        static_cast<float>(ce_initialWindowHeight), ce_znear, BlitML::vec3(ce_initialCameraX, ce_initialCameraY, ce_initialCameraZ), 
+        ce_initialDrawDistance);
+
+        BlitCL::DynamicArray<uint32_t>& dynamicTransforms = pResources->dynamicTransforms;
+        BlitCL::DynamicArray<MeshTransform> startTransforms(dynamicTransforms.GetSize());
+        for(size_t i = 0; i < dynamicTransforms.GetSize(); ++i)
+            startTransforms[i] = pResources->transforms[dynamicTransforms[i]];
+
+        double totalTime = 0.0;
+        double worstTime = 0.0;
+        unsigned long long passDraws[ce_cpuFramePassCount] = {};
+        unsigned long long culledObjects = 0;
+        unsigned long long occluders = 0;
+        for(uint32_t f = 0; f < frameCount; ++f)
+        {
+            // The camera only turns, UpdateCamera rebuilds the view matrix from the new rotation
+            RotateCamera(camera, ce_cpuCullBenchmarkFrameTime, 0.f, ce_cpuCullBenchmarkYaw);
+            camera.transformData.cameraDirty = 1;
+            UpdateCamera(camera, ce_cpuCullBenchmarkFrameTime);
+
+            float time = f * ce_cpuCullBenchmarkFrameTime;
+            BlitML::quat spin = BlitML::QuatFromAngleAxis(BlitML::vec3(0.f, 1.f, 0.f), time * ce_cpuCullBenchmarkSpin, 0);
+            for(size_t i = 0; i < dynamicTransforms.GetSize(); ++i)
+            {
+                MeshTransform& transform = pResources->transforms[dynamicTransforms[i]];
+                transform.orientation = BlitML::MulitplyQuat(startTransforms[i].orientation, spin);
+                transform.pos = startTransforms[i].pos + BlitML::vec3(0.f, BlitML::Sin(time + float(i)) * ce_cpuCullBenchmarkBob, 0.f);
+            }
+            frame.bTransformsMoved = 1;
+
+            double frameStart = BlitzenPlatform::PlatformGetAbsoluteTime();
+            CpuDrawFrame(frame, camera.viewData);
+            double frameTime = BlitzenPlatform::PlatformGetAbsoluteTime() - frameStart;
+
+            totalTime += frameTime;
+            worstTime = frameTime > worstTime ? frameTime : worstTime;
+            for(uint8_t i = 0; i < ce_cpuFramePassCount; ++i)
+                passDraws[i] += frame.stats.passDraws[i];
+            culledObjects += frame.stats.culledObjects;
+            occluders += frame.stats.occluders;
+        }
+
+        if(frameCount == 0)
+            return;
+        BLIT_INFO("CPU culling of %u dynamic transforms over %u frames: %.3f ms on average, %.3f ms at worst", 
+        static_cast<uint32_t>(dynamicTransforms.GetSize()), frameCount, totalTime * 1000.0 / frameCount, worstTime * 1000.0)
+        BLIT_INFO("Draws per frame: initial pass %llu, late pass %llu, post pass %llu", 
+        passDraws[0] / frameCount, passDraws[1] / frameCount, passDraws[2] / frameCount)
+        BLIT_INFO("Objects in the frustum of the hierarchy per frame: %llu", culledObjects / frameCount)
+        BLIT_INFO("Occluders rasterized per frame: %llu", occluders / frameCount)
+    }
+
     // Everything besides the engine itself lives inside this scope
     void Engine::Run(uint32_t argc, char* argv[])
     {
@@ -43,6 +131,24 @@ namespace BlitzenEngine
         // Initialize logging
         BlitzenCore::InitLogging();
 
+        // Cooking mode: "BuildAssetPack <pack path> <files...>" writes the pack and exits without starting the renderer
+        if(argc > 3 && strcmp(argv[1], "BuildAssetPack") == 0)
+        {
+            BlitzenPlatform::BuildAssetPack(argv[2], argv + 3, argc - 3, 1);
+            BlitzenCore::ShutdownLogging();
+            s_pEngine = nullptr;
+            return;
+        }
+
+        // Benchmark mode: "CpuCullBenchmark [frames]" culls the stress test on the CPU and exits without starting the renderer
+        if(argc > 1 && strcmp(argv[1], "CpuCullBenchmark") == 0)
+        {
+            RunCpuCullBenchmark(argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : ce_cpuCullBenchmarkFrames);
+            BlitzenCore::ShutdownLogging();
+            s_pEngine = nullptr;
+            return;
+        }
+
         // Initialize the camera stystem
         BlitzenEngine::CameraSystem cameraSystem;
 
@@ -94,6 +200,10 @@ namespace BlitzenEngine
         // Allocated the rendering resources on the heap, it is too big for the stack of this function
         BlitCL::SmartPointer<BlitzenEngine::RenderingResources, BlitzenCore::AllocationType::Renderer> pResources;
 
+        // Packed assets take priority over loose files, so the pack needs to be mounted before anything is loaded
+        if(BlitzenPlatform::FilepathExists(ce_defaultAssetPack))
+            BlitzenPlatform::VfsMountPack(ce_defaultAssetPack);
+
         LoadRenderingResourceSystem(pResources.Data());
         
         // If the engine passes the above assertion, then it means that it can run the main loop (unless some less fundamental stuff makes it fail)
@@ -112,8 +222,7 @@ namespace BlitzenEngine
             // If the first command line argument is rendring stress test, the rendering stress test is loaded
             if(strcmp(argv[1], "RenderingStressTest") == 0)
             {
-                constexpr uint32_t ce_defaultObjectCount = 1'000'000;
-                LoadGeometryStressTest(pResources.Data(), ce_defaultObjectCount);
+                LoadGeometryStressTest(pResources.Data(), ce_stressTestObjectCount);
 
                 // The following arguments are used as gltf filepaths
                 for(uint32_t i = 2; i < argc; ++i)
@@ -131,6 +240,17 @@ namespace BlitzenEngine
             }
         }
 
+        // The transforms of game objects that can move are kept out of the baked bounds
+        GatherDynamicTransforms(pResources.Data());
+
+        // Everything has been loaded, so render objects and transforms can be put in spatial order
+        if(pResources->bSpatialReorder)
+            ReorderSceneSpatially(pResources.Data());
+
+        // Everything has been imported, so the report is complete
+        if(pResources->bImportReport)
+            WriteImportReport(pResources.Data(), ce_importReportPath);
+
         // Set the draw count to the render object count   
         uint32_t drawCount = pResources.Data()->renderObjectCount;
 
@@ -196,6 +316,8 @@ namespace BlitzenEngine
 
         renderer->Shutdown();
 
+        BlitzenPlatform::VfsUnmountAll();
+
         BlitzenCore::ShutdownLogging();
 
         BlitzenPlatform::PlatformShutdown();
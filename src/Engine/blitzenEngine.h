@@ -23,6 +23,9 @@ namespace BlitzenEngine
     constexpr const char* ce_blitzenVersion = "Blitzen Engine 0";
     constexpr uint32_t ce_blitzenMajor = 0;
 
+    // If this pack exists, it is mounted before any resources are loaded and its files are used instead of the loose ones
+    constexpr const char* ce_defaultAssetPack = "Assets/blitzen.bpk";
+
     // Honestly, this class does not need to exist, the only important thing it has is the Run function.
     // But it started off as the most important thing in the codebase and I don't really want to erase it
     class Engine
@@ -14,5 +14,8 @@ namespace BlitzenEngine
         // but including the file will cause circular dependency at the moment
         uint32_t transformIndex; // Index into the transform array in Engine resources,
         // used to access orientation, position and scale. But to also change them when necessary
+
+        // Objects that can move after the scene is loaded. GatherDynamicTransforms adds their transform to the dynamic ones of the renderer
+        uint8_t bDynamic = 0;
     };
 }
\ No newline at end of file
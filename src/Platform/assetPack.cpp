@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "assetPack.h"
+#include "Core/blitLogger.h"
+#include "Core/blitMemory.h"
+
+namespace BlitzenPlatform
+{
+    /*----------------------------------------------------------------------------
+        LZ4 block format codec. Small enough to live here instead of a dependency
+    -----------------------------------------------------------------------------*/
+
+    constexpr size_t ce_lzMinMatch = 4;
+    constexpr size_t ce_lzLastLiterals = 5;// The format requires the last 5 bytes to be literals
+    constexpr size_t ce_lzMatchFindLimit = 12;// and the last match to start at least 12 bytes before the end
+    constexpr size_t ce_lzMaxOffset = 65535;
+    constexpr uint32_t ce_lzHashBits = 16;
+
+    inline size_t LzCompressBound(size_t size)
+    {
+        return size + size / 255 + 16;
+    }
+
+    inline uint32_t LzRead32(const uint8_t* p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(uint32_t));
+        return value;
+    }
+
+    inline uint8_t* LzWriteLength(uint8_t* pOut, size_t length)
+    {
+        while(length >= 255)
+        {
+            *pOut++ = 255;
+            length -= 255;
+        }
+        *pOut++ = static_cast<uint8_t>(length);
+        return pOut;
+    }
+
+    // Greedy single pass compressor. Returns the compressed size, pDst needs LzCompressBound(size) bytes
+    static size_t LzCompress(const uint8_t* pSrc, size_t size, uint8_t* pDst, uint32_t* pHashTable)
+    {
+        // Positions are stored plus one, so that zero means empty
+        memset(pHashTable, 0, sizeof(uint32_t) << ce_lzHashBits);
+
+        uint8_t* pOut = pDst;
+        size_t anchor = 0;
+        size_t ip = 0;
+
+        if(size > ce_lzMatchFindLimit)
+        {
+            size_t matchLimit = size - ce_lzMatchFindLimit;
+            while(ip < matchLimit)
+            {
+                uint32_t sequence = LzRead32(pSrc + ip);
+                uint32_t hash = (sequence * 2654435761u) >> (32 - ce_lzHashBits);
+                size_t candidate = pHashTable[hash];
+                pHashTable[hash] = static_cast<uint32_t>(ip + 1);
+
+                if(!candidate || ip - (candidate - 1) > ce_lzMaxOffset || LzRead32(pSrc + candidate - 1) != sequence)
+                {
+                    ++ip;
+                    continue;
+                }
+
+                size_t reference = candidate - 1;
+                size_t matchLength = ce_lzMinMatch;
+                while(ip + matchLength < size - ce_lzLastLiterals && pSrc[reference + matchLength] == pSrc[ip + matchLength])
+                    ++matchLength;
+
+                // Token, literals, offset, then the rest of the match length
+                size_t literalLength = ip - anchor;
+                uint8_t* pToken = pOut++;
+                *pToken = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+                if(literalLength >= 15)
+                    pOut = LzWriteLength(pOut, literalLength - 15);
+                memcpy(pOut, pSrc + anchor, literalLength);
+                pOut += literalLength;
+
+                size_t offset = ip - reference;
+                *pOut++ = static_cast<uint8_t>(offset);
+                *pOut++ = static_cast<uint8_t>(offset >> 8);
+
+                size_t extraMatch = matchLength - ce_lzMinMatch;
+                *pToken |= static_cast<uint8_t>(extraMatch < 15 ? extraMatch : 15);
+                if(extraMatch >= 15)
+                    pOut = LzWriteLength(pOut, extraMatch - 15);
+
+                ip += matchLength;
+                anchor = ip;
+            }
+        }
+
+        // Whatever is left goes out as literals
+        size_t literalLength = size - anchor;
+        *pOut++ = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+        if(literalLength >= 15)
+            pOut = LzWriteLength(pOut, literalLength - 15);
+        memcpy(pOut, pSrc + anchor, literalLength);
+        pOut += literalLength;
+
+        return static_cast<size_t>(pOut - pDst);
+    }
+
+    // Returns 0 if the input is malformed or does not decompress to exactly dstSize bytes
+    static uint8_t LzDecompress(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstSize)
+    {
+        const uint8_t* ip = pSrc;
+        const uint8_t* pSrcEnd = pSrc + srcSize;
+        uint8_t* op = pDst;
+        uint8_t* pDstEnd = pDst + dstSize;
+
+        while(ip < pSrcEnd)
+        {
+            uint8_t token = *ip++;
+
+            size_t literalLength = token >> 4;
+            if(literalLength == 15)
+            {
+                uint8_t next;
+                do
+                {
+                    if(ip >= pSrcEnd)
+                        return 0;
+                    next = *ip++;
+                    literalLength += next;
+                } while(next == 255);
+            }
+
+            if(literalLength > size_t(pSrcEnd - ip) || literalLength > size_t(pDstEnd - op))
+                return 0;
+            memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            // The last sequence has no match
+            if(ip >= pSrcEnd)
+                break;
+
+            if(pSrcEnd - ip < 2)
+                return 0;
+            size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+            ip += 2;
+            if(offset == 0 || offset > size_t(op - pDst))
+                return 0;
+
+            size_t matchLength = (token & 15) + ce_lzMinMatch;
+            if((token & 15) == 15)
+            {
+                uint8_t next;
+                do
+                {
+                    if(ip >= pSrcEnd)
+                        return 0;
+                    next = *ip++;
+                    matchLength += next;
+                } while(next == 255);
+            }
+
+            if(matchLength > size_t(pDstEnd - op))
+                return 0;
+
+            // Matches can overlap the bytes they produce, so this has to go one byte at a time
+            const uint8_t* pMatch = op - offset;
+            for(size_t i = 0; i < matchLength; ++i)
+                op[i] = pMatch[i];
+            op += matchLength;
+        }
+
+        return op == pDstEnd;
+    }
+
+
+
+    /*--------------
+        Asset pack
+    ---------------*/
+
+    // Paths are compared after this, so that "./Assets\\a.dds" and "Assets/a.dds" are the same file
+    static const char* SkipCurrentDirectory(const char* path)
+    {
+        while(path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+            path += 2;
+        return path;
+    }
+
+    uint64_t HashAssetPath(const char* path)
+    {
+        path = SkipCurrentDirectory(path);
+
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for(; *path; ++path)
+        {
+            char c = *path == '\\' ? '/' : *path;
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static uint8_t AssetPathsEqual(const char* a, const char* b)
+    {
+        a = SkipCurrentDirectory(a);
+        b = SkipCurrentDirectory(b);
+        for(; *a && *b; ++a, ++b)
+        {
+            char ca = *a == '\\' ? '/' : *a;
+            char cb = *b == '\\' ? '/' : *b;
+            if(ca != cb)
+                return 0;
+        }
+        return *a == *b;
+    }
+
+    inline uint64_t AlignAssetPackOffset(uint64_t offset)
+    {
+        return (offset + ce_assetPackAlignment - 1) & ~(ce_assetPackAlignment - 1);
+    }
+
+    uint8_t AssetPack::Open(const char* path)
+    {
+        if(!PlatformMapFile(path, m_mapping))
+            return 0;
+
+        // Validate everything that will be read in place, a truncated pack should fail here and not during a lookup
+        const AssetPackHeader* pHeader = reinterpret_cast<const AssetPackHeader*>(m_mapping.pData);
+        uint8_t bValid = m_mapping.size >= sizeof(AssetPackHeader) && pHeader->magic == ce_assetPackMagic &&
+        pHeader->version == ce_assetPackVersion && pHeader->slotCount && !(pHeader->slotCount & (pHeader->slotCount - 1)) &&
+        pHeader->slotsOffset + uint64_t(pHeader->slotCount) * sizeof(uint32_t) <= m_mapping.size &&
+        pHeader->entriesOffset + uint64_t(pHeader->entryCount) * sizeof(AssetPackEntry) <= m_mapping.size &&
+        pHeader->pathsOffset + pHeader->pathsSize <= m_mapping.size && pHeader->pathsSize &&
+        m_mapping.pData[pHeader->pathsOffset + pHeader->pathsSize - 1] == 0;
+
+        if(bValid)
+        {
+            const AssetPackEntry* pEntries = reinterpret_cast<const AssetPackEntry*>(m_mapping.pData + pHeader->entriesOffset);
+            for(uint32_t i = 0; i < pHeader->entryCount && bValid; ++i)
+            {
+                bValid = pEntries[i].dataOffset + pEntries[i].storedSize <= m_mapping.size && pEntries[i].pathOffset < pHeader->pathsSize &&
+                (pEntries[i].compression == AssetPackCompression::None ? pEntries[i].storedSize == pEntries[i].size :
+                pEntries[i].compression == AssetPackCompression::Lz4Block);
+            }
+        }
+
+        if(!bValid)
+        {
+            BLIT_ERROR("File: '%s' is not a valid asset pack", path)
+            PlatformUnmapFile(m_mapping);
+            return 0;
+        }
+
+        m_pHeader = pHeader;
+        m_pSlots = reinterpret_cast<const uint32_t*>(m_mapping.pData + pHeader->slotsOffset);
+        m_pEntries = reinterpret_cast<const AssetPackEntry*>(m_mapping.pData + pHeader->entriesOffset);
+        m_pPaths = reinterpret_cast<const char*>(m_mapping.pData + pHeader->pathsOffset);
+
+        return 1;
+    }
+
+    void AssetPack::Close()
+    {
+        PlatformUnmapFile(m_mapping);
+        m_pHeader = nullptr;
+        m_pSlots = nullptr;
+        m_pEntries = nullptr;
+        m_pPaths = nullptr;
+    }
+
+    AssetPack::~AssetPack()
+    {
+        Close();
+    }
+
+    const AssetPackEntry* AssetPack::Find(const char* path)
+    {
+        if(!m_pHeader)
+            return nullptr;
+
+        uint64_t hash = HashAssetPath(path);
+        uint32_t mask = m_pHeader->slotCount - 1;
+
+        // Linear probing, an empty slot ends the search. The table is never full, the writer makes it at least twice the entry count
+        for(uint32_t slot = static_cast<uint32_t>(hash) & mask; m_pSlots[slot] != UINT32_MAX; slot = (slot + 1) & mask)
+        {
+            uint32_t entryIndex = m_pSlots[slot];
+            if(entryIndex >= m_pHeader->entryCount)
+                return nullptr;
+
+            const AssetPackEntry& entry = m_pEntries[entryIndex];
+            if(entry.pathHash == hash && AssetPathsEqual(m_pPaths + entry.pathOffset, path))
+                return &entry;
+        }
+
+        return nullptr;
+    }
+
+    uint8_t AssetPack::ReadEntry(const AssetPackEntry* pEntry, void* pDst)
+    {
+        const uint8_t* pStored = m_mapping.pData + pEntry->dataOffset;
+        if(pEntry->compression == AssetPackCompression::None)
+        {
+            memcpy(pDst, pStored, pEntry->size);
+            return 1;
+        }
+
+        if(!LzDecompress(pStored, pEntry->storedSize, reinterpret_cast<uint8_t*>(pDst), pEntry->size))
+        {
+            BLIT_ERROR("Asset pack entry: '%s' is corrupted", m_pPaths + pEntry->pathOffset)
+            return 0;
+        }
+        return 1;
+    }
+
+    // Writes zeros until the file position reaches offset
+    static uint8_t PadAssetPack(FileHandle& handle, uint64_t& position, uint64_t offset)
+    {
+        static const uint8_t zeros[256] = {};
+        while(position < offset)
+        {
+            size_t chunk = static_cast<size_t>(offset - position < sizeof(zeros) ? offset - position : sizeof(zeros));
+            size_t written = 0;
+            if(!FilesystemWrite(handle, chunk, zeros, &written))
+                return 0;
+            position += chunk;
+        }
+        return 1;
+    }
+
+    // Writes every file and then the directory to the open pack
+    static uint8_t WriteAssetPack(FileHandle& handle, const char* packPath, const char* const* ppFilepaths, size_t fileCount, uint8_t bCompress)
+    {
+        // The directory is written last, but its size is known now, so the data can start right after it
+        AssetPackHeader header{};
+        header.magic = ce_assetPackMagic;
+        header.version = ce_assetPackVersion;
+        header.entryCount = static_cast<uint32_t>(fileCount);
+        header.slotCount = 1;
+        while(header.slotCount < fileCount * 2)
+            header.slotCount *= 2;
+
+        header.slotsOffset = sizeof(AssetPackHeader);
+        header.entriesOffset = header.slotsOffset + uint64_t(header.slotCount) * sizeof(uint32_t);
+        header.pathsOffset = header.entriesOffset + uint64_t(fileCount) * sizeof(AssetPackEntry);
+        header.pathsSize = 0;
+        for(size_t i = 0; i < fileCount; ++i)
+            header.pathsSize += strlen(ppFilepaths[i]) + 1;
+        header.dataOffset = AlignAssetPackOffset(header.pathsOffset + header.pathsSize);
+
+        BlitCL::DynamicArray<AssetPackEntry> entries(fileCount);
+        BlitCL::DynamicArray<char> paths(static_cast<size_t>(header.pathsSize));
+        BlitCL::DynamicArray<uint32_t> slots(header.slotCount);
+        BlitzenCore::BlitMemSet(slots.Data(), 0xff, slots.GetSize() * sizeof(uint32_t));
+
+        // Leave room for the directory
+        uint64_t position = 0;
+        if(!PadAssetPack(handle, position, header.dataOffset))
+            return 0;
+
+        BlitCL::DynamicArray<uint32_t> hashTable(size_t(1) << ce_lzHashBits);
+        BlitCL::DynamicArray<uint8_t> compressed;
+
+        uint32_t pathOffset = 0;
+        for(size_t i = 0; i < fileCount; ++i)
+        {
+            const char* path = ppFilepaths[i];
+            AssetPackEntry& entry = entries[i];
+
+            entry.pathHash = HashAssetPath(path);
+            entry.pathOffset = pathOffset;
+            size_t pathLength = strlen(path) + 1;
+            memcpy(paths.Data() + pathOffset, path, pathLength);
+            pathOffset += static_cast<uint32_t>(pathLength);
+
+            // Insert in the directory, duplicate paths are an error since only one of them could ever be found
+            uint32_t slot = static_cast<uint32_t>(entry.pathHash) & (header.slotCount - 1);
+            while(slots[slot] != UINT32_MAX)
+            {
+                if(entries[slots[slot]].pathHash == entry.pathHash && AssetPathsEqual(paths.Data() + entries[slots[slot]].pathOffset, path))
+                {
+                    BLIT_ERROR("File: '%s' was given to asset pack: '%s' twice", path, packPath)
+                    return 0;
+                }
+                slot = (slot + 1) & (header.slotCount - 1);
+            }
+            slots[slot] = static_cast<uint32_t>(i);
+
+            // Every source is read front to back once, by the compressor or the write below
+            FileHandle source;
+            if(!source.OpenMapped(path, FileAccessHint::Sequential))
+            {
+                BLIT_ERROR("Asset pack: '%s' could not read file: '%s'", packPath, path)
+                return 0;
+            }
+
+            entry.size = source.GetMappedSize();
+            entry.compression = AssetPackCompression::None;
+            const uint8_t* pStored = source.GetMappedData();
+            entry.storedSize = source.GetMappedSize();
+
+            if(bCompress)
+            {
+                compressed.Resize(LzCompressBound(source.GetMappedSize()));
+                size_t compressedSize = LzCompress(source.GetMappedData(), source.GetMappedSize(), compressed.Data(), hashTable.Data());
+                if(compressedSize * 8 <= source.GetMappedSize() * ce_assetPackMinCompressionEighths)
+                {
+                    entry.compression = AssetPackCompression::Lz4Block;
+                    entry.storedSize = compressedSize;
+                    pStored = compressed.Data();
+                }
+            }
+
+            entry.dataOffset = AlignAssetPackOffset(position);
+            size_t written = 0;
+            uint8_t bWritten = PadAssetPack(handle, position, entry.dataOffset) &&
+            FilesystemWrite(handle, static_cast<size_t>(entry.storedSize), pStored, &written);
+            source.Close();
+            if(!bWritten)
+            {
+                BLIT_ERROR("Failed to write asset pack: '%s'", packPath)
+                return 0;
+            }
+            position += entry.storedSize;
+        }
+
+        // Go back and write the directory
+        FILE* pFile = reinterpret_cast<FILE*>(handle.pHandle);
+        size_t written = 0;
+        if(fseek(pFile, 0, SEEK_SET) != 0 ||
+        !FilesystemWrite(handle, sizeof(AssetPackHeader), &header, &written) ||
+        !FilesystemWrite(handle, slots.GetSize() * sizeof(uint32_t), slots.Data(), &written) ||
+        !FilesystemWrite(handle, entries.GetSize() * sizeof(AssetPackEntry), entries.Data(), &written) ||
+        !FilesystemWrite(handle, paths.GetSize(), paths.Data(), &written))
+        {
+            BLIT_ERROR("Failed to write the directory of asset pack: '%s'", packPath)
+            return 0;
+        }
+
+        return 1;
+    }
+
+    uint8_t BuildAssetPack(const char* packPath, const char* const* ppFilepaths, size_t fileCount, uint8_t bCompress)
+    {
+        if(!fileCount || fileCount >= UINT32_MAX / 2)
+        {
+            BLIT_ERROR("Asset pack: '%s' needs at least one file", packPath)
+            return 0;
+        }
+
+        FileHandle handle;
+        if(!handle.Open(packPath, FileModes::Write, 1))
+            return 0;
+
+        if(!WriteAssetPack(handle, packPath, ppFilepaths, fileCount, bCompress))
+        {
+            // The engine mounts the default pack whenever it exists, so a partial one is not left behind
+            handle.Close();
+            remove(packPath);
+            return 0;
+        }
+
+        BLIT_INFO("Asset pack: '%s' created with %i files", packPath, static_cast<int32_t>(fileCount))
+        return 1;
+    }
+
+
+
+    /*---------------------------
+        Virtual file system
+    ----------------------------*/
+
+    static AssetPack s_mountedPacks[ce_maxMountedAssetPacks];
+    static uint32_t s_mountedPackCount = 0;
+
+    uint8_t VfsMountPack(const char* packPath)
+    {
+        if(s_mountedPackCount >= ce_maxMountedAssetPacks)
+        {
+            BLIT_ERROR("Max asset pack count: ( %i ) reached, '%s' was not mounted", ce_maxMountedAssetPacks, packPath)
+            return 0;
+        }
+
+        if(!s_mountedPacks[s_mountedPackCount].Open(packPath))
+            return 0;
+
+        BLIT_INFO("Mounted asset pack: '%s'", packPath)
+        s_mountedPackCount++;
+        return 1;
+    }
+
+    void VfsUnmountAll()
+    {
+        for(uint32_t i = 0; i < s_mountedPackCount; ++i)
+            s_mountedPacks[i].Close();
+        s_mountedPackCount = 0;
+    }
+
+    // Latest mounted pack first
+    static const AssetPackEntry* VfsFindEntry(const char* path, AssetPack** ppPack)
+    {
+        for(uint32_t i = s_mountedPackCount; i > 0; --i)
+        {
+            if(const AssetPackEntry* pEntry = s_mountedPacks[i - 1].Find(path))
+            {
+                *ppPack = &s_mountedPacks[i - 1];
+                return pEntry;
+            }
+        }
+        return nullptr;
+    }
+
+    uint8_t VfsOpenFile(const char* path, VfsFile& file, FileAccessHint hint /*=FileAccessHint::Normal*/)
+    {
+        // If the file is in use, it asserts
+        BLIT_ASSERT(file.pData == nullptr)
+
+        AssetPack* pPack = nullptr;
+        const AssetPackEntry* pEntry = VfsFindEntry(path, &pPack);
+        if(!pEntry)
+        {
+            // Loose file fallback
+            if(!PlatformMapFile(path, file.mapping, hint))
+                return 0;
+            file.pData = file.mapping.pData;
+            file.size = file.mapping.size;
+            return 1;
+        }
+
+        file.size = static_cast<size_t>(pEntry->size);
+        if(pEntry->compression == AssetPackCompression::None)
+        {
+            pPack->Advise(pEntry, hint);
+            file.pData = pPack->GetStoredData(pEntry);
+            return 1;
+        }
+
+        // The decompressor reads the stored bytes front to back once, whatever the caller does with the output
+        pPack->Advise(pEntry, FileAccessHint::Sequential);
+
+        file.pDecompressed = BlitzenCore::BlitAlloc<uint8_t>(BlitzenCore::AllocationType::String, file.size);
+        if(!pPack->ReadEntry(pEntry, file.pDecompressed))
+        {
+            VfsCloseFile(file);
+            return 0;
+        }
+        file.pData = file.pDecompressed;
+        return 1;
+    }
+
+    void VfsCloseFile(VfsFile& file)
+    {
+        if(file.pDecompressed)
+            BlitzenCore::BlitFree<uint8_t>(BlitzenCore::AllocationType::String, file.pDecompressed, file.size);
+        PlatformUnmapFile(file.mapping);
+
+        file.pDecompressed = nullptr;
+        file.pData = nullptr;
+        file.size = 0;
+    }
+
+    uint8_t VfsIsPacked(const char* path)
+    {
+        AssetPack* pPack = nullptr;
+        return VfsFindEntry(path, &pPack) != nullptr;
+    }
+}
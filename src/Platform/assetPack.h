@@ -0,0 +1,135 @@
+#pragma once
+
+#include "filesystem.h"
+
+namespace BlitzenPlatform
+{
+    // Every pack starts with these 4 bytes ("BPAK")
+    constexpr uint32_t ce_assetPackMagic = 0x4b415042;
+    constexpr uint32_t ce_assetPackVersion = 1;
+
+    // Entry payloads start at page boundaries, so that they can be mapped, hinted and uploaded without touching their neighbours
+    constexpr uint64_t ce_assetPackAlignment = 4096;
+
+    // Compressed entries are only kept if they save at least this fraction of their size (in eighths)
+    constexpr uint64_t ce_assetPackMinCompressionEighths = 7;
+
+    constexpr uint32_t ce_maxMountedAssetPacks = 8;
+
+    enum class AssetPackCompression : uint32_t
+    {
+        None = 0,
+        // LZ4 block format, encoded and decoded by assetPack.cpp
+        Lz4Block = 1
+    };
+
+    // The pack file begins with this header. All offsets are from the start of the file
+    struct AssetPackHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+
+        uint32_t entryCount;
+
+        // The directory is an open addressing hash table of entry indices, the slot count is a power of 2
+        uint32_t slotCount;
+        uint64_t slotsOffset;
+
+        uint64_t entriesOffset;
+
+        // Null terminated paths of every entry, used to confirm hash table hits
+        uint64_t pathsOffset;
+        uint64_t pathsSize;
+
+        uint64_t dataOffset;
+    };
+
+    struct AssetPackEntry
+    {
+        uint64_t pathHash;
+
+        uint64_t dataOffset;
+        uint64_t storedSize;// Size inside the pack
+        uint64_t size;// Size after decompression
+
+        uint32_t pathOffset;// Into the path blob
+        AssetPackCompression compression;
+    };
+
+    static_assert(sizeof(AssetPackHeader) == 56, "The asset pack header is written to disk, its layout should not change");
+    static_assert(sizeof(AssetPackEntry) == 40, "Asset pack entries are written to disk, their layout should not change");
+
+    // A mounted pack. The whole file is mapped once and the directory is read in place
+    class AssetPack
+    {
+    public:
+        uint8_t Open(const char* path);
+
+        void Close();
+
+        // Returns null if the pack does not have a file with this path
+        const AssetPackEntry* Find(const char* path);
+
+        // Only valid for uncompressed entries, returns a pointer inside the mapping
+        inline const uint8_t* GetStoredData(const AssetPackEntry* pEntry) { return m_mapping.pData + pEntry->dataOffset; }
+
+        // Forwards an access hint for the stored range of the entry to the OS
+        inline void Advise(const AssetPackEntry* pEntry, FileAccessHint hint) 
+        { PlatformAdviseMapping(m_mapping, static_cast<size_t>(pEntry->dataOffset), static_cast<size_t>(pEntry->storedSize), hint); }
+
+        // Copies or decompresses the entry to pDst, which needs to have room for pEntry->size bytes
+        uint8_t ReadEntry(const AssetPackEntry* pEntry, void* pDst);
+
+        inline uint8_t IsOpen() { return m_mapping.pData != nullptr; }
+
+        ~AssetPack();
+
+    private:
+        MappedFile m_mapping;
+
+        const AssetPackHeader* m_pHeader = nullptr;
+        const uint32_t* m_pSlots = nullptr;
+        const AssetPackEntry* m_pEntries = nullptr;
+        const char* m_pPaths = nullptr;
+    };
+
+    // Hash of a path after it has been normalized (forward slashes, no leading "./"). Used by both the pack writer and the lookups
+    uint64_t HashAssetPath(const char* path);
+
+    // Cooks the files into a single pack. Paths are stored as they are given, so they should be the ones that the loaders will ask for.
+    // If bCompress is 1, each entry is compressed when it saves enough space
+    uint8_t BuildAssetPack(const char* packPath, const char* const* ppFilepaths, size_t fileCount, uint8_t bCompress);
+
+
+
+    /*
+        Virtual file system. Loaders open files through this, mounted packs are searched first and loose files are the fallback
+    */
+
+    // A read only view of a file, no matter where it came from
+    struct VfsFile
+    {
+        const uint8_t* pData = nullptr;
+        size_t size = 0;
+
+        // Loose files are mapped on their own, packed files that are not compressed point inside the pack mapping
+        MappedFile mapping;
+
+        // Compressed entries are decompressed into this allocation
+        uint8_t* pDecompressed = nullptr;
+    };
+
+    // Mounts a pack. Packs that are mounted later take priority over earlier ones
+    uint8_t VfsMountPack(const char* packPath);
+
+    void VfsUnmountAll();
+
+    // The hint is applied to the file's range, whether it is a loose file or a pack entry
+    uint8_t VfsOpenFile(const char* path, VfsFile& file, FileAccessHint hint = FileAccessHint::Normal);
+
+    // Safe to call on a file that failed to open or was already closed
+    void VfsCloseFile(VfsFile& file);
+
+    // Returns 1 if a mounted pack has the file. Loaders that read loose files on their own use VfsOpenFile for the rest
+    uint8_t VfsIsPacked(const char* path);
+}
@@ -0,0 +1,669 @@
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    // liburing is not a dependency, the ring is set up with the raw system calls
+    #if defined(__linux__) && __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+        #include <linux/io_uring.h>
+        #define BLIT_IO_URING
+    #endif
+#endif
+
+#include "asyncIO.h"
+#include "Core/blitLogger.h"
+#include "Core/blitMemory.h"
+
+namespace BlitzenPlatform
+{
+    uint8_t AsyncFile::Open(const char* path)
+    {
+        // If the handle is already in use, it asserts
+        BLIT_ASSERT(handle == -1)
+
+        #ifdef _WIN32
+            HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            LARGE_INTEGER fileSize;
+            if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+            {
+                BLIT_ERROR("Error opening file: '%s'", path);
+                if(file != INVALID_HANDLE_VALUE)
+                    CloseHandle(file);
+                return 0;
+            }
+            handle = reinterpret_cast<intptr_t>(file);
+            m_size = static_cast<uint64_t>(fileSize.QuadPart);
+        #else
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            struct stat fileStats;
+            if(fd == -1 || fstat(fd, &fileStats) != 0)
+            {
+                BLIT_ERROR("Error opening file: '%s'", path);
+                if(fd != -1)
+                    close(fd);
+                return 0;
+            }
+            handle = fd;
+            m_size = static_cast<uint64_t>(fileStats.st_size);
+        #endif
+
+        return 1;
+    }
+
+    void AsyncFile::Close()
+    {
+        if(handle == -1)
+            return;
+
+        #ifdef _WIN32
+            CloseHandle(reinterpret_cast<HANDLE>(handle));
+        #else
+            close(static_cast<int>(handle));
+        #endif
+
+        handle = -1;
+        m_size = 0;
+    }
+
+    AsyncFile::~AsyncFile()
+    {
+        Close();
+    }
+
+    // Blocking positioned read of the whole range, used by the thread pool workers
+    static uint8_t ReadAtOffset(intptr_t handle, uint64_t offset, uint8_t* pDst, size_t size, size_t& bytesRead)
+    {
+        bytesRead = 0;
+        while(bytesRead < size)
+        {
+            size_t chunk = size - bytesRead < ce_asyncIOMaxOperationSize ? size - bytesRead : ce_asyncIOMaxOperationSize;
+            uint64_t position = offset + bytesRead;
+
+            #ifdef _WIN32
+                // The offset in the overlapped struct makes this a positioned read, even though the handle is synchronous
+                OVERLAPPED overlapped{};
+                overlapped.Offset = static_cast<DWORD>(position);
+                overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+                DWORD read = 0;
+                if(!ReadFile(reinterpret_cast<HANDLE>(handle), pDst + bytesRead, static_cast<DWORD>(chunk), &read, &overlapped) || !read)
+                    return 0;
+            #else
+                ssize_t read = pread(static_cast<int>(handle), pDst + bytesRead, chunk, static_cast<off_t>(position));
+                if(read < 0 && errno == EINTR)
+                    continue;
+                // Zero means the file ended before the range did
+                if(read <= 0)
+                    return 0;
+            #endif
+
+            bytesRead += static_cast<size_t>(read);
+        }
+        return 1;
+    }
+
+
+
+    /*------------------------------
+        Queue state shared by both backends
+    -------------------------------*/
+
+    struct AsyncReadSlot
+    {
+        intptr_t handle;
+        uint64_t offset;
+        uint8_t* pDst;
+        size_t size;
+        size_t bytesRead;
+
+        AsyncReadCallback callback;
+        void* pUserData;
+
+        uint8_t bSuccess;
+    };
+
+    // Fixed capacity FIFO of slot indices. Every queue has room for every slot, so pushing never fails
+    struct AsyncSlotQueue
+    {
+        BlitCL::DynamicArray<uint32_t> indices;
+        uint32_t head = 0;
+        uint32_t count = 0;
+
+        inline void Init(uint32_t capacity) { indices.Resize(capacity); }
+
+        inline void Push(uint32_t slot)
+        {
+            indices[(head + count) % indices.GetSize()] = slot;
+            count++;
+        }
+
+        inline uint32_t Pop()
+        {
+            uint32_t slot = indices[head];
+            head = static_cast<uint32_t>((head + 1) % indices.GetSize());
+            count--;
+            return slot;
+        }
+    };
+
+    #ifdef BLIT_IO_URING
+        // The three shared memory regions of an io_uring instance
+        struct IoUring
+        {
+            int fd = -1;
+
+            uint32_t* pSqHead = nullptr;
+            uint32_t* pSqTail = nullptr;
+            uint32_t* pSqArray = nullptr;
+            uint32_t sqMask = 0;
+            io_uring_sqe* pSqes = nullptr;
+
+            uint32_t* pCqHead = nullptr;
+            uint32_t* pCqTail = nullptr;
+            uint32_t cqMask = 0;
+            io_uring_cqe* pCqes = nullptr;
+
+            void* pSqRing = nullptr;
+            size_t sqRingSize = 0;
+            void* pCqRing = nullptr;
+            size_t cqRingSize = 0;
+            size_t sqesSize = 0;
+
+            // Entries written to the submission ring that the kernel has not consumed yet
+            uint32_t unsubmitted = 0;
+        };
+    #endif
+
+    struct AsyncIOState
+    {
+        BlitCL::DynamicArray<AsyncReadSlot> slots;
+        BlitCL::DynamicArray<uint32_t> freeSlots;
+        uint32_t freeSlotCount = 0;
+
+        // Slots that are in use, from SubmitRead until their callback is called
+        uint32_t pendingCount = 0;
+
+        // Added by SubmitRead, handed to the backend by Submit
+        AsyncSlotQueue staged;
+
+        // Done and waiting for Poll to call the callback. Only touched by the thread that polls
+        AsyncSlotQueue finished;
+
+        uint8_t bIoUring = 0;
+
+        #ifdef BLIT_IO_URING
+            IoUring ring;
+        #endif
+
+        // Thread pool backend. The work and completed queues are guarded by the mutex
+        std::mutex mutex;
+        std::condition_variable workCondition;
+        std::condition_variable completionCondition;
+        AsyncSlotQueue work;
+        AsyncSlotQueue completed;
+        BlitCL::DynamicArray<std::thread> workers;
+        uint8_t bShutdown = 0;
+    };
+
+
+
+    /*------------------------
+        io_uring backend
+    -------------------------*/
+
+    #ifdef BLIT_IO_URING
+        static uint8_t IoUringInit(IoUring& ring, uint32_t entries)
+        {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if(fd < 0)
+                return 0;
+
+            // IORING_OP_READ came with 5.6, which is also the first kernel to report this feature
+            if(!(params.features & IORING_FEAT_RW_CUR_POS))
+            {
+                close(fd);
+                return 0;
+            }
+
+            ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+            ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            uint8_t bSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if(bSingleMap)
+            {
+                ring.sqRingSize = ring.sqRingSize > ring.cqRingSize ? ring.sqRingSize : ring.cqRingSize;
+                ring.cqRingSize = ring.sqRingSize;
+            }
+
+            ring.pSqRing = mmap(nullptr, ring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            ring.pCqRing = bSingleMap ? ring.pSqRing :
+            mmap(nullptr, ring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* pSqes = mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+            if(ring.pSqRing == MAP_FAILED || ring.pCqRing == MAP_FAILED || pSqes == MAP_FAILED)
+            {
+                if(pSqes != MAP_FAILED)
+                    munmap(pSqes, ring.sqesSize);
+                if(!bSingleMap && ring.pCqRing != MAP_FAILED)
+                    munmap(ring.pCqRing, ring.cqRingSize);
+                if(ring.pSqRing != MAP_FAILED)
+                    munmap(ring.pSqRing, ring.sqRingSize);
+                close(fd);
+                return 0;
+            }
+
+            uint8_t* pSq = reinterpret_cast<uint8_t*>(ring.pSqRing);
+            ring.pSqHead = reinterpret_cast<uint32_t*>(pSq + params.sq_off.head);
+            ring.pSqTail = reinterpret_cast<uint32_t*>(pSq + params.sq_off.tail);
+            ring.pSqArray = reinterpret_cast<uint32_t*>(pSq + params.sq_off.array);
+            ring.sqMask = *reinterpret_cast<uint32_t*>(pSq + params.sq_off.ring_mask);
+            ring.pSqes = reinterpret_cast<io_uring_sqe*>(pSqes);
+
+            uint8_t* pCq = reinterpret_cast<uint8_t*>(ring.pCqRing);
+            ring.pCqHead = reinterpret_cast<uint32_t*>(pCq + params.cq_off.head);
+            ring.pCqTail = reinterpret_cast<uint32_t*>(pCq + params.cq_off.tail);
+            ring.cqMask = *reinterpret_cast<uint32_t*>(pCq + params.cq_off.ring_mask);
+            ring.pCqes = reinterpret_cast<io_uring_cqe*>(pCq + params.cq_off.cqes);
+
+            ring.fd = fd;
+            return 1;
+        }
+
+        static void IoUringShutdown(IoUring& ring)
+        {
+            if(ring.fd == -1)
+                return;
+
+            munmap(ring.pSqes, ring.sqesSize);
+            if(ring.pCqRing != ring.pSqRing)
+                munmap(ring.pCqRing, ring.cqRingSize);
+            munmap(ring.pSqRing, ring.sqRingSize);
+            close(ring.fd);
+            ring.fd = -1;
+        }
+
+        static int32_t IoUringEnter(IoUring& ring, uint32_t toSubmit, uint32_t minComplete)
+        {
+            for(;;)
+            {
+                long result = syscall(__NR_io_uring_enter, ring.fd, toSubmit, minComplete,
+                minComplete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if(result >= 0 || errno != EINTR)
+                    return result >= 0 ? static_cast<int32_t>(result) : -errno;
+            }
+        }
+
+        // Writes the next operation of a slot to the submission ring. There are never more slots than ring entries, so there is always room
+        static void IoUringQueueRead(IoUring& ring, AsyncReadSlot& slot, uint32_t slotIndex)
+        {
+            uint32_t tail = *ring.pSqTail;
+            uint32_t index = tail & ring.sqMask;
+
+            size_t remaining = slot.size - slot.bytesRead;
+            io_uring_sqe& sqe = ring.pSqes[index];
+            memset(&sqe, 0, sizeof(io_uring_sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = static_cast<int32_t>(slot.handle);
+            sqe.off = slot.offset + slot.bytesRead;
+            sqe.addr = reinterpret_cast<uint64_t>(slot.pDst + slot.bytesRead);
+            sqe.len = static_cast<uint32_t>(remaining < ce_asyncIOMaxOperationSize ? remaining : ce_asyncIOMaxOperationSize);
+            sqe.user_data = slotIndex;
+
+            ring.pSqArray[index] = index;
+
+            // The kernel must see the entry before the new tail
+            __atomic_store_n(ring.pSqTail, tail + 1, __ATOMIC_RELEASE);
+            ring.unsubmitted++;
+        }
+
+        static void IoUringSubmit(AsyncIOState& state, uint32_t minComplete)
+        {
+            IoUring& ring = state.ring;
+            if(!ring.unsubmitted && !minComplete)
+                return;
+
+            int32_t result = IoUringEnter(ring, ring.unsubmitted, minComplete);
+            if(result >= 0)
+                ring.unsubmitted -= static_cast<uint32_t>(result) < ring.unsubmitted ? static_cast<uint32_t>(result) : ring.unsubmitted;
+            // Busy means that the completion ring needs to be drained first, the entries stay queued until the next call
+            else if(result != -EBUSY && result != -EAGAIN)
+            {
+                BLIT_ERROR("io_uring_enter failed with error: %i", -result)
+
+                // The kernel only reads the submission ring inside io_uring_enter, so the entries it did not take can be removed.
+                // Their reads fail, otherwise they would stay pending forever
+                uint32_t tail = *ring.pSqTail;
+                uint32_t firstUnsubmitted = tail - ring.unsubmitted;
+                for(uint32_t i = firstUnsubmitted; i != tail; ++i)
+                {
+                    uint32_t slotIndex = static_cast<uint32_t>(ring.pSqes[ring.pSqArray[i & ring.sqMask]].user_data);
+                    state.slots[slotIndex].bSuccess = 0;
+                    state.finished.Push(slotIndex);
+                }
+                __atomic_store_n(ring.pSqTail, firstUnsubmitted, __ATOMIC_RELEASE);
+                ring.unsubmitted = 0;
+            }
+        }
+
+        // Moves finished reads to the finished queue and resubmits the ones that were cut short
+        static void IoUringReap(AsyncIOState& state, uint8_t bWait)
+        {
+            IoUring& ring = state.ring;
+
+            uint32_t head = *ring.pCqHead;
+            if(bWait && head == __atomic_load_n(ring.pCqTail, __ATOMIC_ACQUIRE))
+                IoUringSubmit(state, 1);
+
+            uint32_t tail = __atomic_load_n(ring.pCqTail, __ATOMIC_ACQUIRE);
+            for(; head != tail; ++head)
+            {
+                io_uring_cqe& cqe = ring.pCqes[head & ring.cqMask];
+                uint32_t slotIndex = static_cast<uint32_t>(cqe.user_data);
+                AsyncReadSlot& slot = state.slots[slotIndex];
+
+                if(cqe.res == -EINTR || cqe.res == -EAGAIN)
+                {
+                    IoUringQueueRead(ring, slot, slotIndex);
+                    continue;
+                }
+
+                // Errors and reads past the end of the file fail the whole request
+                if(cqe.res <= 0)
+                {
+                    slot.bSuccess = 0;
+                    state.finished.Push(slotIndex);
+                    continue;
+                }
+
+                slot.bytesRead += static_cast<size_t>(cqe.res);
+                if(slot.bytesRead < slot.size)
+                {
+                    IoUringQueueRead(ring, slot, slotIndex);
+                    continue;
+                }
+
+                slot.bSuccess = 1;
+                state.finished.Push(slotIndex);
+            }
+            __atomic_store_n(ring.pCqHead, head, __ATOMIC_RELEASE);
+
+            // Partial reads that were queued above
+            IoUringSubmit(state, 0);
+        }
+    #endif
+
+
+
+    /*----------------------------
+        Thread pool backend
+    -----------------------------*/
+
+    static void AsyncIOWorker(AsyncIOState* pState)
+    {
+        AsyncIOState& state = *pState;
+        for(;;)
+        {
+            uint32_t slotIndex;
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.workCondition.wait(lock, [&state]() { return state.bShutdown || state.work.count; });
+                if(!state.work.count)
+                    return;
+                slotIndex = state.work.Pop();
+            }
+
+            AsyncReadSlot& slot = state.slots[slotIndex];
+            slot.bSuccess = ReadAtOffset(slot.handle, slot.offset, slot.pDst, slot.size, slot.bytesRead);
+
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                state.completed.Push(slotIndex);
+            }
+            state.completionCondition.notify_one();
+        }
+    }
+
+
+
+    /*------------------
+        AsyncIOQueue
+    -------------------*/
+
+    uint8_t AsyncIOQueue::Init(uint32_t queueDepth)
+    {
+        // If the queue is already initialized, it asserts
+        BLIT_ASSERT(m_pState == nullptr)
+        BLIT_ASSERT(queueDepth)
+
+        m_pState = BlitzenCore::BlitConstructAlloc<AsyncIOState>(BlitzenCore::AllocationType::Engine);
+        AsyncIOState& state = *m_pState;
+
+        state.slots.Resize(queueDepth);
+        state.freeSlots.Resize(queueDepth);
+        for(uint32_t i = 0; i < queueDepth; ++i)
+            state.freeSlots[i] = queueDepth - 1 - i;
+        state.freeSlotCount = queueDepth;
+
+        state.staged.Init(queueDepth);
+        state.finished.Init(queueDepth);
+        state.work.Init(queueDepth);
+        state.completed.Init(queueDepth);
+
+        #ifdef BLIT_IO_URING
+            if(IoUringInit(state.ring, queueDepth))
+            {
+                state.bIoUring = 1;
+                BLIT_INFO("Asynchronous file reads will use io_uring, queue depth: %i", queueDepth)
+                return 1;
+            }
+        #endif
+
+        uint32_t threadCount = queueDepth < ce_asyncIOFallbackThreadCount ? queueDepth : ce_asyncIOFallbackThreadCount;
+        state.workers.Resize(threadCount);
+        for(uint32_t i = 0; i < threadCount; ++i)
+            state.workers[i] = std::thread(AsyncIOWorker, m_pState);
+
+        BLIT_INFO("Asynchronous file reads will use %i worker threads", threadCount)
+        return 1;
+    }
+
+    void AsyncIOQueue::Shutdown()
+    {
+        if(!m_pState)
+            return;
+
+        WaitIdle();
+
+        AsyncIOState& state = *m_pState;
+        #ifdef BLIT_IO_URING
+            IoUringShutdown(state.ring);
+        #endif
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.bShutdown = 1;
+        }
+        state.workCondition.notify_all();
+        for(size_t i = 0; i < state.workers.GetSize(); ++i)
+        {
+            if(state.workers[i].joinable())
+                state.workers[i].join();
+        }
+
+        BlitzenCore::BlitDestroyAlloc(BlitzenCore::AllocationType::Engine, m_pState);
+        m_pState = nullptr;
+    }
+
+    AsyncIOQueue::~AsyncIOQueue()
+    {
+        Shutdown();
+    }
+
+    uint8_t AsyncIOQueue::SubmitRead(AsyncFile& file, uint64_t offset, size_t size, void* pDst, AsyncReadCallback callback, void* pUserData)
+    {
+        BLIT_ASSERT(m_pState)
+        AsyncIOState& state = *m_pState;
+
+        if(!file.IsOpen() || !pDst || !size || offset > file.GetSize() || size > file.GetSize() - offset)
+        {
+            BLIT_ERROR("Invalid asynchronous read, offset: %llu, size: %llu",
+            static_cast<unsigned long long>(offset), static_cast<unsigned long long>(size))
+            return 0;
+        }
+
+        // Full, the caller should poll first
+        if(!state.freeSlotCount)
+            return 0;
+
+        uint32_t slotIndex = state.freeSlots[--state.freeSlotCount];
+        AsyncReadSlot& slot = state.slots[slotIndex];
+        slot.handle = file.handle;
+        slot.offset = offset;
+        slot.pDst = reinterpret_cast<uint8_t*>(pDst);
+        slot.size = size;
+        slot.bytesRead = 0;
+        slot.callback = callback;
+        slot.pUserData = pUserData;
+        slot.bSuccess = 0;
+
+        state.staged.Push(slotIndex);
+        state.pendingCount++;
+        return 1;
+    }
+
+    void AsyncIOQueue::Submit()
+    {
+        BLIT_ASSERT(m_pState)
+        AsyncIOState& state = *m_pState;
+
+        #ifdef BLIT_IO_URING
+            if(state.bIoUring)
+            {
+                while(state.staged.count)
+                {
+                    uint32_t slotIndex = state.staged.Pop();
+                    IoUringQueueRead(state.ring, state.slots[slotIndex], slotIndex);
+                }
+                IoUringSubmit(state, 0);
+                return;
+            }
+        #endif
+
+        if(!state.staged.count)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            while(state.staged.count)
+                state.work.Push(state.staged.Pop());
+        }
+        state.workCondition.notify_all();
+    }
+
+    uint32_t AsyncIOQueue::Poll(uint8_t bWait)
+    {
+        BLIT_ASSERT(m_pState)
+        AsyncIOState& state = *m_pState;
+
+        // Waiting for reads that were never submitted would never return
+        if(state.staged.count)
+            Submit();
+
+        // Reads that already failed are in the finished queue, waiting for the kernel would not return when they are the only ones left
+        bWait = bWait && state.pendingCount > state.finished.count;
+
+        #ifdef BLIT_IO_URING
+            if(state.bIoUring)
+                IoUringReap(state, bWait);
+        #endif
+
+        if(!state.bIoUring)
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            if(bWait)
+                state.completionCondition.wait(lock, [&state]() { return state.completed.count != 0; });
+            while(state.completed.count)
+                state.finished.Push(state.completed.Pop());
+        }
+
+        // The slot is released before its callback, so that callbacks can queue more reads
+        uint32_t completedCount = 0;
+        while(state.finished.count)
+        {
+            uint32_t slotIndex = state.finished.Pop();
+            AsyncReadSlot slot = state.slots[slotIndex];
+            state.freeSlots[state.freeSlotCount++] = slotIndex;
+            state.pendingCount--;
+            completedCount++;
+
+            if(slot.callback)
+                slot.callback(slot.pUserData, slot.bSuccess, slot.bSuccess ? slot.size : slot.bytesRead);
+        }
+
+        return completedCount;
+    }
+
+    void AsyncIOQueue::WaitIdle()
+    {
+        if(!m_pState)
+            return;
+
+        while(m_pState->pendingCount)
+            Poll(1);
+    }
+
+    uint32_t AsyncIOQueue::GetPendingCount() const
+    {
+        return m_pState ? m_pState->pendingCount : 0;
+    }
+
+    uint8_t AsyncIOQueue::IsUsingIoUring() const
+    {
+        return m_pState ? m_pState->bIoUring : 0;
+    }
+
+    static void AsyncRangeChunkDone(void* pUserData, uint8_t bSuccess, size_t bytesRead)
+    {
+        if(!bSuccess)
+            (*static_cast<uint32_t*>(pUserData))++;
+    }
+
+    uint8_t AsyncReadRange(AsyncIOQueue& queue, AsyncFile& file, uint64_t offset, size_t size, void* pDst, size_t chunkSize)
+    {
+        BLIT_ASSERT(chunkSize)
+
+        // Checked once here, so that SubmitRead only fails when the queue is full
+        if(!file.IsOpen() || !pDst || offset > file.GetSize() || size > file.GetSize() - offset)
+        {
+            BLIT_ERROR("Invalid asynchronous range read, offset: %llu, size: %llu",
+            static_cast<unsigned long long>(offset), static_cast<unsigned long long>(size))
+            return 0;
+        }
+
+        uint32_t failedCount = 0;
+        uint8_t* pBytes = reinterpret_cast<uint8_t*>(pDst);
+        size_t queued = 0;
+        while(queued < size)
+        {
+            size_t chunk = size - queued < chunkSize ? size - queued : chunkSize;
+            if(queue.SubmitRead(file, offset + queued, chunk, pBytes + queued, AsyncRangeChunkDone, &failedCount))
+                queued += chunk;
+            // Full, the reads that finish make room for the rest
+            else
+                queue.Poll(1);
+        }
+        queue.WaitIdle();
+
+        return failedCount == 0;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "filesystem.h"
+
+namespace BlitzenPlatform
+{
+    // How many reads can be in flight at once. NVMe drives need deep queues to reach their bandwidth
+    constexpr uint32_t ce_asyncIODefaultQueueDepth = 128;
+
+    // Worker count of the fallback backend, used when io_uring is not available (older kernels, containers, Windows)
+    constexpr uint32_t ce_asyncIOFallbackThreadCount = 4;
+
+    // Reads bigger than this are split into multiple operations, since both io_uring and pread take 32bit lengths
+    constexpr size_t ce_asyncIOMaxOperationSize = size_t(1) << 30;
+
+    // Reads of AsyncReadRange are split to this size, so that a single file keeps many of them in flight
+    constexpr size_t ce_asyncIORangeChunkSize = size_t(1) << 20;
+
+    // A file opened for positioned reads. Unlike FileHandle, it has no stream position, so any number of reads can use it at once
+    class AsyncFile
+    {
+    public:
+        uint8_t Open(const char* path);
+
+        void Close();
+
+        inline uint64_t GetSize() const { return m_size; }
+
+        inline uint8_t IsOpen() const { return handle != -1; }
+
+        ~AsyncFile();
+
+    public:
+        // File descriptor on linux, HANDLE on Windows. -1 is invalid for both
+        intptr_t handle = -1;
+
+    private:
+        uint64_t m_size = 0;
+    };
+
+    // Called by AsyncIOQueue::Poll, on the thread that polls. bytesRead equals the requested size on success
+    using AsyncReadCallback = void (*)(void* pUserData, uint8_t bSuccess, size_t bytesRead);
+
+    // Defined in asyncIO.cpp, holds either the io_uring or the thread pool backend
+    struct AsyncIOState;
+
+    // Queue of asynchronous file reads.
+    // Reads are added with SubmitRead and handed to the backend in a batch by Submit.
+    // Completed reads call their callback from inside Poll.
+    // Data goes straight into the buffer given by the caller (e.g. mapped staging memory), so there is no intermediate copy
+    class AsyncIOQueue
+    {
+    public:
+        // Tries io_uring first and falls back to the thread pool
+        uint8_t Init(uint32_t queueDepth = ce_asyncIODefaultQueueDepth);
+
+        // Waits for all reads in flight and releases the backend
+        void Shutdown();
+
+        // Queues a read of size bytes at offset into pDst. pDst and the file need to stay valid until the callback is called.
+        // Returns 0 if the queue is full, in which case the caller should Poll and try again
+        uint8_t SubmitRead(AsyncFile& file, uint64_t offset, size_t size, void* pDst, AsyncReadCallback callback, void* pUserData);
+
+        // Hands every read queued since the last call to the backend, with one system call for io_uring
+        void Submit();
+
+        // Calls the callbacks of all finished reads and returns their count.
+        // If bWait is 1 and there are reads in flight, it blocks until at least one finishes
+        uint32_t Poll(uint8_t bWait);
+
+        // Submits and polls until nothing is in flight
+        void WaitIdle();
+
+        // Reads that were queued but have not had their callback called yet
+        uint32_t GetPendingCount() const;
+
+        uint8_t IsUsingIoUring() const;
+
+        ~AsyncIOQueue();
+
+    private:
+        AsyncIOState* m_pState = nullptr;
+    };
+
+    // Reads size bytes at offset into pDst as reads of chunkSize bytes, queueing as many as the queue holds at once,
+    // and returns when all of them are done, along with anything else that was in flight. Returns 0 if any of them failed
+    uint8_t AsyncReadRange(AsyncIOQueue& queue, AsyncFile& file, uint64_t offset, size_t size, void* pDst,
+    size_t chunkSize = ce_asyncIORangeChunkSize);
+}
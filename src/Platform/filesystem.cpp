@@ -3,6 +3,15 @@
 #include <string.h>
 #include <sys/stat.h>
 
+// File mapping is the one part of the filesystem that cannot go through stdio
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
 #include "Core/blitLogger.h"
 #include "filesystem.h"
 #include "Core/blitMemory.h"
@@ -77,6 +86,14 @@ namespace BlitzenPlatform
         return 1;
     }
 
+    uint8_t FileHandle::OpenMapped(const char* path, FileAccessHint hint /*=FileAccessHint::Sequential*/)
+    {
+        // If the handle already has a stream or a mapping, it asserts
+        BLIT_ASSERT(pHandle == nullptr && mapping.pData == nullptr)
+
+        return PlatformMapFile(path, mapping, hint);
+    }
+
     FileHandle::~FileHandle()
     {
         Close();
@@ -89,6 +106,8 @@ namespace BlitzenPlatform
             fclose(reinterpret_cast<FILE*>(pHandle));
             pHandle = nullptr;
         }
+
+        PlatformUnmapFile(mapping);
     }
 
     uint8_t FilesystemReadLine(FileHandle& handle, size_t maxLength, char** lineBuffer, size_t* pLength)
@@ -162,10 +181,13 @@ namespace BlitzenPlatform
             uint64_t size = ftell(reinterpret_cast<FILE*>(handle.pHandle));
             
             rewind(reinterpret_cast<FILE*>(handle.pHandle));
-            *pBytesRead = reinterpret_cast<uint8_t*>(BlitzenCore::BlitAllocLinear(BlitzenCore::AllocationType::String, sizeof(char) * size));
+            // This used to come from the linear allocator, which is never freed, so every call leaked the whole file
+            *pBytesRead = BlitzenCore::BlitAlloc<uint8_t>(BlitzenCore::AllocationType::String, size);
             *byteCount = fread(*pBytesRead, 1, size, reinterpret_cast<FILE*>(handle.pHandle));
             if (*byteCount != size) 
             {
+                BlitzenCore::BlitFree<uint8_t>(BlitzenCore::AllocationType::String, *pBytesRead, size);
+                *pBytesRead = nullptr;
                 return 0;
             }
             return 1;
@@ -193,4 +215,131 @@ namespace BlitzenPlatform
         }
         return 0;
     }
+
+    uint8_t PlatformMapFile(const char* path, MappedFile& mapping, FileAccessHint hint /*=FileAccessHint::Normal*/)
+    {
+        // If the mapping is already in use, it asserts
+        BLIT_ASSERT(mapping.pData == nullptr)
+
+        #ifdef _WIN32
+            // The cache manager only takes the access pattern when the file is opened
+            DWORD flags = hint == FileAccessHint::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN :
+            hint == FileAccessHint::Random ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+            HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+            if(file == INVALID_HANDLE_VALUE)
+            {
+                BLIT_ERROR("Error opening file for mapping: '%s'", path);
+                return 0;
+            }
+
+            LARGE_INTEGER fileSize;
+            if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            {
+                // Empty files cannot be mapped
+                BLIT_ERROR("File: '%s' is empty or its size could not be queried", path);
+                CloseHandle(file);
+                return 0;
+            }
+
+            HANDLE mappingObject = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if(!mappingObject)
+            {
+                BLIT_ERROR("Failed to create file mapping for: '%s'", path);
+                CloseHandle(file);
+                return 0;
+            }
+
+            void* pView = MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0);
+            if(!pView)
+            {
+                BLIT_ERROR("Failed to map view of file: '%s'", path);
+                CloseHandle(mappingObject);
+                CloseHandle(file);
+                return 0;
+            }
+
+            mapping.pData = reinterpret_cast<const uint8_t*>(pView);
+            mapping.size = static_cast<size_t>(fileSize.QuadPart);
+            mapping.pFileHandle = file;
+            mapping.pMappingHandle = mappingObject;
+            if(hint == FileAccessHint::WillNeed)
+                PlatformAdviseMapping(mapping, 0, mapping.size, hint);
+            return 1;
+        #else
+            int fd = open(path, O_RDONLY);
+            if(fd == -1)
+            {
+                BLIT_ERROR("Error opening file for mapping: '%s'", path);
+                return 0;
+            }
+
+            struct stat fileStats;
+            if(fstat(fd, &fileStats) != 0 || fileStats.st_size == 0)
+            {
+                // mmap fails on empty files, so the caller gets an error instead
+                BLIT_ERROR("File: '%s' is empty or its size could not be queried", path);
+                close(fd);
+                return 0;
+            }
+
+            void* pView = mmap(nullptr, static_cast<size_t>(fileStats.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            // The mapping keeps its own reference to the file, so the descriptor is not needed anymore
+            close(fd);
+            if(pView == MAP_FAILED)
+            {
+                BLIT_ERROR("Failed to map file: '%s'", path);
+                return 0;
+            }
+
+            mapping.pData = reinterpret_cast<const uint8_t*>(pView);
+            mapping.size = static_cast<size_t>(fileStats.st_size);
+            PlatformAdviseMapping(mapping, 0, mapping.size, hint);
+            return 1;
+        #endif
+    }
+
+    void PlatformAdviseMapping(const MappedFile& mapping, size_t offset, size_t size, FileAccessHint hint)
+    {
+        if(!mapping.pData || offset >= mapping.size)
+            return;
+        size = size < mapping.size - offset ? size : mapping.size - offset;
+
+        #ifdef _WIN32
+            // Windows only has an equivalent for WillNeed, the other hints are given to CreateFileA when the file is mapped
+            if(hint == FileAccessHint::WillNeed)
+            {
+                WIN32_MEMORY_RANGE_ENTRY range;
+                range.VirtualAddress = const_cast<uint8_t*>(mapping.pData + offset);
+                range.NumberOfBytes = size;
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+            }
+        #else
+            // madvise needs a page aligned address, the range is grown to cover the whole first page
+            static const size_t s_pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t alignedOffset = offset & ~(s_pageSize - 1);
+
+            int advice = hint == FileAccessHint::Sequential ? MADV_SEQUENTIAL : hint == FileAccessHint::WillNeed ? MADV_WILLNEED :
+            hint == FileAccessHint::Random ? MADV_RANDOM : MADV_NORMAL;
+            madvise(const_cast<uint8_t*>(mapping.pData + alignedOffset), size + offset - alignedOffset, advice);
+        #endif
+    }
+
+    void PlatformUnmapFile(MappedFile& mapping)
+    {
+        if(!mapping.pData)
+            return;
+
+        #ifdef _WIN32
+            UnmapViewOfFile(mapping.pData);
+            CloseHandle(reinterpret_cast<HANDLE>(mapping.pMappingHandle));
+            CloseHandle(reinterpret_cast<HANDLE>(mapping.pFileHandle));
+        #else
+            munmap(const_cast<uint8_t*>(mapping.pData), mapping.size);
+        #endif
+
+        mapping.pData = nullptr;
+        mapping.size = 0;
+        mapping.pFileHandle = nullptr;
+        mapping.pMappingHandle = nullptr;
+    }
 }
\ No newline at end of file
@@ -10,6 +10,30 @@ namespace BlitzenPlatform
         Write = 0x2
     };
 
+    // Tells the OS how a mapped file is about to be read, so that it can prefetch or drop pages accordingly
+    enum class FileAccessHint : uint8_t
+    {
+        Normal = 0,
+        // Read front to back once (e.g. text parsing, texture payloads)
+        Sequential = 1,
+        // The whole range will be needed soon, start paging it in now
+        WillNeed = 2,
+        // Scattered reads, readahead would be wasted
+        Random = 3
+    };
+
+    // A read only view of an entire file, mapped into the address space of the process.
+    // Loaders can read from pData directly instead of copying the file into a heap buffer first
+    struct MappedFile
+    {
+        const uint8_t* pData = nullptr;
+        size_t size = 0;
+
+        // The file and mapping object handles are only needed on Windows, on linux the descriptor is closed right after mmap
+        void* pFileHandle = nullptr;
+        void* pMappingHandle = nullptr;
+    };
+
     class FileHandle
     {
     public:
@@ -17,12 +41,20 @@ namespace BlitzenPlatform
 
         uint8_t Open(const char* path, const char* mode);
 
+        // Maps the file instead of opening a stream. The view is released by Close or the destructor
+        uint8_t OpenMapped(const char* path, FileAccessHint hint = FileAccessHint::Sequential);
+
+        inline const uint8_t* GetMappedData() const { return mapping.pData; }
+        inline size_t GetMappedSize() const { return mapping.size; }
+
         // Close the file manually
         void Close();
 
         ~FileHandle();
     public:
         void* pHandle = nullptr;
+
+        MappedFile mapping;
     };
 
     // Determines if filepath exists
@@ -36,10 +68,22 @@ namespace BlitzenPlatform
     uint8_t FilesystemRead(FileHandle& handle, size_t size, void* pDataRead, size_t* bytesRead);
     uint8_t FilesystemWrite(FileHandle& handle, size_t size, const void* pData, size_t* bitesWritten);
 
-    // Takes a file handle and reads its content in byte form into a uint8_t buffer and its size into a byte count buffer
+    // Takes a file handle and reads its content in byte form into a uint8_t buffer and its size into a byte count buffer.
+    // The buffer is allocated as AllocationType::String and the caller frees it with BlitFree once it is done
     uint8_t FilesystemReadAllBytes(FileHandle& handle, uint8_t** pBytesRead, size_t* byteCount);
 
-    // Does the same as the above but takes uses a (terrible)RAII wrapper instead of the linear allocator, so it should be prefered
+    // Does the same as the above but uses a (terrible)RAII wrapper, so nothing needs to be freed by hand and it should be prefered
     uint8_t FilesystemReadAllBytes(FileHandle& handle, BlitCL::StoragePointer<uint8_t, BlitzenCore::AllocationType::String>& bytes, 
     size_t* byteCount);
+
+
+
+    // Maps the whole file at path with read only access. Returns 0 if the file could not be opened or mapped
+    uint8_t PlatformMapFile(const char* path, MappedFile& mapping, FileAccessHint hint = FileAccessHint::Normal);
+
+    // Hints the OS about how part of a mapping is about to be read (madvise on linux, prefetching on Windows)
+    void PlatformAdviseMapping(const MappedFile& mapping, size_t offset, size_t size, FileAccessHint hint);
+
+    // Releases a view created by PlatformMapFile. Safe to call on a mapping that failed or was already released
+    void PlatformUnmapFile(MappedFile& mapping);
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "blitRenderingResources.h"
+
+namespace BlitzenEngine
+{
+    // Surfaces with fewer triangles only use the discrete lods of PrimitiveSurface::meshLod
+    constexpr size_t ce_clusterLodMinTriangles = 32'768;
+
+    // Amount of clusters that are merged and simplified together. Their result is split to about half as many clusters
+    constexpr size_t ce_clusterLodGroupSize = 4;
+
+    // A group whose simplification keeps more than this fraction of its triangles is not simplified further
+    constexpr float ce_clusterLodMinReduction = 0.85f;
+
+    // Builds the cluster lod hierarchy (DAG) of a surface and sets its firstLodCluster and lodClusterCount.
+    // The surface is split into clusters, then groups of neighbouring clusters are merged, simplified with their borders locked
+    // and split into new clusters, until a level cannot be simplified further. Locked borders keep neighbouring groups crack free
+    // no matter which of their levels is drawn. The clusters are appended to the meshlet and lodCluster arrays of the resources
+    void BuildClusterLod(RenderingResources* pResources, BlitCL::DynamicArray<Vertex>& vertices, 
+    BlitCL::DynamicArray<uint32_t>& indices, PrimitiveSurface& surface);
+}
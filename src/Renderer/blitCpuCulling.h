@@ -0,0 +1,101 @@
+#pragma once
+
+#include "blitSurfaceCullData.h"
+#include "Game/blitCamera.h"
+#include "blitSoftwareOcclusion.h"
+
+namespace BlitzenEngine
+{
+    // Same layout as IndirectDrawData (vulkanData.h) and IndirectDraw in ShaderBuffers.glsl, so the commands can be uploaded as they are
+    struct CpuDrawCommand
+    {
+        uint32_t objectId;
+
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        uint32_t vertexOffset;
+        uint32_t firstInstance;
+    };
+
+    static_assert(sizeof(CpuDrawCommand) == 24, "CpuDrawCommand layout should match the shaders");
+
+    // Same layout as the indirect count buffer of the culling shaders
+    struct CpuDrawCounts
+    {
+        uint32_t drawCount;
+        uint32_t drawCount16;
+    };
+
+    // What the culling shaders read from the resources. The transforms are the unpacked ones,
+    // callers that upload packed transforms should decode them with DecodePackedTransform first, so that both sides see the same values
+    struct CpuCullScene
+    {
+        const RenderObject* pRenders;
+        uint32_t renderCount;
+
+        const MeshTransform* pTransforms;
+
+        // Tables from BuildSurfaceCullTables
+        const SurfaceCullData* pSurfaces;
+        const SurfaceLodDraw* pLodDraws;
+
+        // Baked bounds from BuildRenderWorldBounds, optional. Objects with baked bounds do not read their transform for the frustum tests
+        const RenderWorldBounds* pWorldBounds = nullptr;
+
+        // Depth pyramid for the occlusion test of the late pass, usually from BuildSoftwareDepthPyramid. Nothing is occluded without one
+        SoftwareDepthPyramid* pDepthPyramid = nullptr;
+
+        // Optional ids of the only objects to cull, in increasing order, usually from QueryRenderBvhFrustum.
+        // The rest get no command and keep their visibility, so they should be ones that the full cull would reject
+        const uint32_t* pObjectIds = nullptr;
+        uint32_t objectCount = 0;
+    };
+
+    // The defaults match the macros of CullingShaderData.glsl
+    struct CpuCullSettings
+    {
+        // 0 runs InitialDrawCull.comp.glsl, 1 runs LateDrawCull.comp.glsl
+        uint8_t bLatePass = 0;
+
+        // Same as DrawCullShaderPushConstant::bPostPass, only read by the late pass
+        uint8_t bPostPass = 0;
+
+        // OCCLUSION_ENABLED. Without it the initial pass ignores the visibilities and the late pass does nothing
+        uint8_t bOcclusion = 1;
+
+        // LOD_ENABLED, objects use lod 0 without it
+        uint8_t bLod = 1;
+
+        // CONE_CULLING_ENABLED
+        uint8_t bConeCulling = 0;
+
+        // INSTANCED_DRAWS. Commands keep the lod draw index of their object (its bucket) in firstInstance, for CpuCompactInstancedDraws
+        uint8_t bInstancedDraws = 0;
+    };
+
+    // Runs the same culling and lod selection as the culling shaders on the CPU, split between threadCount threads (0 uses every hardware thread).
+    // pCommands is laid out like the indirect draw buffer: 2 * renderCount elements, with the commands of surfaces with 16-bit indices from renderCount.
+    // pVisibilities is the visibility buffer, read by the initial pass and written by the late pass.
+    // Unlike the shaders, the commands are in object order, so the output does not depend on the thread count
+    void CpuDrawCull(const CpuCullScene& scene, const CameraViewData& view, const CpuCullSettings& settings,
+    uint32_t* pVisibilities, CpuDrawCommand* pCommands, CpuDrawCounts& counts, uint32_t threadCount = 0);
+
+    // Visible objects bucketed by the lod that they are drawn with. Bucket surfaceId * ce_primitiveSurfaceMaxLODCount + lod,
+    // the same index as the lod draw table
+    struct CpuInstancedDraws
+    {
+        // Visible objects of each bucket, and where they start in instances (exclusive prefix sum of the counts)
+        BlitCL::DynamicArray<uint32_t> bucketCounts;
+        BlitCL::DynamicArray<uint32_t> bucketOffsets;
+
+        // Object ids grouped by bucket. The instance buffer, read by the vertex shader with gl_InstanceIndex
+        BlitCL::DynamicArray<uint32_t> instances;
+    };
+
+    // Same as the DrawBucket compute shaders. Takes the commands of CpuDrawCull with bInstancedDraws and replaces them with one command
+    // for every bucket that has objects, whose instanceCount is the bucket's object count and firstInstance its offset in instances.
+    // Commands are in bucket order and the objects of each bucket in command order, so the output does not depend on the thread count
+    void CpuCompactInstancedDraws(const CpuCullScene& scene, uint32_t surfaceCount, CpuDrawCommand* pCommands, CpuDrawCounts& counts,
+    CpuInstancedDraws& draws, uint32_t threadCount = 0);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "blitCpuCulling.h"
+#include "blitRenderBvh.h"
+
+namespace BlitzenEngine
+{
+    // The initial, late and post pass, in the order that they run
+    constexpr uint8_t ce_cpuFramePassCount = 3;
+
+    // Default width of the software depth buffer, its height follows the aspect ratio of the view
+    constexpr uint32_t ce_cpuFrameDepthWidth = 256;
+
+    struct CpuFrameStats
+    {
+        // Objects drawn by each pass of the last frame, both index buffers together. 
+        // Without instanced draws these are the pass's commands, with them the instances of its bucket commands
+        uint32_t passDraws[ce_cpuFramePassCount];
+
+        // Objects that the hierarchy let through to the passes, all of them without it
+        uint32_t culledObjects;
+
+        // Objects of the initial pass that were rasterized into the software depth buffer
+        uint32_t occluders;
+    };
+
+    struct CpuFrameContext;
+
+    // Called after every pass of CpuDrawFrame. The frame's commands and counts are the ones of the pass, they are replaced by the next one.
+    // With bInstancedDraws, they are the bucket commands and instancedDraws holds the pass's instances
+    using CpuDrawPassCallback = void (*)(CpuFrameContext& frame, const CpuCullSettings& pass, void* pUserData);
+
+    // What the CPU culling path keeps between frames. It runs the passes of the culling shaders without a compute capable graphics API,
+    // for renderers that cannot cull on the GPU and for the CpuCullBenchmark mode of the engine
+    struct CpuFrameContext
+    {
+        // The render objects and transforms belong to the caller, the tables and the baked bounds to the frame
+        CpuCullScene scene;
+        uint32_t surfaceCount = 0;
+
+        BlitCL::DynamicArray<SurfaceCullData> surfaceCullData;
+        BlitCL::DynamicArray<SurfaceLodDraw> surfaceLodDraws;
+        BlitCL::DynamicArray<RenderWorldBounds> worldBounds;
+
+        // The visibility buffer and the indirect draw buffer, laid out like the ones of CpuDrawCull
+        BlitCL::DynamicArray<uint32_t> visibilities;
+        BlitCL::DynamicArray<CpuDrawCommand> commands;
+        CpuDrawCounts counts;
+
+        // Only bOcclusion, bLod, bConeCulling and bInstancedDraws are read, each pass sets the rest
+        CpuCullSettings settings;
+
+        // Buckets and instance buffer of the last pass, when the commands are compacted with bInstancedDraws
+        CpuInstancedDraws instancedDraws;
+
+        // Hierarchy over the world boxes of the render objects, built with the frame. 
+        // When bHierarchyCull is set, the passes only cull the objects whose box the frustum query lets through
+        RenderBvh bvh;
+        uint8_t bHierarchyCull = 1;
+
+        // Set by the caller after it moves dynamic transforms, the next frame refits the hierarchy before querying it
+        uint8_t bTransformsMoved = 0;
+
+        // Occluder meshes of the surfaces, RenderingResources::occluders, occluderVertices and occluderIndices.
+        // With them and bOcclusion, the objects that the initial pass draws are rasterized with their surface's occluder,
+        // and the late and post pass test the spheres that pass the frustum against the depth pyramid of what they cover
+        const OccluderMesh* pOccluderMeshes = nullptr;
+        const BlitML::vec3* pOccluderVertices = nullptr;
+        const uint32_t* pOccluderIndices = nullptr;
+
+        uint32_t depthBufferWidth = ce_cpuFrameDepthWidth;
+        BlitCL::DynamicArray<uint32_t> occluders;
+        SoftwareDepthBuffer depthBuffer;
+        SoftwareDepthPyramid depthPyramid;
+
+        // Objects of the last frustum query in increasing order, the query's own results and a flag for each object to sort them
+        BlitCL::DynamicArray<uint32_t> candidates;
+        BlitCL::DynamicArray<uint32_t> bvhResults;
+        BlitCL::DynamicArray<uint8_t> candidateFlags;
+
+        // 0 uses every hardware thread
+        uint32_t threadCount = 0;
+
+        CpuFrameStats stats;
+    };
+
+    // Builds the surface tables from the resources and sets up a frame that culls their render objects and transforms
+    void CreateCpuFrame(RenderingResources* pResources, CpuFrameContext& frame, uint32_t threadCount = 0);
+
+    // Sets up a frame for a scene whose tables are already built. 
+    // The bounds of objects without a dynamic transform are baked here, then the hierarchy is built over them
+    void CreateCpuFrame(const CpuCullScene& scene, uint32_t surfaceCount, size_t transformCount,
+    BlitCL::DynamicArray<uint32_t>& dynamicTransforms, CpuFrameContext& frame, uint32_t threadCount = 0);
+
+    // Runs the culling passes of a frame in the order of the Vulkan renderer. The initial pass draws what was visible last frame,
+    // the late pass draws what has become visible and updates the visibilities, the post pass draws the objects of post pass surfaces.
+    // Without occlusion only the initial pass draws anything, like the shaders.
+    // With the hierarchy, objects outside the frustum are skipped. The shaders would reject them as well, 
+    // besides the ones whose bounding volume passes the symmetric plane tests from behind the camera
+    void CpuDrawFrame(CpuFrameContext& frame, const CameraViewData& view, CpuDrawPassCallback drawPass = nullptr,
+    void* pUserData = nullptr);
+}
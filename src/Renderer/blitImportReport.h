@@ -0,0 +1,23 @@
+#pragma once
+
+#include "blitRenderingResources.h"
+
+namespace BlitzenEngine
+{
+    // Written next to the executable when RenderingResources::bImportReport is set
+    constexpr const char* ce_importReportPath = "ImportReport.json";
+
+    // Cache size of the fifo model that acmr and atvr are measured with
+    constexpr uint32_t ce_importReportCacheSize = 16;
+
+    // Measures a triangle list. The indices may point anywhere in the vertex array, only the range that they use is counted.
+    // vertexSize is the size of a vertex as it is uploaded, for the overfetch
+    void AnalyzeLodIndices(const uint32_t* pIndices, size_t indexCount, BlitCL::DynamicArray<Vertex>& vertices,
+    size_t vertexSize, LodImportStats& stats);
+
+    // Sets the source name of the last surface's report entry, if it has one
+    void SetImportReportSource(RenderingResources* pResources, const char* source);
+
+    // Writes every entry of RenderingResources::importReport as json. Returns 0 if the file could not be written
+    uint8_t WriteImportReport(RenderingResources* pResources, const char* path);
+}
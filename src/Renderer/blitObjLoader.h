@@ -0,0 +1,15 @@
+#pragma once
+
+#include "blitRenderingResources.h"
+
+namespace BlitzenEngine
+{
+    // Chunks smaller than this are not worth a thread of their own
+    constexpr size_t ce_objMinChunkSize = 256 * 1024;
+
+    // Parses an obj file straight into indexed geometry.
+    // The file is mapped and split into line aligned chunks that are parsed in parallel.
+    // Then each (position, uv, normal) triplet is deduplicated with a hash table, so a de-indexed vertex array is never created.
+    // Polygons are triangulated as fans. Returns 0 if the file could not be mapped, has invalid indices or has no faces
+    uint8_t ParseObjFile(const char* filepath, BlitCL::DynamicArray<Vertex>& vertices, BlitCL::DynamicArray<uint32_t>& indices);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "blitCpuCulling.h"
+
+namespace BlitzenEngine
+{
+    // Most render objects that a leaf holds
+    constexpr uint32_t ce_renderBvhLeafSize = 4;
+
+    // Ranges of objects this size or smaller are built as one job. It does not depend on the thread count,
+    // so the node array is the same for any number of threads
+    constexpr uint32_t ce_renderBvhTaskObjects = 16'384;
+
+    // Morton splits end after 30 levels and the rest halve ranges of equal codes, so no tree of less than 2^32 objects goes deeper.
+    // Traversals keep a stack of this size
+    constexpr uint32_t ce_renderBvhMaxDepth = 64;
+
+    // The 2 children of a node are next to each other, so internal nodes only point to the first one.
+    // Same size and std430 layout as a GLSL struct of vec3 boundsMin, uint leftOrFirst, vec3 boundsMax, uint objectCount,
+    // so the array can be uploaded as it is
+    struct RenderBvhNode
+    {
+        // World space bounding box
+        BlitML::vec3 boundsMin;
+
+        // First child for internal nodes, first element of RenderBvh::objects for leaves
+        uint32_t leftOrFirst;
+
+        BlitML::vec3 boundsMax;
+
+        // 0 for internal nodes
+        uint32_t objectCount;
+    };
+
+    static_assert(sizeof(RenderBvhNode) == 32, "RenderBvhNode should fit in 32 bytes");
+
+    // Linear bounding volume hierarchy over the world space boxes of render objects
+    struct RenderBvh
+    {
+        // Node 0 is the root. Children always come after their parent, so going through the nodes backwards visits children first
+        BlitCL::DynamicArray<RenderBvhNode> nodes;
+
+        // Render object ids, sorted along a morton curve. The objects of a leaf are next to each other
+        BlitCL::DynamicArray<uint32_t> objects;
+    };
+
+    // World space box of the surface's bounding box (the one that the culling shaders test) after the object's transform.
+    // Static objects of scenes with pWorldBounds use their baked box
+    void RenderObjectBounds(const CpuCullScene& scene, uint32_t objectId, BlitML::vec3& boundsMin, BlitML::vec3& boundsMax);
+
+    // Builds the hierarchy from the morton codes of the objects' box centers, split between threadCount threads (0 uses every hardware thread).
+    // Only pRenders, renderCount, pTransforms, pSurfaces and pWorldBounds are read
+    void BuildRenderBvh(const CpuCullScene& scene, RenderBvh& bvh, uint32_t threadCount = 0);
+
+    // Updates the boxes of every node after objects have moved. The tree is kept, so it gets looser the further objects move from where it was built
+    void RefitRenderBvh(const CpuCullScene& scene, RenderBvh& bvh, uint32_t threadCount = 0);
+
+    // The queries append the ids of the objects whose world box passes the test to results
+
+    // Boxes that intersect the sphere
+    void QueryRenderBvhSphere(RenderBvh& bvh, const CpuCullScene& scene, const BlitML::vec3& center, float radius,
+    BlitCL::DynamicArray<uint32_t>& results);
+
+    // Boxes that the ray hits within maxDistance. The direction does not need to be normalized, distances are in its units
+    void QueryRenderBvhRay(RenderBvh& bvh, const CpuCullScene& scene, const BlitML::vec3& origin, const BlitML::vec3& direction,
+    float maxDistance, BlitCL::DynamicArray<uint32_t>& results);
+
+    // Boxes that are not fully outside one of the frustum planes of the view. Whole subtrees are rejected when their node is outside.
+    // Objects that the culling shaders let through with their center in front of the camera always pass
+    void QueryRenderBvhFrustum(RenderBvh& bvh, const CpuCullScene& scene, const CameraViewData& view,
+    BlitCL::DynamicArray<uint32_t>& results);
+}
@@ -23,6 +23,108 @@ namespace BlitzenEngine
         constexpr uint8_t ce_buildClusters = 0;
     #endif 
 
+    // Default value of RenderingResources::bCompactVertices. Only the Vulkan renderer can draw compact vertices
+    #ifdef BLITZEN_COMPACT_VERTICES
+        constexpr uint8_t ce_compactVertices = 1;
+    #else
+        constexpr uint8_t ce_compactVertices = 0;
+    #endif
+
+    // Default value of RenderingResources::bIndices16. Surfaces with fewer than 65535 vertices store their indices as 16-bit
+    #ifdef BLITZEN_16BIT_INDICES
+        constexpr uint8_t ce_indices16 = 1;
+    #else
+        constexpr uint8_t ce_indices16 = 0;
+    #endif
+
+    // Default value of RenderingResources::bStripIndices. Every LOD is stored as a triangle strip, split with primitive restart
+    #ifdef BLITZEN_STRIP_INDICES
+        constexpr uint8_t ce_stripIndices = 1;
+    #else
+        constexpr uint8_t ce_stripIndices = 0;
+    #endif
+
+    // Default value of RenderingResources::bPackedTransforms. Only the Vulkan renderer can read packed transforms
+    #ifdef BLITZEN_PACKED_TRANSFORMS
+        constexpr uint8_t ce_packedTransforms = 1;
+    #else
+        constexpr uint8_t ce_packedTransforms = 0;
+    #endif
+
+    // Default value of RenderingResources::bInstancedDraws. Only the Vulkan renderer draws instanced
+    #ifdef BLITZEN_INSTANCED_DRAWS
+        constexpr uint8_t ce_instancedDraws = 1;
+    #else
+        constexpr uint8_t ce_instancedDraws = 0;
+    #endif
+
+    // Default value of RenderingResources::bClusterLod. Large surfaces also get a hierarchy of cluster lods for the mesh shader path
+    #ifdef BLITZEN_CLUSTER_LOD
+        constexpr uint8_t ce_clusterLod = 1;
+    #else
+        constexpr uint8_t ce_clusterLod = 0;
+    #endif
+
+    // Default value of RenderingResources::bImportReport. Every surface is analyzed at import and the results are written as json
+    #ifdef BLITZEN_IMPORT_REPORT
+        constexpr uint8_t ce_importReport = 1;
+    #else
+        constexpr uint8_t ce_importReport = 0;
+    #endif
+
+    // Default value of RenderingResources::bOccluderMeshes. Every surface gets a simplified mesh for the software occlusion rasterizer
+    #ifdef BLITZEN_OCCLUDER_MESHES
+        constexpr uint8_t ce_occluderMeshes = 1;
+    #else
+        constexpr uint8_t ce_occluderMeshes = 0;
+    #endif
+
+    // Default value of RenderingResources::bSpatialReorder. Transforms and render objects are sorted along a space filling curve once the scene is loaded
+    #ifdef BLITZEN_SPATIAL_REORDER
+        constexpr uint8_t ce_spatialReorder = 1;
+    #else
+        constexpr uint8_t ce_spatialReorder = 0;
+    #endif
+
+    // Primitive restart values for strip indices. The 16-bit one is also the reason 16-bit surfaces are limited to 65535 vertices
+    constexpr uint16_t ce_stripRestartIndex16 = 0xFFFF;
+    constexpr uint32_t ce_stripRestartIndex32 = 0xFFFFFFFF;
+
+    // How the lods of a surface are generated. RenderingResources::lodSettings is used unless a mesh is loaded with its own
+    struct LodSettings
+    {
+        // Each lod targets this fraction of the previous lod's triangles
+        float ratio = 0.65f;
+
+        // Relative error bound of the attribute aware simplifier
+        float maxError = 1e-1f;
+
+        // A lod that keeps more than this fraction of the previous lod's triangles is not added, and no lods are generated after it
+        float minReduction = 0.95f;
+
+        uint8_t maxLodCount = ce_primitiveSurfaceMaxLODCount;
+
+        // When the attribute aware simplifier stalls, the sloppy simplifier is used to reach the target. 
+        // It ignores topology, so it is only used for lods that are far enough away for its larger error to be acceptable
+        uint8_t bSloppyFallback = 1;
+
+        // Every lod after the first gets its own copy of the vertices it uses, so that coarse lods fetch from a small contiguous range.
+        // Costs extra vertex memory
+        uint8_t bCompactLodVertices = 1;
+    };
+
+    // Identifies the geometry of a surface as it was loaded, before any optimization. 
+    // Two independent 64-bit hashes, so that a match can be trusted without keeping the original data around
+    struct GeometryHash
+    {
+        uint64_t hash[2];
+        uint32_t vertexCount;
+        uint32_t indexCount;
+
+        // The first surface that was loaded with this geometry
+        uint32_t surfaceId;
+    };
+
     struct TextureStats
     {
         std::string filepath;
@@ -46,6 +148,26 @@ namespace BlitzenEngine
         uint8_t tangentX, tangentY, tangentZ, tangentW;
     };
 
+    // 16 byte alternative to Vertex, used when RenderingResources::bCompactVertices is set.
+    // Converted from Vertex by EncodeCompactVertex (blitVertexQuantization.h) and decoded by LoadVertex in ShaderBuffers.glsl
+    struct CompactVertex
+    {
+        // Position inside the surface's bounding sphere: center + position / 32767 * radius (3 16-bit snorm).
+        // The first 8 bytes are read by ray tracing as R16G16B16A16_SNORM, which ignores the 4th component (the normal below)
+        int16_t positionX, positionY, positionZ;
+        // Octahedral normal (2 8-bit snorm)
+        int8_t normalX, normalY;
+        // Uv maps (2 half floats)
+        uint16_t uvX, uvY;
+        // Octahedral tangent (2 8-bit snorm) and the bitangent sign
+        int8_t tangentX, tangentY;
+        int8_t tangentW;
+        uint8_t padding;
+    };
+
+    static_assert(sizeof(Vertex) == 32, "Vertex layout should match the shaders");
+    static_assert(sizeof(CompactVertex) == 16, "CompactVertex layout should match the shaders");
+
     struct alignas(16) Meshlet
     {
         // Bounding sphere for frustum culling
@@ -61,6 +183,76 @@ namespace BlitzenEngine
     	uint8_t triangleCount;
     };
 
+    // A cluster of a surface's lod hierarchy (blitClusterLod.h). The cluster is drawn when the error of the group it was built from 
+    // is acceptable and the error of the group it was simplified into is not. Errors and spheres grow towards the root, 
+    // so exactly one cluster is drawn on each path from a leaf to a root
+    struct alignas(16) LodCluster
+    {
+        // Bounds and error of the group that the cluster was built from. Clusters of the original geometry have 0 error
+        BlitML::vec3 center;
+        float radius;
+
+        // Bounds and error of the group that the cluster was simplified into. Roots have an infinite error
+        BlitML::vec3 parentCenter;
+        float parentRadius;
+
+        float error;
+        float parentError;
+
+        // Index into the meshlet array, the cluster's geometry
+        uint32_t meshlet;
+
+        // 0 for clusters of the original geometry, incremented with each simplification
+        uint32_t depth;
+    };
+
+    static_assert(sizeof(LodCluster) == 48, "LodCluster layout should match the shaders");
+
+    // Mesh quality of one lod, as measured by the meshoptimizer analyzers (blitImportReport.h)
+    struct LodImportStats
+    {
+        uint32_t triangleCount;
+
+        // Vertices that the lod uses
+        uint32_t vertexCount;
+
+        // Transformed vertices per triangle (0.5 at best) and per used vertex (1.0 at best), with a 16 entry fifo cache
+        float acmr;
+        float atvr;
+
+        // Shaded pixels per covered pixel, 1.0 at best
+        float overdraw;
+
+        // Fetched bytes per byte of the lod's vertex range, 1.0 at best
+        float overfetch;
+    };
+
+    // Import report entry of one surface
+    struct SurfaceImportReport
+    {
+        // File or mesh name that the surface came from, set by the loader
+        char source[64];
+
+        uint32_t surfaceId;
+
+        // The indices as they were loaded, before any optimization
+        LodImportStats unoptimized;
+
+        LodImportStats lods[ce_primitiveSurfaceMaxLODCount];
+        uint8_t lodCount;
+    };
+
+    // Simplified version of a surface that the software occlusion rasterizer draws (blitSoftwareOcclusion.h).
+    // The indices are relative to firstVertex, an index count of 0 means that the surface is never drawn as an occluder
+    struct OccluderMesh
+    {
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+
+        uint32_t firstIndex;
+        uint32_t indexCount;
+    };
+
     // Passed to the GPU as a unified storage buffer. Part of Material stats
     struct alignas(16) Material
     {
@@ -100,6 +292,16 @@ namespace BlitzenEngine
         BlitML::vec3 center;
         float radius;
 
+        // Axis aligned bounding box in model space
+        BlitML::vec3 aabbMin;
+
+        // Normal cone of every triangle of the surface, same encoding as meshopt_Bounds::cone_axis_s8 and cone_cutoff_s8.
+        // A cutoff of 127 means that the surface cannot be culled by its cone
+        int8_t coneAxis[3];
+        int8_t coneCutoff;
+
+        BlitML::vec3 aabbMax;
+
         MeshLod meshLod[ce_primitiveSurfaceMaxLODCount];
         uint8_t lodCount = 0;
 
@@ -110,8 +312,18 @@ namespace BlitzenEngine
         uint32_t materialId;
 
         uint8_t postPass = 0;
+
+        // When this is set, the lod indices are in RenderingResources::indices16 instead of RenderingResources::indices
+        uint8_t bIndices16 = 0;
+
+        // The clusters of the surface's lod hierarchy in RenderingResources::lodClusters, if it has one
+        uint32_t firstLodCluster = 0;
+        uint32_t lodClusterCount = 0;
     };
 
+    // The Surface structs of the shaders need to match this
+    static_assert(sizeof(PrimitiveSurface) == 240, "PrimitiveSurface layout should match the shaders");
+
     struct Mesh
     {
         uint32_t firstSurface;
@@ -156,18 +368,64 @@ namespace BlitzenEngine
         // Holds the vertex count of each primitive. This does not need to be passed to shader for now. But I do need it for ray tracing
         BlitCL::DynamicArray<uint32_t> primitiveVertexCounts;
 
+        // Surfaces whose loaded vertices, indices and lod settings match an earlier surface share its geometry and lods. 
+        // They still get their own surface entry, so that their material can be different
+        uint8_t bDeduplicateGeometry = 1;
+
+        // Hashes of every surface with unique geometry, and an open addressing table (entry index + 1, 0 is empty) to find them
+        BlitCL::DynamicArray<GeometryHash> geometryHashes;
+        BlitCL::DynamicArray<uint32_t> geometryHashSlots;
+
+        // Decides which of the 2 arrays below holds the geometry. All surfaces share one vertex buffer, so this needs to be set before anything is loaded
+        uint8_t bCompactVertices = ce_compactVertices;
+
         // Holds the vertices of all the primitives that were loaded
         BlitCL::DynamicArray<Vertex> vertices;
 
+        // Holds the vertices of all the primitives that were loaded, when compact vertices are active
+        BlitCL::DynamicArray<CompactVertex> compactVertices;
+
+        // Allows surfaces with few enough vertices to use the 16-bit index array. Only the Vulkan renderer can draw 16-bit indices
+        uint8_t bIndices16 = ce_indices16;
+
+        // Stores lod indices as strips with primitive restart instead of triangle lists. Only the Vulkan renderer can draw strips
+        uint8_t bStripIndices = ce_stripIndices;
+
+        // Lod generation settings of surfaces whose mesh was not loaded with its own
+        LodSettings lodSettings;
+
         // Holds the indices of all the primitives that were loaded
         BlitCL::DynamicArray<uint32_t> indices;
 
+        // Holds the indices of the primitives that were loaded with PrimitiveSurface::bIndices16
+        BlitCL::DynamicArray<uint16_t> indices16;
+
         // Holds all clusters for all the primitives that were loaded
         BlitCL::DynamicArray<Meshlet> meshlets;
 
         // Holds the meshlet indices to index into the clusters above
         BlitCL::DynamicArray<uint32_t> meshletData;
 
+        // Builds a cluster lod hierarchy for surfaces with at least ce_clusterLodMinTriangles triangles
+        uint8_t bClusterLod = ce_clusterLod;
+
+        // Holds the lod hierarchy clusters of every surface. Their geometry is in the meshlet array
+        BlitCL::DynamicArray<LodCluster> lodClusters;
+
+        // Analyzes every surface that is loaded and keeps the results below
+        uint8_t bImportReport = ce_importReport;
+
+        // One entry for each surface, written as json by WriteImportReport
+        BlitCL::DynamicArray<SurfaceImportReport> importReport;
+
+        // Simplifies every surface that is loaded into an occluder mesh
+        uint8_t bOccluderMeshes = ce_occluderMeshes;
+
+        // One occluder for each surface, their model space positions and indices
+        BlitCL::DynamicArray<OccluderMesh> occluders;
+        BlitCL::DynamicArray<BlitML::vec3> occluderVertices;
+        BlitCL::DynamicArray<uint32_t> occluderIndices;
+
 
         /*
             Per instance data
@@ -175,9 +433,22 @@ namespace BlitzenEngine
         // Holds the transforms of every render object / instance on the scene 
         BlitCL::DynamicArray<MeshTransform> transforms;
 
+        // Tells the renderer to upload the transforms as PackedTransform (blitTransformQuantization.h)
+        uint8_t bPackedTransforms = ce_packedTransforms;
+
+        // Transforms that can change after the scene is loaded, filled from the game objects with bDynamic by GatherDynamicTransforms.
+        // The world bounds of render objects with any other transform are baked once at upload (BuildRenderWorldBounds)
+        BlitCL::DynamicArray<uint32_t> dynamicTransforms;
+
+        // Tells the renderer to draw the visible objects of each surface lod with one instanced command, instead of one command each
+        uint8_t bInstancedDraws = ce_instancedDraws;
+
         // Holds all the render objects / primitives. They index into one primitive and one transform each
         RenderObject renders[ce_maxRenderObjects];
         uint32_t renderObjectCount; 
+
+        // Tells the engine to call ReorderSceneSpatially after loading, so that neighbouring render objects are also close in the world
+        uint8_t bSpatialReorder = ce_spatialReorder;
         
         // Holds the meshes that were loaded for the scene. Meshes are a collection of primitives. TODO: Put these on a separate struct (maybe)
         Mesh meshes[ce_maxMeshCount];
@@ -211,18 +482,22 @@ namespace BlitzenEngine
     void DefineMaterial(RenderingResources* pResources, BlitML::vec4& diffuseColor, float shininess, const char* diffuseMapName, 
     const char* specularMapName, const char* materialName);
 
-    // Loads a mesh from an obj file
-    uint8_t LoadMeshFromObj(RenderingResources* pResources, const char* filename);
+    // Loads a mesh from an obj file. Its surfaces use pLodSettings if it is not null, or RenderingResources::lodSettings
+    uint8_t LoadMeshFromObj(RenderingResources* pResources, const char* filename, const LodSettings* pLodSettings = nullptr);
 
-    // Generates meshlet for a mesh or surface loaded using meshOptimizer library and converts it to the renderer's format
-    size_t GenerateClusters(RenderingResources* pResources, 
-    BlitCL::DynamicArray<Vertex>& vertices, 
-    BlitCL::DynamicArray<uint32_t>& indices);
+    // Generates meshlets for one lod of a surface using meshOptimizer library and appends them to the arrays in the renderer's format.
+    // Does not touch any shared state, so lods can be processed in parallel. Returns the amount of meshlets
+    size_t GenerateClusters(BlitCL::DynamicArray<Vertex>& vertices, 
+    BlitCL::DynamicArray<uint32_t>& indices, 
+    BlitCL::DynamicArray<Meshlet>& meshlets, 
+    BlitCL::DynamicArray<uint32_t>& meshletData);
 
-    // Takes the vertices and indices loaded for a mesh primitive from a file and converts the data to the renderer's format
+    // Takes the vertices and indices loaded for a mesh primitive from a file and converts the data to the renderer's format.
+    // Lods are generated with pLodSettings if it is not null, or RenderingResources::lodSettings
     void LoadPrimitiveSurface(RenderingResources* pResources, 
     BlitCL::DynamicArray<Vertex>& vertices, 
-    BlitCL::DynamicArray<uint32_t>& indices);
+    BlitCL::DynamicArray<uint32_t>& indices, 
+    const LodSettings* pLodSettings = nullptr);
 
     // Placeholder to load some default resources while testing the systems
     void LoadTestGeometry(RenderingResources* pResources);
@@ -239,4 +514,11 @@ namespace BlitzenEngine
     // This function uses the cgltf library to load a .glb or .gltf scene
     // The repository can be found on https://github.com/jkuhlmann/cgltf
     uint8_t LoadGltfScene(RenderingResources* pResources, const char* path);
+
+    // Fills dynamicTransforms with the transforms of the game objects that can move, each transform once
+    void GatherDynamicTransforms(RenderingResources* pResources);
+
+    // Sorts the transforms along a space filling curve of their positions (meshopt_spatialSortRemap) and the render objects by their new transform.
+    // The transform indices of render objects, game objects and dynamicTransforms are remapped. Render objects of the same transform keep their order
+    void ReorderSceneSpatially(RenderingResources* pResources);
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "blitRenderingResources.h"
+#include "Game/blitCamera.h"
+
+namespace BlitzenEngine
+{
+    // Occluder meshes are simplified towards this many triangles at import
+    constexpr uint32_t ce_occluderTargetTriangles = 128;
+
+    // Relative error bound of the occluder simplification. Surfaces that are still above ce_occluderMaxTriangles within it get no occluder
+    constexpr float ce_occluderMaxError = 5e-2f;
+    constexpr uint32_t ce_occluderMaxTriangles = 512;
+
+    // The depth buffer is rasterized in tiles, each thread takes whole tiles. The width is whole AVX2 registers
+    constexpr uint32_t ce_occlusionTileWidth = 32;
+    constexpr uint32_t ce_occlusionTileHeight = 16;
+
+    // Same limit as the depth pyramid image's mip levels
+    constexpr uint8_t ce_maxDepthPyramidLevels = 16;
+
+    // Screen space occluder triangle. Every pixel it covers gets the depth of its farthest vertex
+    struct OcclusionTriangle
+    {
+        // Edge functions, a pixel center is inside when all 3 are at least 0
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+
+        float depth;
+
+        // Pixels whose centers are inside the triangle's bounds, minX > maxX when the triangle covers nothing
+        int32_t minX;
+        int32_t minY;
+        int32_t maxX;
+        int32_t maxY;
+    };
+
+    // Same depth convention as the depth attachment: reverse z, 0 on the far plane and growing towards the camera.
+    // The rows are padded to whole tiles. The other arrays are kept between frames, so rasterizing does not allocate once they are large enough
+    struct SoftwareDepthBuffer
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        uint32_t tileCountX = 0;
+        uint32_t tileCountY = 0;
+
+        // tileCountX * ce_occlusionTileWidth
+        uint32_t pitch = 0;
+
+        BlitCL::DynamicArray<float> depth;
+
+        BlitCL::DynamicArray<OcclusionTriangle> triangles;
+
+        // Triangles of each tile. Tile t's triangles are tileTriangles[tileStarts[t]] to tileTriangles[tileStarts[t + 1] - 1]
+        BlitCL::DynamicArray<uint32_t> tileStarts;
+        BlitCL::DynamicArray<uint32_t> tileTriangles;
+    };
+
+    // Built from a depth buffer the same way as DepthPyramidGeneration.comp.glsl builds the depth pyramid image
+    struct SoftwareDepthPyramid
+    {
+        // Size of level 0, the previous powers of 2 of the depth buffer's size
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        uint8_t levelCount = 0;
+        uint32_t levelOffsets[ce_maxDepthPyramidLevels];
+
+        BlitCL::DynamicArray<float> data;
+    };
+
+    // The objects that are drawn as occluders, with their surface's occluder mesh
+    struct SoftwareOcclusionScene
+    {
+        const RenderObject* pRenders;
+        const MeshTransform* pTransforms;
+
+        // Render object ids of the occluders
+        const uint32_t* pOccluders;
+        uint32_t occluderCount;
+
+        // RenderingResources::occluders, occluderVertices and occluderIndices
+        const OccluderMesh* pOccluderMeshes;
+        const BlitML::vec3* pOccluderVertices;
+        const uint32_t* pOccluderIndices;
+    };
+
+    // Simplifies the surface into an occluder mesh and appends it to the occluder arrays. Called by LoadPrimitiveSurface
+    void BuildOccluderMesh(RenderingResources* pResources, BlitCL::DynamicArray<Vertex>& vertices,
+    BlitCL::DynamicArray<uint32_t>& indices, OccluderMesh& occluder);
+
+    // Sets the size of the depth buffer, which should have the aspect ratio of the camera
+    void ResizeSoftwareDepthBuffer(SoftwareDepthBuffer& buffer, uint32_t width, uint32_t height);
+
+    // Clears the depth buffer and draws the occluders, split between threadCount threads (0 uses every hardware thread).
+    // Triangles that cross the near plane are skipped and pixels only get the farthest depth of the triangle,
+    // so the buffer is never closer than the occluders that were drawn
+    void RasterizeOccluders(const SoftwareOcclusionScene& scene, const CameraViewData& view, SoftwareDepthBuffer& buffer,
+    uint32_t threadCount = 0);
+
+    // Each level holds the farthest depth of the level before it
+    void BuildSoftwareDepthPyramid(SoftwareDepthBuffer& buffer, SoftwareDepthPyramid& pyramid);
+
+    // Same as the occlusion test of LateDrawCull.comp.glsl, for a view space bounding sphere. Returns 0 when it is occluded
+    uint8_t SphereVisibleInPyramid(SoftwareDepthPyramid& pyramid, const CameraViewData& view, const BlitML::vec3& center, float radius);
+
+    // The rest of SphereVisibleInPyramid once the sphere is projected, for callers that project a block at a time with BatchProjectSpheres.
+    // rect is the uv rectangle of the view space sphere, which has to be in front of the near plane
+    uint8_t SphereRectVisibleInPyramid(SoftwareDepthPyramid& pyramid, const CameraViewData& view, const BlitML::vec4& rect, float centerZ,
+    float radius);
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <stddef.h>
+#include "blitRenderingResources.h"
+#include "Meshoptimizer/meshoptimizer.h"
+#include "BlitzenMathLibrary/blitMLBatch.h"
+
+namespace BlitzenEngine
+{
+    // Flags of SurfaceCullData, same values as SURFACE_CULL_POST_PASS and SURFACE_CULL_INDICES16 in CullingShaderData.glsl
+    constexpr uint8_t ce_surfaceCullPostPass = 1;
+    constexpr uint8_t ce_surfaceCullIndices16 = 2;
+
+    // Largest value a half float LOD error can hold, larger errors are clamped to it
+    constexpr float ce_maxHalfLodError = 65504.f;
+
+    // The part of a PrimitiveSurface that the culling shaders read for every render object.
+    // Everything that is only needed after an object passes culling is in the SurfaceLodDraw table
+    struct alignas(16) SurfaceCullData
+    {
+        // Bounding sphere
+        BlitML::vec3 center;
+        float radius;
+
+        // Half float errors of lods 1 to lodCount - 1. The error of lod 0 is always 0, so it is not stored
+        uint16_t lodErrors[ce_primitiveSurfaceMaxLODCount - 1];
+
+        uint8_t lodCount;
+
+        // ce_surfaceCullPostPass | ce_surfaceCullIndices16
+        uint8_t flags;
+
+        // Model space bounding box as half floats, rounded outwards
+        uint16_t aabbMin[3];
+        uint16_t aabbMax[3];
+
+        // Same as PrimitiveSurface::coneAxis and PrimitiveSurface::coneCutoff
+        int8_t coneAxis[3];
+        int8_t coneCutoff;
+    };
+
+    // The structs of this file are read by CullingShaderData.glsl, the checks below keep them in sync with the shader structs
+    static_assert(sizeof(SurfaceCullData) == 48, "SurfaceCullData should fit in 48 bytes");
+    static_assert(offsetof(SurfaceCullData, radius) == 12, "SurfaceCullData layout should match the shaders");
+    static_assert(offsetof(SurfaceCullData, lodErrors) == 16, "SurfaceCullData layout should match the shaders");
+    static_assert(offsetof(SurfaceCullData, lodCount) == 30, "SurfaceCullData layout should match the shaders");
+    static_assert(offsetof(SurfaceCullData, flags) == 31, "SurfaceCullData layout should match the shaders");
+    static_assert(offsetof(SurfaceCullData, aabbMin) == 32, "SurfaceCullData layout should match the shaders");
+    static_assert(offsetof(SurfaceCullData, aabbMax) == 38, "SurfaceCullData layout should match the shaders");
+    static_assert(offsetof(SurfaceCullData, coneAxis) == 44, "SurfaceCullData layout should match the shaders");
+
+    // What a draw command needs from a surface's lod. Each surface has ce_primitiveSurfaceMaxLODCount of these in the table,
+    // so the lod of surface s is at s * ce_primitiveSurfaceMaxLODCount + lodIndex
+    struct SurfaceLodDraw
+    {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        uint32_t vertexOffset;
+    };
+
+    static_assert(sizeof(SurfaceLodDraw) == 12, "SurfaceLodDraw layout should match the shaders");
+    static_assert(offsetof(SurfaceLodDraw, vertexOffset) == 8, "SurfaceLodDraw layout should match the shaders");
+
+    // Radius of the world bounds of render objects whose transform can change. The culling shaders transform their surface's bounds every frame
+    constexpr float ce_dynamicWorldBounds = -1.f;
+
+    // World space bounding sphere and box of a render object, baked once at upload for objects whose transform never changes.
+    // The frustum tests of the culling shaders only read these for them, instead of a transform and a surface
+    struct alignas(16) RenderWorldBounds
+    {
+        BlitML::vec3 center;
+
+        // ce_dynamicWorldBounds for objects with a dynamic transform
+        float radius;
+
+        BlitML::vec3 boundsMin;
+        float padding0;
+        BlitML::vec3 boundsMax;
+        float padding1;
+    };
+
+    static_assert(sizeof(RenderWorldBounds) == 48, "RenderWorldBounds layout should match the shaders");
+    static_assert(offsetof(RenderWorldBounds, boundsMin) == 16, "RenderWorldBounds layout should match the shaders");
+    static_assert(offsetof(RenderWorldBounds, boundsMax) == 32, "RenderWorldBounds layout should match the shaders");
+
+    // Half float that is not smaller (bRoundUp) or not larger than the value, so that boxes only grow when they are quantized
+    inline uint16_t QuantizeHalfConservative(float value, uint8_t bRoundUp)
+    {
+        // Denormals are flushed to zero, so tiny values go to zero or to the smallest normal half in the direction of rounding
+        constexpr float ce_smallestNormalHalf = 6.1035156e-5f;
+        if(value > -ce_smallestNormalHalf && value < ce_smallestNormalHalf)
+        {
+            if(bRoundUp)
+                return value > 0.f ? 0x0400 : 0x0000;
+            return value < 0.f ? 0x8400 : 0x0000;
+        }
+
+        uint16_t half = meshopt_quantizeHalf(value);
+        float rounded = meshopt_dequantizeHalf(half);
+        if(bRoundUp ? rounded >= value : rounded <= value)
+            return half;
+
+        // Halves are sign and magnitude, so one step away from zero makes positive values larger and negative values smaller
+        uint8_t bNegative = (half & 0x8000) != 0;
+        if(bRoundUp == !bNegative)
+            return half + 1;
+
+        // Steps towards zero, crossing it when the value is a zero of the wrong sign
+        if((half & 0x7FFF) == 0)
+            return bNegative ? 0x0001 : 0x8001;
+        return half - 1;
+    }
+
+    inline void BuildSurfaceCullData(const PrimitiveSurface& surface, SurfaceCullData& out)
+    {
+        out.center = surface.center;
+        out.radius = surface.radius;
+        out.lodCount = surface.lodCount;
+        out.flags = (surface.postPass ? ce_surfaceCullPostPass : 0) | (surface.bIndices16 ? ce_surfaceCullIndices16 : 0);
+
+        for(uint8_t i = 1; i < ce_primitiveSurfaceMaxLODCount; ++i)
+        {
+            float error = i < surface.lodCount ? surface.meshLod[i].error : 0.f;
+            error = error > ce_maxHalfLodError ? ce_maxHalfLodError : error;
+            out.lodErrors[i - 1] = meshopt_quantizeHalf(error);
+        }
+
+        out.aabbMin[0] = QuantizeHalfConservative(surface.aabbMin.x, 0);
+        out.aabbMin[1] = QuantizeHalfConservative(surface.aabbMin.y, 0);
+        out.aabbMin[2] = QuantizeHalfConservative(surface.aabbMin.z, 0);
+        out.aabbMax[0] = QuantizeHalfConservative(surface.aabbMax.x, 1);
+        out.aabbMax[1] = QuantizeHalfConservative(surface.aabbMax.y, 1);
+        out.aabbMax[2] = QuantizeHalfConservative(surface.aabbMax.z, 1);
+
+        for(uint8_t i = 0; i < 3; ++i)
+            out.coneAxis[i] = surface.coneAxis[i];
+        out.coneCutoff = surface.coneCutoff;
+    }
+
+    // Writes ce_primitiveSurfaceMaxLODCount elements to pOut. Unused lods repeat the last one
+    inline void BuildSurfaceLodDraws(const PrimitiveSurface& surface, SurfaceLodDraw* pOut)
+    {
+        for(uint8_t i = 0; i < ce_primitiveSurfaceMaxLODCount; ++i)
+        {
+            const MeshLod& lod = surface.meshLod[i < surface.lodCount ? i : surface.lodCount - 1];
+            pOut[i].indexCount = lod.indexCount;
+            pOut[i].firstIndex = lod.firstIndex;
+            pOut[i].vertexOffset = surface.vertexOffset;
+        }
+    }
+
+    // Splits the surfaces into the cull records and the lod draw table that the culling shaders read
+    inline void BuildSurfaceCullTables(BlitCL::DynamicArray<PrimitiveSurface>& surfaces,
+    BlitCL::DynamicArray<SurfaceCullData>& cullData, BlitCL::DynamicArray<SurfaceLodDraw>& lodDraws)
+    {
+        cullData.Resize(surfaces.GetSize());
+        lodDraws.Resize(surfaces.GetSize() * ce_primitiveSurfaceMaxLODCount);
+        for(size_t i = 0; i < surfaces.GetSize(); ++i)
+        {
+            BLIT_ASSERT(surfaces[i].lodCount > 0)
+            BuildSurfaceCullData(surfaces[i], cullData[i]);
+            BuildSurfaceLodDraws(surfaces[i], &lodDraws[i * ce_primitiveSurfaceMaxLODCount]);
+        }
+    }
+
+    // Model space bounding box of the surface, the same values that the culling shaders read
+    inline void SurfaceBox(const SurfaceCullData& surface, BlitML::vec3& boxMin, BlitML::vec3& boxMax)
+    {
+        boxMin = BlitML::vec3(meshopt_dequantizeHalf(surface.aabbMin[0]), meshopt_dequantizeHalf(surface.aabbMin[1]),
+        meshopt_dequantizeHalf(surface.aabbMin[2]));
+        boxMax = BlitML::vec3(meshopt_dequantizeHalf(surface.aabbMax[0]), meshopt_dequantizeHalf(surface.aabbMax[1]),
+        meshopt_dequantizeHalf(surface.aabbMax[2]));
+    }
+
+    // World box of a rotated box with the given world center and half extents.
+    // Row i of QuatToMat4 holds the world axis i parts of the rotated axes, so the box reaches as far as their absolute values scaled by the extents
+    inline void RotatedBoxBounds(const BlitML::vec3& center, const BlitML::vec3& extents, const BlitML::mat4& rotation,
+    BlitML::vec3& boundsMin, BlitML::vec3& boundsMax)
+    {
+        const float* r = rotation.data;
+        BlitML::vec3 worldExtents(
+            BlitML::Abs(r[0]) * extents.x + BlitML::Abs(r[1]) * extents.y + BlitML::Abs(r[2]) * extents.z,
+            BlitML::Abs(r[4]) * extents.x + BlitML::Abs(r[5]) * extents.y + BlitML::Abs(r[6]) * extents.z,
+            BlitML::Abs(r[8]) * extents.x + BlitML::Abs(r[9]) * extents.y + BlitML::Abs(r[10]) * extents.z);
+        boundsMin = center - worldExtents;
+        boundsMax = center + worldExtents;
+    }
+
+    // World space box of the surface's box after the transform. Gives the same values as the boxes of BuildRenderWorldBounds
+    inline void SurfaceWorldBounds(const SurfaceCullData& surface, const MeshTransform& transform, BlitML::vec3& boundsMin,
+    BlitML::vec3& boundsMax)
+    {
+        BlitML::vec3 boxMin;
+        BlitML::vec3 boxMax;
+        SurfaceBox(surface, boxMin, boxMax);
+        BlitML::vec3 center = BlitML::RotateQuat((boxMin + boxMax) * 0.5f, transform.orientation) * transform.scale + transform.pos;
+        RotatedBoxBounds(center, (boxMax - boxMin) * 0.5f * transform.scale, BlitML::QuatToMat4(transform.orientation),
+        boundsMin, boundsMax);
+    }
+
+    // Bakes the world sphere and box of every render object. The sphere steps are the ones the culling shaders take for dynamic objects,
+    // so the sphere is the same either way. Transforms should be the ones the shaders see, decoded first when they are packed.
+    // Static objects go through the batch kernels in blocks, which give the same values as RotateQuat and QuatToMat4
+    inline void BuildRenderWorldBounds(const RenderObject* pRenders, uint32_t renderCount, const MeshTransform* pTransforms,
+    size_t transformCount, const SurfaceCullData* pSurfaces, BlitCL::DynamicArray<uint32_t>& dynamicTransforms,
+    BlitCL::DynamicArray<RenderWorldBounds>& bounds)
+    {
+        constexpr size_t ce_blockSize = 256;
+
+        BlitCL::DynamicArray<uint8_t> bDynamic(transformCount, uint8_t(0));
+        for(size_t i = 0; i < dynamicTransforms.GetSize(); ++i)
+            bDynamic[dynamicTransforms[i]] = 1;
+
+        float local[6][ce_blockSize];
+        float orientation[4][ce_blockSize];
+        float rotated[6][ce_blockSize];
+        BlitML::mat4 rotations[ce_blockSize];
+        uint32_t blockObjects[ce_blockSize];
+
+        // Surface sphere centers first, box centers after them
+        BlitML::Vec3Stream sphereCenters{local[0], local[1], local[2]};
+        BlitML::Vec3Stream boxCenters{local[3], local[4], local[5]};
+        BlitML::Vec3Stream rotatedSphereCenters{rotated[0], rotated[1], rotated[2]};
+        BlitML::Vec3Stream rotatedBoxCenters{rotated[3], rotated[4], rotated[5]};
+        BlitML::QuatStream orientations{orientation[0], orientation[1], orientation[2], orientation[3]};
+
+        bounds.Resize(renderCount);
+        uint32_t objectId = 0;
+        while(objectId < renderCount)
+        {
+            // Gathers the next block of static objects, dynamic ones are marked as they are passed
+            size_t count = 0;
+            for(; objectId < renderCount && count < ce_blockSize; ++objectId)
+            {
+                const RenderObject& render = pRenders[objectId];
+                if(bDynamic[render.transformId])
+                {
+                    bounds[objectId].center = BlitML::vec3(0.f);
+                    bounds[objectId].radius = ce_dynamicWorldBounds;
+                    bounds[objectId].boundsMin = BlitML::vec3(0.f);
+                    bounds[objectId].boundsMax = BlitML::vec3(0.f);
+                    continue;
+                }
+
+                const SurfaceCullData& surface = pSurfaces[render.surfaceId];
+                const MeshTransform& transform = pTransforms[render.transformId];
+                BlitML::vec3 boxMin;
+                BlitML::vec3 boxMax;
+                SurfaceBox(surface, boxMin, boxMax);
+                BlitML::vec3 boxCenter = (boxMin + boxMax) * 0.5f;
+
+                local[0][count] = surface.center.x;
+                local[1][count] = surface.center.y;
+                local[2][count] = surface.center.z;
+                local[3][count] = boxCenter.x;
+                local[4][count] = boxCenter.y;
+                local[5][count] = boxCenter.z;
+                orientation[0][count] = transform.orientation.x;
+                orientation[1][count] = transform.orientation.y;
+                orientation[2][count] = transform.orientation.z;
+                orientation[3][count] = transform.orientation.w;
+                blockObjects[count++] = objectId;
+            }
+
+            BlitML::BatchRotateQuat(orientations, sphereCenters, rotatedSphereCenters, count);
+            BlitML::BatchRotateQuat(orientations, boxCenters, rotatedBoxCenters, count);
+            BlitML::BatchQuatToMat4(orientations, rotations, count);
+
+            for(size_t i = 0; i < count; ++i)
+            {
+                const RenderObject& render = pRenders[blockObjects[i]];
+                const SurfaceCullData& surface = pSurfaces[render.surfaceId];
+                const MeshTransform& transform = pTransforms[render.transformId];
+                RenderWorldBounds& objectBounds = bounds[blockObjects[i]];
+
+                BlitML::vec3 sphereCenter(rotated[0][i], rotated[1][i], rotated[2][i]);
+                objectBounds.center = sphereCenter * transform.scale + transform.pos;
+                objectBounds.radius = surface.radius * transform.scale;
+
+                BlitML::vec3 boxMin;
+                BlitML::vec3 boxMax;
+                SurfaceBox(surface, boxMin, boxMax);
+                BlitML::vec3 boxCenter(rotated[3][i], rotated[4][i], rotated[5][i]);
+                RotatedBoxBounds(boxCenter * transform.scale + transform.pos, (boxMax - boxMin) * 0.5f * transform.scale, rotations[i],
+                objectBounds.boundsMin, objectBounds.boundsMax);
+                objectBounds.padding0 = 0.f;
+                objectBounds.padding1 = 0.f;
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "blitRenderingResources.h"
+#include "Meshoptimizer/meshoptimizer.h"
+
+namespace BlitzenEngine
+{
+    // Edge length of the cells that packed transform positions are relative to.
+    // Positions are stored with 16 bits per axis inside the cell, so this gives a precision of about 4mm
+    constexpr float ce_transformCellSize = 256.f;
+
+    // Packed transform cells are indexed with 16 bits
+    constexpr uint32_t ce_maxTransformCells = 1 << 16;
+
+    // 16 byte alternative to MeshTransform, decoded by LoadTransform in ShaderBuffers.glsl
+    struct PackedTransform
+    {
+        // Position inside the cell: cell origin + position / 65535 * cell size (3 16-bit unorm). The top 16 bits of the 2nd word are the cell index
+        uint32_t positionXY;
+        uint32_t positionZCell;
+
+        // Smallest three quaternion: 2 bits for the index of the largest component and 15 bits for each of the other 3.
+        // The last 15 bits are in the lower half of the 2nd word, the upper half holds the scale as a half float
+        uint32_t orientationLow;
+        uint32_t orientationHighScale;
+    };
+
+    static_assert(sizeof(PackedTransform) == 16, "PackedTransform layout should match the shaders");
+
+    inline uint32_t QuantizeUnorm16(float value)
+    {
+        value = value > 1.f ? 1.f : (value < 0.f ? 0.f : value);
+        return static_cast<uint32_t>(value * 65535.f + 0.5f);
+    }
+
+    // Returns 48 bits holding the orientation
+    inline uint64_t EncodeSmallestThreeQuat(const BlitML::quat& orientation)
+    {
+        BlitML::quat q = BlitML::NormalizeQuat(orientation);
+
+        uint32_t largest = 0;
+        for(uint32_t i = 1; i < 4; ++i)
+            if(BlitML::Abs(q.elements[i]) > BlitML::Abs(q.elements[largest]))
+                largest = i;
+
+        // q and -q are the same rotation, so the largest component is made positive and does not need its sign stored
+        float sign = q.elements[largest] < 0.f ? -1.f : 1.f;
+
+        // The other 3 components are within [-1/sqrt(2), 1/sqrt(2)]
+        constexpr float ce_componentScale = 1.41421356f;
+        uint64_t bits = largest;
+        uint32_t shift = 2;
+        for(uint32_t i = 0; i < 4; ++i)
+        {
+            if(i == largest)
+                continue;
+
+            float component = q.elements[i] * sign * ce_componentScale;
+            component = component > 1.f ? 1.f : (component < -1.f ? -1.f : component);
+            uint64_t quantized = static_cast<uint64_t>((component * 0.5f + 0.5f) * 32767.f + 0.5f);
+            bits |= quantized << shift;
+            shift += 15;
+        }
+
+        return bits;
+    }
+
+    // Same as DecodeSmallestThreeQuat in ShaderBuffers.glsl
+    inline BlitML::quat DecodeSmallestThreeQuat(uint64_t bits)
+    {
+        uint32_t largest = static_cast<uint32_t>(bits & 3);
+
+        BlitML::quat q;
+        float sumSquared = 0.f;
+        uint32_t shift = 2;
+        for(uint32_t i = 0; i < 4; ++i)
+        {
+            if(i == largest)
+                continue;
+
+            float quantized = static_cast<float>((bits >> shift) & 0x7FFF);
+            q.elements[i] = (quantized / 32767.f * 2.f - 1.f) / 1.41421356f;
+            sumSquared += q.elements[i] * q.elements[i];
+            shift += 15;
+        }
+        q.elements[largest] = BlitML::Sqrt(BlitML::Max(1.f - sumSquared, 0.f));
+
+        return q;
+    }
+
+    // Packs a transform that is inside the cell with the given origin
+    inline void EncodePackedTransform(const MeshTransform& transform, const BlitML::vec3& cellOrigin, uint32_t cellIndex,
+    PackedTransform& out)
+    {
+        float invCellSize = 1.f / ce_transformCellSize;
+        uint32_t x = QuantizeUnorm16((transform.pos.x - cellOrigin.x) * invCellSize);
+        uint32_t y = QuantizeUnorm16((transform.pos.y - cellOrigin.y) * invCellSize);
+        uint32_t z = QuantizeUnorm16((transform.pos.z - cellOrigin.z) * invCellSize);
+        out.positionXY = x | (y << 16);
+        out.positionZCell = z | (cellIndex << 16);
+
+        uint64_t orientation = EncodeSmallestThreeQuat(transform.orientation);
+        out.orientationLow = static_cast<uint32_t>(orientation);
+        out.orientationHighScale = static_cast<uint32_t>(orientation >> 32) |
+        (static_cast<uint32_t>(meshopt_quantizeHalf(transform.scale)) << 16);
+    }
+
+    // Same as LoadTransform in ShaderBuffers.glsl. The cell origin is the one of the cell index in positionZCell
+    inline MeshTransform DecodePackedTransform(const PackedTransform& packed, const BlitML::vec3& cellOrigin)
+    {
+        MeshTransform transform;
+        transform.pos.x = cellOrigin.x + (packed.positionXY & 0xFFFF) / 65535.f * ce_transformCellSize;
+        transform.pos.y = cellOrigin.y + (packed.positionXY >> 16) / 65535.f * ce_transformCellSize;
+        transform.pos.z = cellOrigin.z + (packed.positionZCell & 0xFFFF) / 65535.f * ce_transformCellSize;
+
+        transform.orientation = DecodeSmallestThreeQuat(packed.orientationLow |
+        (static_cast<uint64_t>(packed.orientationHighScale & 0xFFFF) << 32));
+        transform.scale = meshopt_dequantizeHalf(static_cast<unsigned short>(packed.orientationHighScale >> 16));
+
+        return transform;
+    }
+
+    // Packs every transform. Each transform is placed in the cell that contains its position and the origins of the cells that were used
+    // are written to cells (the 4th component is the cell size). Fails if the transforms are spread over more than ce_maxTransformCells
+    inline uint8_t PackMeshTransforms(BlitCL::DynamicArray<MeshTransform>& transforms,
+    BlitCL::DynamicArray<PackedTransform>& packed, BlitCL::DynamicArray<BlitML::vec4>& cells)
+    {
+        // Open addressing table from the integer cell coordinates to the cell index
+        constexpr size_t ce_tableSize = ce_maxTransformCells * 2;
+        uint64_t emptyKey = ~0ull;
+        BlitCL::DynamicArray<uint64_t> keys(ce_tableSize, emptyKey);
+        BlitCL::DynamicArray<uint32_t> values(ce_tableSize);
+
+        packed.Resize(transforms.GetSize());
+        for(size_t i = 0; i < transforms.GetSize(); ++i)
+        {
+            const MeshTransform& transform = transforms[i];
+            int32_t cellX = static_cast<int32_t>(floorf(transform.pos.x / ce_transformCellSize));
+            int32_t cellY = static_cast<int32_t>(floorf(transform.pos.y / ce_transformCellSize));
+            int32_t cellZ = static_cast<int32_t>(floorf(transform.pos.z / ce_transformCellSize));
+
+            // 21 bits per coordinate
+            uint64_t key = (static_cast<uint64_t>(cellX & 0x1FFFFF)) | (static_cast<uint64_t>(cellY & 0x1FFFFF) << 21) |
+            (static_cast<uint64_t>(cellZ & 0x1FFFFF) << 42);
+
+            size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 47) & (ce_tableSize - 1);
+            while(keys[slot] != emptyKey && keys[slot] != key)
+                slot = (slot + 1) & (ce_tableSize - 1);
+
+            if(keys[slot] == emptyKey)
+            {
+                if(cells.GetSize() == ce_maxTransformCells)
+                {
+                    BLIT_WARN("Transforms are spread over more than %u cells, they cannot be packed", ce_maxTransformCells)
+                    return 0;
+                }
+
+                keys[slot] = key;
+                values[slot] = static_cast<uint32_t>(cells.GetSize());
+                cells.PushBack(BlitML::vec4(cellX * ce_transformCellSize, cellY * ce_transformCellSize,
+                cellZ * ce_transformCellSize, ce_transformCellSize));
+            }
+
+            uint32_t cellIndex = values[slot];
+            BlitML::vec4& cell = cells[cellIndex];
+            EncodePackedTransform(transform, BlitML::vec3(cell.x, cell.y, cell.z), cellIndex, packed[i]);
+        }
+
+        return 1;
+    }
+}
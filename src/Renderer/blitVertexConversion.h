@@ -0,0 +1,51 @@
+#pragma once
+
+#include "blitRenderingResources.h"
+
+// SSE2 is part of every x64 target, anything else falls back to the scalar conversion loops.
+// AVX2 builds (BLIT_ML_AVX2) convert 8 elements at a time with gathers instead
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define BLIT_SSE2_VERTEX_CONVERSION
+    #include <emmintrin.h>
+#endif
+
+namespace BlitzenEngine
+{
+    // Where the float elements of a vertex attribute are read from. Element i is at pData + i * stride.
+    // When pIndices is set, element i is at pData + index * stride instead, with the index read from pIndices + i * indexStride bytes.
+    // Negative indices read pDefault. A stride of 0 repeats the same element
+    struct VertexAttributeSource
+    {
+        const uint8_t* pData = nullptr;
+        size_t stride = 0;
+
+        const int32_t* pIndices = nullptr;
+        size_t indexStride = 0;
+
+        const float* pDefault = nullptr;
+    };
+
+    // Same formula that the shaders use to unpack normals and tangents, clamped so that bad data does not wrap around
+    inline uint8_t QuantizeUnorm8(float value)
+    {
+        float scaled = value * 127.f + 127.5f;
+        return static_cast<uint8_t>(scaled < 0.f ? 0.f : scaled > 255.f ? 255.f : scaled);
+    }
+
+    // Every function below writes count vertices, starting from the first element of the source.
+    // The results are the same to the bit with or without SIMD
+
+    // float3 positions
+    void ConvertVertexPositions(const VertexAttributeSource& source, size_t count, Vertex* pVertices);
+
+    // float3 normals or float4 tangents to the 8 bit format of the vertex with QuantizeUnorm8.
+    // pDst points to the first byte of the attribute in the first vertex, the rest are found with sizeof(Vertex).
+    // Normals only write 3 bytes, so that normalW is left as it was
+    void ConvertVertexUnorm8(const VertexAttributeSource& source, size_t count, uint8_t componentCount, uint8_t* pDst);
+
+    // float2 uv maps to half floats, rounded the same way as meshopt_quantizeHalf
+    void ConvertVertexUvs(const VertexAttributeSource& source, size_t count, Vertex* pVertices);
+
+    // Same as EncodeCompactVertex for every vertex
+    void EncodeCompactVertices(const Vertex* pVertices, size_t count, const BlitML::vec3& center, float radius, CompactVertex* pOut);
+}
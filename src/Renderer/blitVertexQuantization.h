@@ -0,0 +1,77 @@
+#pragma once
+
+#include "blitRenderingResources.h"
+
+namespace BlitzenEngine
+{
+    // Float in [-1, 1] to a signed normalized 8-bit integer, rounded to nearest
+    inline int8_t QuantizeSnorm8(float value)
+    {
+        value = value > 1.f ? 1.f : (value < -1.f ? -1.f : value);
+        return static_cast<int8_t>(value * 127.f + (value >= 0.f ? 0.5f : -0.5f));
+    }
+
+    inline int16_t QuantizeSnorm16(float value)
+    {
+        value = value > 1.f ? 1.f : (value < -1.f ? -1.f : value);
+        return static_cast<int16_t>(value * 32767.f + (value >= 0.f ? 0.5f : -0.5f));
+    }
+
+    // Unit vector to 2 components on the octahedron. The lower hemisphere is folded over the diagonals
+    inline void EncodeOctahedralSnorm8(float x, float y, float z, int8_t& outX, int8_t& outY)
+    {
+        float length = BlitML::Abs(x) + BlitML::Abs(y) + BlitML::Abs(z);
+        if(length == 0.f)
+        {
+            // Degenerate vectors become +Z
+            outX = 0;
+            outY = 0;
+            return;
+        }
+
+        float octX = x / length;
+        float octY = y / length;
+        if(z < 0.f)
+        {
+            float foldedX = (1.f - BlitML::Abs(octY)) * (octX >= 0.f ? 1.f : -1.f);
+            float foldedY = (1.f - BlitML::Abs(octX)) * (octY >= 0.f ? 1.f : -1.f);
+            octX = foldedX;
+            octY = foldedY;
+        }
+
+        outX = QuantizeSnorm8(octX);
+        outY = QuantizeSnorm8(octY);
+    }
+
+    // Same as DecodeOctahedral in ShaderBuffers.glsl
+    inline BlitML::vec3 DecodeOctahedralSnorm8(int8_t x, int8_t y)
+    {
+        float octX = BlitML::Max(x / 127.f, -1.f);
+        float octY = BlitML::Max(y / 127.f, -1.f);
+        float z = 1.f - BlitML::Abs(octX) - BlitML::Abs(octY);
+        float t = BlitML::Max(-z, 0.f);
+        octX += octX >= 0.f ? -t : t;
+        octY += octY >= 0.f ? -t : t;
+        return BlitML::GetNormalized(BlitML::vec3(octX, octY, z));
+    }
+
+    // Converts a full vertex of a surface with the given bounding sphere. The sphere needs to contain the vertex
+    inline void EncodeCompactVertex(const Vertex& vertex, const BlitML::vec3& center, float radius, CompactVertex& out)
+    {
+        float invRadius = radius > 0.f ? 1.f / radius : 0.f;
+        out.positionX = QuantizeSnorm16((vertex.position.x - center.x) * invRadius);
+        out.positionY = QuantizeSnorm16((vertex.position.y - center.y) * invRadius);
+        out.positionZ = QuantizeSnorm16((vertex.position.z - center.z) * invRadius);
+
+        // The full vertex stores its normal and tangent as unsigned 8-bit (x * 127 + 127)
+        EncodeOctahedralSnorm8(vertex.normalX / 127.f - 1.f, vertex.normalY / 127.f - 1.f, vertex.normalZ / 127.f - 1.f,
+        out.normalX, out.normalY);
+        EncodeOctahedralSnorm8(vertex.tangentX / 127.f - 1.f, vertex.tangentY / 127.f - 1.f, vertex.tangentZ / 127.f - 1.f,
+        out.tangentX, out.tangentY);
+        out.tangentW = vertex.tangentW / 127.f - 1.f < 0.f ? -1 : 1;
+
+        out.uvX = vertex.uvX;
+        out.uvY = vertex.uvY;
+        out.padding = 0;
+    }
+}
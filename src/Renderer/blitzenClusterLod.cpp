@@ -0,0 +1,273 @@
+#include "blitClusterLod.h"
+
+// https://github.com/zeux/meshoptimizer
+#include "Meshoptimizer/meshoptimizer.h"
+
+#include <float.h>
+
+namespace BlitzenEngine
+{
+    // A cluster of the level that is being simplified. Its indices are kept so that it can be merged with its group
+    struct ClusterLodBuildCluster
+    {
+        size_t firstIndex;
+        size_t indexCount;
+
+        // Index into RenderingResources::lodClusters
+        uint32_t lodCluster;
+    };
+
+    // The clusters of one level of the hierarchy
+    struct ClusterLodLevel
+    {
+        BlitCL::DynamicArray<uint32_t> indices;
+        BlitCL::DynamicArray<ClusterLodBuildCluster> clusters;
+    };
+
+    // Splits the indices to meshlets and adds a lod cluster for each. Clusters that are built from a group get the group's bounds and error
+    static void AppendLodClusters(RenderingResources* pResources, BlitCL::DynamicArray<Vertex>& vertices,
+    BlitCL::DynamicArray<uint32_t>& indices, const BlitML::vec3& groupCenter, float groupRadius, float groupError,
+    uint32_t depth, ClusterLodLevel& level)
+    {
+        size_t firstMeshlet = pResources->meshlets.GetSize();
+        size_t meshletCount = GenerateClusters(vertices, indices, pResources->meshlets, pResources->meshletData);
+
+        for(size_t i = 0; i < meshletCount; ++i)
+        {
+            Meshlet& meshlet = pResources->meshlets[firstMeshlet + i];
+
+            LodCluster cluster;
+            cluster.center = depth ? groupCenter : meshlet.center;
+            cluster.radius = depth ? groupRadius : meshlet.radius;
+            cluster.error = depth ? groupError : 0.f;
+
+            // Every cluster starts as a root, until its group is simplified
+            cluster.parentCenter = cluster.center;
+            cluster.parentRadius = cluster.radius;
+            cluster.parentError = FLT_MAX;
+
+            cluster.meshlet = static_cast<uint32_t>(firstMeshlet + i);
+            cluster.depth = depth;
+
+            // The indices are read back from the meshlet data, one packed triangle after the vertex indices
+            ClusterLodBuildCluster buildCluster;
+            buildCluster.firstIndex = level.indices.GetSize();
+            buildCluster.indexCount = meshlet.triangleCount * 3;
+            buildCluster.lodCluster = static_cast<uint32_t>(pResources->lodClusters.GetSize());
+
+            level.indices.Resize(buildCluster.firstIndex + buildCluster.indexCount);
+            const uint32_t* pVertices = &pResources->meshletData[meshlet.dataOffset];
+            const uint32_t* pTriangles = pVertices + meshlet.vertexCount;
+            for(uint32_t t = 0; t < meshlet.triangleCount; ++t)
+            {
+                level.indices[buildCluster.firstIndex + t * 3] = pVertices[(pTriangles[t] >> 16) & 0xFF];
+                level.indices[buildCluster.firstIndex + t * 3 + 1] = pVertices[(pTriangles[t] >> 8) & 0xFF];
+                level.indices[buildCluster.firstIndex + t * 3 + 2] = pVertices[pTriangles[t] & 0xFF];
+            }
+
+            pResources->lodClusters.PushBack(cluster);
+            level.clusters.PushBack(buildCluster);
+        }
+    }
+
+    // Groups clusters that share the most vertices, ce_clusterLodGroupSize at a time.
+    // The clusters of group i are groupClusters[groupOffsets[i]] to groupClusters[groupOffsets[i + 1] - 1]
+    static void PartitionLodClusters(ClusterLodLevel& level, size_t vertexCount,
+    BlitCL::DynamicArray<uint32_t>& groupClusters, BlitCL::DynamicArray<uint32_t>& groupOffsets)
+    {
+        size_t clusterCount = level.clusters.GetSize();
+
+        // Lists the clusters that use each vertex, each cluster once
+        uint32_t zero = 0;
+        uint32_t none = ~0u;
+        BlitCL::DynamicArray<uint32_t> vertexClusterOffsets(vertexCount + 1, zero);
+        BlitCL::DynamicArray<uint32_t> lastCluster(vertexCount, none);
+        for(uint32_t c = 0; c < clusterCount; ++c)
+        {
+            ClusterLodBuildCluster& cluster = level.clusters[c];
+            for(size_t i = 0; i < cluster.indexCount; ++i)
+            {
+                uint32_t vertex = level.indices[cluster.firstIndex + i];
+                if(lastCluster[vertex] != c)
+                {
+                    lastCluster[vertex] = c;
+                    vertexClusterOffsets[vertex + 1]++;
+                }
+            }
+        }
+        for(size_t v = 0; v < vertexCount; ++v)
+            vertexClusterOffsets[v + 1] += vertexClusterOffsets[v];
+
+        BlitCL::DynamicArray<uint32_t> vertexClusters(vertexClusterOffsets[vertexCount]);
+        BlitCL::DynamicArray<uint32_t> vertexClusterCounts(vertexCount, zero);
+        for(size_t v = 0; v < vertexCount; ++v)
+            lastCluster[v] = none;
+        for(uint32_t c = 0; c < clusterCount; ++c)
+        {
+            ClusterLodBuildCluster& cluster = level.clusters[c];
+            for(size_t i = 0; i < cluster.indexCount; ++i)
+            {
+                uint32_t vertex = level.indices[cluster.firstIndex + i];
+                if(lastCluster[vertex] != c)
+                {
+                    lastCluster[vertex] = c;
+                    vertexClusters[vertexClusterOffsets[vertex] + vertexClusterCounts[vertex]++] = c;
+                }
+            }
+        }
+
+        uint8_t unassigned = 0;
+        BlitCL::DynamicArray<uint8_t> assigned(clusterCount, unassigned);
+        BlitCL::DynamicArray<uint32_t> sharedCounts(clusterCount, zero);
+        BlitCL::DynamicArray<uint32_t> candidates;
+
+        groupClusters.Downsize(0);
+        groupOffsets.Downsize(0);
+        for(uint32_t seed = 0; seed < clusterCount; ++seed)
+        {
+            if(assigned[seed])
+                continue;
+
+            size_t groupStart = groupClusters.GetSize();
+            groupOffsets.PushBack(static_cast<uint32_t>(groupStart));
+            groupClusters.PushBack(seed);
+            assigned[seed] = 1;
+
+            // Grows the group with the neighbour that shares the most triangle corners with it
+            while(groupClusters.GetSize() - groupStart < ce_clusterLodGroupSize)
+            {
+                for(size_t m = groupStart; m < groupClusters.GetSize(); ++m)
+                {
+                    ClusterLodBuildCluster& member = level.clusters[groupClusters[m]];
+                    for(size_t i = 0; i < member.indexCount; ++i)
+                    {
+                        uint32_t vertex = level.indices[member.firstIndex + i];
+                        for(uint32_t n = vertexClusterOffsets[vertex]; n < vertexClusterOffsets[vertex + 1]; ++n)
+                        {
+                            uint32_t neighbour = vertexClusters[n];
+                            if(assigned[neighbour])
+                                continue;
+                            if(sharedCounts[neighbour]++ == 0)
+                                candidates.PushBack(neighbour);
+                        }
+                    }
+                }
+
+                uint32_t best = none;
+                uint32_t bestShared = 0;
+                for(size_t i = 0; i < candidates.GetSize(); ++i)
+                {
+                    if(sharedCounts[candidates[i]] > bestShared)
+                    {
+                        bestShared = sharedCounts[candidates[i]];
+                        best = candidates[i];
+                    }
+                    sharedCounts[candidates[i]] = 0;
+                }
+                candidates.Downsize(0);
+
+                // Nothing left that touches the group
+                if(best == none)
+                    break;
+
+                groupClusters.PushBack(best);
+                assigned[best] = 1;
+            }
+        }
+        groupOffsets.PushBack(static_cast<uint32_t>(groupClusters.GetSize()));
+    }
+
+    void BuildClusterLod(RenderingResources* pResources, BlitCL::DynamicArray<Vertex>& vertices,
+    BlitCL::DynamicArray<uint32_t>& indices, PrimitiveSurface& surface)
+    {
+        // Same scale that the discrete lod errors use
+        float lodScale = meshopt_simplifyScale(&vertices[0].position.x, vertices.GetSize(), sizeof(Vertex));
+
+        surface.firstLodCluster = static_cast<uint32_t>(pResources->lodClusters.GetSize());
+
+        // Two levels are swapped, the next one is built from the groups of the current one
+        ClusterLodLevel levels[2];
+        uint8_t current = 0;
+        AppendLodClusters(pResources, vertices, indices, BlitML::vec3(0.f), 0.f, 0.f, 0, levels[current]);
+
+        BlitCL::DynamicArray<uint32_t> groupClusters;
+        BlitCL::DynamicArray<uint32_t> groupOffsets;
+        BlitCL::DynamicArray<uint32_t> groupIndices;
+        uint32_t depth = 0;
+        while(levels[current].clusters.GetSize() > 1)
+        {
+            ClusterLodLevel& level = levels[current];
+            ClusterLodLevel& next = levels[1 - current];
+            next.indices.Downsize(0);
+            next.clusters.Downsize(0);
+
+            PartitionLodClusters(level, vertices.GetSize(), groupClusters, groupOffsets);
+            for(size_t g = 0; g + 1 < groupOffsets.GetSize(); ++g)
+            {
+                uint32_t groupStart = groupOffsets[g];
+                uint32_t groupEnd = groupOffsets[g + 1];
+
+                // A cluster without neighbours stays a root
+                if(groupEnd - groupStart < 2)
+                    continue;
+
+                groupIndices.Downsize(0);
+                for(uint32_t m = groupStart; m < groupEnd; ++m)
+                {
+                    ClusterLodBuildCluster& member = level.clusters[groupClusters[m]];
+                    size_t offset = groupIndices.GetSize();
+                    groupIndices.Resize(offset + member.indexCount);
+                    BlitzenCore::BlitMemCopy(&groupIndices[offset], &level.indices[member.firstIndex], sizeof(uint32_t) * member.indexCount);
+                }
+
+                // Half of the triangles, with the group's border locked so that it still matches its neighbours
+                size_t targetIndexCount = (groupIndices.GetSize() / 6) * 3;
+                float simplifyError = 0.f;
+                BlitCL::DynamicArray<uint32_t> simplified(groupIndices.GetSize());
+                simplified.Downsize(meshopt_simplify(simplified.Data(), groupIndices.Data(), groupIndices.GetSize(),
+                &vertices[0].position.x, vertices.GetSize(), sizeof(Vertex), targetIndexCount, FLT_MAX,
+                meshopt_SimplifyLockBorder, &simplifyError));
+
+                // Groups that barely simplify are left as roots
+                if(simplified.GetSize() == 0 ||
+                simplified.GetSize() > static_cast<size_t>(groupIndices.GetSize() * ce_clusterLodMinReduction))
+                    continue;
+
+                // The group's sphere contains the spheres of its clusters and its error is not smaller than theirs,
+                // so the error that a cluster is tested with only grows towards the root
+                BlitML::vec3 groupCenter(0.f);
+                for(uint32_t m = groupStart; m < groupEnd; ++m)
+                    groupCenter = groupCenter + pResources->lodClusters[level.clusters[groupClusters[m]].lodCluster].center;
+                groupCenter = groupCenter / static_cast<float>(groupEnd - groupStart);
+
+                float groupRadius = 0.f;
+                float groupError = simplifyError * lodScale;
+                for(uint32_t m = groupStart; m < groupEnd; ++m)
+                {
+                    LodCluster& member = pResources->lodClusters[level.clusters[groupClusters[m]].lodCluster];
+                    groupRadius = BlitML::Max(groupRadius, BlitML::Distance(groupCenter, member.center) + member.radius);
+                    groupError = BlitML::Max(groupError, member.error);
+                }
+
+                for(uint32_t m = groupStart; m < groupEnd; ++m)
+                {
+                    LodCluster& member = pResources->lodClusters[level.clusters[groupClusters[m]].lodCluster];
+                    member.parentCenter = groupCenter;
+                    member.parentRadius = groupRadius;
+                    member.parentError = groupError;
+                }
+
+                AppendLodClusters(pResources, vertices, simplified, groupCenter, groupRadius, groupError, depth + 1, next);
+            }
+
+            current = 1 - current;
+            ++depth;
+        }
+
+        surface.lodClusterCount = static_cast<uint32_t>(pResources->lodClusters.GetSize()) - surface.firstLodCluster;
+
+        // The last cluster that was added is from the deepest level
+        BLIT_INFO("Cluster lod hierarchy: %i clusters, %i levels", surface.lodClusterCount, 
+        pResources->lodClusters[pResources->lodClusters.GetSize() - 1].depth + 1)
+    }
+}
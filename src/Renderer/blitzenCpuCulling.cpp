@@ -0,0 +1,460 @@
+#include "blitCpuCulling.h"
+#include "BlitzenMathLibrary/blitMLBatch.h"
+
+#include <thread>
+
+namespace BlitzenEngine
+{
+    // Objects are gathered to structure of arrays blocks of this size, so that the batch kernels see long streams
+    constexpr size_t ce_cpuCullBlockSize = 256;
+
+    // Lod of objects that do not get a draw command
+    constexpr uint8_t ce_cpuCullNoDraw = 0xFF;
+
+    // mat3(viewData.view) * v
+    static BlitML::vec3 ViewRotate(const BlitML::mat4& view, const BlitML::vec3& v)
+    {
+        const float* m = view.data;
+        return BlitML::vec3(m[0] * v.x + m[4] * v.y + m[8] * v.z, m[1] * v.x + m[5] * v.y + m[9] * v.z,
+        m[2] * v.x + m[6] * v.y + m[10] * v.z);
+    }
+
+    static float BoxProjectedRadius(const BlitML::vec3& direction, const BlitML::vec3& axisX, const BlitML::vec3& axisY,
+    const BlitML::vec3& axisZ)
+    {
+        return BlitML::Abs(BlitML::Dot(direction, axisX)) + BlitML::Abs(BlitML::Dot(direction, axisY)) +
+        BlitML::Abs(BlitML::Dot(direction, axisZ));
+    }
+
+    // Same as ViewBoxInFrustum in CullingShaderData.glsl
+    static uint8_t CpuViewBoxInFrustum(const BlitML::vec3& center, const BlitML::vec3& axisX, const BlitML::vec3& axisY,
+    const BlitML::vec3& axisZ, const CameraViewData& view)
+    {
+        // Like the sphere test, only the plane on the side of the center is tested
+        BlitML::vec3 sidePlane(center.x >= 0.f ? -view.frustumRight : view.frustumRight, 0.f, view.frustumLeft);
+        BlitML::vec3 verticalPlane(0.f, center.y >= 0.f ? -view.frustumTop : view.frustumTop, view.frustumBottom);
+        float depthRadius = BoxProjectedRadius(BlitML::vec3(0.f, 0.f, 1.f), axisX, axisY, axisZ);
+
+        uint8_t visible = BlitML::Dot(sidePlane, center) > -BoxProjectedRadius(sidePlane, axisX, axisY, axisZ);
+        visible = visible && BlitML::Dot(verticalPlane, center) > -BoxProjectedRadius(verticalPlane, axisX, axisY, axisZ);
+        visible = visible && center.z + depthRadius > view.zNear && center.z - depthRadius < view.zFar;
+        return visible;
+    }
+
+    // Same as BoxInFrustum in CullingShaderData.glsl
+    static uint8_t CpuBoxInFrustum(const SurfaceCullData& surface, const MeshTransform& transform, const CameraViewData& view)
+    {
+        BlitML::vec3 boxMin;
+        BlitML::vec3 boxMax;
+        SurfaceBox(surface, boxMin, boxMax);
+        BlitML::vec3 extents = (boxMax - boxMin) * 0.5f * transform.scale;
+
+        // The box's axes in view space
+        BlitML::vec3 axisX = ViewRotate(view.viewMatrix, BlitML::RotateQuat(BlitML::vec3(1.f, 0.f, 0.f), transform.orientation)) * extents.x;
+        BlitML::vec3 axisY = ViewRotate(view.viewMatrix, BlitML::RotateQuat(BlitML::vec3(0.f, 1.f, 0.f), transform.orientation)) * extents.y;
+        BlitML::vec3 axisZ = ViewRotate(view.viewMatrix, BlitML::RotateQuat(BlitML::vec3(0.f, 0.f, 1.f), transform.orientation)) * extents.z;
+
+        BlitML::vec3 center;
+        float unusedRadius;
+        BlitML::TransformSphereToView((boxMin + boxMax) * 0.5f, 0.f, transform.pos, transform.scale, transform.orientation,
+        view.viewMatrix, center, unusedRadius);
+
+        return CpuViewBoxInFrustum(center, axisX, axisY, axisZ, view);
+    }
+
+    // Same as WorldBoxInFrustum in CullingShaderData.glsl
+    static uint8_t CpuWorldBoxInFrustum(const RenderWorldBounds& bounds, const CameraViewData& view)
+    {
+        BlitML::vec3 extents = (bounds.boundsMax - bounds.boundsMin) * 0.5f;
+
+        // The box's axes are the world axes, their view space versions are the columns of the view rotation
+        BlitML::vec3 axisX = ViewRotate(view.viewMatrix, BlitML::vec3(1.f, 0.f, 0.f)) * extents.x;
+        BlitML::vec3 axisY = ViewRotate(view.viewMatrix, BlitML::vec3(0.f, 1.f, 0.f)) * extents.y;
+        BlitML::vec3 axisZ = ViewRotate(view.viewMatrix, BlitML::vec3(0.f, 0.f, 1.f)) * extents.z;
+
+        BlitML::vec3 center;
+        float unusedRadius;
+        BlitML::TransformSphereToView((bounds.boundsMin + bounds.boundsMax) * 0.5f, 0.f, BlitML::vec3(0.f), 1.f,
+        BlitML::quat(0.f, 0.f, 0.f, 1.f), view.viewMatrix, center, unusedRadius);
+
+        return CpuViewBoxInFrustum(center, axisX, axisY, axisZ, view);
+    }
+
+    // Same as ConeCulled in CullingShaderData.glsl
+    static uint8_t CpuConeCulled(const SurfaceCullData& surface, const MeshTransform& transform, const CameraViewData& view,
+    const BlitML::vec3& center, float radius)
+    {
+        BlitML::vec3 axis = BlitML::vec3(float(surface.coneAxis[0]), float(surface.coneAxis[1]), float(surface.coneAxis[2])) / 127.f;
+        float cutoff = float(surface.coneCutoff) / 127.f;
+        axis = ViewRotate(view.viewMatrix, BlitML::RotateQuat(axis, transform.orientation));
+        return BlitML::Dot(center, axis) >= cutoff * BlitML::Length(center) + radius;
+    }
+
+    // Same as SelectLod in CullingShaderData.glsl
+    static uint8_t CpuSelectLod(const SurfaceCullData& surface, float threshold)
+    {
+        uint8_t lodIndex = 0;
+        for(uint8_t i = 1; i < surface.lodCount; ++i)
+            if(meshopt_dequantizeHalf(surface.lodErrors[i - 1]) < threshold)
+                lodIndex = i;
+        return lodIndex;
+    }
+
+    // Whether the pass looks at the object at all, the shaders return before doing anything for the rest
+    static uint8_t CpuCullPassIncludes(const SurfaceCullData& surface, const CpuCullSettings& settings, const uint32_t* pVisibilities,
+    uint32_t objectId)
+    {
+        uint8_t postPass = (surface.flags & ce_surfaceCullPostPass) != 0;
+        if(settings.bLatePass)
+            return settings.bOcclusion && postPass == (settings.bPostPass != 0);
+
+        if(settings.bOcclusion && pVisibilities[objectId] == 0)
+            return 0;
+        return !postPass;
+    }
+
+    // Objects that a cull visits, all of them unless the scene has a list
+    static uint32_t CpuCullCount(const CpuCullScene& scene)
+    {
+        return scene.pObjectIds ? scene.objectCount : scene.renderCount;
+    }
+
+    static uint32_t CpuCullObject(const CpuCullScene& scene, uint32_t i)
+    {
+        return scene.pObjectIds ? scene.pObjectIds[i] : i;
+    }
+
+    // Culls the objects that the cull visits first to last - 1. Writes their lod, or ce_cpuCullNoDraw, to pLods 
+    // and counts the commands of each index buffer
+    static void CpuCullRange(const CpuCullScene& scene, const CameraViewData& view, const CpuCullSettings& settings,
+    uint32_t* pVisibilities, uint8_t* pLods, uint32_t first, uint32_t last, uint32_t& drawCount, uint32_t& drawCount16)
+    {
+        BlitML::ViewFrustum frustum{view.frustumRight, view.frustumLeft, view.frustumTop, view.frustumBottom, view.zNear, view.zFar};
+
+        float sphere[4][ce_cpuCullBlockSize];
+        float transform[8][ce_cpuCullBlockSize];
+        float viewSphere[4][ce_cpuCullBlockSize];
+        uint8_t sphereVisible[ce_cpuCullBlockSize];
+        float rect[4][ce_cpuCullBlockSize];
+        uint8_t rectValid[ce_cpuCullBlockSize];
+
+        BlitML::SphereStream spheres{sphere[0], sphere[1], sphere[2], sphere[3]};
+        BlitML::TransformStream transforms{transform[0], transform[1], transform[2], transform[3],
+        {transform[4], transform[5], transform[6], transform[7]}};
+        BlitML::SphereStream viewSpheres{viewSphere[0], viewSphere[1], viewSphere[2], viewSphere[3]};
+        BlitML::RectStream rects{rect[0], rect[1], rect[2], rect[3]};
+
+        // The occlusion test of the late pass, when the caller has a depth pyramid to test against
+        uint8_t bOcclusionTest = settings.bLatePass && scene.pDepthPyramid;
+
+        drawCount = 0;
+        drawCount16 = 0;
+        for(uint32_t block = first; block < last; block += ce_cpuCullBlockSize)
+        {
+            size_t count = last - block < ce_cpuCullBlockSize ? last - block : ce_cpuCullBlockSize;
+
+            // Gathers the bounding sphere and transform of each object.
+            // Baked spheres are already in world space, so they go through an identity transform, which leaves them exactly as they are
+            for(size_t i = 0; i < count; ++i)
+            {
+                uint32_t objectId = CpuCullObject(scene, block + static_cast<uint32_t>(i));
+                if(scene.pWorldBounds && scene.pWorldBounds[objectId].radius >= 0.f)
+                {
+                    const RenderWorldBounds& worldBounds = scene.pWorldBounds[objectId];
+                    sphere[0][i] = worldBounds.center.x;
+                    sphere[1][i] = worldBounds.center.y;
+                    sphere[2][i] = worldBounds.center.z;
+                    sphere[3][i] = worldBounds.radius;
+                    transform[0][i] = 0.f;
+                    transform[1][i] = 0.f;
+                    transform[2][i] = 0.f;
+                    transform[3][i] = 1.f;
+                    transform[4][i] = 0.f;
+                    transform[5][i] = 0.f;
+                    transform[6][i] = 0.f;
+                    transform[7][i] = 1.f;
+                    continue;
+                }
+
+                const RenderObject& render = scene.pRenders[objectId];
+                const SurfaceCullData& surface = scene.pSurfaces[render.surfaceId];
+                const MeshTransform& meshTransform = scene.pTransforms[render.transformId];
+                sphere[0][i] = surface.center.x;
+                sphere[1][i] = surface.center.y;
+                sphere[2][i] = surface.center.z;
+                sphere[3][i] = surface.radius;
+                transform[0][i] = meshTransform.pos.x;
+                transform[1][i] = meshTransform.pos.y;
+                transform[2][i] = meshTransform.pos.z;
+                transform[3][i] = meshTransform.scale;
+                transform[4][i] = meshTransform.orientation.x;
+                transform[5][i] = meshTransform.orientation.y;
+                transform[6][i] = meshTransform.orientation.z;
+                transform[7][i] = meshTransform.orientation.w;
+            }
+
+            BlitML::BatchTransformSpheresToView(spheres, transforms, view.viewMatrix, viewSpheres, count);
+            BlitML::BatchSpheresInFrustum(viewSpheres, frustum, sphereVisible, count);
+            if(bOcclusionTest)
+                BlitML::BatchProjectSpheres(viewSpheres, view.zNear, view.proj0, view.proj5, rects, rectValid, count);
+
+            // The rest of the tests only run for objects whose sphere passed, like in the shaders
+            for(size_t i = 0; i < count; ++i)
+            {
+                uint32_t objectId = CpuCullObject(scene, block + static_cast<uint32_t>(i));
+                pLods[block + i] = ce_cpuCullNoDraw;
+
+                // The initial pass writes nothing for objects outside the frustum, so like the shader it skips them before reading their surface
+                if(!settings.bLatePass && !sphereVisible[i])
+                    continue;
+
+                const RenderObject& render = scene.pRenders[objectId];
+                const SurfaceCullData& surface = scene.pSurfaces[render.surfaceId];
+                if(!CpuCullPassIncludes(surface, settings, pVisibilities, objectId))
+                    continue;
+
+                const MeshTransform& meshTransform = scene.pTransforms[render.transformId];
+                BlitML::vec3 center(viewSphere[0][i], viewSphere[1][i], viewSphere[2][i]);
+                float radius = viewSphere[3][i];
+
+                // Static objects test their baked world box, the rest the box of their surface after the transform
+                uint8_t bStatic = scene.pWorldBounds && scene.pWorldBounds[objectId].radius >= 0.f;
+                uint8_t visible = sphereVisible[i] && (bStatic ? CpuWorldBoxInFrustum(scene.pWorldBounds[objectId], view) :
+                CpuBoxInFrustum(surface, meshTransform, view));
+                visible = visible && !(settings.bConeCulling && CpuConeCulled(surface, meshTransform, view, center, radius));
+
+                // Spheres that cross the near plane have no rectangle and are never occluded
+                if(bOcclusionTest && visible && rectValid[i])
+                {
+                    BlitML::vec4 sphereRect(rect[0][i], rect[1][i], rect[2][i], rect[3][i]);
+                    visible = SphereRectVisibleInPyramid(*scene.pDepthPyramid, view, sphereRect, center.z, radius);
+                }
+
+                uint8_t bDraw = visible;
+                if(settings.bLatePass)
+                {
+                    bDraw = visible && (pVisibilities[objectId] == 0 || settings.bPostPass);
+                    pVisibilities[objectId] = visible;
+                }
+                if(!bDraw)
+                    continue;
+
+                uint8_t lodIndex = 0;
+                if(settings.bLod)
+                {
+                    float distance = BlitML::Max(BlitML::Length(center) - radius, 0.f);
+                    float threshold = distance * view.lodTarget / meshTransform.scale;
+                    lodIndex = CpuSelectLod(surface, threshold);
+                }
+                pLods[block + i] = lodIndex;
+
+                if(surface.flags & ce_surfaceCullIndices16)
+                    drawCount16++;
+                else
+                    drawCount++;
+            }
+        }
+    }
+
+    // Writes the commands of the objects that the cull visits first to last - 1, starting from the given elements of each index buffer's part
+    static void CpuWriteDrawCommands(const CpuCullScene& scene, const uint8_t* pLods, uint32_t first, uint32_t last,
+    uint8_t bInstancedDraws, CpuDrawCommand* pCommands, uint32_t drawIndex, uint32_t drawIndex16)
+    {
+        for(uint32_t i = first; i < last; ++i)
+        {
+            if(pLods[i] == ce_cpuCullNoDraw)
+                continue;
+
+            uint32_t objectId = CpuCullObject(scene, i);
+            uint32_t surfaceId = scene.pRenders[objectId].surfaceId;
+            const SurfaceLodDraw& lod = scene.pLodDraws[surfaceId * ce_primitiveSurfaceMaxLODCount + pLods[i]];
+
+            CpuDrawCommand& command = (scene.pSurfaces[surfaceId].flags & ce_surfaceCullIndices16) ?
+            pCommands[scene.renderCount + drawIndex16++] : pCommands[drawIndex++];
+            command.objectId = objectId;
+            command.indexCount = lod.indexCount;
+            command.instanceCount = 1;
+            command.firstIndex = lod.firstIndex;
+            command.vertexOffset = lod.vertexOffset;
+            command.firstInstance = bInstancedDraws ? surfaceId * ce_primitiveSurfaceMaxLODCount + pLods[i] : 0;
+        }
+    }
+
+    void CpuDrawCull(const CpuCullScene& scene, const CameraViewData& view, const CpuCullSettings& settings,
+    uint32_t* pVisibilities, CpuDrawCommand* pCommands, CpuDrawCounts& counts, uint32_t threadCount)
+    {
+        counts.drawCount = 0;
+        counts.drawCount16 = 0;
+        uint32_t cullCount = CpuCullCount(scene);
+        if(cullCount == 0)
+            return;
+
+        if(threadCount == 0)
+            threadCount = static_cast<uint32_t>(std::thread::hardware_concurrency());
+        threadCount = BlitML::Clamp(threadCount, (cullCount + ce_cpuCullBlockSize - 1) / ce_cpuCullBlockSize, 1u);
+
+        // Each thread takes a contiguous range, so that the commands can be written in object order once the counts are known
+        BlitCL::DynamicArray<uint32_t> rangeStarts(threadCount + 1);
+        for(uint32_t i = 0; i <= threadCount; ++i)
+            rangeStarts[i] = static_cast<uint32_t>(uint64_t(cullCount) * i / threadCount);
+
+        BlitCL::DynamicArray<uint8_t> lods(cullCount);
+        BlitCL::DynamicArray<uint32_t> drawCounts(threadCount);
+        BlitCL::DynamicArray<uint32_t> drawCounts16(threadCount);
+
+        // Culling, the calling thread takes the first range
+        BlitCL::DynamicArray<std::thread> workers(threadCount - 1);
+        auto cullRange = [&](uint32_t i)
+        {
+            CpuCullRange(scene, view, settings, pVisibilities, lods.Data(), rangeStarts[i], rangeStarts[i + 1], drawCounts[i], drawCounts16[i]);
+        };
+        for(uint32_t i = 1; i < threadCount; ++i)
+        {
+            workers[i - 1] = std::thread(cullRange, i);
+        }
+        cullRange(0);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+
+        // The commands of each range start after the ones of the ranges before it
+        BlitCL::DynamicArray<uint32_t> drawStarts(threadCount);
+        BlitCL::DynamicArray<uint32_t> drawStarts16(threadCount);
+        for(uint32_t i = 0; i < threadCount; ++i)
+        {
+            drawStarts[i] = counts.drawCount;
+            drawStarts16[i] = counts.drawCount16;
+            counts.drawCount += drawCounts[i];
+            counts.drawCount16 += drawCounts16[i];
+        }
+
+        auto writeRange = [&](uint32_t i)
+        {
+            CpuWriteDrawCommands(scene, lods.Data(), rangeStarts[i], rangeStarts[i + 1], settings.bInstancedDraws, pCommands, 
+            drawStarts[i], drawStarts16[i]);
+        };
+        for(uint32_t i = 1; i < threadCount; ++i)
+        {
+            workers[i - 1] = std::thread(writeRange, i);
+        }
+        writeRange(0);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+    }
+
+    // The commands of both index buffers, as one sequence. The 16-bit ones start at counts.drawCount
+    static CpuDrawCommand& CpuVisibleCommand(const CpuCullScene& scene, CpuDrawCommand* pCommands, const CpuDrawCounts& counts, uint32_t i)
+    {
+        return i < counts.drawCount ? pCommands[i] : pCommands[scene.renderCount + i - counts.drawCount];
+    }
+
+    void CpuCompactInstancedDraws(const CpuCullScene& scene, uint32_t surfaceCount, CpuDrawCommand* pCommands, CpuDrawCounts& counts,
+    CpuInstancedDraws& draws, uint32_t threadCount)
+    {
+        uint32_t bucketCount = surfaceCount * ce_primitiveSurfaceMaxLODCount;
+        uint32_t commandCount = counts.drawCount + counts.drawCount16;
+        // Nothing visible, there are no buckets to fill and the commands stay empty
+        if(bucketCount == 0 || commandCount == 0)
+        {
+            draws.bucketCounts.Clear();
+            draws.bucketOffsets.Clear();
+            draws.instances.Clear();
+            return;
+        }
+
+        // Every thread counts its own range of commands into its own row of buckets. 
+        // Threads are limited so that clearing and adding the rows does not take longer than counting
+        if(threadCount == 0)
+            threadCount = static_cast<uint32_t>(std::thread::hardware_concurrency());
+        threadCount = BlitML::Max(1u, BlitML::Min(threadCount, commandCount / (bucketCount + ce_cpuCullBlockSize)));
+
+        BlitCL::DynamicArray<uint32_t> rangeStarts(threadCount + 1);
+        for(uint32_t i = 0; i <= threadCount; ++i)
+            rangeStarts[i] = static_cast<uint32_t>(uint64_t(commandCount) * i / threadCount);
+
+        BlitCL::DynamicArray<uint32_t> threadCounts(size_t(threadCount) * bucketCount, uint32_t(0));
+        BlitCL::DynamicArray<std::thread> workers(threadCount - 1);
+
+        // Counter pass
+        auto countRange = [&](uint32_t t)
+        {
+            uint32_t* pCounts = &threadCounts[size_t(t) * bucketCount];
+            for(uint32_t i = rangeStarts[t]; i < rangeStarts[t + 1]; ++i)
+            {
+                pCounts[CpuVisibleCommand(scene, pCommands, counts, i).firstInstance]++;
+            }
+        };
+        for(uint32_t i = 1; i < threadCount; ++i)
+        {
+            workers[i - 1] = std::thread(countRange, i);
+        }
+        countRange(0);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+
+        // Prefix sum. The rows are turned into where each thread's objects start in its bucket
+        // The arrays are kept between frames, Resize only grows them and Downsize only shrinks them
+        draws.bucketCounts.Resize(bucketCount);
+        draws.bucketCounts.Downsize(bucketCount);
+        draws.bucketOffsets.Resize(bucketCount);
+        draws.bucketOffsets.Downsize(bucketCount);
+        uint32_t offset = 0;
+        for(uint32_t bucket = 0; bucket < bucketCount; ++bucket)
+        {
+            draws.bucketOffsets[bucket] = offset;
+            for(uint32_t t = 0; t < threadCount; ++t)
+            {
+                uint32_t count = threadCounts[size_t(t) * bucketCount + bucket];
+                threadCounts[size_t(t) * bucketCount + bucket] = offset;
+                offset += count;
+            }
+            draws.bucketCounts[bucket] = offset - draws.bucketOffsets[bucket];
+        }
+
+        // Scatter of the object ids
+        draws.instances.Resize(commandCount);
+        draws.instances.Downsize(commandCount);
+        auto scatterRange = [&](uint32_t t)
+        {
+            uint32_t* pCursors = &threadCounts[size_t(t) * bucketCount];
+            for(uint32_t i = rangeStarts[t]; i < rangeStarts[t + 1]; ++i)
+            {
+                const CpuDrawCommand& command = CpuVisibleCommand(scene, pCommands, counts, i);
+                draws.instances[pCursors[command.firstInstance]++] = command.objectId;
+            }
+        };
+        for(uint32_t i = 1; i < threadCount; ++i)
+        {
+            workers[i - 1] = std::thread(scatterRange, i);
+        }
+        scatterRange(0);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+
+        // One command for every bucket with objects, after the object commands have been read
+        counts.drawCount = 0;
+        counts.drawCount16 = 0;
+        for(uint32_t bucket = 0; bucket < bucketCount; ++bucket)
+        {
+            if(draws.bucketCounts[bucket] == 0)
+                continue;
+
+            const SurfaceLodDraw& lod = scene.pLodDraws[bucket];
+            CpuDrawCommand& command = (scene.pSurfaces[bucket / ce_primitiveSurfaceMaxLODCount].flags & ce_surfaceCullIndices16) ?
+            pCommands[scene.renderCount + counts.drawCount16++] : pCommands[counts.drawCount++];
+            command.objectId = bucket;
+            command.indexCount = lod.indexCount;
+            command.instanceCount = draws.bucketCounts[bucket];
+            command.firstIndex = lod.firstIndex;
+            command.vertexOffset = lod.vertexOffset;
+            command.firstInstance = draws.bucketOffsets[bucket];
+        }
+    }
+}
@@ -0,0 +1,189 @@
+#include "blitCpuFrame.h"
+
+namespace BlitzenEngine
+{
+    void CreateCpuFrame(RenderingResources* pResources, CpuFrameContext& frame, uint32_t threadCount)
+    {
+        BuildSurfaceCullTables(pResources->surfaces, frame.surfaceCullData, frame.surfaceLodDraws);
+
+        CpuCullScene scene;
+        scene.pRenders = pResources->renders;
+        scene.renderCount = pResources->renderObjectCount;
+        scene.pTransforms = pResources->transforms.Data();
+        scene.pSurfaces = frame.surfaceCullData.Data();
+        scene.pLodDraws = frame.surfaceLodDraws.Data();
+        CreateCpuFrame(scene, static_cast<uint32_t>(pResources->surfaces.GetSize()), pResources->transforms.GetSize(),
+        pResources->dynamicTransforms, frame, threadCount);
+
+        frame.settings.bInstancedDraws = pResources->bInstancedDraws;
+
+        // Every surface has an occluder when they were built at import, the ones that could not be simplified have no indices
+        if(pResources->occluders.GetSize() == pResources->surfaces.GetSize())
+        {
+            frame.pOccluderMeshes = pResources->occluders.Data();
+            frame.pOccluderVertices = pResources->occluderVertices.Data();
+            frame.pOccluderIndices = pResources->occluderIndices.Data();
+        }
+    }
+
+    void CreateCpuFrame(const CpuCullScene& scene, uint32_t surfaceCount, size_t transformCount,
+    BlitCL::DynamicArray<uint32_t>& dynamicTransforms, CpuFrameContext& frame, uint32_t threadCount)
+    {
+        frame.scene = scene;
+        frame.surfaceCount = surfaceCount;
+        frame.threadCount = threadCount;
+
+        BuildRenderWorldBounds(scene.pRenders, scene.renderCount, scene.pTransforms, transformCount, scene.pSurfaces,
+        dynamicTransforms, frame.worldBounds);
+        frame.scene.pWorldBounds = frame.worldBounds.Data();
+
+        // Nothing has been visible yet, so the first initial pass draws nothing and the late pass draws everything that passes.
+        // The arrays are kept when a frame is created again, Resize only grows them and Downsize only shrinks them
+        frame.visibilities.Resize(scene.renderCount);
+        frame.visibilities.Downsize(scene.renderCount);
+        BlitzenCore::BlitZeroMemory(frame.visibilities.Data(), frame.visibilities.GetSize() * sizeof(uint32_t));
+        frame.commands.Resize(size_t(scene.renderCount) * 2);
+        frame.commands.Downsize(size_t(scene.renderCount) * 2);
+        frame.counts = {0, 0};
+        frame.stats = {};
+
+        // The frame picks the objects of each pass itself
+        frame.scene.pObjectIds = nullptr;
+        frame.scene.objectCount = 0;
+        BuildRenderBvh(frame.scene, frame.bvh, threadCount);
+        frame.bTransformsMoved = 0;
+        frame.candidates.Clear();
+        frame.candidateFlags.Resize(scene.renderCount);
+        frame.candidateFlags.Downsize(scene.renderCount);
+        BlitzenCore::BlitZeroMemory(frame.candidateFlags.Data(), frame.candidateFlags.GetSize());
+    }
+
+    // Puts the objects of the frustum query in increasing order, the order of the commands of a full cull.
+    // Only objects that were candidates can be visible, so the ones that left the frustum are hidden, like the late pass would do
+    static void GatherFrameCandidates(CpuFrameContext& frame, const CameraViewData& view)
+    {
+        if(frame.bTransformsMoved)
+        {
+            RefitRenderBvh(frame.scene, frame.bvh, frame.threadCount);
+            frame.bTransformsMoved = 0;
+        }
+
+        frame.bvhResults.Clear();
+        QueryRenderBvhFrustum(frame.bvh, frame.scene, view, frame.bvhResults);
+
+        uint8_t* pFlags = frame.candidateFlags.Data();
+        uint32_t firstFlag = frame.scene.renderCount;
+        uint32_t lastFlag = 0;
+        for(size_t i = 0; i < frame.bvhResults.GetSize(); ++i)
+        {
+            uint32_t objectId = frame.bvhResults[i];
+            pFlags[objectId] = 1;
+            firstFlag = BlitML::Min(firstFlag, objectId);
+            lastFlag = BlitML::Max(lastFlag, objectId + 1);
+        }
+
+        // After a frame that culled every object, any of them can be visible
+        if(!frame.scene.pObjectIds)
+        {
+            for(uint32_t objectId = 0; objectId < frame.scene.renderCount; ++objectId)
+            {
+                if(!pFlags[objectId])
+                    frame.visibilities[objectId] = 0;
+            }
+        }
+        else
+        {
+            for(size_t i = 0; i < frame.candidates.GetSize(); ++i)
+            {
+                if(!pFlags[frame.candidates[i]])
+                    frame.visibilities[frame.candidates[i]] = 0;
+            }
+        }
+
+        frame.candidates.Clear();
+        for(uint32_t objectId = firstFlag; objectId < lastFlag; ++objectId)
+        {
+            if(pFlags[objectId])
+            {
+                frame.candidates.PushBack(objectId);
+                pFlags[objectId] = 0;
+            }
+        }
+    }
+
+    // Rasterizes the objects that the initial pass drew and whose surface has an occluder, 
+    // then builds the depth pyramid that the late and post pass test against
+    static void BuildFrameDepthPyramid(CpuFrameContext& frame, const CameraViewData& view)
+    {
+        const CpuCullScene& scene = frame.scene;
+        frame.occluders.Clear();
+        for(uint32_t i = 0; i < frame.counts.drawCount + frame.counts.drawCount16; ++i)
+        {
+            const CpuDrawCommand& command = i < frame.counts.drawCount ? frame.commands[i] : 
+            frame.commands[scene.renderCount + i - frame.counts.drawCount];
+            if(frame.pOccluderMeshes[scene.pRenders[command.objectId].surfaceId].indexCount != 0)
+                frame.occluders.PushBack(command.objectId);
+        }
+        frame.stats.occluders = static_cast<uint32_t>(frame.occluders.GetSize());
+
+        // proj0 is proj5 divided by the aspect ratio
+        uint32_t height = BlitML::Max(1u, static_cast<uint32_t>(frame.depthBufferWidth * view.proj0 / view.proj5 + 0.5f));
+        ResizeSoftwareDepthBuffer(frame.depthBuffer, frame.depthBufferWidth, height);
+
+        SoftwareOcclusionScene occlusion;
+        occlusion.pRenders = scene.pRenders;
+        occlusion.pTransforms = scene.pTransforms;
+        occlusion.pOccluders = frame.occluders.Data();
+        occlusion.occluderCount = frame.stats.occluders;
+        occlusion.pOccluderMeshes = frame.pOccluderMeshes;
+        occlusion.pOccluderVertices = frame.pOccluderVertices;
+        occlusion.pOccluderIndices = frame.pOccluderIndices;
+        RasterizeOccluders(occlusion, view, frame.depthBuffer, frame.threadCount);
+        BuildSoftwareDepthPyramid(frame.depthBuffer, frame.depthPyramid);
+        frame.scene.pDepthPyramid = &frame.depthPyramid;
+    }
+
+    void CpuDrawFrame(CpuFrameContext& frame, const CameraViewData& view, CpuDrawPassCallback drawPass, void* pUserData)
+    {
+        frame.stats = {};
+
+        if(frame.bHierarchyCull)
+        {
+            GatherFrameCandidates(frame, view);
+            frame.scene.pObjectIds = frame.candidates.Data();
+            frame.scene.objectCount = static_cast<uint32_t>(frame.candidates.GetSize());
+        }
+        else
+        {
+            frame.scene.pObjectIds = nullptr;
+            frame.scene.objectCount = 0;
+        }
+        frame.stats.culledObjects = frame.scene.pObjectIds ? frame.scene.objectCount : frame.scene.renderCount;
+
+        // The pyramid is built from this frame's initial pass
+        frame.scene.pDepthPyramid = nullptr;
+
+        uint8_t passCount = frame.settings.bOcclusion ? ce_cpuFramePassCount : 1;
+        for(uint8_t i = 0; i < passCount; ++i)
+        {
+            CpuCullSettings pass = frame.settings;
+            pass.bLatePass = i != 0;
+            pass.bPostPass = i == 2;
+
+            CpuDrawCull(frame.scene, view, pass, frame.visibilities.Data(), frame.commands.Data(), frame.counts, frame.threadCount);
+            frame.stats.passDraws[i] = frame.counts.drawCount + frame.counts.drawCount16;
+            if(i == 0 && pass.bOcclusion && frame.pOccluderMeshes)
+                BuildFrameDepthPyramid(frame, view);
+
+            // The occluders are read from the object commands, so the buckets replace them after
+            if(pass.bInstancedDraws)
+            {
+                CpuCompactInstancedDraws(frame.scene, frame.surfaceCount, frame.commands.Data(), frame.counts, frame.instancedDraws, 
+                frame.threadCount);
+            }
+
+            if(drawPass)
+                drawPass(frame, pass, pUserData);
+        }
+    }
+}
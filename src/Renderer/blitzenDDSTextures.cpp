@@ -1,30 +1,44 @@
 #include "blitDDSTextures.h"
 #include "Core/blitzenContainerLibrary.h"
-#include "Platform/filesystem.h"
+#include "Platform/assetPack.h"
+#include "Platform/asyncIO.h"
+#include <string.h>
 
 #include "Renderer/blitRenderer.h"
 #include "BlitzenVulkan/vulkanRenderer.h"
 
 namespace BlitzenEngine
 {
-    uint8_t LoadDDSImage(const char* filepath, DDS_HEADER& header, DDS_HEADER_DXT10& header10, 
-	unsigned int& vulkanImageFormat, RendererToLoadDDS chosenRenderer, void* pData)
-    {
-		BlitzenPlatform::FileHandle handle;
-		if(!handle.Open(filepath, BlitzenPlatform::FileModes::Read, 1))
-			return 0;
+	// Largest header of a DDS file, the magic number followed by DDS_HEADER and DDS_HEADER_DXT10
+	constexpr size_t ce_ddsMaxHeaderSize = sizeof(unsigned int) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
 
-		FILE* file = reinterpret_cast<FILE*>(handle.pHandle);
+	// Loose textures are read in ce_asyncIORangeChunkSize pieces, this many of them at once
+	constexpr uint32_t ce_ddsReadQueueDepth = 64;
+
+	// Checks the header at the start of the file, of which size bytes are in pBytes, and finds where the image data is and its size
+	static uint8_t ParseDDSHeader(const uint8_t* pBytes, size_t size, DDS_HEADER& header, DDS_HEADER_DXT10& header10, 
+	unsigned int& vulkanImageFormat, RendererToLoadDDS chosenRenderer, size_t& dataOffset, size_t& imageSize)
+	{
+		// Bounds checked reads from the start of the file
+		size_t offset = 0;
+		auto ReadBytes = [pBytes, size, &offset](void* pDst, size_t readSize) -> uint8_t
+		{
+			if (readSize > size - offset)
+				return 0;
+			memcpy(pDst, pBytes + offset, readSize);
+			offset += readSize;
+			return 1;
+		};
 
 	    unsigned int magic = 0;
 
-	    if (fread(&magic, sizeof(magic), 1, file) != 1 || magic != FourCC("DDS "))
+	    if (!ReadBytes(&magic, sizeof(magic)) || magic != FourCC("DDS "))
 		    return 0;
 
-	    if (fread(&header, sizeof(header), 1, file) != 1)
+	    if (!ReadBytes(&header, sizeof(header)))
 		    return 0;
 
-	    if (header.ddspf.dwFourCC == FourCC("DX10") && fread(&header10, sizeof(header10), 1, file) != 1)
+	    if (header.ddspf.dwFourCC == FourCC("DX10") && !ReadBytes(&header10, sizeof(header10)))
 		    return 0;
 
 	    if (header.dwSize != sizeof(header) || header.ddspf.dwSize != sizeof(header.ddspf))
@@ -36,6 +50,7 @@ namespace BlitzenEngine
 	    if (header.ddspf.dwFourCC == FourCC("DX10") && header10.resourceDimension != DDS_DIMENSION_TEXTURE2D)
 		    return 0;
 
+		dataOffset = offset;
 		switch (chosenRenderer)
 		{
 			case RendererToLoadDDS::Vulkan:
@@ -48,15 +63,7 @@ namespace BlitzenEngine
 				unsigned int blockSize =
 					(vulkanImageFormat == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || vulkanImageFormat == VK_FORMAT_BC4_SNORM_BLOCK
 						|| vulkanImageFormat == VK_FORMAT_BC4_UNORM_BLOCK) ? 8 : 16;
-				size_t imageSize = GetDDSImageSizeBC(header.dwWidth, header.dwHeight, header.dwMipMapCount, blockSize);
-
-				size_t readSize = fread(pData, 1, imageSize, file);
-
-				if (!pData)
-					return 0;
-
-				if (readSize != imageSize)
-					return 0;
+				imageSize = GetDDSImageSizeBC(header.dwWidth, header.dwHeight, header.dwMipMapCount, blockSize);
 
 				return 1;
 			}
@@ -64,23 +71,78 @@ namespace BlitzenEngine
 			case RendererToLoadDDS::Opengl:
 			{
 				size_t blockSize = GetDDSBlockSize(header, header10);
-				size_t imageSize = GetDDSImageSizeBC(header.dwWidth, header.dwHeight, header.dwMipMapCount, 
+				imageSize = GetDDSImageSizeBC(header.dwWidth, header.dwHeight, header.dwMipMapCount, 
 				static_cast<unsigned int>(blockSize));
 
-				size_t readSize = fread(pData, 1, imageSize, file);
-
-				if (!pData)
-					return 0;
-
-				if (readSize != imageSize)
-					return 0;
-
 				return 1;
 			}
 
 			default:
 				return 0;
 		}
+	}
+
+	// Reads a texture that is not in a mounted pack. The image data goes from the disk straight to pData with many reads in flight,
+	// instead of faulting in the pages of a mapping one after the other while copying
+	static uint8_t LoadLooseDDSImage(const char* filepath, DDS_HEADER& header, DDS_HEADER_DXT10& header10, 
+	unsigned int& vulkanImageFormat, RendererToLoadDDS chosenRenderer, void* pData)
+	{
+		BlitzenPlatform::AsyncFile file;
+		if (!file.Open(filepath))
+			return 0;
+
+		BlitzenPlatform::AsyncIOQueue queue;
+		if (!queue.Init(ce_ddsReadQueueDepth))
+			return 0;
+
+		uint8_t headerBytes[ce_ddsMaxHeaderSize];
+		size_t headerSize = file.GetSize() < ce_ddsMaxHeaderSize ? static_cast<size_t>(file.GetSize()) : ce_ddsMaxHeaderSize;
+		if (!BlitzenPlatform::AsyncReadRange(queue, file, 0, headerSize, headerBytes))
+			return 0;
+
+		size_t dataOffset = 0;
+		size_t imageSize = 0;
+		if (!ParseDDSHeader(headerBytes, headerSize, header, header10, vulkanImageFormat, chosenRenderer, dataOffset, imageSize))
+			return 0;
+
+		if (imageSize > file.GetSize() - dataOffset)
+			return 0;
+
+		return BlitzenPlatform::AsyncReadRange(queue, file, dataOffset, imageSize, pData);
+	}
+
+    uint8_t LoadDDSImage(const char* filepath, DDS_HEADER& header, DDS_HEADER_DXT10& header10, 
+	unsigned int& vulkanImageFormat, RendererToLoadDDS chosenRenderer, void* pData)
+    {
+		if (!pData)
+			return 0;
+
+		if (!BlitzenPlatform::VfsIsPacked(filepath))
+			return LoadLooseDDSImage(filepath, header, header10, vulkanImageFormat, chosenRenderer, pData);
+
+		// Packed textures are already mapped with the pack, the payload is copied straight from the mapping to pData
+		BlitzenPlatform::VfsFile file;
+		if(!BlitzenPlatform::VfsOpenFile(filepath, file, BlitzenPlatform::FileAccessHint::Sequential))
+			return 0;
+
+		struct VfsFileScope
+		{
+			BlitzenPlatform::VfsFile& file;
+
+			inline ~VfsFileScope() { BlitzenPlatform::VfsCloseFile(file); }
+		};
+		VfsFileScope fileScope{ file };
+
+		size_t dataOffset = 0;
+		size_t imageSize = 0;
+		if (!ParseDDSHeader(file.pData, file.size, header, header10, vulkanImageFormat, chosenRenderer, dataOffset, imageSize))
+			return 0;
+
+		if (imageSize > file.size - dataOffset)
+			return 0;
+
+		memcpy(pData, file.pData + dataOffset, imageSize);
+		return 1;
     }
 
     size_t GetDDSImageSizeBC(unsigned int width, unsigned int height, unsigned int levels, unsigned int blockSize)
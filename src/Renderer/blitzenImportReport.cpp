@@ -0,0 +1,121 @@
+#include "blitImportReport.h"
+#include "Platform/filesystem.h"
+
+// https://github.com/zeux/meshoptimizer
+#include "Meshoptimizer/meshoptimizer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace BlitzenEngine
+{
+    void AnalyzeLodIndices(const uint32_t* pIndices, size_t indexCount, BlitCL::DynamicArray<Vertex>& vertices,
+    size_t vertexSize, LodImportStats& stats)
+    {
+        stats = {};
+        if(indexCount == 0)
+            return;
+
+        // The analyzers see the range that the lod uses as its own vertex buffer
+        uint32_t minIndex = ~0u;
+        uint32_t maxIndex = 0;
+        for(size_t i = 0; i < indexCount; ++i)
+        {
+            minIndex = pIndices[i] < minIndex ? pIndices[i] : minIndex;
+            maxIndex = pIndices[i] > maxIndex ? pIndices[i] : maxIndex;
+        }
+        size_t rangeSize = maxIndex - minIndex + 1;
+
+        BlitCL::DynamicArray<uint32_t> localIndices(indexCount);
+        uint8_t unused = 0;
+        BlitCL::DynamicArray<uint8_t> used(rangeSize, unused);
+        for(size_t i = 0; i < indexCount; ++i)
+        {
+            localIndices[i] = pIndices[i] - minIndex;
+            stats.vertexCount += used[localIndices[i]] ? 0 : 1;
+            used[localIndices[i]] = 1;
+        }
+        stats.triangleCount = static_cast<uint32_t>(indexCount / 3);
+
+        meshopt_VertexCacheStatistics cache = meshopt_analyzeVertexCache(localIndices.Data(), indexCount, rangeSize,
+        ce_importReportCacheSize, 0, 0);
+        stats.acmr = cache.acmr;
+        stats.atvr = static_cast<float>(cache.vertices_transformed) / static_cast<float>(stats.vertexCount);
+
+        meshopt_OverdrawStatistics overdraw = meshopt_analyzeOverdraw(localIndices.Data(), indexCount,
+        &vertices[minIndex].position.x, rangeSize, sizeof(Vertex));
+        stats.overdraw = overdraw.overdraw;
+
+        meshopt_VertexFetchStatistics fetch = meshopt_analyzeVertexFetch(localIndices.Data(), indexCount, rangeSize, vertexSize);
+        stats.overfetch = fetch.overfetch;
+    }
+
+    void SetImportReportSource(RenderingResources* pResources, const char* source)
+    {
+        // Surfaces that share the geometry of an earlier one are not analyzed again
+        if(!pResources->bImportReport || pResources->importReport.GetSize() == 0 || 
+        pResources->importReport.Back().surfaceId + 1 != pResources->surfaces.GetSize())
+            return;
+
+        SurfaceImportReport& report = pResources->importReport.Back();
+        strncpy(report.source, source ? source : "", sizeof(report.source) - 1);
+        report.source[sizeof(report.source) - 1] = 0;
+    }
+
+    static void AppendLodStatsJson(std::string& json, const LodImportStats& stats)
+    {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer),
+        "{\"triangles\": %u, \"vertices\": %u, \"acmr\": %.4f, \"atvr\": %.4f, \"overdraw\": %.4f, \"overfetch\": %.4f}",
+        stats.triangleCount, stats.vertexCount, stats.acmr, stats.atvr, stats.overdraw, stats.overfetch);
+        json += buffer;
+    }
+
+    uint8_t WriteImportReport(RenderingResources* pResources, const char* path)
+    {
+        std::string json = "{\n\t\"surfaces\": [\n";
+        for(size_t i = 0; i < pResources->importReport.GetSize(); ++i)
+        {
+            SurfaceImportReport& report = pResources->importReport[i];
+
+            // Names come from files, so the characters that would break the string are dropped
+            std::string source;
+            for(const char* c = report.source; *c; ++c)
+                if(*c != '"' && *c != '\\' && static_cast<unsigned char>(*c) >= 0x20)
+                    source += *c;
+
+            char buffer[128];
+            snprintf(buffer, sizeof(buffer), "\t\t{\"surface\": %u, \"source\": \"", report.surfaceId);
+            json += buffer;
+            json += source;
+            json += "\",\n\t\t\"unoptimized\": ";
+            AppendLodStatsJson(json, report.unoptimized);
+            json += ",\n\t\t\"lods\": [\n";
+            for(uint8_t l = 0; l < report.lodCount; ++l)
+            {
+                json += "\t\t\t";
+                AppendLodStatsJson(json, report.lods[l]);
+                json += l + 1 < report.lodCount ? ",\n" : "\n";
+            }
+            json += i + 1 < pResources->importReport.GetSize() ? "\t\t]},\n" : "\t\t]}\n";
+        }
+        json += "\t]\n}\n";
+
+        BlitzenPlatform::FileHandle handle;
+        if(!handle.Open(path, BlitzenPlatform::FileModes::Write, 0))
+        {
+            BLIT_ERROR("Failed to open %s for the import report", path)
+            return 0;
+        }
+        size_t bytesWritten = 0;
+        if(!BlitzenPlatform::FilesystemWrite(handle, json.size(), json.data(), &bytesWritten) || bytesWritten != json.size())
+        {
+            BLIT_ERROR("Failed to write the import report to %s", path)
+            return 0;
+        }
+
+        BLIT_INFO("Import report of %i surfaces written to %s", static_cast<int>(pResources->importReport.GetSize()), path)
+        return 1;
+    }
+}
@@ -0,0 +1,457 @@
+#include "blitObjLoader.h"
+#include "Platform/assetPack.h"
+
+// Attribute conversion shared with the gltf loader
+#include "blitVertexConversion.h"
+
+#include <string.h>
+#include <math.h>
+#include <thread>
+
+namespace BlitzenEngine
+{
+    // One corner of a face, as it was written in the file
+    struct ObjFaceVertex
+    {
+        int32_t position;
+        int32_t uv;
+        int32_t normal;
+
+        // Negative obj indices are relative to the attributes parsed so far.
+        // A chunk does not know how many attributes came before it, so those are stored relative to the chunk,
+        // and these bits tell the merge pass to add the chunk's attribute offsets
+        uint32_t relativeMask;
+    };
+
+    constexpr uint32_t ce_objRelativePosition = 1;
+    constexpr uint32_t ce_objRelativeUv = 2;
+    constexpr uint32_t ce_objRelativeNormal = 4;
+
+    // Everything that a single thread parses from its part of the file
+    struct ObjChunk
+    {
+        const char* pBegin;
+        const char* pEnd;
+
+        BlitCL::DynamicArray<BlitML::vec3> positions;
+        BlitCL::DynamicArray<BlitML::vec2> uvs;
+        BlitCL::DynamicArray<BlitML::vec3> normals;
+
+        // Already triangulated, 3 per triangle
+        BlitCL::DynamicArray<ObjFaceVertex> faceVertices;
+    };
+
+    // A fully resolved vertex key, -1 means that the attribute is missing
+    struct ObjVertexKey
+    {
+        int32_t position;
+        int32_t uv;
+        int32_t normal;
+    };
+
+
+
+    /*-----------------------------------------------------------------------------------
+        Number parsing. The mapped file is not null terminated, so everything checks pEnd
+    ------------------------------------------------------------------------------------*/
+
+    inline const char* ObjSkipSpaces(const char* s, const char* pEnd)
+    {
+        while(s < pEnd && (*s == ' ' || *s == '\t'))
+            ++s;
+        return s;
+    }
+
+    static int32_t ObjParseInt(const char* s, const char* pEnd, const char** ppNext)
+    {
+        s = ObjSkipSpaces(s, pEnd);
+
+        uint8_t negative = s < pEnd && *s == '-';
+        if(s < pEnd && (*s == '-' || *s == '+'))
+            ++s;
+
+        uint32_t result = 0;
+        while(s < pEnd && unsigned(*s - '0') < 10)
+        {
+            result = result * 10 + unsigned(*s - '0');
+            ++s;
+        }
+
+        *ppNext = s;
+        return negative ? -int32_t(result) : int32_t(result);
+    }
+
+    // Same approach as the float parser in objparser.cpp, with bounds checks added
+    static float ObjParseFloat(const char* s, const char* pEnd, const char** ppNext)
+    {
+        static const double powers[] = {1e0, 1e+1, 1e+2, 1e+3, 1e+4, 1e+5, 1e+6, 1e+7, 1e+8, 1e+9, 1e+10, 1e+11,
+        1e+12, 1e+13, 1e+14, 1e+15, 1e+16, 1e+17, 1e+18, 1e+19, 1e+20, 1e+21, 1e+22};
+
+        s = ObjSkipSpaces(s, pEnd);
+
+        double sign = (s < pEnd && *s == '-') ? -1.0 : 1.0;
+        if(s < pEnd && (*s == '-' || *s == '+'))
+            ++s;
+
+        double result = 0;
+        int32_t power = 0;
+        while(s < pEnd && unsigned(*s - '0') < 10)
+        {
+            result = result * 10 + double(*s - '0');
+            ++s;
+        }
+
+        if(s < pEnd && *s == '.')
+        {
+            ++s;
+            while(s < pEnd && unsigned(*s - '0') < 10)
+            {
+                result = result * 10 + double(*s - '0');
+                ++s;
+                --power;
+            }
+        }
+
+        if(s < pEnd && (*s | ' ') == 'e')
+        {
+            ++s;
+            int32_t exponentSign = (s < pEnd && *s == '-') ? -1 : 1;
+            if(s < pEnd && (*s == '-' || *s == '+'))
+                ++s;
+
+            int32_t exponent = 0;
+            while(s < pEnd && unsigned(*s - '0') < 10)
+            {
+                exponent = exponent * 10 + (*s - '0');
+                ++s;
+            }
+            power += exponentSign * exponent;
+        }
+
+        *ppNext = s;
+
+        if(unsigned(-power) < BLIT_ARRAY_SIZE(powers))
+            return float(sign * result / powers[-power]);
+        else if(unsigned(power) < BLIT_ARRAY_SIZE(powers))
+            return float(sign * result * powers[power]);
+        else
+            return float(sign * result * pow(10.0, power));
+    }
+
+    // Turns a 1 based (or negative relative) obj index to a 0 based one. Missing indices become -1
+    inline int32_t ObjFixupIndex(int32_t index, size_t localCount, uint32_t relativeBit, uint32_t& relativeMask)
+    {
+        if(index > 0)
+            return index - 1;
+
+        if(index < 0)
+        {
+            relativeMask |= relativeBit;
+            return int32_t(localCount) + index;
+        }
+
+        return -1;
+    }
+
+
+
+    /*------------------
+        Chunk parsing
+    -------------------*/
+
+    static void ObjParseFace(ObjChunk& chunk, const char* s, const char* pEnd)
+    {
+        ObjFaceVertex corners[2];
+        uint8_t cornerCount = 0;
+
+        for(;;)
+        {
+            s = ObjSkipSpaces(s, pEnd);
+            int32_t positionIndex = ObjParseInt(s, pEnd, &s);
+            if(positionIndex == 0)
+                break;
+
+            int32_t uvIndex = 0;
+            int32_t normalIndex = 0;
+            if(s < pEnd && *s == '/')
+            {
+                ++s;
+                // Handles the position//normal form
+                if(s < pEnd && *s != '/')
+                    uvIndex = ObjParseInt(s, pEnd, &s);
+                if(s < pEnd && *s == '/')
+                {
+                    ++s;
+                    normalIndex = ObjParseInt(s, pEnd, &s);
+                }
+            }
+
+            ObjFaceVertex corner;
+            corner.relativeMask = 0;
+            corner.position = ObjFixupIndex(positionIndex, chunk.positions.GetSize(), ce_objRelativePosition, corner.relativeMask);
+            corner.uv = ObjFixupIndex(uvIndex, chunk.uvs.GetSize(), ce_objRelativeUv, corner.relativeMask);
+            corner.normal = ObjFixupIndex(normalIndex, chunk.normals.GetSize(), ce_objRelativeNormal, corner.relativeMask);
+
+            // Polygons are triangulated as a fan around the first corner
+            if(cornerCount == 2)
+            {
+                chunk.faceVertices.PushBack(corners[0]);
+                chunk.faceVertices.PushBack(corners[1]);
+                chunk.faceVertices.PushBack(corner);
+                corners[1] = corner;
+            }
+            else
+            {
+                corners[cornerCount++] = corner;
+            }
+        }
+    }
+
+    static void ObjParseChunk(ObjChunk& chunk)
+    {
+        const char* pLine = chunk.pBegin;
+        while(pLine < chunk.pEnd)
+        {
+            const char* pLineEnd = reinterpret_cast<const char*>(memchr(pLine, '\n', chunk.pEnd - pLine));
+            if(!pLineEnd)
+                pLineEnd = chunk.pEnd;
+
+            size_t lineLength = pLineEnd - pLine;
+            const char* s = pLine;
+
+            if(lineLength > 2 && s[0] == 'v' && (s[1] == ' ' || s[1] == '\t'))
+            {
+                s += 2;
+                BlitML::vec3 position;
+                position.x = ObjParseFloat(s, pLineEnd, &s);
+                position.y = ObjParseFloat(s, pLineEnd, &s);
+                position.z = ObjParseFloat(s, pLineEnd, &s);
+                chunk.positions.PushBack(position);
+            }
+            else if(lineLength > 3 && s[0] == 'v' && s[1] == 't' && (s[2] == ' ' || s[2] == '\t'))
+            {
+                // The third texture coordinate is not used by the engine
+                s += 3;
+                BlitML::vec2 uv;
+                uv.x = ObjParseFloat(s, pLineEnd, &s);
+                uv.y = ObjParseFloat(s, pLineEnd, &s);
+                chunk.uvs.PushBack(uv);
+            }
+            else if(lineLength > 3 && s[0] == 'v' && s[1] == 'n' && (s[2] == ' ' || s[2] == '\t'))
+            {
+                s += 3;
+                BlitML::vec3 normal;
+                normal.x = ObjParseFloat(s, pLineEnd, &s);
+                normal.y = ObjParseFloat(s, pLineEnd, &s);
+                normal.z = ObjParseFloat(s, pLineEnd, &s);
+                chunk.normals.PushBack(normal);
+            }
+            else if(lineLength > 2 && s[0] == 'f' && (s[1] == ' ' || s[1] == '\t'))
+            {
+                ObjParseFace(chunk, s + 2, pLineEnd);
+            }
+
+            pLine = pLineEnd + 1;
+        }
+    }
+
+
+
+    /*------------------------
+        Vertex deduplication
+    -------------------------*/
+
+    inline uint32_t ObjHashKey(const ObjVertexKey& key)
+    {
+        // Multiplicative hashing of the three indices, folded so that the low bits (used for the table index) get the high bits too
+        uint32_t h = uint32_t(key.position) * 73856093u ^ uint32_t(key.uv) * 19349663u ^ uint32_t(key.normal) * 83492791u;
+        return h ^ (h >> 15);
+    }
+
+    inline uint8_t ObjKeysEqual(const ObjVertexKey& a, const ObjVertexKey& b)
+    {
+        return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+    }
+
+    // Resolves an index of a chunk against the global attribute arrays. Returns -1 if it is missing or out of bounds
+    inline int32_t ObjResolveIndex(int32_t index, uint32_t relativeMask, uint32_t relativeBit, size_t chunkOffset, size_t globalCount)
+    {
+        if(index < 0 && !(relativeMask & relativeBit))
+            return -1;
+
+        int64_t resolved = (relativeMask & relativeBit) ? int64_t(chunkOffset) + index : int64_t(index);
+        return (resolved >= 0 && resolved < int64_t(globalCount)) ? int32_t(resolved) : -1;
+    }
+
+    uint8_t ParseObjFile(const char* filepath, BlitCL::DynamicArray<Vertex>& vertices, BlitCL::DynamicArray<uint32_t>& indices)
+    {
+        // Packed or loose, the parser only needs the bytes. Each chunk is parsed front to back, so readahead is worth it
+        BlitzenPlatform::VfsFile file;
+        if(!BlitzenPlatform::VfsOpenFile(filepath, file, BlitzenPlatform::FileAccessHint::Sequential))
+            return 0;
+
+        // Closes the file no matter where the function returns
+        struct VfsFileScope
+        {
+            BlitzenPlatform::VfsFile& file;
+
+            inline ~VfsFileScope() { BlitzenPlatform::VfsCloseFile(file); }
+        };
+        VfsFileScope fileScope{ file };
+
+        const char* pText = reinterpret_cast<const char*>(file.pData);
+        const char* pTextEnd = pText + file.size;
+
+        // Decide how many threads the file is worth
+        size_t threadCount = static_cast<size_t>(std::thread::hardware_concurrency());
+        size_t chunkCount = file.size / ce_objMinChunkSize;
+        chunkCount = chunkCount < threadCount ? chunkCount : threadCount;
+        chunkCount = chunkCount ? chunkCount : 1;
+
+        // Split the file in equal parts and move each boundary forward to the start of the next line
+        BlitCL::DynamicArray<ObjChunk> chunks(chunkCount);
+        const char* pChunkBegin = pText;
+        for(size_t i = 0; i < chunkCount; ++i)
+        {
+            const char* pChunkEnd = (i + 1 == chunkCount) ? pTextEnd : pText + (file.size / chunkCount) * (i + 1);
+            if(pChunkEnd < pChunkBegin)
+                pChunkEnd = pChunkBegin;
+            if(pChunkEnd < pTextEnd)
+            {
+                const char* pNewLine = reinterpret_cast<const char*>(memchr(pChunkEnd, '\n', pTextEnd - pChunkEnd));
+                pChunkEnd = pNewLine ? pNewLine + 1 : pTextEnd;
+            }
+
+            chunks[i].pBegin = pChunkBegin;
+            chunks[i].pEnd = pChunkEnd;
+            pChunkBegin = pChunkEnd;
+        }
+
+        // The calling thread parses the first chunk while the rest get a thread each
+        BlitCL::DynamicArray<std::thread> workers(chunkCount - 1);
+        for(size_t i = 1; i < chunkCount; ++i)
+        {
+            ObjChunk* pChunk = &chunks[i];
+            workers[i - 1] = std::thread([pChunk]() { ObjParseChunk(*pChunk); });
+        }
+        ObjParseChunk(chunks[0]);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+
+        // Gather the attributes of all chunks, so that global indices can be used directly
+        BlitCL::DynamicArray<BlitML::vec3> positions;
+        BlitCL::DynamicArray<BlitML::vec2> uvs;
+        BlitCL::DynamicArray<BlitML::vec3> normals;
+        size_t faceVertexCount = 0;
+        for(size_t i = 0; i < chunkCount; ++i)
+        {
+            positions.AppendArray(chunks[i].positions);
+            uvs.AppendArray(chunks[i].uvs);
+            normals.AppendArray(chunks[i].normals);
+            faceVertexCount += chunks[i].faceVertices.GetSize();
+        }
+
+        if(faceVertexCount == 0)
+        {
+            BLIT_ERROR("Obj file: %s has no faces", filepath)
+            return 0;
+        }
+
+        // Open addressing hash table from vertex key to vertex index. Sized for the worst case of every corner being unique
+        size_t tableSize = 1;
+        while(tableSize < faceVertexCount * 2)
+            tableSize *= 2;
+        BlitCL::DynamicArray<uint32_t> table(tableSize);
+        BlitzenCore::BlitMemSet(table.Data(), 0xff, tableSize * sizeof(uint32_t));// Every slot starts as UINT32_MAX
+        BlitCL::DynamicArray<ObjVertexKey> keys;
+
+        indices.Resize(faceVertexCount);
+        size_t currentIndex = 0;
+
+        // Attribute offsets of the current chunk, needed for relative indices
+        size_t positionOffset = 0;
+        size_t uvOffset = 0;
+        size_t normalOffset = 0;
+
+        for(size_t c = 0; c < chunkCount; ++c)
+        {
+            ObjChunk& chunk = chunks[c];
+            for(size_t i = 0; i < chunk.faceVertices.GetSize(); ++i)
+            {
+                const ObjFaceVertex& corner = chunk.faceVertices[i];
+
+                ObjVertexKey key;
+                key.position = ObjResolveIndex(corner.position, corner.relativeMask, ce_objRelativePosition, positionOffset, positions.GetSize());
+                key.uv = ObjResolveIndex(corner.uv, corner.relativeMask, ce_objRelativeUv, uvOffset, uvs.GetSize());
+                key.normal = ObjResolveIndex(corner.normal, corner.relativeMask, ce_objRelativeNormal, normalOffset, normals.GetSize());
+
+                // A face without a valid position cannot be recovered
+                if(key.position < 0)
+                {
+                    BLIT_ERROR("Obj file: %s has a face with an invalid vertex index", filepath)
+                    return 0;
+                }
+
+                // Find the key or the first empty slot
+                size_t slot = ObjHashKey(key) & (tableSize - 1);
+                while(table[slot] != UINT32_MAX && !ObjKeysEqual(keys[table[slot]], key))
+                {
+                    slot = (slot + 1) & (tableSize - 1);
+                }
+
+                if(table[slot] == UINT32_MAX)
+                {
+                    table[slot] = static_cast<uint32_t>(keys.GetSize());
+                    keys.PushBack(key);
+                }
+
+                indices[currentIndex++] = table[slot];
+            }
+
+            positionOffset += chunk.positions.GetSize();
+            uvOffset += chunk.uvs.GetSize();
+            normalOffset += chunk.normals.GetSize();
+        }
+
+        // Build one vertex for every unique key. The attributes are gathered through the indices of the keys,
+        // missing normals and uvs read the default values
+        vertices.Resize(keys.GetSize());
+        const float defaultNormal[3] = {0.f, 0.f, 1.f};
+        const float defaultUv[2] = {0.f, 0.f};
+
+        VertexAttributeSource positionSource;
+        positionSource.pData = reinterpret_cast<const uint8_t*>(positions.Data());
+        positionSource.stride = sizeof(BlitML::vec3);
+        positionSource.pIndices = &keys[0].position;
+        positionSource.indexStride = sizeof(ObjVertexKey);
+        ConvertVertexPositions(positionSource, keys.GetSize(), vertices.Data());
+
+        VertexAttributeSource normalSource;
+        normalSource.pData = normals.GetSize() ? reinterpret_cast<const uint8_t*>(normals.Data()) : reinterpret_cast<const uint8_t*>(defaultNormal);
+        normalSource.stride = sizeof(BlitML::vec3);
+        normalSource.pIndices = &keys[0].normal;
+        normalSource.indexStride = sizeof(ObjVertexKey);
+        normalSource.pDefault = defaultNormal;
+        ConvertVertexUnorm8(normalSource, keys.GetSize(), 3, &vertices[0].normalX);
+
+        VertexAttributeSource uvSource;
+        uvSource.pData = uvs.GetSize() ? reinterpret_cast<const uint8_t*>(uvs.Data()) : reinterpret_cast<const uint8_t*>(defaultUv);
+        uvSource.stride = sizeof(BlitML::vec2);
+        uvSource.pIndices = &keys[0].uv;
+        uvSource.indexStride = sizeof(ObjVertexKey);
+        uvSource.pDefault = defaultUv;
+        ConvertVertexUvs(uvSource, keys.GetSize(), vertices.Data());
+
+        for(size_t i = 0; i < vertices.GetSize(); ++i)
+        {
+            Vertex& vtx = vertices[i];
+            vtx.normalW = 0;
+            vtx.tangentX = vtx.tangentY = vtx.tangentZ = 127;
+            vtx.tangentW = 254;
+        }
+
+        return 1;
+    }
+}
@@ -0,0 +1,425 @@
+#include "blitRenderBvh.h"
+
+#include <float.h>
+#include <thread>
+
+namespace BlitzenEngine
+{
+    // A range of sorted objects whose subtree is built as one job, below the node that it starts from
+    struct RenderBvhTask
+    {
+        uint32_t nodeIndex;
+        uint32_t first;
+        uint32_t last;
+    };
+
+    // Calls job(i) for every i below jobCount, the calling thread takes job 0 and the rest get a thread each
+    template<typename Job>
+    static void RunBvhJobs(uint32_t jobCount, Job job)
+    {
+        if(jobCount == 0)
+            return;
+
+        BlitCL::DynamicArray<std::thread> workers(jobCount - 1);
+        for(uint32_t i = 1; i < jobCount; ++i)
+        {
+            workers[i - 1] = std::thread(job, i);
+        }
+        job(0);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+    }
+
+    template<typename T>
+    static void SetBvhArraySize(BlitCL::DynamicArray<T>& array, size_t size)
+    {
+        if(array.GetSize() < size)
+            array.Resize(size);
+        else
+            array.Downsize(size);
+    }
+
+    static BlitML::vec3 MinVec3(const BlitML::vec3& a, const BlitML::vec3& b)
+    {
+        return BlitML::vec3(BlitML::Min(a.x, b.x), BlitML::Min(a.y, b.y), BlitML::Min(a.z, b.z));
+    }
+
+    static BlitML::vec3 MaxVec3(const BlitML::vec3& a, const BlitML::vec3& b)
+    {
+        return BlitML::vec3(BlitML::Max(a.x, b.x), BlitML::Max(a.y, b.y), BlitML::Max(a.z, b.z));
+    }
+
+    void RenderObjectBounds(const CpuCullScene& scene, uint32_t objectId, BlitML::vec3& boundsMin, BlitML::vec3& boundsMax)
+    {
+        // Static objects have the same box baked
+        if(scene.pWorldBounds && scene.pWorldBounds[objectId].radius >= 0.f)
+        {
+            boundsMin = scene.pWorldBounds[objectId].boundsMin;
+            boundsMax = scene.pWorldBounds[objectId].boundsMax;
+            return;
+        }
+
+        const RenderObject& render = scene.pRenders[objectId];
+        SurfaceWorldBounds(scene.pSurfaces[render.surfaceId], scene.pTransforms[render.transformId], boundsMin, boundsMax);
+    }
+
+    // The sorted objects are split where the highest bit that differs between their codes changes, or in half when every code is the same
+    static uint32_t FindRenderBvhSplit(const uint32_t* pCodes, uint32_t first, uint32_t last)
+    {
+        uint32_t difference = pCodes[first] ^ pCodes[last - 1];
+        if(difference == 0)
+            return first + (last - first) / 2;
+
+        uint32_t highestBit = 1u << 31;
+        while(!(difference & highestBit))
+            highestBit >>= 1;
+
+        // First object with the bit set. The last object has it, the first does not
+        uint32_t low = first;
+        uint32_t high = last - 1;
+        while(low < high)
+        {
+            uint32_t middle = low + (high - low) / 2;
+            if(pCodes[middle] & highestBit)
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        return low;
+    }
+
+    // Turns nodes[nodeIndex] into the root of the objects first to last - 1. Nodes at or below the task size become tasks when pTasks is set
+    static void BuildRenderBvhNode(const uint32_t* pCodes, BlitCL::DynamicArray<RenderBvhNode>& nodes, uint32_t nodeIndex,
+    uint32_t first, uint32_t last, BlitCL::DynamicArray<RenderBvhTask>* pTasks)
+    {
+        uint32_t count = last - first;
+        if(count <= ce_renderBvhLeafSize)
+        {
+            nodes[nodeIndex].leftOrFirst = first;
+            nodes[nodeIndex].objectCount = count;
+            return;
+        }
+
+        if(pTasks && count <= ce_renderBvhTaskObjects)
+        {
+            pTasks->PushBack({nodeIndex, first, last});
+            return;
+        }
+
+        uint32_t split = FindRenderBvhSplit(pCodes, first, last);
+        uint32_t left = static_cast<uint32_t>(nodes.GetSize());
+        nodes[nodeIndex].leftOrFirst = left;
+        nodes[nodeIndex].objectCount = 0;
+        nodes.PushBack(RenderBvhNode{});
+        nodes.PushBack(RenderBvhNode{});
+
+        BuildRenderBvhNode(pCodes, nodes, left, first, split, pTasks);
+        BuildRenderBvhNode(pCodes, nodes, left + 1, split, last, pTasks);
+    }
+
+    void BuildRenderBvh(const CpuCullScene& scene, RenderBvh& bvh, uint32_t threadCount)
+    {
+        if(threadCount == 0)
+            threadCount = static_cast<uint32_t>(std::thread::hardware_concurrency());
+        uint32_t objectCount = scene.renderCount;
+        uint32_t jobCount = BlitML::Max(1u, BlitML::Min(threadCount, objectCount));
+        auto rangeStart = [objectCount, jobCount](uint32_t job) { return uint32_t(uint64_t(objectCount) * job / jobCount); };
+
+        SetBvhArraySize(bvh.objects, objectCount);
+        SetBvhArraySize(bvh.nodes, 0);
+        if(objectCount == 0)
+            return;
+
+        // Box centers of every object, and the bounds of the centers for each job
+        BlitCL::DynamicArray<BlitML::vec3> centers(objectCount);
+        BlitCL::DynamicArray<BlitML::vec3> jobCenterMin(jobCount);
+        BlitCL::DynamicArray<BlitML::vec3> jobCenterMax(jobCount);
+        RunBvhJobs(jobCount, [&](uint32_t job)
+        {
+            BlitML::vec3 centerMin(FLT_MAX);
+            BlitML::vec3 centerMax(-FLT_MAX);
+            for(uint32_t i = rangeStart(job); i < rangeStart(job + 1); ++i)
+            {
+                BlitML::vec3 boundsMin;
+                BlitML::vec3 boundsMax;
+                RenderObjectBounds(scene, i, boundsMin, boundsMax);
+                centers[i] = (boundsMin + boundsMax) * 0.5f;
+                centerMin = MinVec3(centerMin, centers[i]);
+                centerMax = MaxVec3(centerMax, centers[i]);
+            }
+            jobCenterMin[job] = centerMin;
+            jobCenterMax[job] = centerMax;
+        });
+
+        BlitML::vec3 centerMin = jobCenterMin[0];
+        BlitML::vec3 centerMax = jobCenterMax[0];
+        for(uint32_t job = 1; job < jobCount; ++job)
+        {
+            centerMin = MinVec3(centerMin, jobCenterMin[job]);
+            centerMax = MaxVec3(centerMax, jobCenterMax[job]);
+        }
+
+        // Each axis of the center bounds gets 10 bits. Flat axes all go to 0
+        BlitML::vec3 extent = centerMax - centerMin;
+        BlitML::vec3 quantizeScale(extent.x > 0.f ? 1023.f / extent.x : 0.f, extent.y > 0.f ? 1023.f / extent.y : 0.f,
+        extent.z > 0.f ? 1023.f / extent.z : 0.f);
+
+        BlitCL::DynamicArray<uint32_t> codes(objectCount);
+        BlitCL::DynamicArray<uint32_t> sortedCodes(objectCount);
+        BlitCL::DynamicArray<uint32_t> ids(objectCount);
+        RunBvhJobs(jobCount, [&](uint32_t job)
+        {
+            for(uint32_t i = rangeStart(job); i < rangeStart(job + 1); ++i)
+            {
+                BlitML::vec3 cell = (centers[i] - centerMin) * quantizeScale;
+                codes[i] = BlitML::MortonCode3(BlitML::Clamp(static_cast<uint32_t>(cell.x), 1023u, 0u),
+                BlitML::Clamp(static_cast<uint32_t>(cell.y), 1023u, 0u), BlitML::Clamp(static_cast<uint32_t>(cell.z), 1023u, 0u));
+                ids[i] = i;
+            }
+        });
+
+        // Stable radix sort of the 30-bit codes, 8 bits at a time. Every job counts its own range,
+        // so that it knows where each of its objects goes without waiting on the others
+        uint32_t* pCodes = codes.Data();
+        uint32_t* pIds = ids.Data();
+        uint32_t* pSortedCodes = sortedCodes.Data();
+        uint32_t* pSortedIds = bvh.objects.Data();
+        BlitCL::DynamicArray<uint32_t> digitOffsets(size_t(jobCount) * 256);
+        for(uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            RunBvhJobs(jobCount, [&](uint32_t job)
+            {
+                uint32_t* pOffsets = digitOffsets.Data() + size_t(job) * 256;
+                for(uint32_t digit = 0; digit < 256; ++digit)
+                    pOffsets[digit] = 0;
+                for(uint32_t i = rangeStart(job); i < rangeStart(job + 1); ++i)
+                    pOffsets[(pCodes[i] >> shift) & 0xFF]++;
+            });
+
+            uint32_t offset = 0;
+            for(uint32_t digit = 0; digit < 256; ++digit)
+            {
+                for(uint32_t job = 0; job < jobCount; ++job)
+                {
+                    uint32_t count = digitOffsets[size_t(job) * 256 + digit];
+                    digitOffsets[size_t(job) * 256 + digit] = offset;
+                    offset += count;
+                }
+            }
+
+            RunBvhJobs(jobCount, [&](uint32_t job)
+            {
+                uint32_t* pOffsets = digitOffsets.Data() + size_t(job) * 256;
+                for(uint32_t i = rangeStart(job); i < rangeStart(job + 1); ++i)
+                {
+                    uint32_t destination = pOffsets[(pCodes[i] >> shift) & 0xFF]++;
+                    pSortedCodes[destination] = pCodes[i];
+                    pSortedIds[destination] = pIds[i];
+                }
+            });
+
+            // The sorted arrays are the source of the next pass. After an even number of passes the ids are back in ids
+            uint32_t* pTemp = pCodes;
+            pCodes = pSortedCodes;
+            pSortedCodes = pTemp;
+            pTemp = pIds;
+            pIds = pSortedIds;
+            pSortedIds = pTemp;
+        }
+        BlitzenCore::BlitMemCopy(bvh.objects.Data(), pIds, size_t(objectCount) * sizeof(uint32_t));
+
+        // The top of the tree is split on this thread, down to ranges that are small enough to be tasks
+        BlitCL::DynamicArray<RenderBvhTask> tasks;
+        bvh.nodes.PushBack(RenderBvhNode{});
+        BuildRenderBvhNode(pCodes, bvh.nodes, 0, 0, objectCount, &tasks);
+
+        // Each task builds its subtree on its own, with its root at 0. The subtrees are then appended in task order
+        uint32_t taskCount = static_cast<uint32_t>(tasks.GetSize());
+        BlitCL::DynamicArray<BlitCL::DynamicArray<RenderBvhNode>> taskNodes(taskCount);
+        if(taskCount != 0)
+        {
+            uint32_t taskJobCount = BlitML::Max(1u, BlitML::Min(threadCount, taskCount));
+            RunBvhJobs(taskJobCount, [&](uint32_t job)
+            {
+                for(uint32_t t = job; t < taskCount; t += taskJobCount)
+                {
+                    taskNodes[t].PushBack(RenderBvhNode{});
+                    BuildRenderBvhNode(pCodes, taskNodes[t], 0, tasks[t].first, tasks[t].last, nullptr);
+                }
+            });
+        }
+
+        for(uint32_t t = 0; t < taskCount; ++t)
+        {
+            // The task's root replaces the node that it was started from, the rest are moved by the nodes before them
+            uint32_t offset = static_cast<uint32_t>(bvh.nodes.GetSize()) - 1;
+            BlitCL::DynamicArray<RenderBvhNode>& subtree = taskNodes[t];
+            for(size_t i = 0; i < subtree.GetSize(); ++i)
+            {
+                if(subtree[i].objectCount == 0)
+                    subtree[i].leftOrFirst += offset;
+            }
+            bvh.nodes[tasks[t].nodeIndex] = subtree[0];
+            bvh.nodes.AddBlockAtBack(subtree.Data() + 1, subtree.GetSize() - 1);
+        }
+
+        RefitRenderBvh(scene, bvh, threadCount);
+    }
+
+    void RefitRenderBvh(const CpuCullScene& scene, RenderBvh& bvh, uint32_t threadCount)
+    {
+        if(threadCount == 0)
+            threadCount = static_cast<uint32_t>(std::thread::hardware_concurrency());
+        uint32_t nodeCount = static_cast<uint32_t>(bvh.nodes.GetSize());
+        if(nodeCount == 0)
+            return;
+
+        // Leaves hold all of the objects, so they are split between the threads
+        uint32_t jobCount = BlitML::Max(1u, BlitML::Min(threadCount, nodeCount));
+        RunBvhJobs(jobCount, [&](uint32_t job)
+        {
+            uint32_t first = uint32_t(uint64_t(nodeCount) * job / jobCount);
+            uint32_t last = uint32_t(uint64_t(nodeCount) * (job + 1) / jobCount);
+            for(uint32_t n = first; n < last; ++n)
+            {
+                RenderBvhNode& node = bvh.nodes[n];
+                if(node.objectCount == 0)
+                    continue;
+
+                RenderObjectBounds(scene, bvh.objects[node.leftOrFirst], node.boundsMin, node.boundsMax);
+                for(uint32_t i = 1; i < node.objectCount; ++i)
+                {
+                    BlitML::vec3 boundsMin;
+                    BlitML::vec3 boundsMax;
+                    RenderObjectBounds(scene, bvh.objects[node.leftOrFirst + i], boundsMin, boundsMax);
+                    node.boundsMin = MinVec3(node.boundsMin, boundsMin);
+                    node.boundsMax = MaxVec3(node.boundsMax, boundsMax);
+                }
+            }
+        });
+
+        // Children come after their parents, so a backwards pass sees every child before its parent
+        for(uint32_t n = nodeCount; n-- > 0;)
+        {
+            RenderBvhNode& node = bvh.nodes[n];
+            if(node.objectCount != 0)
+                continue;
+
+            const RenderBvhNode& left = bvh.nodes[node.leftOrFirst];
+            const RenderBvhNode& right = bvh.nodes[node.leftOrFirst + 1];
+            node.boundsMin = MinVec3(left.boundsMin, right.boundsMin);
+            node.boundsMax = MaxVec3(left.boundsMax, right.boundsMax);
+        }
+    }
+
+    // Visits the nodes that pass boxTest depth first, left child first, and calls it again on each object of the leaves that it reaches
+    template<typename BoxTest>
+    static void QueryRenderBvh(RenderBvh& bvh, const CpuCullScene& scene, BoxTest boxTest, BlitCL::DynamicArray<uint32_t>& results)
+    {
+        if(bvh.nodes.GetSize() == 0)
+            return;
+
+        uint32_t stack[ce_renderBvhMaxDepth];
+        uint32_t stackSize = 0;
+        uint32_t nodeIndex = 0;
+        while(1)
+        {
+            const RenderBvhNode& node = bvh.nodes[nodeIndex];
+            if(boxTest(node.boundsMin, node.boundsMax))
+            {
+                if(node.objectCount == 0)
+                {
+                    BLIT_ASSERT(stackSize < ce_renderBvhMaxDepth)
+                    stack[stackSize++] = node.leftOrFirst + 1;
+                    nodeIndex = node.leftOrFirst;
+                    continue;
+                }
+
+                for(uint32_t i = 0; i < node.objectCount; ++i)
+                {
+                    uint32_t objectId = bvh.objects[node.leftOrFirst + i];
+                    BlitML::vec3 boundsMin;
+                    BlitML::vec3 boundsMax;
+                    RenderObjectBounds(scene, objectId, boundsMin, boundsMax);
+                    if(boxTest(boundsMin, boundsMax))
+                        results.PushBack(objectId);
+                }
+            }
+
+            if(stackSize == 0)
+                break;
+            nodeIndex = stack[--stackSize];
+        }
+    }
+
+    void QueryRenderBvhSphere(RenderBvh& bvh, const CpuCullScene& scene, const BlitML::vec3& center, float radius,
+    BlitCL::DynamicArray<uint32_t>& results)
+    {
+        float radiusSquared = radius * radius;
+        QueryRenderBvh(bvh, scene, [&](const BlitML::vec3& boundsMin, const BlitML::vec3& boundsMax)
+        {
+            // Distance from the center to the closest point of the box
+            BlitML::vec3 closest = MinVec3(MaxVec3(center, boundsMin), boundsMax);
+            BlitML::vec3 offset = center - closest;
+            return BlitML::Dot(offset, offset) <= radiusSquared;
+        }, results);
+    }
+
+    void QueryRenderBvhRay(RenderBvh& bvh, const CpuCullScene& scene, const BlitML::vec3& origin, const BlitML::vec3& direction,
+    float maxDistance, BlitCL::DynamicArray<uint32_t>& results)
+    {
+        // Axes that the ray is parallel to get infinite slabs, which only pass when the origin is between the planes
+        BlitML::vec3 inverseDirection(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+        QueryRenderBvh(bvh, scene, [&](const BlitML::vec3& boundsMin, const BlitML::vec3& boundsMax)
+        {
+            BlitML::vec3 t0 = (boundsMin - origin) * inverseDirection;
+            BlitML::vec3 t1 = (boundsMax - origin) * inverseDirection;
+            BlitML::vec3 slabEnter = MinVec3(t0, t1);
+            BlitML::vec3 slabExit = MaxVec3(t0, t1);
+            float enter = BlitML::Max(BlitML::Max(slabEnter.x, slabEnter.y), BlitML::Max(slabEnter.z, 0.f));
+            float exit = BlitML::Min(BlitML::Min(slabExit.x, slabExit.y), BlitML::Min(slabExit.z, maxDistance));
+            return enter <= exit;
+        }, results);
+    }
+
+    void QueryRenderBvhFrustum(RenderBvh& bvh, const CpuCullScene& scene, const CameraViewData& view,
+    BlitCL::DynamicArray<uint32_t>& results)
+    {
+        // Both side planes and both vertical planes, where the shaders only test the one on the side of the center, then near and far.
+        // A view space point p is inside a plane when dot(normal, p) + offset > 0
+        BlitML::vec4 viewPlanes[6] = {
+            BlitML::vec4(-view.frustumRight, 0.f, view.frustumLeft, 0.f),
+            BlitML::vec4(view.frustumRight, 0.f, view.frustumLeft, 0.f),
+            BlitML::vec4(0.f, -view.frustumTop, view.frustumBottom, 0.f),
+            BlitML::vec4(0.f, view.frustumTop, view.frustumBottom, 0.f),
+            BlitML::vec4(0.f, 0.f, 1.f, -view.zNear),
+            BlitML::vec4(0.f, 0.f, -1.f, view.zFar)
+        };
+
+        // The planes are moved to world space, so that the world boxes are tested as they are
+        const float* m = view.viewMatrix.data;
+        BlitML::vec4 planes[6];
+        for(uint8_t i = 0; i < 6; ++i)
+        {
+            const BlitML::vec4& plane = viewPlanes[i];
+            planes[i] = BlitML::vec4(m[0] * plane.x + m[1] * plane.y + m[2] * plane.z, m[4] * plane.x + m[5] * plane.y + m[6] * plane.z,
+            m[8] * plane.x + m[9] * plane.y + m[10] * plane.z, m[12] * plane.x + m[13] * plane.y + m[14] * plane.z + plane.w);
+        }
+
+        QueryRenderBvh(bvh, scene, [&](const BlitML::vec3& boundsMin, const BlitML::vec3& boundsMax)
+        {
+            BlitML::vec3 center = (boundsMin + boundsMax) * 0.5f;
+            BlitML::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+            for(uint8_t i = 0; i < 6; ++i)
+            {
+                const BlitML::vec4& plane = planes[i];
+                float radius = BlitML::Abs(plane.x) * extents.x + BlitML::Abs(plane.y) * extents.y + BlitML::Abs(plane.z) * extents.z;
+                if(plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w <= -radius)
+                    return false;
+            }
+            return true;
+        }, results);
+    }
+}
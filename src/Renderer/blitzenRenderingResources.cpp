@@ -7,14 +7,29 @@
 #include "VendorCode/stb_image.h"
 
 // Used for loading .obj meshes
-// https://github.com/thisistherk/fast_obj
-#define FAST_OBJ_IMPLEMENTATION
-#include "fast_obj.h"
+#include "blitObjLoader.h"
+
+// Compact vertex encoding
+#include "blitVertexQuantization.h"
+
+// Seeded random streams for the stress test scene
+#include "BlitzenMathLibrary/blitMLRandom.h"
+
+// Attribute conversion shared by the obj and gltf loaders
+#include "blitVertexConversion.h"
+
+// Hierarchical cluster lods for large surfaces
+#include "blitClusterLod.h"
+
+// Mesh quality analysis of the imported surfaces
+#include "blitImportReport.h"
+
+// Simplified occluder meshes for the software occlusion rasterizer
+#include "blitSoftwareOcclusion.h"
 
 // Algorithms for building meshlets, loading LODs, optimizing vertex caches etc.
 // https://github.com/zeux/meshoptimizer
 #include "Meshoptimizer/meshoptimizer.h"
-#include "objparser.h"
 
 // Single file gltf loading https://github.com/jkuhlmann/cgltf
 #define CGLTF_IMPLEMENTATION
@@ -31,6 +46,14 @@
 
 // I have that this is temporary and that I can do my own string formating
 #include <string>
+#include <stddef.h>
+
+// Clusters of each lod are generated on their own thread
+#include <thread>
+
+// glTF buffers are mapped and their accessors converted in place
+#include "Platform/assetPack.h"
+
 
 namespace BlitzenEngine
 {
@@ -76,7 +99,7 @@ namespace BlitzenEngine
 
 
 
-    uint8_t LoadMeshFromObj(RenderingResources* pResources, const char* filename)
+    uint8_t LoadMeshFromObj(RenderingResources* pResources, const char* filename, const LodSettings* pLodSettings /*= nullptr*/)
     {
         // The function should return if the engine will go over the max allowed mesh assets
         if(pResources->meshCount > ce_maxMeshCount)
@@ -92,54 +115,15 @@ namespace BlitzenEngine
         Mesh& currentMesh = pResources->meshes[pResources->meshCount];
         currentMesh.firstSurface = static_cast<uint32_t>(pResources->surfaces.GetSize());
 
-        ObjFile file;
-        if(!objParseFile(file, filename))
+        // The parser builds indexed geometry directly, with vertices already deduplicated
+        BlitCL::DynamicArray<Vertex> vertices;
+        BlitCL::DynamicArray<uint32_t> indices;
+        if(!ParseObjFile(filename, vertices, indices))
             return 0;
 
-        size_t indexCount = file.f_size / 3;
-
-        BlitCL::DynamicArray<Vertex> triangleVertices(indexCount);
-
-        BLIT_INFO("Loading vertices and indices")
-
-        for(size_t i = 0; i < indexCount; ++i)
-        {
-            Vertex& vtx = triangleVertices[i];
-
-            int32_t vertexIndex = file.f[i * 3 + 0];
-		    int32_t vertexTextureIndex = file.f[i * 3 + 1];
-		    int32_t vertexNormalIndex = file.f[i * 3 + 2];
-
-            vtx.position.x = file.v[vertexIndex * 3 + 0];
-		    vtx.position.y = file.v[vertexIndex * 3 + 1];
-		    vtx.position.z = file.v[vertexIndex * 3 + 2];
-
-            // Load the normal and turn them to 8 bit integers
-		    float normalX = vertexNormalIndex < 0 ? 0.f : file.vn[vertexNormalIndex * 3 + 0];
-		    float normalY = vertexNormalIndex < 0 ? 0.f : file.vn[vertexNormalIndex * 3 + 1];
-		    float normalZ = vertexNormalIndex < 0 ? 1.f : file.vn[vertexNormalIndex * 3 + 2];
-            vtx.normalX = static_cast<uint8_t>(normalX * 127.f + 127.5f);
-            vtx.normalY = static_cast<uint8_t>(normalY * 127.f + 127.5f);
-            vtx.normalZ = static_cast<uint8_t>(normalZ * 127.f + 127.5f);
-
-            vtx.tangentX = vtx.tangentY = vtx.tangentZ = 127;
-            vtx.tangentW = 254;
-
-		    vtx.uvX = meshopt_quantizeHalf(vertexTextureIndex < 0 ? 0.f : file.vt[vertexTextureIndex * 3 + 0]);
-		    vtx.uvY = meshopt_quantizeHalf(vertexTextureIndex < 0 ? 0.f : file.vt[vertexTextureIndex * 3 + 1]);
-        }
-
-        BlitCL::DynamicArray<uint32_t> remap(indexCount);
-		size_t vertexCount = meshopt_generateVertexRemap(remap.Data(), 0, indexCount, triangleVertices.Data(), indexCount, sizeof(Vertex));
-
-        BlitCL::DynamicArray<uint32_t> indices(indexCount);
-        BlitCL::DynamicArray<Vertex> vertices(vertexCount);
-
-        meshopt_remapVertexBuffer(vertices.Data(), triangleVertices.Data(), indexCount, sizeof(Vertex), remap.Data());
-		meshopt_remapIndexBuffer(indices.Data(), 0, indexCount, remap.Data());
-
         BLIT_INFO("Creating surface")
-        LoadPrimitiveSurface(pResources, vertices, indices);
+        LoadPrimitiveSurface(pResources, vertices, indices, pLodSettings);
+        SetImportReportSource(pResources, filename);
 
         currentMesh.surfaceCount++;// Increment the surface count
         ++(pResources->meshCount);// Increment the mesh count
@@ -148,8 +132,8 @@ namespace BlitzenEngine
     }
 
     // The code for this function is taken from Arseny's niagara streams. It uses his meshoptimizer library which I am not that familiar with
-    size_t GenerateClusters(RenderingResources* pResources, BlitCL::DynamicArray<Vertex>& vertices, 
-    BlitCL::DynamicArray<uint32_t>& indices)
+    size_t GenerateClusters(BlitCL::DynamicArray<Vertex>& vertices, BlitCL::DynamicArray<uint32_t>& indices, 
+    BlitCL::DynamicArray<Meshlet>& meshlets, BlitCL::DynamicArray<uint32_t>& meshletData)
     {
         const size_t maxVertices = 64;
         const size_t maxTriangles = 124;
@@ -162,9 +146,16 @@ namespace BlitzenEngine
         akMeshlets.Downsize(meshopt_buildMeshlets(akMeshlets.Data(), meshletVertices.Data(), meshletTriangles.Data(), indices.Data(), indices.GetSize(), 
         &vertices[0].position.x, vertices.GetSize(), sizeof(Vertex), maxVertices, maxTriangles, coneWeight));
 
-        
-	    // note: I could append meshletVertices & meshletTriangles buffers more or less directly with small changes in Meshlet struct, 
-        // but for now keep the GPU side layout flexible and separate
+        // Each meshlet takes one element for each vertex index and one for each triangle, so the output can be sized once
+        size_t dataSize = 0;
+        for(size_t i = 0; i < akMeshlets.GetSize(); ++i)
+            dataSize += akMeshlets[i].vertex_count + akMeshlets[i].triangle_count;
+
+        size_t firstMeshlet = meshlets.GetSize();
+        size_t dataOffset = meshletData.GetSize();
+        meshlets.Resize(firstMeshlet + akMeshlets.GetSize());
+        meshletData.Resize(dataOffset + dataSize);
+
         for(size_t i = 0; i < akMeshlets.GetSize(); ++i)
         {
             meshopt_Meshlet& meshlet = akMeshlets[i];
@@ -172,56 +163,512 @@ namespace BlitzenEngine
             meshopt_optimizeMeshlet(&meshletVertices[meshlet.vertex_offset], &meshletTriangles[meshlet.triangle_offset], 
             meshlet.triangle_count, meshlet.vertex_count);
 
-            size_t dataOffset = pResources->meshletData.GetSize();
-            for(unsigned int i = 0; i < meshlet.vertex_count; ++i)
-            {
-                pResources->meshletData.PushBack(meshletVertices[meshlet.vertex_offset + i]);
-            }
+            Meshlet& m = meshlets[firstMeshlet + i];
+            m = {};
+            m.dataOffset = static_cast<uint32_t>(dataOffset);
+            m.triangleCount = meshlet.triangle_count;
+            m.vertexCount = meshlet.vertex_count;
 
-            unsigned int* indexGroups = reinterpret_cast<unsigned int*>(&meshletTriangles[0] + meshlet.triangle_offset);
-            unsigned int indexGroupCount = (meshlet.triangle_count * 3 + 3);
+            memcpy(&meshletData[dataOffset], &meshletVertices[meshlet.vertex_offset], sizeof(uint32_t) * meshlet.vertex_count);
+            dataOffset += meshlet.vertex_count;
 
-            for(unsigned int i = 0; i < indexGroupCount; ++i)
+            // One triangle in each element, in the order that the mesh shader unpacks them
+            const unsigned char* pTriangles = &meshletTriangles[meshlet.triangle_offset];
+            for(unsigned int t = 0; t < meshlet.triangle_count; ++t)
             {
-                pResources->meshletData.PushBack(indexGroups[size_t(i)]);
+                meshletData[dataOffset + t] = (uint32_t(pTriangles[t * 3]) << 16) | (uint32_t(pTriangles[t * 3 + 1]) << 8) | 
+                uint32_t(pTriangles[t * 3 + 2]);
             }
+            dataOffset += meshlet.triangle_count;
 
             meshopt_Bounds bounds = meshopt_computeMeshletBounds(&meshletVertices[meshlet.vertex_offset], 
             &meshletTriangles[meshlet.triangle_offset], meshlet.triangle_count, &vertices[0].position.x, vertices.GetSize(), sizeof(Vertex));
 
-            Meshlet m = {};
-            m.dataOffset = static_cast<uint32_t>(dataOffset);
-            m.triangleCount = meshlet.triangle_count;
-            m.vertexCount = meshlet.vertex_count;
-
             m.center = BlitML::vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
             m.radius = bounds.radius;
             m.cone_axis[0] = bounds.cone_axis_s8[0];
 		    m.cone_axis[1] = bounds.cone_axis_s8[1];
 		    m.cone_axis[2] = bounds.cone_axis_s8[2];
 		    m.cone_cutoff = bounds.cone_cutoff_s8; 
-
-            pResources->meshlets.PushBack(m);
         }
 
         return akMeshlets.GetSize();
     }
 
+    // The clusters of one lod. Each lod is generated by its own job into its own arrays, so data offsets start from 0
+    struct LodClusterJob
+    {
+        BlitCL::DynamicArray<uint32_t> indices;
+
+        BlitCL::DynamicArray<Meshlet> meshlets;
+        BlitCL::DynamicArray<uint32_t> meshletData;
+    };
+
+    // Generates the clusters of every lod of a surface, the calling thread takes the 1st lod and the rest get a thread each
+    static void GenerateLodClusters(BlitCL::DynamicArray<Vertex>& vertices, LodClusterJob* pJobs, uint8_t jobCount)
+    {
+        BlitCL::DynamicArray<std::thread> workers(jobCount > 1 ? jobCount - 1 : 0);
+        for(uint8_t i = 1; i < jobCount; ++i)
+        {
+            LodClusterJob* pJob = &pJobs[i];
+            BlitCL::DynamicArray<Vertex>* pVertices = &vertices;
+            workers[i - 1] = std::thread([pJob, pVertices]() 
+            { 
+                GenerateClusters(*pVertices, pJob->indices, pJob->meshlets, pJob->meshletData); 
+            });
+        }
+        if(jobCount)
+            GenerateClusters(vertices, pJobs[0].indices, pJobs[0].meshlets, pJobs[0].meshletData);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+    }
+
+    // Adds the indices of a lod to the global index array that the surface uses, as a strip if strips are active
+    static void AppendLodIndices(RenderingResources* pResources, BlitCL::DynamicArray<uint32_t>& lodIndices, 
+    size_t vertexCount, uint8_t bIndices16, MeshLod& lod)
+    {
+        BlitCL::DynamicArray<uint32_t> stripIndices;
+        BlitCL::DynamicArray<uint32_t>* pEncoded = &lodIndices;
+        if(pResources->bStripIndices)
+        {
+            stripIndices.Resize(meshopt_stripifyBound(lodIndices.GetSize()));
+            stripIndices.Downsize(meshopt_stripify(stripIndices.Data(), lodIndices.Data(), lodIndices.GetSize(), vertexCount, 
+            bIndices16 ? ce_stripRestartIndex16 : ce_stripRestartIndex32));
+            pEncoded = &stripIndices;
+        }
+        BlitCL::DynamicArray<uint32_t>& encoded = *pEncoded;
+
+        lod.indexCount = static_cast<uint32_t>(encoded.GetSize());
+        if(bIndices16)
+        {
+            lod.firstIndex = static_cast<uint32_t>(pResources->indices16.GetSize());
+            pResources->indices16.Resize(lod.firstIndex + encoded.GetSize());
+            for(size_t i = 0; i < encoded.GetSize(); ++i)
+                pResources->indices16[lod.firstIndex + i] = static_cast<uint16_t>(encoded[i]);
+        }
+        else
+        {
+            lod.firstIndex = static_cast<uint32_t>(pResources->indices.GetSize());
+            pResources->indices.AppendArray(encoded);
+        }
+    }
+
+    // Bytes of a vertex that hold data, the rest is alignment padding that the loaders do not initialize
+    constexpr size_t ce_hashedVertexSize = offsetof(Vertex, tangentW) + sizeof(uint8_t);
+
+    // Murmur3 finalizer
+    inline uint64_t MixHash(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    inline uint64_t RotateLeft(uint64_t value, uint32_t bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // Adds the bytes to both hashes, 8 at a time. The two hashes use different constants, so they do not collide together
+    static void HashBytes(const uint8_t* pData, size_t size, uint64_t* pHash)
+    {
+        size_t wordCount = size / sizeof(uint64_t);
+        for(size_t i = 0; i < wordCount; ++i)
+        {
+            uint64_t word;
+            memcpy(&word, pData + i * sizeof(uint64_t), sizeof(uint64_t));
+            pHash[0] = RotateLeft(pHash[0] ^ (word * 0x87c37b91114253d5ull), 27) * 0x9e3779b97f4a7c15ull;
+            pHash[1] = RotateLeft(pHash[1] + (word * 0x4cf5ad432745937full), 31) * 0xc2b2ae3d27d4eb4full;
+        }
+
+        uint64_t tail = 0;
+        memcpy(&tail, pData + wordCount * sizeof(uint64_t), size - wordCount * sizeof(uint64_t));
+        pHash[0] = MixHash(pHash[0] ^ tail ^ size);
+        pHash[1] = MixHash(pHash[1] + tail + size);
+    }
+
+    static GeometryHash HashGeometry(BlitCL::DynamicArray<Vertex>& vertices, BlitCL::DynamicArray<uint32_t>& indices, 
+    const LodSettings& lodSettings)
+    {
+        GeometryHash geometry{};
+        geometry.hash[0] = 0x243f6a8885a308d3ull;
+        geometry.hash[1] = 0x13198a2e03707344ull;
+        geometry.vertexCount = static_cast<uint32_t>(vertices.GetSize());
+        geometry.indexCount = static_cast<uint32_t>(indices.GetSize());
+
+        for(size_t i = 0; i < vertices.GetSize(); ++i)
+            HashBytes(reinterpret_cast<const uint8_t*>(&vertices[i]), ce_hashedVertexSize, geometry.hash);
+        HashBytes(reinterpret_cast<const uint8_t*>(indices.Data()), indices.GetSize() * sizeof(uint32_t), geometry.hash);
+
+        // Surfaces with the same geometry but different lod settings have different lods
+        float lodFactors[3] = {lodSettings.ratio, lodSettings.maxError, lodSettings.minReduction};
+        uint8_t lodOptions[3] = {lodSettings.maxLodCount, lodSettings.bSloppyFallback, lodSettings.bCompactLodVertices};
+        HashBytes(reinterpret_cast<const uint8_t*>(lodFactors), sizeof(lodFactors), geometry.hash);
+        HashBytes(lodOptions, sizeof(lodOptions), geometry.hash);
+
+        return geometry;
+    }
+
+    // Returns the id of the surface that was loaded with the same geometry, or ce_noGeometryMatch
+    constexpr uint32_t ce_noGeometryMatch = ~0u;
+    static uint32_t FindGeometry(RenderingResources* pResources, const GeometryHash& geometry)
+    {
+        size_t slotCount = pResources->geometryHashSlots.GetSize();
+        if(slotCount == 0)
+            return ce_noGeometryMatch;
+
+        for(size_t slot = geometry.hash[0] & (slotCount - 1); pResources->geometryHashSlots[slot]; slot = (slot + 1) & (slotCount - 1))
+        {
+            GeometryHash& entry = pResources->geometryHashes[pResources->geometryHashSlots[slot] - 1];
+            if(entry.hash[0] == geometry.hash[0] && entry.hash[1] == geometry.hash[1] && 
+            entry.vertexCount == geometry.vertexCount && entry.indexCount == geometry.indexCount)
+                return entry.surfaceId;
+        }
+        return ce_noGeometryMatch;
+    }
+
+    // The table is kept at most half full, it is rebuilt with twice the slots when it would go over
+    static void InsertGeometry(RenderingResources* pResources, const GeometryHash& geometry)
+    {
+        pResources->geometryHashes.PushBack(geometry);
+
+        size_t slotCount = pResources->geometryHashSlots.GetSize();
+        size_t first = slotCount;
+        if(pResources->geometryHashes.GetSize() * 2 > slotCount)
+        {
+            slotCount = slotCount ? slotCount * 2 : 64;
+            uint32_t empty = 0;
+            BlitCL::DynamicArray<uint32_t> slots(slotCount, empty);
+            pResources->geometryHashSlots.Downsize(0);
+            pResources->geometryHashSlots.AppendArray(slots);
+            first = 0;
+        }
+        else
+        {
+            first = pResources->geometryHashes.GetSize() - 1;
+        }
+
+        for(size_t i = first; i < pResources->geometryHashes.GetSize(); ++i)
+        {
+            size_t slot = pResources->geometryHashes[i].hash[0] & (slotCount - 1);
+            while(pResources->geometryHashSlots[slot])
+                slot = (slot + 1) & (slotCount - 1);
+            pResources->geometryHashSlots[slot] = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+    // Largest acmr increase that the overdraw optimizer may trade for less overdraw
+    constexpr float ce_overdrawCacheThreshold = 1.05f;
+
+    // Vertex cache order first, then meshopt_optimizeOverdraw moves clusters of triangles so that the ones facing outwards are drawn first.
+    // Strips skip the overdraw pass, it would break the triangle order that they are built from
+    static void OptimizeLodIndices(RenderingResources* pResources, BlitCL::DynamicArray<Vertex>& vertices, 
+    BlitCL::DynamicArray<uint32_t>& lodIndices)
+    {
+        if(pResources->bStripIndices)
+        {
+            meshopt_optimizeVertexCacheStrip(lodIndices.Data(), lodIndices.Data(), lodIndices.GetSize(), vertices.GetSize());
+            return;
+        }
+
+        meshopt_optimizeVertexCache(lodIndices.Data(), lodIndices.Data(), lodIndices.GetSize(), vertices.GetSize());
+        meshopt_optimizeOverdraw(lodIndices.Data(), lodIndices.Data(), lodIndices.GetSize(), &vertices[0].position.x, 
+        vertices.GetSize(), sizeof(Vertex), ce_overdrawCacheThreshold);
+    }
+
+    // Appends the vertices that the lod uses to the surface's vertices, in the order that the lod first uses them,
+    // and points the lod's indices to the copies. Only the first sourceVertexCount vertices are read
+    static void CompactLodVertices(BlitCL::DynamicArray<Vertex>& vertices, size_t sourceVertexCount, 
+    BlitCL::DynamicArray<uint32_t>& lodIndices)
+    {
+        BlitCL::DynamicArray<Vertex> lodVertices(sourceVertexCount);
+        size_t lodVertexCount = meshopt_optimizeVertexFetch(lodVertices.Data(), lodIndices.Data(), lodIndices.GetSize(), 
+        vertices.Data(), sourceVertexCount, sizeof(Vertex));
+        lodVertices.Downsize(lodVertexCount);
+
+        uint32_t firstVertex = static_cast<uint32_t>(vertices.GetSize());
+        for(size_t i = 0; i < lodIndices.GetSize(); ++i)
+            lodIndices[i] += firstVertex;
+
+        vertices.AppendArray(lodVertices);
+    }
+
+    // The bounding sphere is seeded from the extreme vertices along the 3 axes and the 4 diagonals (EPOS-14)
+    constexpr uint32_t ce_extremeDirectionCount = 7;
+
+    // Finds the vertices with the smallest and largest projection on each direction. The first 3 directions are the axes,
+    // so their projections are also the bounding box
+    static void FindExtremeVertices(BlitCL::DynamicArray<Vertex>& vertices, uint32_t* pMinVertices, uint32_t* pMaxVertices,
+    BlitML::vec3& aabbMin, BlitML::vec3& aabbMax)
+    {
+        float minProjections[8];
+        float maxProjections[8];
+        uint32_t vertexCount = static_cast<uint32_t>(vertices.GetSize());
+
+        #ifdef BLIT_SSE2_VERTEX_CONVERSION
+        // The axis projections are the position itself, the diagonal projections are 4 dot products done at the same time
+        const __m128 diagonalX = _mm_setr_ps(1.f, 1.f, 1.f, -1.f);
+        const __m128 diagonalY = _mm_setr_ps(1.f, 1.f, -1.f, 1.f);
+        const __m128 diagonalZ = _mm_setr_ps(1.f, -1.f, 1.f, 1.f);
+
+        __m128 minAxes = _mm_set1_ps(FLT_MAX);
+        __m128 maxAxes = _mm_set1_ps(-FLT_MAX);
+        __m128 minDiagonals = minAxes;
+        __m128 maxDiagonals = maxAxes;
+        __m128i minAxisVertices = _mm_setzero_si128();
+        __m128i maxAxisVertices = minAxisVertices;
+        __m128i minDiagonalVertices = minAxisVertices;
+        __m128i maxDiagonalVertices = minAxisVertices;
+
+        for(uint32_t i = 0; i < vertexCount; ++i)
+        {
+            // The 4th lane holds the uvs, it is ignored. The load does not go past the vertex since the position is its first member
+            __m128 axes = _mm_loadu_ps(&vertices[i].position.x);
+            __m128 diagonals = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(_mm_shuffle_ps(axes, axes, _MM_SHUFFLE(0, 0, 0, 0)), diagonalX),
+            _mm_mul_ps(_mm_shuffle_ps(axes, axes, _MM_SHUFFLE(1, 1, 1, 1)), diagonalY)),
+            _mm_mul_ps(_mm_shuffle_ps(axes, axes, _MM_SHUFFLE(2, 2, 2, 2)), diagonalZ));
+
+            __m128i index = _mm_set1_epi32(static_cast<int>(i));
+
+            // Each lane keeps the index of the vertex that last moved its bound
+            __m128i mask = _mm_castps_si128(_mm_cmplt_ps(axes, minAxes));
+            minAxisVertices = _mm_or_si128(_mm_and_si128(mask, index), _mm_andnot_si128(mask, minAxisVertices));
+            minAxes = _mm_min_ps(axes, minAxes);
+
+            mask = _mm_castps_si128(_mm_cmpgt_ps(axes, maxAxes));
+            maxAxisVertices = _mm_or_si128(_mm_and_si128(mask, index), _mm_andnot_si128(mask, maxAxisVertices));
+            maxAxes = _mm_max_ps(axes, maxAxes);
+
+            mask = _mm_castps_si128(_mm_cmplt_ps(diagonals, minDiagonals));
+            minDiagonalVertices = _mm_or_si128(_mm_and_si128(mask, index), _mm_andnot_si128(mask, minDiagonalVertices));
+            minDiagonals = _mm_min_ps(diagonals, minDiagonals);
+
+            mask = _mm_castps_si128(_mm_cmpgt_ps(diagonals, maxDiagonals));
+            maxDiagonalVertices = _mm_or_si128(_mm_and_si128(mask, index), _mm_andnot_si128(mask, maxDiagonalVertices));
+            maxDiagonals = _mm_max_ps(diagonals, maxDiagonals);
+        }
+
+        uint32_t minVertices[8];
+        uint32_t maxVertices[8];
+        _mm_storeu_ps(minProjections, minAxes);
+        _mm_storeu_ps(minProjections + 3, minDiagonals);
+        _mm_storeu_ps(maxProjections, maxAxes);
+        _mm_storeu_ps(maxProjections + 3, maxDiagonals);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(minVertices), minAxisVertices);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(minVertices + 3), minDiagonalVertices);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(maxVertices), maxAxisVertices);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(maxVertices + 3), maxDiagonalVertices);
+        for(uint32_t d = 0; d < ce_extremeDirectionCount; ++d)
+        {
+            pMinVertices[d] = minVertices[d];
+            pMaxVertices[d] = maxVertices[d];
+        }
+        #else
+        const float directions[ce_extremeDirectionCount][3] =
+        {
+            {1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, 0.f, 1.f},
+            {1.f, 1.f, 1.f}, {1.f, 1.f, -1.f}, {1.f, -1.f, 1.f}, {-1.f, 1.f, 1.f}
+        };
+
+        for(uint32_t d = 0; d < ce_extremeDirectionCount; ++d)
+        {
+            minProjections[d] = FLT_MAX;
+            maxProjections[d] = -FLT_MAX;
+            pMinVertices[d] = 0;
+            pMaxVertices[d] = 0;
+        }
+
+        for(uint32_t i = 0; i < vertexCount; ++i)
+        {
+            const BlitML::vec3& p = vertices[i].position;
+            for(uint32_t d = 0; d < ce_extremeDirectionCount; ++d)
+            {
+                float projection = p.x * directions[d][0] + p.y * directions[d][1] + p.z * directions[d][2];
+                if(projection < minProjections[d])
+                {
+                    minProjections[d] = projection;
+                    pMinVertices[d] = i;
+                }
+                if(projection > maxProjections[d])
+                {
+                    maxProjections[d] = projection;
+                    pMaxVertices[d] = i;
+                }
+            }
+        }
+        #endif
+
+        aabbMin = BlitML::vec3(minProjections[0], minProjections[1], minProjections[2]);
+        aabbMax = BlitML::vec3(maxProjections[0], maxProjections[1], maxProjections[2]);
+    }
+
+    // Largest distance from the center to any vertex
+    static float FitSphereRadius(BlitCL::DynamicArray<Vertex>& vertices, const BlitML::vec3& center)
+    {
+        float radiusSquared = 0.f;
+        for(size_t i = 0; i < vertices.GetSize(); ++i)
+            radiusSquared = BlitML::Max(radiusSquared, BlitML::LengthSquared(vertices[i].position - center));
+        return BlitML::Sqrt(radiusSquared);
+    }
+
+    // Computes the bounding box and a near minimal bounding sphere of the surface
+    static void ComputeSurfaceBounds(BlitCL::DynamicArray<Vertex>& vertices, PrimitiveSurface& surface)
+    {
+        uint32_t minVertices[ce_extremeDirectionCount];
+        uint32_t maxVertices[ce_extremeDirectionCount];
+        FindExtremeVertices(vertices, minVertices, maxVertices, surface.aabbMin, surface.aabbMax);
+
+        // The initial sphere goes through the pair of extreme vertices that are furthest apart
+        uint32_t widestDirection = 0;
+        float widestDistanceSquared = -1.f;
+        for(uint32_t d = 0; d < ce_extremeDirectionCount; ++d)
+        {
+            float distanceSquared = BlitML::LengthSquared(vertices[maxVertices[d]].position - vertices[minVertices[d]].position);
+            if(distanceSquared > widestDistanceSquared)
+            {
+                widestDistanceSquared = distanceSquared;
+                widestDirection = d;
+            }
+        }
+        BlitML::vec3 center = (vertices[minVertices[widestDirection]].position + vertices[maxVertices[widestDirection]].position) * 0.5f;
+        float radius = BlitML::Sqrt(widestDistanceSquared) * 0.5f;
+
+        // Ritter's algorithm, grows the sphere just enough to include each vertex that is outside of it
+        for(size_t i = 0; i < vertices.GetSize(); ++i)
+        {
+            BlitML::vec3 offset = vertices[i].position - center;
+            float distanceSquared = BlitML::LengthSquared(offset);
+            if(distanceSquared > radius * radius)
+            {
+                float distance = BlitML::Sqrt(distanceSquared);
+                float newRadius = (radius + distance) * 0.5f;
+                center = center + offset * ((newRadius - radius) / distance);
+                radius = newRadius;
+            }
+        }
+
+        // The radius is fit again so that rounding in the growth steps cannot leave a vertex outside.
+        // Ritter can do worse than the vertex centroid for some shapes, so that sphere is used instead when it is smaller
+        BlitML::vec3 centroid(0.f);
+        for(size_t i = 0; i < vertices.GetSize(); ++i)
+            centroid = centroid + vertices[i].position;
+        centroid = centroid / static_cast<float>(vertices.GetSize());
+
+        float ritterRadius = FitSphereRadius(vertices, center);
+        float centroidRadius = FitSphereRadius(vertices, centroid);
+        surface.center = ritterRadius <= centroidRadius ? center : centroid;
+        surface.radius = BlitML::Max(ritterRadius <= centroidRadius ? ritterRadius : centroidRadius, 0.f);
+    }
+
+    // Computes the normal cone of all the triangles of the surface, the same way that meshopt_computeClusterBounds does for clusters
+    static void ComputeSurfaceNormalCone(BlitCL::DynamicArray<Vertex>& vertices, BlitCL::DynamicArray<uint32_t>& indices,
+    PrimitiveSurface& surface)
+    {
+        // The default is a cone that culls nothing
+        surface.coneAxis[0] = surface.coneAxis[1] = surface.coneAxis[2] = 0;
+        surface.coneCutoff = 127;
+
+        BlitML::vec3 normalSum(0.f);
+        for(size_t i = 0; i + 2 < indices.GetSize(); i += 3)
+        {
+            const BlitML::vec3& p0 = vertices[indices[i]].position;
+            BlitML::vec3 normal = BlitML::Cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+            float length = BlitML::Length(normal);
+            if(length > 0.f)
+                normalSum = normalSum + normal / length;
+        }
+
+        float sumLength = BlitML::Length(normalSum);
+        if(sumLength == 0.f)
+            return;
+        BlitML::vec3 axis = normalSum / sumLength;
+
+        float minDot = 1.f;
+        for(size_t i = 0; i + 2 < indices.GetSize(); i += 3)
+        {
+            const BlitML::vec3& p0 = vertices[indices[i]].position;
+            BlitML::vec3 normal = BlitML::Cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+            float length = BlitML::Length(normal);
+            if(length == 0.f)
+                continue;
+
+            float dot = BlitML::Dot(normal / length, axis);
+            minDot = dot < minDot ? dot : minDot;
+        }
+
+        // Some triangles face away from the axis, the surface is visible from every direction
+        if(minDot <= 0.f)
+            return;
+
+        // The cutoff is the sine of the cone's angle. The quantization error of the axis is added to it so that the test stays conservative
+        float cutoff = BlitML::Sqrt(1.f - minDot * minDot);
+        float axisComponents[3] = {axis.x, axis.y, axis.z};
+        float axisError = 0.f;
+        for(uint8_t i = 0; i < 3; ++i)
+        {
+            surface.coneAxis[i] = QuantizeSnorm8(axisComponents[i]);
+            axisError += BlitML::Abs(surface.coneAxis[i] / 127.f - axisComponents[i]);
+        }
+        int32_t quantizedCutoff = static_cast<int32_t>(127.f * (cutoff + axisError) + 1.f);
+        surface.coneCutoff = static_cast<int8_t>(quantizedCutoff > 127 ? 127 : quantizedCutoff);
+    }
+
     void LoadPrimitiveSurface(RenderingResources* pResources, 
     BlitCL::DynamicArray<Vertex>& vertices, 
-    BlitCL::DynamicArray<uint32_t>& indices)
+    BlitCL::DynamicArray<uint32_t>& indices, 
+    const LodSettings* pLodSettings /*= nullptr*/)
     {
-        // This is an algorithm from Arseny Kapoulkine that improves the way vertices are distributed for a primitive
-        meshopt_optimizeVertexCache(indices.Data(), indices.Data(), indices.GetSize(), vertices.GetSize());
-	    meshopt_optimizeVertexFetch(vertices.Data(), indices.Data(), indices.GetSize(), vertices.Data(), 
+        const LodSettings& lodSettings = pLodSettings ? *pLodSettings : pResources->lodSettings;
+        uint8_t maxLodCount = lodSettings.maxLodCount < ce_primitiveSurfaceMaxLODCount ? 
+        lodSettings.maxLodCount : ce_primitiveSurfaceMaxLODCount;
+        BLIT_ASSERT(maxLodCount > 0)
+
+        // Geometry that was already loaded only gets a new surface entry, which points to the same vertices, indices and lods
+        GeometryHash geometry{};
+        if(pResources->bDeduplicateGeometry)
+        {
+            geometry = HashGeometry(vertices, indices, lodSettings);
+            uint32_t matchingSurface = FindGeometry(pResources, geometry);
+            if(matchingSurface != ce_noGeometryMatch)
+            {
+                PrimitiveSurface sharedSurface = pResources->surfaces[matchingSurface];
+                sharedSurface.materialId = 0;
+                sharedSurface.postPass = 0;
+                pResources->surfaces.PushBack(sharedSurface);
+                pResources->primitiveVertexCounts.PushBack(pResources->primitiveVertexCounts[matchingSurface]);
+                OccluderMesh sharedOccluder = pResources->occluders[matchingSurface];
+                pResources->occluders.PushBack(sharedOccluder);
+                return;
+            }
+            geometry.surfaceId = static_cast<uint32_t>(pResources->surfaces.GetSize());
+        }
+
+        // The import report keeps the loaded geometry's numbers, to compare the optimized lods against
+        size_t uploadedVertexSize = pResources->bCompactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+        SurfaceImportReport report{};
+        if(pResources->bImportReport)
+        {
+            report.surfaceId = static_cast<uint32_t>(pResources->surfaces.GetSize());
+            AnalyzeLodIndices(indices.Data(), indices.GetSize(), vertices, uploadedVertexSize, report.unoptimized);
+        }
+
+        // This is an algorithm from Arseny Kapoulkine that improves the way vertices are distributed for a primitive.
+        // The strip variant trades some cache efficiency for longer strips
+        OptimizeLodIndices(pResources, vertices, indices);
+
+        meshopt_optimizeVertexFetch(vertices.Data(), indices.Data(), indices.GetSize(), vertices.Data(), 
         vertices.GetSize(), sizeof(Vertex));
 
         // Create the new surface that will be added and initialize its vertex offset
         PrimitiveSurface newSurface;
-        newSurface.vertexOffset = static_cast<uint32_t>(pResources->vertices.GetSize());
-
-        // Since the vertices will be global for all shaders and objects, new elements will be added to the one vertex array
-        pResources->vertices.AppendArray(vertices);
+        newSurface.vertexOffset = static_cast<uint32_t>(pResources->bCompactVertices ? 
+        pResources->compactVertices.GetSize() : pResources->vertices.GetSize());
 
         // Create the normal array to be used with the meshoptimizer function for lod generation
         BlitCL::DynamicArray<BlitML::vec3> normals(vertices.GetSize());
@@ -239,92 +686,161 @@ namespace BlitzenEngine
 
 	    float normalWeights[3] = {1.f, 1.f, 1.f};
 
-        // Pass the original loaded indices of the surface to the new lod indices
-        BlitCL::DynamicArray<uint32_t> lodIndices(indices);
+        // The indices of every lod, each one simplified from the previous. The first one holds the original loaded indices
+        BlitCL::DynamicArray<uint32_t> lodIndexLists[ce_primitiveSurfaceMaxLODCount];
+        lodIndexLists[0].AppendArray(indices);
 
-        while(newSurface.lodCount < ce_primitiveSurfaceMaxLODCount)
+        while(newSurface.lodCount < maxLodCount)
         {
             // Get current element in the LOD array and increment the count
             MeshLod& lod = newSurface.meshLod[newSurface.lodCount++];
 
-            // Save the indices that will be used for the current lod level
-            lod.firstIndex = static_cast<uint32_t>(pResources->indices.GetSize());
-            lod.indexCount = static_cast<uint32_t>(lodIndices.GetSize());
+            // Save the current lod error
+            lod.error = lodError * lodScale;
 
-            // Save the meshlets that will be used for the current lod level
-            lod.firstMeshlet = static_cast<uint32_t>(pResources->meshlets.GetSize());
-            lod.meshletCount = ce_buildClusters ? static_cast<uint32_t>(GenerateClusters(pResources, vertices, indices)) : 0;
+            if(newSurface.lodCount == maxLodCount)
+                break;
 
-            // Add the new indices that were loaded for this lod level to the global index buffer
-            pResources->indices.AppendArray(lodIndices);
+            BlitCL::DynamicArray<uint32_t>& lodIndices = lodIndexLists[newSurface.lodCount - 1];
+            BlitCL::DynamicArray<uint32_t>& nextIndices = lodIndexLists[newSurface.lodCount];
+            nextIndices.Resize(lodIndices.GetSize());
 
-            // Save the current lod error
-            lod.error = lodError * lodScale;
+            // Specify the next target index count
+            size_t nextIndicesTarget = static_cast<size_t>((double(lodIndices.GetSize()) * lodSettings.ratio) / 3) * 3;
 
-            if(newSurface.lodCount < ce_primitiveSurfaceMaxLODCount)
-            {
-                // Specify the next target index count (simplify by 65% each time)
-                size_t nextIndicesTarget = static_cast<size_t>((double(lodIndices.GetSize()) * 0.65) / 3) * 3;
+            // Lods that are too close to the previous one are not worth keeping
+            size_t minReductionSize = static_cast<size_t>(double(lodIndices.GetSize()) * lodSettings.minReduction);
 
-                const float maxError = 1e-1f;// Parameter for meshopt_simplifyWithAttributes
+            // The next error will be saved here to check if the actual lod error should be updated
+            float nextError = 0;
 
-                // The next error will be saved here to check if the actual lod error should be updated
-                float nextError = 0;
+            // Generate the indices
+            size_t nextIndicesSize = meshopt_simplifyWithAttributes(nextIndices.Data(), lodIndices.Data(), 
+            lodIndices.GetSize(), &vertices[0].position.x, 
+            vertices.GetSize(), sizeof(Vertex), &normals[0].x, sizeof(BlitML::vec3), 
+            normalWeights, 3, nullptr, nextIndicesTarget, lodSettings.maxError, 0, &nextError);
 
-                // Generate the indices
-                size_t nextIndicesSize = meshopt_simplifyWithAttributes(lodIndices.Data(), lodIndices.Data(), 
-                lodIndices.GetSize(), &vertices[0].position.x, 
-                vertices.GetSize(), sizeof(Vertex), &normals[0].x, sizeof(BlitML::vec3), 
-                normalWeights, 3, nullptr, nextIndicesTarget, maxError, 0, &nextError);
+            // If the next lod size surpasses the previous than this function has failed
+            BLIT_ASSERT(nextIndicesSize <= lodIndices.GetSize())
 
-                // If the next lod size surpasses the previous than this function has failed
-                BLIT_ASSERT(nextIndicesSize <= lodIndices.GetSize())
+            // Reached the error bound or the topology does not allow more collapses. 
+            // The sloppy simplifier gets to the target regardless, its error is saved so lod selection only picks it from far enough
+            if((nextIndicesSize == 0 || nextIndicesSize >= minReductionSize) && lodSettings.bSloppyFallback)
+            {
+                nextIndicesSize = meshopt_simplifySloppy(nextIndices.Data(), lodIndices.Data(), lodIndices.GetSize(), 
+                &vertices[0].position.x, vertices.GetSize(), sizeof(Vertex), nextIndicesTarget, FLT_MAX, &nextError);
+            }
 
-                // Reached the error bounds
-                if(nextIndicesSize == lodIndices.GetSize() || nextIndicesSize == 0)
-                    break;
+            if(nextIndicesSize == 0 || nextIndicesSize >= minReductionSize)
+                break;
 
-                // while I could keep this LOD, it's too close to the last one (and it can't go below that due to constant error bound above)
-			    if (nextIndicesSize >= size_t(double(lodIndices.GetSize()) * 0.95))
-				    break;
+            // Downsize the indices to the next indices size
+            nextIndices.Downsize(nextIndicesSize);
 
-                // Downsize the indices to the next indices size
-                lodIndices.Downsize(nextIndicesSize);
- 
-                // Optimize the new vertex cache that was generated
-                meshopt_optimizeVertexCache(lodIndices.Data(), lodIndices.Data(), lodIndices.GetSize(), vertices.GetSize());
+            // Optimize the new vertex cache that was generated
+            OptimizeLodIndices(pResources, vertices, nextIndices);
 
-                // since it starts from next lod accumulate the error
-                lodError = BlitML::Max(lodError, nextError);
-            }
+            // since it starts from next lod accumulate the error
+            lodError = BlitML::Max(lodError, nextError);
         }
 
-        // Calculate the center of the bounding sphere for the surface
-        BlitML::vec3 center(0.f);
-        for(size_t i = 0; i < vertices.GetSize(); ++i)
+        // Each lod after the first gets a copy of the vertices it uses, appended after the surface's vertices in the order it uses them.
+        // Its indices stay relative to the surface's vertex offset, so nothing else needs to know about the sub ranges
+        if(lodSettings.bCompactLodVertices)
         {
-            center = center + vertices[i].position;// I have not overloaded the += operator
+            size_t sourceVertexCount = vertices.GetSize();
+            for(uint8_t i = 1; i < newSurface.lodCount; ++i)
+                CompactLodVertices(vertices, sourceVertexCount, lodIndexLists[i]);
         }
-        center = center / static_cast<float>(vertices.GetSize());// Again, I've only overloaded the regular operators
 
-        // After calculating the center, calculate the radius of the bounding sphere
-        float radius = 0;
-        for(size_t i = 0; i < vertices.GetSize(); ++i)
+        // 16-bit indices need to leave the largest value free for primitive restart
+        newSurface.bIndices16 = pResources->bIndices16 && vertices.GetSize() < ce_stripRestartIndex16;
+
+        // Measured on the final triangle lists, before they are encoded as strips
+        if(pResources->bImportReport)
         {
-            BlitML::vec3 pos = vertices[i].position;
-            radius = BlitML::Max(radius, BlitML::Distance(center, BlitML::vec3(pos.x, pos.y, pos.z)));
+            report.lodCount = newSurface.lodCount;
+            for(uint8_t i = 0; i < newSurface.lodCount; ++i)
+                AnalyzeLodIndices(lodIndexLists[i].Data(), lodIndexLists[i].GetSize(), vertices, uploadedVertexSize, report.lods[i]);
+            pResources->importReport.PushBack(report);
         }
 
-        // Pass the center and radius to the surface, so that bounding sphere data is available for frustum culling
-        newSurface.center = center;
-        newSurface.radius = radius;
+        // Holds the indices of each lod for cluster generation
+        LodClusterJob clusterJobs[ce_primitiveSurfaceMaxLODCount];
+
+        for(uint8_t i = 0; i < newSurface.lodCount; ++i)
+        {
+            MeshLod& lod = newSurface.meshLod[i];
+
+            // The clusters of this lod are generated from its own indices after every lod is known
+            lod.firstMeshlet = static_cast<uint32_t>(pResources->meshlets.GetSize());
+            lod.meshletCount = 0;
+            if(ce_buildClusters)
+                clusterJobs[i].indices.AppendArray(lodIndexLists[i]);
+
+            // Add the new indices that were loaded for this lod level to the global index buffer, this also saves their offset and count
+            AppendLodIndices(pResources, lodIndexLists[i], vertices.GetSize(), newSurface.bIndices16, lod);
+        }
+
+        // Every lod gets clusters of its own indices. The jobs write to separate arrays, which are then appended in lod order
+        if(ce_buildClusters)
+        {
+            GenerateLodClusters(vertices, clusterJobs, newSurface.lodCount);
+            for(uint8_t i = 0; i < newSurface.lodCount; ++i)
+            {
+                MeshLod& lod = newSurface.meshLod[i];
+                LodClusterJob& job = clusterJobs[i];
+                lod.firstMeshlet = static_cast<uint32_t>(pResources->meshlets.GetSize());
+                lod.meshletCount = static_cast<uint32_t>(job.meshlets.GetSize());
+
+                uint32_t dataOffset = static_cast<uint32_t>(pResources->meshletData.GetSize());
+                for(size_t m = 0; m < job.meshlets.GetSize(); ++m)
+                    job.meshlets[m].dataOffset += dataOffset;
+
+                pResources->meshlets.AppendArray(job.meshlets);
+                pResources->meshletData.AppendArray(job.meshletData);
+            }
+        }
+
+        // Large surfaces also get a hierarchy of clusters, so that the mesh shader can pick the detail of each part separately
+        if(pResources->bClusterLod && indices.GetSize() / 3 >= ce_clusterLodMinTriangles)
+            BuildClusterLod(pResources, vertices, indices, newSurface);
+
+        // Bounding sphere, box and normal cone, so that they are available for culling.
+        // The cone uses the full detail indices, lods are simplified versions of the same surface
+        ComputeSurfaceBounds(vertices, newSurface);
+        ComputeSurfaceNormalCone(vertices, indices, newSurface);
+
+        // The occluder is simplified from the full detail indices, surfaces without one are never drawn as occluders
+        OccluderMesh occluder{};
+        if(pResources->bOccluderMeshes)
+            BuildOccluderMesh(pResources, vertices, indices, occluder);
+
+        BlitML::vec3 center = newSurface.center;
+        float radius = newSurface.radius;
+
+        // Since the vertices will be global for all shaders and objects, new elements will be added to the one vertex array.
+        // Compact vertices are quantized relative to the bounding sphere above, which contains every vertex
+        if(pResources->bCompactVertices)
+        {
+            size_t firstVertex = pResources->compactVertices.GetSize();
+            pResources->compactVertices.Resize(firstVertex + vertices.GetSize());
+            EncodeCompactVertices(vertices.Data(), vertices.GetSize(), center, radius, &pResources->compactVertices[firstVertex]);
+        }
+        else
+        {
+            pResources->vertices.AppendArray(vertices);
+        }
 
         // Default material
         newSurface.materialId = 0;
 
         // Add the resources to the global surface array so that it is added to the GPU buffer
         pResources->surfaces.PushBack(newSurface);
+        if(pResources->bDeduplicateGeometry)
+            InsertGeometry(pResources, geometry);
         pResources->primitiveVertexCounts.PushBack(static_cast<uint32_t>(vertices.GetSize()));
+        pResources->occluders.PushBack(occluder);
     }
 
 
@@ -338,124 +854,113 @@ namespace BlitzenEngine
     }
 
 
-    void CreateTestGameObjects(RenderingResources* pResources, uint32_t dc)
-    {
-        constexpr float ce_stressTestRandomTransformMultiplier = 3'000.f;
-        #ifdef BLITZEN_RENDERING_STRESS_TEST
-        constexpr uint32_t drawCount = 4'500'000;
-        #else
-        uint32_t drawCount = dc;
-        #endif
+    // The stress test scene is generated from a fixed seed, so that every run and every machine draws the same objects
+    constexpr uint64_t ce_stressTestSeed = 0xb1172e9;
+    constexpr float ce_stressTestRandomTransformMultiplier = 3'000.f;
 
-        BLIT_INFO("Loading Renderer Stress test with %i objects", drawCount)
-        BLIT_WARN("If your machine cannot withstand this many objects, decrease the draw count or undef the stress test macro")
+    // The objects are split into a fixed number of chunks, each with its own random streams, so the scene does not depend on the thread count
+    constexpr uint32_t ce_stressTestChunkCount = 64;
 
-        pResources->objectCount = drawCount;// Normally the draw count differs from the game object count, but the engine is really simple at the moment
-        pResources->transforms.Resize(pResources->objectCount);// Every object has a different transform
+    // Every one of this many stress test objects can move, so that the dynamic paths of culling always have objects to work on
+    constexpr uint32_t ce_stressTestDynamicInterval = 16;
+
+    // Random floats taken by each object: translation, rotation axis and rotation angle
+    constexpr uint32_t ce_stressTestFloatsPerObject = 7;
+    constexpr uint32_t ce_stressTestBatchSize = 256;
 
+    // Mesh and scale of the object, by where the object is in the scene
+    static void GetStressTestObjectMesh(size_t objectId, size_t objectCount, uint32_t& meshIndex, float& scale)
+    {
         // Hardcode a large amount of male model mesh
-        for(size_t i = 0; i < pResources->objectCount / 10; ++i)
+        if(objectId < objectCount / 10)
         {
-            BlitzenEngine::MeshTransform& transform = pResources->transforms[i];
-
-            // Loading random position and scale. Normally you would get this from the game object
-            BlitML::vec3 translation(
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//x 
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//y
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier);//z
-            transform.pos = translation;
-            transform.scale = 0.1f;
-
-            // Loading random orientation. Normally you would get this from the game object
-            BlitML::vec3 axis((float(rand()) / RAND_MAX) * 2 - 1, // x
-            (float(rand()) / RAND_MAX) * 2 - 1, // y
-            (float(rand()) / RAND_MAX) * 2 - 1); // z
-		    float angle = BlitML::Radians((float(rand()) / RAND_MAX) * 90.f);
-            BlitML::quat orientation = BlitML::QuatFromAngleAxis(axis, angle, 0);
-            transform.orientation = orientation;
-
-            GameObject& currentObject = pResources->objects[i];
-
-            currentObject.meshIndex = 3;// Hardcode the bunny mesh for each object in this loop
-            currentObject.transformIndex = static_cast<uint32_t>(i);// Transform index is the same as the object index
+            meshIndex = 3;
+            scale = 0.1f;
         }
-        // Hardcode a large amount of objects with the high polygon kitten mesh and random transforms
-        for (size_t i = pResources->objectCount / 10; i < pResources->objectCount / 8; ++i)
+        // Hardcode a large amount of objects with the high polygon kitten mesh
+        else if(objectId < objectCount / 8)
         {
-            BlitzenEngine::MeshTransform& transform = pResources->transforms[i];
-
-            // Loading random position and scale. Normally you would get this from the game object
-            BlitML::vec3 translation(
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//x 
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//y
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier);//z
-            transform.pos = translation;
-            transform.scale = 1.f;
-
-            // Loading random orientation. Normally you would get this from the game object
-            BlitML::vec3 axis((float(rand()) / RAND_MAX) * 2 - 1, // x
-            (float(rand()) / RAND_MAX) * 2 - 1, // y
-            (float(rand()) / RAND_MAX) * 2 - 1); // z
-		    float angle = BlitML::Radians((float(rand()) / RAND_MAX) * 90.f);
-            BlitML::quat orientation = BlitML::QuatFromAngleAxis(axis, angle, 0);
-            transform.orientation = orientation;
-
-            GameObject& currentObject = pResources->objects[i];
-
-            currentObject.meshIndex = 1;// Hardcode the kitten mesh for each object in this loop
-            currentObject.transformIndex = static_cast<uint32_t>(i);// Transform index is the same as the object index
+            meshIndex = 1;
+            scale = 1.f;
         }
         // Hardcode a large amount of stanford dragons
-        for (size_t i = pResources->objectCount / 8; i < pResources->objectCount / 6; ++i)
+        else if(objectId < objectCount / 6)
+        {
+            meshIndex = 0;
+            scale = 0.1f;
+        }
+        // Hardcode a large amount of standford bunnies
+        else
         {
-            BlitzenEngine::MeshTransform& transform = pResources->transforms[i];
+            meshIndex = 2;
+            scale = 5.f;
+        }
+    }
 
-            // Loading random position and scale. Normally you would get this from the game object
-            BlitML::vec3 translation(
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//x 
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//y
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier);//z
-            transform.pos = translation;
-            transform.scale = 0.1f;
+    static void CreateTestGameObjectChunk(RenderingResources* pResources, uint32_t chunk)
+    {
+        size_t first = pResources->objectCount * chunk / ce_stressTestChunkCount;
+        size_t last = pResources->objectCount * (chunk + 1) / ce_stressTestChunkCount;
 
-            // Loading random orientation. Normally you would get this from the game object
-            BlitML::vec3 axis((float(rand()) / RAND_MAX) * 2 - 1, // x
-                (float(rand()) / RAND_MAX) * 2 - 1, // y
-                (float(rand()) / RAND_MAX) * 2 - 1); // z
-            float angle = BlitML::Radians((float(rand()) / RAND_MAX) * 90.f);
-            BlitML::quat orientation = BlitML::QuatFromAngleAxis(axis, angle, 0);
-            transform.orientation = orientation;
+        BlitML::RandomBulkState random;
+        BlitML::SeedRandomBulk(random, ce_stressTestSeed, uint64_t(chunk) * BlitML::ce_randomBulkLanes);
 
-            GameObject& currentObject = pResources->objects[i];
+        float values[ce_stressTestBatchSize * ce_stressTestFloatsPerObject];
+        for(size_t batch = first; batch < last; batch += ce_stressTestBatchSize)
+        {
+            size_t batchSize = last - batch < ce_stressTestBatchSize ? last - batch : ce_stressTestBatchSize;
+            BlitML::RandomFillFloats(random, values, batchSize * ce_stressTestFloatsPerObject);
 
-            currentObject.meshIndex = 0;// Hardcode the kitten mesh for each object in this loop
-            currentObject.transformIndex = static_cast<uint32_t>(i);// Transform index is the same as the object index
+            for(size_t j = 0; j < batchSize; ++j)
+            {
+                size_t i = batch + j;
+                const float* pValues = values + j * ce_stressTestFloatsPerObject;
+                BlitzenEngine::MeshTransform& transform = pResources->transforms[i];
+                GameObject& currentObject = pResources->objects[i];
+
+                // Loading random position and orientation. Normally you would get this from the game object
+                transform.pos = BlitML::vec3(pValues[0], pValues[1], pValues[2]) * ce_stressTestRandomTransformMultiplier;
+                BlitML::vec3 axis(pValues[3] * 2 - 1, pValues[4] * 2 - 1, pValues[5] * 2 - 1);
+                float angle = BlitML::Radians(pValues[6] * 90.f);
+                transform.orientation = BlitML::QuatFromAngleAxis(axis, angle, 0);
+
+                GetStressTestObjectMesh(i, pResources->objectCount, currentObject.meshIndex, transform.scale);
+                currentObject.transformIndex = static_cast<uint32_t>(i);// Transform index is the same as the object index
+                currentObject.bDynamic = (i % ce_stressTestDynamicInterval) == 0;
+            }
         }
-        // Hardcode a large amount of standford bunnies
-        for (size_t i = pResources->objectCount / 6; i < pResources->objectCount; ++i)
-        {
-            BlitzenEngine::MeshTransform& transform = pResources->transforms[i];
+    }
 
-            // Loading random position and scale. Normally you would get this from the game object
-            BlitML::vec3 translation(
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//x 
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier,//y
-            (float(rand()) / RAND_MAX) * ce_stressTestRandomTransformMultiplier);//z
-            transform.pos = translation;
-            transform.scale = 5.f;
+    void CreateTestGameObjects(RenderingResources* pResources, uint32_t dc)
+    {
+        #ifdef BLITZEN_RENDERING_STRESS_TEST
+        constexpr uint32_t drawCount = 4'500'000;
+        #else
+        uint32_t drawCount = dc;
+        #endif
 
-            // Loading random orientation. Normally you would get this from the game object
-            BlitML::vec3 axis((float(rand()) / RAND_MAX) * 2 - 1, // x
-                (float(rand()) / RAND_MAX) * 2 - 1, // y
-                (float(rand()) / RAND_MAX) * 2 - 1); // z
-            float angle = BlitML::Radians((float(rand()) / RAND_MAX) * 90.f);
-            BlitML::quat orientation = BlitML::QuatFromAngleAxis(axis, angle, 0);
-            transform.orientation = orientation;
+        BLIT_INFO("Loading Renderer Stress test with %i objects", drawCount)
+        BLIT_WARN("If your machine cannot withstand this many objects, decrease the draw count or undef the stress test macro")
 
-            GameObject& currentObject = pResources->objects[i];
+        pResources->objectCount = drawCount;// Normally the draw count differs from the game object count, but the engine is really simple at the moment
+        pResources->transforms.Resize(pResources->objectCount);// Every object has a different transform
 
-            currentObject.meshIndex = 2;// Hardcode the kitten mesh for each object in this loop
-            currentObject.transformIndex = static_cast<uint32_t>(i);// Transform index is the same as the object index
+        // Each thread takes every threadCount-th chunk, the calling thread takes the first ones
+        uint32_t threadCount = BlitML::Clamp(static_cast<uint32_t>(std::thread::hardware_concurrency()), ce_stressTestChunkCount, 1u);
+        BlitCL::DynamicArray<std::thread> workers(threadCount - 1);
+        auto createChunks = [pResources, threadCount](uint32_t thread)
+        {
+            for(uint32_t chunk = thread; chunk < ce_stressTestChunkCount; chunk += threadCount)
+                CreateTestGameObjectChunk(pResources, chunk);
+        };
+        for(uint32_t i = 1; i < threadCount; ++i)
+        {
+            workers[i - 1] = std::thread(createChunks, i);
+        }
+        createChunks(0);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
         }
 
         // Create all the render objects by getting the data from the game objects
@@ -485,6 +990,22 @@ namespace BlitzenEngine
         CreateTestGameObjects(pResources, drawCount);
     }
 
+    void GatherDynamicTransforms(RenderingResources* pResources)
+    {
+        // Game objects can share a transform, it should still only be added once
+        BlitCL::DynamicArray<uint8_t> bAdded(pResources->transforms.GetSize(), uint8_t(0));
+        pResources->dynamicTransforms.Clear();
+        for(uint32_t i = 0; i < pResources->objectCount; ++i)
+        {
+            const GameObject& object = pResources->objects[i];
+            if(!object.bDynamic || bAdded[object.transformIndex])
+                continue;
+
+            bAdded[object.transformIndex] = 1;
+            pResources->dynamicTransforms.PushBack(object.transformIndex);
+        }
+    }
+
     uint8_t LoadTextureFromFile(RenderingResources* pResources, const char* filename, const char* texName)
     {
         // Don't go over the texture limit, might want to throw a warning here
@@ -497,6 +1018,107 @@ namespace BlitzenEngine
         return 1;
     }
 
+    /*-----------------------------------------
+        GLTF mapped buffers and accessor reads
+    ------------------------------------------*/
+
+    // Every file that cgltf asks for (the .gltf/.glb itself and any external .bin) goes through the virtual file system.
+    // Loose files are mapped and packed files are read in place (or decompressed), instead of being read into a heap buffer.
+    // The release callback only gets the data pointer, so the open files are kept here to find the rest
+    struct GltfMappedFiles
+    {
+        BlitCL::DynamicArray<BlitzenPlatform::VfsFile> files;
+
+        // Anything that cgltf did not release (it should not happen) is closed when the loader is done
+        inline ~GltfMappedFiles()
+        {
+            for(size_t i = 0; i < files.GetSize(); ++i)
+                BlitzenPlatform::VfsCloseFile(files[i]);
+        }
+    };
+
+    static cgltf_result GltfMapFile(const cgltf_memory_options* pMemoryOptions, const cgltf_file_options* pFileOptions, 
+    const char* path, cgltf_size* pSize, void** ppData)
+    {
+        GltfMappedFiles* pMappedFiles = reinterpret_cast<GltfMappedFiles*>(pFileOptions->user_data);
+
+        // Accessors are read all over the buffers, so the pages are requested up front instead of faulting in one by one
+        BlitzenPlatform::VfsFile file;
+        if(!BlitzenPlatform::VfsOpenFile(path, file, BlitzenPlatform::FileAccessHint::WillNeed))
+            return cgltf_result_file_not_found;
+
+        // External buffers come with their expected size, the file should at least be that big
+        if(pSize && *pSize && file.size < *pSize)
+        {
+            BlitzenPlatform::VfsCloseFile(file);
+            return cgltf_result_data_too_short;
+        }
+
+        if(pSize && *pSize == 0)
+            *pSize = file.size;
+
+        // cgltf only reads from buffers, so handing it the read only view is fine
+        *ppData = const_cast<uint8_t*>(file.pData);
+        pMappedFiles->files.PushBack(file);
+
+        return cgltf_result_success;
+    }
+
+    static void GltfUnmapFile(const cgltf_memory_options* pMemoryOptions, const cgltf_file_options* pFileOptions, void* pData)
+    {
+        GltfMappedFiles* pMappedFiles = reinterpret_cast<GltfMappedFiles*>(pFileOptions->user_data);
+        for(size_t i = 0; i < pMappedFiles->files.GetSize(); ++i)
+        {
+            if(pMappedFiles->files[i].pData == pData)
+            {
+                // Closing resets the entry, so the destructor above will skip it
+                BlitzenPlatform::VfsCloseFile(pMappedFiles->files[i]);
+                return;
+            }
+        }
+    }
+
+    // Returns the first element of an accessor inside its (mapped) buffer, if the accessor is plain floats that can be read in place.
+    // Sparse and quantized accessors return null and go through GltfReadAccessorElements instead
+    static const uint8_t* GltfGetInPlaceFloats(const cgltf_accessor* pAccessor)
+    {
+        if(pAccessor->is_sparse || !pAccessor->buffer_view || pAccessor->component_type != cgltf_component_type_r_32f)
+            return nullptr;
+
+        const uint8_t* pView = cgltf_buffer_view_data(pAccessor->buffer_view);
+        return pView ? pView + pAccessor->offset : nullptr;
+    }
+
+    static VertexAttributeSource GltfInPlaceSource(const uint8_t* pSrc, const cgltf_accessor* pAccessor)
+    {
+        VertexAttributeSource source;
+        source.pData = pSrc;
+        source.stride = pAccessor->stride;
+        return source;
+    }
+
+    // Slow path for accessors that cannot be read in place. Converts one element at a time through cgltf
+    template<typename ElementFunc>
+    static void GltfReadAccessorElements(const cgltf_accessor* pAccessor, cgltf_size componentCount, ElementFunc func)
+    {
+        // Sparse accessors need to be resolved as a whole, so they are the only case that still goes through a temporary buffer
+        if(pAccessor->is_sparse)
+        {
+            BlitCL::DynamicArray<float> unpacked(pAccessor->count * componentCount);
+            cgltf_accessor_unpack_floats(pAccessor, unpacked.Data(), unpacked.GetSize());
+            for(size_t i = 0; i < pAccessor->count; ++i)
+                func(i, &unpacked[i * componentCount]);
+            return;
+        }
+
+        float element[4] = {0.f, 0.f, 0.f, 0.f};
+        for(size_t i = 0; i < pAccessor->count; ++i)
+        {
+            cgltf_accessor_read_float(pAccessor, i, element, componentCount);
+            func(i, element);
+        }
+    }
+
     // Takes a path to a gltf file and loads the resources needed to render the scene
     // This function uses the cgltf library to load a .glb or .gltf scene
     // The repository can be found on https://github.com/jkuhlmann/cgltf
@@ -508,7 +1130,14 @@ namespace BlitzenEngine
                 return 0;
         }
 
+        // The files are opened through the virtual file system, so that vertex data can be read straight from the page cache or a mounted pack.
+        // This needs to outlive the cgltf scope below, since cgltf_free releases the files through it
+        GltfMappedFiles mappedFiles;
+
         cgltf_options options = {};
+        options.file.read = GltfMapFile;
+        options.file.release = GltfUnmapFile;
+        options.file.user_data = &mappedFiles;
 
         cgltf_data* pData = nullptr;
 
@@ -711,18 +1340,22 @@ namespace BlitzenEngine
 
                 BlitCL::DynamicArray<Vertex> vertices(vertexCount);
 
-                // Will temporarily hold each aspect of the vertices (pos, tangent, normals, uvMaps) from the primitive
-                BlitCL::DynamicArray<float> scratch(vertexCount * 4);
-
+                // Each attribute is converted from the mapped buffer directly into the vertices. 
+                // Float streams take the SIMD path, anything else is read element by element without a scratch copy
                 if (const cgltf_accessor* pos = cgltf_find_accessor(&prim, cgltf_attribute_type_position, 0))
                 {
                     // No choice but to assert here, as some data might already have been loaded
                     BLIT_ASSERT(cgltf_num_components(pos->type) == 3);
 
-                    cgltf_accessor_unpack_floats(pos, scratch.Data(), vertexCount * 3);
-                    for (size_t j = 0; j < vertexCount; ++j)
+                    if (const uint8_t* pSrc = GltfGetInPlaceFloats(pos))
+                    {
+                        ConvertVertexPositions(GltfInPlaceSource(pSrc, pos), vertexCount, vertices.Data());
+                    }
+                    else
                     {
-                        vertices[j].position = BlitML::vec3(scratch[j * 3 + 0], scratch[j * 3 + 1], scratch[j * 3 + 2]);
+                        GltfReadAccessorElements(pos, 3, [&](size_t v, const float* p) {
+                            vertices[v].position = BlitML::vec3(p[0], p[1], p[2]);
+                        });
                     }
                 }
 
@@ -730,12 +1363,17 @@ namespace BlitzenEngine
                 {
                     BLIT_ASSERT(cgltf_num_components(nrm->type) == 3);
 
-                    cgltf_accessor_unpack_floats(nrm, scratch.Data(), vertexCount * 3);
-                    for (size_t j = 0; j < vertexCount; ++j)
+                    if (const uint8_t* pSrc = GltfGetInPlaceFloats(nrm))
+                    {
+                        ConvertVertexUnorm8(GltfInPlaceSource(pSrc, nrm), vertexCount, 3, &vertices[0].normalX);
+                    }
+                    else
                     {
-                        vertices[j].normalX = static_cast<uint8_t>(scratch[j * 3 + 0] * 127.f + 127.5f);
-                        vertices[j].normalY = static_cast<uint8_t>(scratch[j * 3 + 1] * 127.f + 127.5f);
-                        vertices[j].normalZ = static_cast<uint8_t>(scratch[j * 3 + 2] * 127.f + 127.5f);
+                        GltfReadAccessorElements(nrm, 3, [&](size_t v, const float* p) {
+                            vertices[v].normalX = QuantizeUnorm8(p[0]);
+                            vertices[v].normalY = QuantizeUnorm8(p[1]);
+                            vertices[v].normalZ = QuantizeUnorm8(p[2]);
+                        });
                     }
                 }
 
@@ -743,24 +1381,35 @@ namespace BlitzenEngine
                 {
                     BLIT_ASSERT(cgltf_num_components(tang->type) == 4)
 
-                        cgltf_accessor_unpack_floats(tang, scratch.Data(), vertexCount * 4);
-                    for (size_t j = 0; j < vertexCount; ++j)
+                    if (const uint8_t* pSrc = GltfGetInPlaceFloats(tang))
                     {
-                        vertices[j].tangentX = uint8_t(scratch[j * 4 + 0] * 127.f + 127.5f);
-                        vertices[j].tangentY = uint8_t(scratch[j * 4 + 1] * 127.f + 127.5f);
-                        vertices[j].tangentZ = uint8_t(scratch[j * 4 + 2] * 127.f + 127.5f);
-                        vertices[j].tangentW = uint8_t(scratch[j * 4 + 3] * 127.f + 127.5f);
+                        ConvertVertexUnorm8(GltfInPlaceSource(pSrc, tang), vertexCount, 4, &vertices[0].tangentX);
+                    }
+                    else
+                    {
+                        GltfReadAccessorElements(tang, 4, [&](size_t v, const float* p) {
+                            vertices[v].tangentX = QuantizeUnorm8(p[0]);
+                            vertices[v].tangentY = QuantizeUnorm8(p[1]);
+                            vertices[v].tangentZ = QuantizeUnorm8(p[2]);
+                            vertices[v].tangentW = QuantizeUnorm8(p[3]);
+                        });
                     }
                 }
 
                 if (const cgltf_accessor* tex = cgltf_find_accessor(&prim, cgltf_attribute_type_texcoord, 0))
                 {
                     BLIT_ASSERT(cgltf_num_components(tex->type) == 2);
-                    cgltf_accessor_unpack_floats(tex, scratch.Data(), vertexCount * 2);
-                    for (size_t j = 0; j < vertexCount; ++j)
+
+                    if (const uint8_t* pSrc = GltfGetInPlaceFloats(tex))
+                    {
+                        ConvertVertexUvs(GltfInPlaceSource(pSrc, tex), vertexCount, vertices.Data());
+                    }
+                    else
                     {
-                        vertices[j].uvX = meshopt_quantizeHalf(scratch[j * 2 + 0]);
-                        vertices[j].uvY = meshopt_quantizeHalf(scratch[j * 2 + 1]);
+                        GltfReadAccessorElements(tex, 2, [&](size_t v, const float* p) {
+                            vertices[v].uvX = meshopt_quantizeHalf(p[0]);
+                            vertices[v].uvY = meshopt_quantizeHalf(p[1]);
+                        });
                     }
                 }
 
@@ -768,6 +1417,7 @@ namespace BlitzenEngine
                 cgltf_accessor_unpack_indices(prim.indices, indices.Data(), 4, indices.GetSize());
 
                 LoadPrimitiveSurface(pResources, vertices, indices);
+                SetImportReportSource(pResources, mesh.name ? mesh.name : path);
 
                 // Get the material index and pass it to the surface if there is material index
                 if (prim.material)
@@ -830,4 +1480,55 @@ namespace BlitzenEngine
 
         return 1;
     }
+
+    void ReorderSceneSpatially(RenderingResources* pResources)
+    {
+        size_t transformCount = pResources->transforms.GetSize();
+        uint32_t renderCount = pResources->renderObjectCount;
+        if(transformCount < 2 || renderCount == 0)
+            return;
+
+        // The position is the first member of MeshTransform, so the transforms are given as they are. The remap goes from old to new index
+        BlitCL::DynamicArray<uint32_t> remap(transformCount);
+        meshopt_spatialSortRemap(remap.Data(), &pResources->transforms[0].pos.x, transformCount, sizeof(MeshTransform));
+
+        BlitCL::DynamicArray<MeshTransform> transforms(transformCount);
+        for(size_t i = 0; i < transformCount; ++i)
+        {
+            transforms[remap[i]] = pResources->transforms[i];
+        }
+        for(size_t i = 0; i < transformCount; ++i)
+        {
+            pResources->transforms[i] = transforms[i];
+        }
+
+        // Counting sort of the render objects by their new transform
+        BlitCL::DynamicArray<uint32_t> offsets(transformCount + 1, uint32_t(0));
+        for(uint32_t i = 0; i < renderCount; ++i)
+        {
+            RenderObject& render = pResources->renders[i];
+            render.transformId = remap[render.transformId];
+            offsets[render.transformId + 1]++;
+        }
+        for(size_t i = 0; i < transformCount; ++i)
+        {
+            offsets[i + 1] += offsets[i];
+        }
+        BlitCL::DynamicArray<RenderObject> renders(renderCount);
+        for(uint32_t i = 0; i < renderCount; ++i)
+        {
+            renders[offsets[pResources->renders[i].transformId]++] = pResources->renders[i];
+        }
+        memcpy(pResources->renders, renders.Data(), sizeof(RenderObject) * renderCount);
+
+        // Game objects and dynamic transforms keep pointing to the same transforms
+        for(uint32_t i = 0; i < pResources->objectCount; ++i)
+        {
+            pResources->objects[i].transformIndex = remap[pResources->objects[i].transformIndex];
+        }
+        for(size_t i = 0; i < pResources->dynamicTransforms.GetSize(); ++i)
+        {
+            pResources->dynamicTransforms[i] = remap[pResources->dynamicTransforms[i]];
+        }
+    }
 }
\ No newline at end of file
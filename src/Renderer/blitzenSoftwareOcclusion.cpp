@@ -0,0 +1,469 @@
+#include "blitSoftwareOcclusion.h"
+#include "BlitzenMathLibrary/blitMLBatch.h"
+
+// https://github.com/zeux/meshoptimizer
+#include "Meshoptimizer/meshoptimizer.h"
+
+#include <math.h>
+#include <thread>
+
+namespace BlitzenEngine
+{
+    // Vertex after the InfiniteZPerspective projection and the flipped viewport of the renderer, in pixels
+    struct OcclusionVertex
+    {
+        float x;
+        float y;
+        float depth;
+
+        uint8_t bInFront;
+    };
+
+    // Calls job(i) for every i below jobCount, the calling thread takes job 0 and the rest get a thread each
+    template<typename Job>
+    static void RunOcclusionJobs(uint32_t jobCount, Job job)
+    {
+        if(jobCount == 0)
+            return;
+
+        BlitCL::DynamicArray<std::thread> workers(jobCount - 1);
+        for(uint32_t i = 1; i < jobCount; ++i)
+        {
+            workers[i - 1] = std::thread(job, i);
+        }
+        job(0);
+        for(size_t i = 0; i < workers.GetSize(); ++i)
+        {
+            workers[i].join();
+        }
+    }
+
+    void BuildOccluderMesh(RenderingResources* pResources, BlitCL::DynamicArray<Vertex>& vertices,
+    BlitCL::DynamicArray<uint32_t>& indices, OccluderMesh& occluder)
+    {
+        occluder = {};
+        if(indices.GetSize() == 0)
+            return;
+
+        // Small surfaces are their own occluder
+        size_t targetIndexCount = size_t(ce_occluderTargetTriangles) * 3;
+        BlitCL::DynamicArray<uint32_t> simplified(indices.GetSize());
+        size_t indexCount = indices.GetSize();
+        if(indexCount > targetIndexCount)
+        {
+            indexCount = meshopt_simplify(simplified.Data(), indices.Data(), indices.GetSize(), &vertices[0].position.x,
+            vertices.GetSize(), sizeof(Vertex), targetIndexCount, ce_occluderMaxError, 0, nullptr);
+        }
+        else
+        {
+            BlitzenCore::BlitMemCopy(simplified.Data(), indices.Data(), indexCount * sizeof(uint32_t));
+        }
+
+        if(indexCount == 0 || indexCount / 3 > ce_occluderMaxTriangles)
+            return;
+
+        // Only the positions of the vertices that the occluder uses are kept, in the order that they are first used
+        BlitCL::DynamicArray<uint32_t> remap(vertices.GetSize(), ~0u);
+        occluder.firstVertex = static_cast<uint32_t>(pResources->occluderVertices.GetSize());
+        occluder.firstIndex = static_cast<uint32_t>(pResources->occluderIndices.GetSize());
+        occluder.indexCount = static_cast<uint32_t>(indexCount);
+        for(size_t i = 0; i < indexCount; ++i)
+        {
+            uint32_t index = simplified[i];
+            if(remap[index] == ~0u)
+            {
+                remap[index] = occluder.vertexCount++;
+                pResources->occluderVertices.PushBack(vertices[index].position);
+            }
+            pResources->occluderIndices.PushBack(remap[index]);
+        }
+    }
+
+    void ResizeSoftwareDepthBuffer(SoftwareDepthBuffer& buffer, uint32_t width, uint32_t height)
+    {
+        buffer.width = width;
+        buffer.height = height;
+        buffer.tileCountX = (width + ce_occlusionTileWidth - 1) / ce_occlusionTileWidth;
+        buffer.tileCountY = (height + ce_occlusionTileHeight - 1) / ce_occlusionTileHeight;
+        buffer.pitch = buffer.tileCountX * ce_occlusionTileWidth;
+
+        size_t pixelCount = size_t(buffer.pitch) * buffer.tileCountY * ce_occlusionTileHeight;
+        if(buffer.depth.GetSize() < pixelCount)
+            buffer.depth.Resize(pixelCount);
+
+        size_t tileCount = size_t(buffer.tileCountX) * buffer.tileCountY;
+        if(buffer.tileStarts.GetSize() < tileCount + 1)
+            buffer.tileStarts.Resize(tileCount + 1);
+    }
+
+    static OcclusionVertex ProjectOccluderVertex(const BlitML::vec3& p, const CameraViewData& view, float width, float height)
+    {
+        OcclusionVertex v;
+        v.bInFront = p.z >= view.zNear;
+        float invZ = 1.f / p.z;
+        v.x = (p.x * view.proj0 * invZ * 0.5f + 0.5f) * width;
+        v.y = (p.y * view.proj5 * invZ * -0.5f + 0.5f) * height;
+        v.depth = view.zNear * invZ;
+        return v;
+    }
+
+    // First pixel whose center is not below value, and last pixel whose center is not above it, clamped to the buffer
+    static int32_t FirstPixelAfter(float value, int32_t size)
+    {
+        float pixel = ceilf(value - 0.5f);
+        return pixel < 0.f ? 0 : pixel > float(size) ? size : static_cast<int32_t>(pixel);
+    }
+
+    static int32_t LastPixelBefore(float value, int32_t size)
+    {
+        float pixel = floorf(value - 0.5f);
+        return pixel < -1.f ? -1 : pixel > float(size - 1) ? size - 1 : static_cast<int32_t>(pixel);
+    }
+
+    static void SetupOcclusionTriangle(const OcclusionVertex& a, const OcclusionVertex& b, const OcclusionVertex& c,
+    const SoftwareDepthBuffer& buffer, OcclusionTriangle& tri)
+    {
+        tri.minX = 1;
+        tri.maxX = 0;
+        tri.minY = 1;
+        tri.maxY = 0;
+        if(!a.bInFront || !b.bInFront || !c.bInFront)
+            return;
+
+        // Both windings are drawn, since surfaces are rendered without back face culling
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if(!(area > 0.f || area < 0.f))
+            return;
+        float sign = area > 0.f ? 1.f : -1.f;
+
+        const OcclusionVertex* v[3] = {&a, &b, &c};
+        for(uint8_t e = 0; e < 3; ++e)
+        {
+            const OcclusionVertex& p0 = *v[e];
+            const OcclusionVertex& p1 = *v[e == 2 ? 0 : e + 1];
+            tri.edgeA[e] = (p0.y - p1.y) * sign;
+            tri.edgeB[e] = (p1.x - p0.x) * sign;
+            tri.edgeC[e] = (p0.x * p1.y - p0.y * p1.x) * sign;
+        }
+
+        // The farthest vertex, so that the triangle is never written closer than it is
+        tri.depth = BlitML::Min(a.depth, BlitML::Min(b.depth, c.depth));
+
+        int32_t width = static_cast<int32_t>(buffer.width);
+        int32_t height = static_cast<int32_t>(buffer.height);
+        tri.minX = FirstPixelAfter(BlitML::Min(a.x, BlitML::Min(b.x, c.x)), width);
+        tri.maxX = LastPixelBefore(BlitML::Max(a.x, BlitML::Max(b.x, c.x)), width);
+        tri.minY = FirstPixelAfter(BlitML::Min(a.y, BlitML::Min(b.y, c.y)), height);
+        tri.maxY = LastPixelBefore(BlitML::Max(a.y, BlitML::Max(b.y, c.y)), height);
+    }
+
+    // Writes the triangles of occluders first to last - 1, starting from the occluder's first triangle
+    static void SetupOccluderRange(const SoftwareOcclusionScene& scene, const CameraViewData& view, SoftwareDepthBuffer& buffer,
+    const uint32_t* pFirstTriangles, uint32_t first, uint32_t last)
+    {
+        float width = static_cast<float>(buffer.width);
+        float height = static_cast<float>(buffer.height);
+
+        BlitCL::DynamicArray<OcclusionVertex> vertices;
+        for(uint32_t i = first; i < last; ++i)
+        {
+            const RenderObject& render = scene.pRenders[scene.pOccluders[i]];
+            const OccluderMesh& mesh = scene.pOccluderMeshes[render.surfaceId];
+            const MeshTransform& transform = scene.pTransforms[render.transformId];
+
+            if(vertices.GetSize() < mesh.vertexCount)
+                vertices.Resize(mesh.vertexCount);
+            for(uint32_t v = 0; v < mesh.vertexCount; ++v)
+            {
+                BlitML::vec3 position;
+                float unusedRadius;
+                BlitML::TransformSphereToView(scene.pOccluderVertices[mesh.firstVertex + v], 0.f, transform.pos, transform.scale,
+                transform.orientation, view.viewMatrix, position, unusedRadius);
+                vertices[v] = ProjectOccluderVertex(position, view, width, height);
+            }
+
+            const uint32_t* pIndices = scene.pOccluderIndices + mesh.firstIndex;
+            for(uint32_t t = 0; t < mesh.indexCount / 3; ++t)
+            {
+                SetupOcclusionTriangle(vertices[pIndices[t * 3]], vertices[pIndices[t * 3 + 1]], vertices[pIndices[t * 3 + 2]],
+                buffer, buffer.triangles[pFirstTriangles[i] + t]);
+            }
+        }
+    }
+
+    // Calls tileFunction(tile) for every tile that the triangle's bounds overlap
+    template<typename TileFunction>
+    static void ForEachTriangleTile(const OcclusionTriangle& tri, uint32_t tileCountX, TileFunction tileFunction)
+    {
+        if(tri.minX > tri.maxX || tri.minY > tri.maxY)
+            return;
+
+        uint32_t firstTileX = static_cast<uint32_t>(tri.minX) / ce_occlusionTileWidth;
+        uint32_t lastTileX = static_cast<uint32_t>(tri.maxX) / ce_occlusionTileWidth;
+        uint32_t firstTileY = static_cast<uint32_t>(tri.minY) / ce_occlusionTileHeight;
+        uint32_t lastTileY = static_cast<uint32_t>(tri.maxY) / ce_occlusionTileHeight;
+        for(uint32_t y = firstTileY; y <= lastTileY; ++y)
+            for(uint32_t x = firstTileX; x <= lastTileX; ++x)
+                tileFunction(y * tileCountX + x);
+    }
+
+    static void RasterizeOcclusionTile(SoftwareDepthBuffer& buffer, uint32_t tile)
+    {
+        int32_t tileMinX = static_cast<int32_t>((tile % buffer.tileCountX) * ce_occlusionTileWidth);
+        int32_t tileMinY = static_cast<int32_t>((tile / buffer.tileCountX) * ce_occlusionTileHeight);
+
+        for(uint32_t y = 0; y < ce_occlusionTileHeight; ++y)
+        {
+            float* pRow = buffer.depth.Data() + size_t(tileMinY + y) * buffer.pitch + tileMinX;
+            for(uint32_t x = 0; x < ce_occlusionTileWidth; ++x)
+                pRow[x] = 0.f;
+        }
+
+        for(uint32_t i = buffer.tileStarts[tile]; i < buffer.tileStarts[tile + 1]; ++i)
+        {
+            const OcclusionTriangle& tri = buffer.triangles[buffer.tileTriangles[i]];
+            int32_t minX = BlitML::Max(tri.minX, tileMinX);
+            int32_t maxX = BlitML::Min(tri.maxX, tileMinX + static_cast<int32_t>(ce_occlusionTileWidth) - 1);
+            int32_t minY = BlitML::Max(tri.minY, tileMinY);
+            int32_t maxY = BlitML::Min(tri.maxY, tileMinY + static_cast<int32_t>(ce_occlusionTileHeight) - 1);
+
+            // Spans of 8 pixels, aligned to the tile. Pixels of a span that are outside the triangle fail its edge functions
+            int32_t firstSpan = tileMinX + ((minX - tileMinX) / 8) * 8;
+
+            #ifdef BLIT_ML_AVX2
+            const __m256 spanOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 depth = _mm256_set1_ps(tri.depth);
+            __m256 edgeA[3];
+            for(uint8_t e = 0; e < 3; ++e)
+                edgeA[e] = _mm256_set1_ps(tri.edgeA[e]);
+            #endif
+
+            for(int32_t y = minY; y <= maxY; ++y)
+            {
+                float py = static_cast<float>(y) + 0.5f;
+                float rowEdges[3];
+                for(uint8_t e = 0; e < 3; ++e)
+                    rowEdges[e] = tri.edgeB[e] * py + tri.edgeC[e];
+
+                float* pRow = buffer.depth.Data() + size_t(y) * buffer.pitch;
+
+                #ifdef BLIT_ML_AVX2
+                __m256 row[3];
+                for(uint8_t e = 0; e < 3; ++e)
+                    row[e] = _mm256_set1_ps(rowEdges[e]);
+                for(int32_t x = firstSpan; x <= maxX; x += 8)
+                {
+                    __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), spanOffsets);
+                    __m256 inside = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[0], px), row[0]), zero, _CMP_GE_OQ);
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[1], px), row[1]), zero, _CMP_GE_OQ));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(edgeA[2], px), row[2]), zero, _CMP_GE_OQ));
+
+                    __m256 old = _mm256_loadu_ps(pRow + x);
+                    _mm256_storeu_ps(pRow + x, _mm256_blendv_ps(old, _mm256_max_ps(old, depth), inside));
+                }
+                #else
+                for(int32_t x = firstSpan; x <= maxX; x += 8)
+                {
+                    for(int32_t l = 0; l < 8; ++l)
+                    {
+                        float px = static_cast<float>(x + l) + 0.5f;
+                        uint8_t inside = tri.edgeA[0] * px + rowEdges[0] >= 0.f;
+                        inside = inside && tri.edgeA[1] * px + rowEdges[1] >= 0.f;
+                        inside = inside && tri.edgeA[2] * px + rowEdges[2] >= 0.f;
+
+                        float& old = pRow[x + l];
+                        if(inside)
+                            old = old > tri.depth ? old : tri.depth;
+                    }
+                }
+                #endif
+            }
+        }
+    }
+
+    void RasterizeOccluders(const SoftwareOcclusionScene& scene, const CameraViewData& view, SoftwareDepthBuffer& buffer,
+    uint32_t threadCount)
+    {
+        if(threadCount == 0)
+            threadCount = static_cast<uint32_t>(std::thread::hardware_concurrency());
+        threadCount = threadCount > 0 ? threadCount : 1;
+        uint32_t tileCount = buffer.tileCountX * buffer.tileCountY;
+
+        // Each occluder writes its triangles from its own first triangle, so the setup can run in parallel
+        BlitCL::DynamicArray<uint32_t> firstTriangles(scene.occluderCount + 1);
+        firstTriangles[0] = 0;
+        for(uint32_t i = 0; i < scene.occluderCount; ++i)
+        {
+            const OccluderMesh& mesh = scene.pOccluderMeshes[scene.pRenders[scene.pOccluders[i]].surfaceId];
+            firstTriangles[i + 1] = firstTriangles[i] + mesh.indexCount / 3;
+        }
+        uint32_t triangleCount = firstTriangles[scene.occluderCount];
+
+        // No occluders, or none with triangles. The depth buffer is only cleared to the far plane
+        if(triangleCount == 0)
+        {
+            for(size_t i = 0; i < buffer.depth.GetSize(); ++i)
+                buffer.depth[i] = 0.f;
+            return;
+        }
+
+        if(buffer.triangles.GetSize() < triangleCount)
+            buffer.triangles.Resize(triangleCount);
+
+        uint32_t setupJobCount = BlitML::Max(1u, BlitML::Min(threadCount, scene.occluderCount));
+        RunOcclusionJobs(setupJobCount, [&](uint32_t job)
+        {
+            SetupOccluderRange(scene, view, buffer, firstTriangles.Data(),
+            uint32_t(uint64_t(scene.occluderCount) * job / setupJobCount), uint32_t(uint64_t(scene.occluderCount) * (job + 1) / setupJobCount));
+        });
+
+        // Binning. Each thread counts the tiles of its triangles, so that every thread knows where its part of each tile's list starts
+        uint32_t binJobCount = BlitML::Max(1u, BlitML::Min(threadCount, triangleCount));
+        BlitCL::DynamicArray<uint32_t> binCursors(size_t(binJobCount) * tileCount, 0u);
+        auto triangleRangeStart = [&](uint32_t job) { return uint32_t(uint64_t(triangleCount) * job / binJobCount); };
+        RunOcclusionJobs(binJobCount, [&](uint32_t job)
+        {
+            uint32_t* pCounts = binCursors.Data() + size_t(job) * tileCount;
+            for(uint32_t t = triangleRangeStart(job); t < triangleRangeStart(job + 1); ++t)
+                ForEachTriangleTile(buffer.triangles[t], buffer.tileCountX, [pCounts](uint32_t tile) { pCounts[tile]++; });
+        });
+
+        uint32_t binnedCount = 0;
+        for(uint32_t tile = 0; tile < tileCount; ++tile)
+        {
+            buffer.tileStarts[tile] = binnedCount;
+            for(uint32_t job = 0; job < binJobCount; ++job)
+            {
+                uint32_t count = binCursors[size_t(job) * tileCount + tile];
+                binCursors[size_t(job) * tileCount + tile] = binnedCount;
+                binnedCount += count;
+            }
+        }
+        buffer.tileStarts[tileCount] = binnedCount;
+        if(buffer.tileTriangles.GetSize() < binnedCount)
+            buffer.tileTriangles.Resize(binnedCount);
+
+        RunOcclusionJobs(binJobCount, [&](uint32_t job)
+        {
+            uint32_t* pCursors = binCursors.Data() + size_t(job) * tileCount;
+            uint32_t* pTileTriangles = buffer.tileTriangles.Data();
+            for(uint32_t t = triangleRangeStart(job); t < triangleRangeStart(job + 1); ++t)
+                ForEachTriangleTile(buffer.triangles[t], buffer.tileCountX, [pCursors, pTileTriangles, t](uint32_t tile)
+                {
+                    pTileTriangles[pCursors[tile]++] = t;
+                });
+        });
+
+        // Every tile is cleared and drawn by one thread
+        uint32_t rasterJobCount = BlitML::Max(1u, BlitML::Min(threadCount, tileCount));
+        RunOcclusionJobs(rasterJobCount, [&](uint32_t job)
+        {
+            for(uint32_t tile = job; tile < tileCount; tile += rasterJobCount)
+                RasterizeOcclusionTile(buffer, tile);
+        });
+    }
+
+    // Linear sample of the depth pyramid sampler, whose min reduction takes the smallest of the texels with a weight above 0.
+    // Coordinates are clamped to the edge like the sampler does
+    static float SampleMinFootprint(const float* pLevel, uint32_t width, uint32_t height, size_t pitch, float u, float v)
+    {
+        float x = u * static_cast<float>(width) - 0.5f;
+        float y = v * static_cast<float>(height) - 0.5f;
+        float floorX = floorf(x);
+        float floorY = floorf(y);
+
+        int32_t x0 = static_cast<int32_t>(floorX);
+        int32_t y0 = static_cast<int32_t>(floorY);
+        int32_t x1 = x > floorX ? x0 + 1 : x0;
+        int32_t y1 = y > floorY ? y0 + 1 : y0;
+
+        int32_t maxX = static_cast<int32_t>(width) - 1;
+        int32_t maxY = static_cast<int32_t>(height) - 1;
+        x0 = x0 < 0 ? 0 : x0 > maxX ? maxX : x0;
+        x1 = x1 < 0 ? 0 : x1 > maxX ? maxX : x1;
+        y0 = y0 < 0 ? 0 : y0 > maxY ? maxY : y0;
+        y1 = y1 < 0 ? 0 : y1 > maxY ? maxY : y1;
+
+        float depth = BlitML::Min(pLevel[size_t(y0) * pitch + x0], pLevel[size_t(y0) * pitch + x1]);
+        return BlitML::Min(depth, BlitML::Min(pLevel[size_t(y1) * pitch + x0], pLevel[size_t(y1) * pitch + x1]));
+    }
+
+    void BuildSoftwareDepthPyramid(SoftwareDepthBuffer& buffer, SoftwareDepthPyramid& pyramid)
+    {
+        // Same extent and level count as CreateDepthPyramid
+        pyramid.width = BlitML::PreviousPow2(buffer.width);
+        pyramid.height = BlitML::PreviousPow2(buffer.height);
+        pyramid.levelCount = 0;
+        size_t dataSize = 0;
+        uint32_t width = pyramid.width;
+        uint32_t height = pyramid.height;
+        do
+        {
+            pyramid.levelOffsets[pyramid.levelCount] = static_cast<uint32_t>(dataSize);
+            dataSize += size_t(BlitML::Max(1u, pyramid.width >> pyramid.levelCount)) * BlitML::Max(1u, pyramid.height >> pyramid.levelCount);
+            pyramid.levelCount++;
+            width /= 2;
+            height /= 2;
+        }
+        while((width > 1 || height > 1) && pyramid.levelCount < ce_maxDepthPyramidLevels);
+
+        if(pyramid.data.GetSize() < dataSize)
+            pyramid.data.Resize(dataSize);
+
+        // Each texel takes a sample from the middle of its area in the level before it, starting from the depth buffer
+        const float* pSource = buffer.depth.Data();
+        uint32_t sourceWidth = buffer.width;
+        uint32_t sourceHeight = buffer.height;
+        size_t sourcePitch = buffer.pitch;
+        for(uint8_t level = 0; level < pyramid.levelCount; ++level)
+        {
+            uint32_t levelWidth = BlitML::Max(1u, pyramid.width >> level);
+            uint32_t levelHeight = BlitML::Max(1u, pyramid.height >> level);
+            float* pLevel = pyramid.data.Data() + pyramid.levelOffsets[level];
+            for(uint32_t y = 0; y < levelHeight; ++y)
+            {
+                float v = (static_cast<float>(y) + 0.5f) / static_cast<float>(levelHeight);
+                for(uint32_t x = 0; x < levelWidth; ++x)
+                {
+                    float u = (static_cast<float>(x) + 0.5f) / static_cast<float>(levelWidth);
+                    pLevel[size_t(y) * levelWidth + x] = SampleMinFootprint(pSource, sourceWidth, sourceHeight, sourcePitch, u, v);
+                }
+            }
+
+            pSource = pLevel;
+            sourceWidth = levelWidth;
+            sourceHeight = levelHeight;
+            sourcePitch = levelWidth;
+        }
+    }
+
+    uint8_t SphereVisibleInPyramid(SoftwareDepthPyramid& pyramid, const CameraViewData& view, const BlitML::vec3& center, float radius)
+    {
+        BlitML::vec4 rect;
+        if(!BlitML::ProjectSphere(center, radius, view.zNear, view.proj0, view.proj5, rect))
+            return 1;
+
+        return SphereRectVisibleInPyramid(pyramid, view, rect, center.z, radius);
+    }
+
+    uint8_t SphereRectVisibleInPyramid(SoftwareDepthPyramid& pyramid, const CameraViewData& view, const BlitML::vec4& rect, float centerZ,
+    float radius)
+    {
+        float width = (rect.z - rect.x) * static_cast<float>(pyramid.width);
+        float height = (rect.w - rect.y) * static_cast<float>(pyramid.height);
+
+        // Find the mip map level that will match the screen size of the sphere. The sampler clamps it to the levels of the pyramid
+        float level = floorf(log2f(BlitML::Max(width, height)));
+        uint8_t lastLevel = static_cast<uint8_t>(pyramid.levelCount - 1);
+        uint8_t levelIndex = level > 0.f ? (level < static_cast<float>(lastLevel) ? static_cast<uint8_t>(level) : lastLevel) : 0;
+
+        uint32_t levelWidth = BlitML::Max(1u, pyramid.width >> levelIndex);
+        uint32_t levelHeight = BlitML::Max(1u, pyramid.height >> levelIndex);
+        float depth = SampleMinFootprint(pyramid.data.Data() + pyramid.levelOffsets[levelIndex], levelWidth, levelHeight, levelWidth,
+        (rect.x + rect.z) * 0.5f, (rect.y + rect.w) * 0.5f);
+
+        float depthSphere = view.zNear / (centerZ - radius);
+        return depthSphere > depth;
+    }
+}
@@ -0,0 +1,309 @@
+#include "blitVertexConversion.h"
+#include "blitVertexQuantization.h"
+
+// AVX2 lane masks and the BLIT_ML_AVX2 macro
+#include "BlitzenMathLibrary/blitMLBatch.h"
+
+// https://github.com/zeux/meshoptimizer
+#include "Meshoptimizer/meshoptimizer.h"
+
+namespace BlitzenEngine
+{
+    static const float* GetAttributeElement(const VertexAttributeSource& source, size_t i)
+    {
+        if(!source.pIndices)
+            return reinterpret_cast<const float*>(source.pData + i * source.stride);
+
+        int32_t index = *reinterpret_cast<const int32_t*>(reinterpret_cast<const uint8_t*>(source.pIndices) + i * source.indexStride);
+        return index < 0 ? source.pDefault : reinterpret_cast<const float*>(source.pData + static_cast<size_t>(index) * source.stride);
+    }
+
+    #ifdef BLIT_ML_AVX2
+    // 8 elements of an attribute. Their components are gathered from pBase + offsets, the lanes that are not in mask read the default instead
+    struct AttributeBlock
+    {
+        const uint8_t* pBase;
+        __m256i offsets;
+        __m256 mask;
+    };
+
+    // The lanes past count are left out of the mask, so the gathers never read past the end of the source
+    static AttributeBlock GetAttributeBlock(const VertexAttributeSource& source, size_t first, size_t count)
+    {
+        const __m256i laneIds = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i lanes = BlitML::BatchMask(count - first);
+
+        AttributeBlock block;
+        if(!source.pIndices)
+        {
+            block.pBase = source.pData + first * source.stride;
+            block.offsets = _mm256_mullo_epi32(laneIds, _mm256_set1_epi32(static_cast<int>(source.stride)));
+            block.mask = _mm256_castsi256_ps(lanes);
+            return block;
+        }
+
+        const int* pFirstIndex = reinterpret_cast<const int*>(reinterpret_cast<const uint8_t*>(source.pIndices) + first * source.indexStride);
+        __m256i indices = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), pFirstIndex,
+        _mm256_mullo_epi32(laneIds, _mm256_set1_epi32(static_cast<int>(source.indexStride))), lanes, 1);
+
+        block.pBase = source.pData;
+        block.offsets = _mm256_mullo_epi32(indices, _mm256_set1_epi32(static_cast<int>(source.stride)));
+        block.mask = _mm256_castsi256_ps(_mm256_and_si256(lanes, _mm256_cmpgt_epi32(indices, _mm256_set1_epi32(-1))));
+        return block;
+    }
+
+    static __m256 GatherComponent(const VertexAttributeSource& source, const AttributeBlock& block, uint8_t component)
+    {
+        __m256 fallback = source.pDefault ? _mm256_set1_ps(source.pDefault[component]) : _mm256_setzero_ps();
+        return _mm256_mask_i32gather_ps(fallback, reinterpret_cast<const float*>(block.pBase + component * sizeof(float)),
+        block.offsets, block.mask, 1);
+    }
+
+    // Same steps as meshopt_quantizeHalf, done on the bits of 8 floats
+    static __m256i QuantizeHalf8(__m256 v)
+    {
+        __m256i bits = _mm256_castps_si256(v);
+        __m256i sign = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x8000));
+        __m256i em = _mm256_and_si256(bits, _mm256_set1_epi32(0x7fffffff));
+
+        // Bias the exponent and round to nearest
+        __m256i h = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sub_epi32(em, _mm256_set1_epi32(112 << 23)), _mm256_set1_epi32(1 << 12)), 13);
+
+        // Underflow flushes to zero, overflow becomes infinity and every NaN becomes the same quiet NaN
+        h = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(113 << 23), em), h);
+        __m256i overflow = _mm256_cmpgt_epi32(em, _mm256_set1_epi32((143 << 23) - 1));
+        h = _mm256_blendv_epi8(h, _mm256_set1_epi32(0x7c00), overflow);
+        __m256i nan = _mm256_cmpgt_epi32(em, _mm256_set1_epi32(255 << 23));
+        h = _mm256_blendv_epi8(h, _mm256_set1_epi32(0x7e00), nan);
+
+        return _mm256_or_si256(sign, h);
+    }
+
+    // Same as QuantizeSnorm8 and QuantizeSnorm16 with the scale of each, before the value is narrowed
+    static __m256i QuantizeSnormWide(__m256 v, float scale)
+    {
+        v = _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(-1.f)), _mm256_set1_ps(1.f));
+        __m256 rounding = _mm256_blendv_ps(_mm256_set1_ps(-0.5f), _mm256_set1_ps(0.5f), _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ));
+        return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(scale)), rounding));
+    }
+
+    static __m256 AbsWide(__m256 v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v); }
+
+    // Same as EncodeOctahedralSnorm8
+    static void EncodeOctahedralWide(__m256 x, __m256 y, __m256 z, __m256i& outX, __m256i& outY)
+    {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 minusOne = _mm256_set1_ps(-1.f);
+
+        __m256 length = _mm256_add_ps(_mm256_add_ps(AbsWide(x), AbsWide(y)), AbsWide(z));
+        __m256 octX = _mm256_div_ps(x, length);
+        __m256 octY = _mm256_div_ps(y, length);
+
+        __m256 foldedX = _mm256_mul_ps(_mm256_sub_ps(one, AbsWide(octY)), _mm256_blendv_ps(minusOne, one, _mm256_cmp_ps(octX, zero, _CMP_GE_OQ)));
+        __m256 foldedY = _mm256_mul_ps(_mm256_sub_ps(one, AbsWide(octX)), _mm256_blendv_ps(minusOne, one, _mm256_cmp_ps(octY, zero, _CMP_GE_OQ)));
+        __m256 fold = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+        octX = _mm256_blendv_ps(octX, foldedX, fold);
+        octY = _mm256_blendv_ps(octY, foldedY, fold);
+
+        // Degenerate vectors become +Z, which quantizes to 0
+        __m256 degenerate = _mm256_cmp_ps(length, zero, _CMP_EQ_OQ);
+        outX = QuantizeSnormWide(_mm256_andnot_ps(degenerate, octX), 127.f);
+        outY = QuantizeSnormWide(_mm256_andnot_ps(degenerate, octY), 127.f);
+    }
+
+    // Unpacks the byte at shift of each lane like the shaders do, x / 127 - 1
+    static __m256 UnpackUnorm8Wide(__m256i packed, int shift)
+    {
+        __m256i bytes = _mm256_and_si256(_mm256_srl_epi32(packed, _mm_cvtsi32_si128(shift)), _mm256_set1_epi32(0xFF));
+        return _mm256_sub_ps(_mm256_div_ps(_mm256_cvtepi32_ps(bytes), _mm256_set1_ps(127.f)), _mm256_set1_ps(1.f));
+    }
+    #endif
+
+    void ConvertVertexPositions(const VertexAttributeSource& source, size_t count, Vertex* pVertices)
+    {
+        size_t i = 0;
+
+        #if defined(BLIT_ML_AVX2)
+        for(; i < count; i += 8)
+        {
+            AttributeBlock block = GetAttributeBlock(source, i, count);
+            alignas(32) float components[3][8];
+            for(uint8_t c = 0; c < 3; ++c)
+                _mm256_store_ps(components[c], GatherComponent(source, block, c));
+
+            size_t lanes = count - i < 8 ? count - i : 8;
+            for(size_t l = 0; l < lanes; ++l)
+                pVertices[i + l].position = BlitML::vec3(components[0][l], components[1][l], components[2][l]);
+        }
+        #elif defined(BLIT_SSE2_VERTEX_CONVERSION)
+        // The last element is left to the scalar loop, since the 4-wide load could read past the end of the buffer
+        for(; !source.pIndices && i + 1 < count; ++i)
+        {
+            __m128 p = _mm_loadu_ps(reinterpret_cast<const float*>(source.pData + i * source.stride));
+            _mm_storel_pi(reinterpret_cast<__m64*>(&pVertices[i].position.x), p);
+            _mm_store_ss(&pVertices[i].position.z, _mm_movehl_ps(p, p));
+        }
+        #endif
+
+        for(; i < count; ++i)
+        {
+            const float* p = GetAttributeElement(source, i);
+            pVertices[i].position = BlitML::vec3(p[0], p[1], p[2]);
+        }
+    }
+
+    void ConvertVertexUnorm8(const VertexAttributeSource& source, size_t count, uint8_t componentCount, uint8_t* pDst)
+    {
+        size_t i = 0;
+
+        #if defined(BLIT_ML_AVX2)
+        const __m256 scale = _mm256_set1_ps(127.f);
+        const __m256 bias = _mm256_set1_ps(127.5f);
+        const __m256 maxValue = _mm256_set1_ps(255.f);
+        for(; i < count; i += 8)
+        {
+            AttributeBlock block = GetAttributeBlock(source, i, count);
+            __m256i packed = _mm256_setzero_si256();
+            for(uint8_t c = 0; c < componentCount; ++c)
+            {
+                // Same clamp as QuantizeUnorm8, before the truncation
+                __m256 scaled = _mm256_add_ps(_mm256_mul_ps(GatherComponent(source, block, c), scale), bias);
+                scaled = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()), maxValue);
+                packed = _mm256_or_si256(packed, _mm256_sll_epi32(_mm256_cvttps_epi32(scaled), _mm_cvtsi32_si128(c * 8)));
+            }
+
+            alignas(32) uint32_t bytes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(bytes), packed);
+            size_t lanes = count - i < 8 ? count - i : 8;
+            for(size_t l = 0; l < lanes; ++l)
+            {
+                uint8_t* pOut = pDst + (i + l) * sizeof(Vertex);
+                for(uint8_t c = 0; c < componentCount; ++c)
+                    pOut[c] = static_cast<uint8_t>(bytes[l] >> (c * 8));
+            }
+        }
+        #elif defined(BLIT_SSE2_VERTEX_CONVERSION)
+        const __m128 scale = _mm_set1_ps(127.f);
+        const __m128 bias = _mm_set1_ps(127.5f);
+        const __m128 maxValue = _mm_set1_ps(255.f);
+
+        // Like with positions, float3 streams cannot load their last element 4-wide
+        size_t simdCount = source.pIndices ? 0 : (componentCount == 4 || count == 0) ? count : count - 1;
+        for(; i < simdCount; ++i)
+        {
+            __m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(source.pData + i * source.stride));
+            __m128 scaled = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v, scale), bias), _mm_setzero_ps()), maxValue);
+            __m128i q = _mm_cvttps_epi32(scaled);
+            q = _mm_packs_epi32(q, q);
+            q = _mm_packus_epi16(q, q);
+            uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(q));
+
+            uint8_t* pOut = pDst + i * sizeof(Vertex);
+            for(uint8_t c = 0; c < componentCount; ++c)
+                pOut[c] = static_cast<uint8_t>(packed >> (c * 8));
+        }
+        #endif
+
+        for(; i < count; ++i)
+        {
+            const float* p = GetAttributeElement(source, i);
+            uint8_t* pOut = pDst + i * sizeof(Vertex);
+            for(uint8_t c = 0; c < componentCount; ++c)
+                pOut[c] = QuantizeUnorm8(p[c]);
+        }
+    }
+
+    void ConvertVertexUvs(const VertexAttributeSource& source, size_t count, Vertex* pVertices)
+    {
+        size_t i = 0;
+
+        #ifdef BLIT_ML_AVX2
+        for(; i < count; i += 8)
+        {
+            AttributeBlock block = GetAttributeBlock(source, i, count);
+            alignas(32) uint32_t halfs[2][8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(halfs[0]), QuantizeHalf8(GatherComponent(source, block, 0)));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(halfs[1]), QuantizeHalf8(GatherComponent(source, block, 1)));
+
+            size_t lanes = count - i < 8 ? count - i : 8;
+            for(size_t l = 0; l < lanes; ++l)
+            {
+                pVertices[i + l].uvX = static_cast<uint16_t>(halfs[0][l]);
+                pVertices[i + l].uvY = static_cast<uint16_t>(halfs[1][l]);
+            }
+        }
+        #endif
+
+        for(; i < count; ++i)
+        {
+            const float* p = GetAttributeElement(source, i);
+            pVertices[i].uvX = meshopt_quantizeHalf(p[0]);
+            pVertices[i].uvY = meshopt_quantizeHalf(p[1]);
+        }
+    }
+
+    void EncodeCompactVertices(const Vertex* pVertices, size_t count, const BlitML::vec3& center, float radius, CompactVertex* pOut)
+    {
+        size_t i = 0;
+
+        #ifdef BLIT_ML_AVX2
+        float invRadius = radius > 0.f ? 1.f / radius : 0.f;
+        const __m256 centerX = _mm256_set1_ps(center.x);
+        const __m256 centerY = _mm256_set1_ps(center.y);
+        const __m256 centerZ = _mm256_set1_ps(center.z);
+        const __m256 scale = _mm256_set1_ps(invRadius);
+        const __m256i vertexOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(sizeof(Vertex)));
+        for(; i < count; i += 8)
+        {
+            // Each 4 byte word of the vertex is gathered on its own: position xyz, uvs, normal and tangent
+            __m256i lanes = BlitML::BatchMask(count - i);
+            const int* pBase = reinterpret_cast<const int*>(pVertices + i);
+            __m256i words[6];
+            for(uint8_t w = 0; w < 6; ++w)
+                words[w] = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), pBase + w, vertexOffsets, lanes, 1);
+
+            alignas(32) int32_t fields[9][8];
+            __m256 x = _mm256_mul_ps(_mm256_sub_ps(_mm256_castsi256_ps(words[0]), centerX), scale);
+            __m256 y = _mm256_mul_ps(_mm256_sub_ps(_mm256_castsi256_ps(words[1]), centerY), scale);
+            __m256 z = _mm256_mul_ps(_mm256_sub_ps(_mm256_castsi256_ps(words[2]), centerZ), scale);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[0]), QuantizeSnormWide(x, 32767.f));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[1]), QuantizeSnormWide(y, 32767.f));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[2]), QuantizeSnormWide(z, 32767.f));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[3]), words[3]);
+
+            __m256i octX, octY;
+            EncodeOctahedralWide(UnpackUnorm8Wide(words[4], 0), UnpackUnorm8Wide(words[4], 8), UnpackUnorm8Wide(words[4], 16), octX, octY);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[4]), octX);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[5]), octY);
+            EncodeOctahedralWide(UnpackUnorm8Wide(words[5], 0), UnpackUnorm8Wide(words[5], 8), UnpackUnorm8Wide(words[5], 16), octX, octY);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[6]), octX);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[7]), octY);
+
+            // The bitangent sign is -1 or 1, stored as the mask of the comparison
+            __m256 negative = _mm256_cmp_ps(UnpackUnorm8Wide(words[5], 24), _mm256_setzero_ps(), _CMP_LT_OQ);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(fields[8]), _mm256_castps_si256(negative));
+
+            size_t laneCount = count - i < 8 ? count - i : 8;
+            for(size_t l = 0; l < laneCount; ++l)
+            {
+                CompactVertex& out = pOut[i + l];
+                out.positionX = static_cast<int16_t>(fields[0][l]);
+                out.positionY = static_cast<int16_t>(fields[1][l]);
+                out.positionZ = static_cast<int16_t>(fields[2][l]);
+                out.normalX = static_cast<int8_t>(fields[4][l]);
+                out.normalY = static_cast<int8_t>(fields[5][l]);
+                out.uvX = static_cast<uint16_t>(fields[3][l]);
+                out.uvY = static_cast<uint16_t>(static_cast<uint32_t>(fields[3][l]) >> 16);
+                out.tangentX = static_cast<int8_t>(fields[6][l]);
+                out.tangentY = static_cast<int8_t>(fields[7][l]);
+                out.tangentW = fields[8][l] ? -1 : 1;
+                out.padding = 0;
+            }
+        }
+        #endif
+
+        for(; i < count; ++i)
+            EncodeCompactVertex(pVertices[i], center, radius, pOut[i]);
+    }
+}